@@ -153,6 +153,10 @@ BvhAccelerator::BvhAccelerator()
 {
 }
 
+BvhAccelerator::~BvhAccelerator()
+{
+}
+
 void BvhAccelerator::Build(const PrimitiveList& primitives)
 {
     this->primitives = primitives;
@@ -196,6 +200,7 @@ bool BvhAccelerator::Intersects(const Ray& ray, Intersection& hit) const
             continue;
         }
 
+        ++ray.traversalSteps;
         real tEntry, tExit;
         const BvhLinearNode* currentNode = &nodes[currentNodeIndex];
         if (!currentNode->worldBound.Intersects(ray, tEntry, tExit))
@@ -35,6 +35,7 @@ class BvhAccelerator : public AcceleratorPrimitive
 public:
 
     BvhAccelerator();
+    virtual ~BvhAccelerator(); // Defined where the node type is complete
     virtual void Build(const PrimitiveList& primitives);
     virtual bool Intersects(const Ray& ray, Intersection& hit) const;
     virtual BoundingBox WorldBound() const;
@@ -0,0 +1,83 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Accelerators/RaySorting.h"
+#include <algorithm>
+#include "renderbliss/Math/Geometry/BoundingBox.h"
+#include "renderbliss/Math/Geometry/Vector3.h"
+
+namespace
+{
+    using namespace renderbliss;
+
+    enum { CellBits = 9 };
+
+    // Inserts two zero bits between each of the lower 10 bits of a value
+    uint32 SpreadBits(uint32 v)
+    {
+        v = (v | (v << 16)) & 0x030000ff;
+        v = (v | (v <<  8)) & 0x0300f00f;
+        v = (v | (v <<  4)) & 0x030c30c3;
+        v = (v | (v <<  2)) & 0x09249249;
+        return v;
+    }
+
+    // Returns the cell of a coordinate along an axis of the grid
+    uint32 CellCoordinate(real value, real min, real extent)
+    {
+        const real numCells = static_cast<real>(1 << CellBits);
+        real cell = (extent > 0.0f) ? (value-min)/extent*numCells : 0.0f;
+        return static_cast<uint32>(std::min(numCells-1.0f, std::max(0.0f, cell)));
+    }
+}
+
+namespace renderbliss
+{
+bool operator<(const RaySortEntry& lhs, const RaySortEntry& rhs)
+{
+    return lhs.key < rhs.key;
+}
+
+uint32 RaySortKey(const Vector3& origin, const Vector3& direction, const BoundingBox& bound)
+{
+    uint32 octant = ((direction.x < 0.0f) ? 1 : 0) | ((direction.y < 0.0f) ? 2 : 0) | ((direction.z < 0.0f) ? 4 : 0);
+    Vector3 extents = bound.Extents();
+    uint32 x = CellCoordinate(origin.x, bound.Min().x, extents.x);
+    uint32 y = CellCoordinate(origin.y, bound.Min().y, extents.y);
+    uint32 z = CellCoordinate(origin.z, bound.Min().z, extents.z);
+    return (octant << (3*CellBits)) | (SpreadBits(x) << 2) | (SpreadBits(y) << 1) | SpreadBits(z);
+}
+
+uint32 CoherentRayCount(const std::vector<RaySortEntry>& entries)
+{
+    uint32 count = 0;
+    for (size_t i = 1; i < entries.size(); ++i)
+    {
+        if (entries[i].key == entries[i-1].key) ++count;
+    }
+    return count;
+}
+
+void SortRays(std::vector<RaySortEntry>& entries)
+{
+    // Keep the relative order of rays sharing a key, which is usually the order of their pixels
+    std::stable_sort(entries.begin(), entries.end());
+}
+}
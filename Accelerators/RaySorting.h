@@ -0,0 +1,52 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_RAY_SORTING_H
+#define RENDERBLISS_RAY_SORTING_H
+
+#include <vector>
+#include "renderbliss/Types.h"
+
+namespace renderbliss
+{
+class  BoundingBox;
+struct Vector3;
+
+// A ray to be traced in sorted order, referred to by its index in a batch
+struct RaySortEntry
+{
+    uint32 key;
+    uint32 index;
+};
+
+bool operator<(const RaySortEntry& lhs, const RaySortEntry& rhs);
+
+// Returns a key that orders rays by direction octant, then along a Morton curve over the cells of
+// a 512^3 grid spanning a bound, so that rays with nearby origins and similar directions are adjacent.
+uint32 RaySortKey(const Vector3& origin, const Vector3& direction, const BoundingBox& bound);
+
+// Returns the number of consecutive rays of a batch that share their key, as a measure of coherence
+uint32 CoherentRayCount(const std::vector<RaySortEntry>& entries);
+
+// Sorts a batch of rays by key
+void SortRays(std::vector<RaySortEntry>& entries);
+}
+
+#endif
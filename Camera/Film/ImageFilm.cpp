@@ -19,17 +19,72 @@
 // THE SOFTWARE.
 
 #include "renderbliss/Camera/Film/ImageFilm.h"
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <limits>
+#include "renderbliss/Macros.h"
 #include "renderbliss/Interfaces/IFilter.h"
 #include "renderbliss/Math/MathUtils.h"
 #include "renderbliss/ToneMapping/PhotographicToneMapper.h"
 #include "renderbliss/Utils/AtomicOps.h"
 
+namespace
+{
+    using namespace renderbliss;
+
+    template <typename T>
+    byte* Put(byte* buffer, const T& value)
+    {
+        memcpy(buffer, &value, sizeof(value));
+        return buffer + sizeof(value);
+    }
+
+    template <typename T>
+    const byte* Get(const byte* buffer, T& value)
+    {
+        memcpy(&value, buffer, sizeof(value));
+        return buffer + sizeof(value);
+    }
+}
+
 namespace renderbliss
 {
+byte* ImageFilm::WeightedPixel::Store(byte* buffer) const
+{
+    buffer = Put(buffer, pixel.colour.x);
+    buffer = Put(buffer, pixel.colour.y);
+    buffer = Put(buffer, pixel.colour.z);
+    buffer = Put(buffer, pixel.opacity);
+    return Put(buffer, weightSum);
+}
+
+const byte* ImageFilm::WeightedPixel::Restore(const byte* buffer)
+{
+    buffer = Get(buffer, pixel.colour.x);
+    buffer = Get(buffer, pixel.colour.y);
+    buffer = Get(buffer, pixel.colour.z);
+    buffer = Get(buffer, pixel.opacity);
+    return Get(buffer, weightSum);
+}
+
+byte* ImageFilm::PixelMoments::Store(byte* buffer) const
+{
+    buffer = Put(buffer, luminanceSum);
+    buffer = Put(buffer, sqrLuminanceSum);
+    return Put(buffer, sampleCount);
+}
+
+const byte* ImageFilm::PixelMoments::Restore(const byte* buffer)
+{
+    buffer = Get(buffer, luminanceSum);
+    buffer = Get(buffer, sqrLuminanceSum);
+    return Get(buffer, sampleCount);
+}
+
 ImageFilm::ImageFilm(uint32 xResolution, uint32 yResolution, const boost::shared_ptr<IFilter>& filter, const boost::shared_ptr<IToneMapper>& toneMapper)
-    : IFilm(xResolution, yResolution, filter), weightedSamples(XResolution(), YResolution()), toneMapper(toneMapper)
+    : IFilm(xResolution, yResolution, filter), weightedSamples(XResolution(), YResolution()),
+      sampleMoments(XResolution(), YResolution()), toneMapper(toneMapper)
 {
     if (!this->toneMapper)
     {
@@ -39,6 +94,17 @@ ImageFilm::ImageFilm(uint32 xResolution, uint32 yResolution, const boost::shared
 
 void ImageFilm::AddSample(const FilmSample& s)
 {
+    // Accumulate the luminance moments of the pixel holding the sample
+    int xPixel = static_cast<int>(floor(s.imageSample[0]));
+    int yPixel = static_cast<int>(floor(s.imageSample[1]));
+    if ((xPixel >= 0) && (yPixel >= 0) && (xPixel < static_cast<int>(XResolution())) && (yPixel < static_cast<int>(YResolution())))
+    {
+        PixelMoments& moments = sampleMoments(xPixel, yPixel);
+        AtomicAdd(&moments.luminanceSum, s.radianceSample.y);
+        AtomicAdd(&moments.sqrLuminanceSum, s.radianceSample.y*s.radianceSample.y);
+        AtomicIncrement(&moments.sampleCount);
+    }
+
     // Compute sample's raster extent
     real dImageX = s.imageSample[0] - 0.5f; // Discrete coordinate
     real dImageY = s.imageSample[1] - 0.5f; // Discrete coordinate
@@ -78,6 +144,142 @@ void ImageFilm::AddSamples(const std::vector<FilmSample>& samples)
     }
 }
 
+real ImageFilm::RelativeError(uint32 x, uint32 y) const
+{
+    const PixelMoments& moments = sampleMoments(x, y);
+    if (moments.sampleCount < 2) { return std::numeric_limits<real>::infinity(); }
+
+    // Unbiased sample variance, divided by the sample count for the variance of the mean
+    real n = static_cast<real>(moments.sampleCount);
+    real mean = moments.luminanceSum / n;
+    real variance = std::max(0.0f, (moments.sqrLuminanceSum - n*mean*mean) / (n-1.0f));
+    return std::sqrt(variance/n) / std::max(mean, 1.0e-3f);
+}
+
+// The state holds the resolution of the film, followed by its weighted samples and sample moments in scanline order
+void ImageFilm::StoreState(std::vector<byte>& state) const
+{
+    std::vector<WeightedPixel> pixels;
+    std::vector<PixelMoments> moments;
+    weightedSamples.CopyToLinearArray(pixels);
+    sampleMoments.CopyToLinearArray(moments);
+
+    state.resize(2*sizeof(uint32) + pixels.size()*WeightedPixel::storedSize + moments.size()*PixelMoments::storedSize);
+    byte* buffer = Put(&state[0], XResolution());
+    buffer = Put(buffer, YResolution());
+    foreach (const WeightedPixel& wp, pixels)
+    {
+        buffer = wp.Store(buffer);
+    }
+    foreach (const PixelMoments& pm, moments)
+    {
+        buffer = pm.Store(buffer);
+    }
+}
+
+bool ImageFilm::RestoreState(const std::vector<byte>& state)
+{
+    uint32 xResolution = 0, yResolution = 0;
+    size_t nPixels = XResolution()*YResolution();
+    if (state.size() != 2*sizeof(uint32) + nPixels*(WeightedPixel::storedSize + PixelMoments::storedSize))
+    {
+        return false;
+    }
+    const byte* buffer = Get(&state[0], xResolution);
+    buffer = Get(buffer, yResolution);
+    if ((xResolution != XResolution()) || (yResolution != YResolution()))
+    {
+        return false;
+    }
+
+    std::vector<WeightedPixel> pixels(nPixels);
+    std::vector<PixelMoments> moments(nPixels);
+    foreach (WeightedPixel& wp, pixels)
+    {
+        buffer = wp.Restore(buffer);
+    }
+    foreach (PixelMoments& pm, moments)
+    {
+        buffer = pm.Restore(buffer);
+    }
+    weightedSamples = BlockedArray<WeightedPixel>(pixels, XResolution(), YResolution());
+    sampleMoments = BlockedArray<PixelMoments>(moments, XResolution(), YResolution());
+    return true;
+}
+
+// The samples of a region are stored as its weighted samples followed by its sample moments, in scanline order
+void ImageFilm::TakeRegion(const RenderingWorkArea& region, std::vector<byte>& samples)
+{
+    RB_ASSERT((region.xStart >= 0) && (region.yStart >= 0));
+    RB_ASSERT((region.xEnd < static_cast<int>(XResolution())) && (region.yEnd < static_cast<int>(YResolution())));
+    samples.clear();
+    if ((region.xEnd < region.xStart) || (region.yEnd < region.yStart))
+    {
+        return;
+    }
+
+    size_t nPixels = (region.xEnd-region.xStart+1)*(region.yEnd-region.yStart+1);
+    samples.resize(nPixels*(WeightedPixel::storedSize + PixelMoments::storedSize));
+    byte* pixels = &samples[0];
+    byte* moments = &samples[nPixels*WeightedPixel::storedSize];
+    for (int y = region.yStart; y <= region.yEnd; ++y)
+    {
+        for (int x = region.xStart; x <= region.xEnd; ++x)
+        {
+            // Pixels do not start from zero opacity, so only the opacity added by the samples is taken
+            WeightedPixel wp = weightedSamples(x, y);
+            wp.pixel.opacity -= WeightedPixel().pixel.opacity;
+            pixels = wp.Store(pixels);
+            moments = sampleMoments(x, y).Store(moments);
+            weightedSamples(x, y) = WeightedPixel();
+            sampleMoments(x, y) = PixelMoments();
+        }
+    }
+}
+
+bool ImageFilm::MergeRegion(const RenderingWorkArea& region, const std::vector<byte>& samples)
+{
+    if ((region.xEnd < region.xStart) || (region.yEnd < region.yStart))
+    {
+        return samples.empty();
+    }
+    if ((region.xStart < 0) || (region.yStart < 0) ||
+        (region.xEnd >= static_cast<int>(XResolution())) || (region.yEnd >= static_cast<int>(YResolution())))
+    {
+        return false;
+    }
+    size_t nPixels = (region.xEnd-region.xStart+1)*(region.yEnd-region.yStart+1);
+    if (samples.size() != nPixels*(WeightedPixel::storedSize + PixelMoments::storedSize))
+    {
+        return false;
+    }
+
+    const byte* pixels = &samples[0];
+    const byte* moments = &samples[nPixels*WeightedPixel::storedSize];
+    for (int y = region.yStart; y <= region.yEnd; ++y)
+    {
+        for (int x = region.xStart; x <= region.xEnd; ++x)
+        {
+            WeightedPixel wp;
+            PixelMoments pm;
+            pixels = wp.Restore(pixels);
+            moments = pm.Restore(moments);
+
+            WeightedPixel& target = weightedSamples(x, y);
+            AtomicAdd(&target.pixel.colour.x, wp.pixel.colour.x);
+            AtomicAdd(&target.pixel.colour.y, wp.pixel.colour.y);
+            AtomicAdd(&target.pixel.colour.z, wp.pixel.colour.z);
+            AtomicAdd(&target.pixel.opacity, wp.pixel.opacity);
+            AtomicAdd(&target.weightSum, wp.weightSum);
+            PixelMoments& targetMoments = sampleMoments(x, y);
+            AtomicAdd(&targetMoments.luminanceSum, pm.luminanceSum);
+            AtomicAdd(&targetMoments.sqrLuminanceSum, pm.sqrLuminanceSum);
+            AtomicAdd(&targetMoments.sampleCount, pm.sampleCount);
+        }
+    }
+    return true;
+}
+
 void ImageFilm::StorePixels(RGBPixelList& pixels) const
 {
     RGBPixel p;
@@ -95,4 +297,38 @@ void ImageFilm::StorePixels(RGBPixelList& pixels) const
     }
     toneMapper->ApplyImagePipeline(pixels);
 }
+
+void ImageFilm::StoreRegion(const RenderingWorkArea& region, RGBPixelList& pixels) const
+{
+    RB_ASSERT((region.xStart >= 0) && (region.yStart >= 0));
+    RB_ASSERT((region.xEnd < static_cast<int>(XResolution())) && (region.yEnd < static_cast<int>(YResolution())));
+    pixels.clear();
+    if ((region.xEnd < region.xStart) || (region.yEnd < region.yStart))
+    {
+        return;
+    }
+
+    // Pixels no sample reached are left black and transparent.
+    // As in TakeRegion, only the opacity added by the samples is counted.
+    RGBPixel p;
+    pixels.reserve((region.xEnd-region.xStart+1)*(region.yEnd-region.yStart+1));
+    for (int y = region.yStart; y <= region.yEnd; ++y)
+    {
+        for (int x = region.xStart; x <= region.xEnd; ++x)
+        {
+            const WeightedPixel& wp = weightedSamples(x, y);
+            if (wp.weightSum > 0.0f)
+            {
+                p.colour = (wp.pixel.colour / wp.weightSum).ToRGB();
+                p.opacity = (wp.pixel.opacity - WeightedPixel().pixel.opacity) / wp.weightSum;
+            }
+            else
+            {
+                p.colour = RGB::black;
+                p.opacity = 0.0f;
+            }
+            pixels.push_back(p);
+        }
+    }
+}
 }
@@ -37,18 +37,41 @@ public:
 
 private:
 
+    // Pixels are stored into byte buffers field by field, in the number of bytes given by their size constant
     struct WeightedPixel
     {
         XYZPixel pixel;
         float weightSum;
         WeightedPixel() : weightSum(0) {}
+        static const size_t storedSize = 5*sizeof(float);
+        byte* Store(byte* buffer) const;
+        const byte* Restore(const byte* buffer);
+    };
+
+    // Unfiltered luminance moments of the samples taken in a pixel, for estimating their variance
+    struct PixelMoments
+    {
+        float luminanceSum;
+        float sqrLuminanceSum;
+        uint32 sampleCount;
+        PixelMoments() : luminanceSum(0), sqrLuminanceSum(0), sampleCount(0) {}
+        static const size_t storedSize = 2*sizeof(float) + sizeof(uint32);
+        byte* Store(byte* buffer) const;
+        const byte* Restore(const byte* buffer);
     };
 
     BlockedArray<WeightedPixel> weightedSamples;
+    BlockedArray<PixelMoments> sampleMoments;
     boost::shared_ptr<IToneMapper> toneMapper;
     void AddSample(const FilmSample& s);
     void AddSamples(const std::vector<FilmSample>& samples);
     void StorePixels(RGBPixelList& pixels) const;
+    void StoreRegion(const RenderingWorkArea& region, RGBPixelList& pixels) const;
+    real RelativeError(uint32 x, uint32 y) const;
+    void StoreState(std::vector<byte>& state) const;
+    bool RestoreState(const std::vector<byte>& state);
+    void TakeRegion(const RenderingWorkArea& region, std::vector<byte>& samples);
+    bool MergeRegion(const RenderingWorkArea& region, const std::vector<byte>& samples);
 };
 }
 
@@ -344,10 +344,9 @@ bool WriteHeader(std::ostream& os, const RGBEHeaderInfo& headerInfo, uint32 imgW
     return true;
 }
 
-bool WritePixels(std::ostream& os, const RGBPixelList& imgPixels)
+bool WritePixels(std::ostream& os, const RGBPixel* imgPixels, size_t nPixels)
 {
     RGBE rgbe;
-    size_t nPixels = imgPixels.size();
 
     for (size_t i = 0; i < nPixels; ++i)
     {
@@ -403,19 +402,9 @@ bool SaveHDR(const std::string& fileName, const RGBPixelList& pixels, uint32 wid
         return false;
     }
 
-    RGBEHeaderInfo headerInfo;
-    headerInfo.valid = 0;
-    headerInfo.gamma = headerInfo.exposure = 1.0f;
-    memset(headerInfo.comment,0,sizeof(headerInfo.comment));
-    memset(headerInfo.programType,0,sizeof(headerInfo.programType));
-    strncpy(headerInfo.programType, "RADIANCE", strlen("RADIANCE"));
-    strncpy(headerInfo.comment, "Generated by RenderBliss", strlen("Generated by RenderBliss"));
-    headerInfo.valid |= rgbeValidComment;
-    headerInfo.valid |= rgbeValidProgramType;
-
     std::ofstream fout(fileName.c_str(), std::ios_base::binary | std::ios_base::trunc);
 
-    if (!WriteHeader(fout, headerInfo, width, height) || !WritePixels(fout, pixels))
+    if (!WriteHDRHeader(fout, width, height) || !WriteHDRScanlines(fout, &pixels[0], width*height))
     {
         fout.close();
         GLOG_ERROR << "File " << fileName << ": failed to write HDR image.";
@@ -425,4 +414,23 @@ bool SaveHDR(const std::string& fileName, const RGBPixelList& pixels, uint32 wid
     fout.close();
     return true;
 }
+
+bool WriteHDRHeader(std::ostream& os, uint32 width, uint32 height)
+{
+    RGBEHeaderInfo headerInfo;
+    headerInfo.valid = 0;
+    headerInfo.gamma = headerInfo.exposure = 1.0f;
+    memset(headerInfo.comment,0,sizeof(headerInfo.comment));
+    memset(headerInfo.programType,0,sizeof(headerInfo.programType));
+    strncpy(headerInfo.programType, "RADIANCE", strlen("RADIANCE"));
+    strncpy(headerInfo.comment, "Generated by RenderBliss", strlen("Generated by RenderBliss"));
+    headerInfo.valid |= rgbeValidComment;
+    headerInfo.valid |= rgbeValidProgramType;
+    return WriteHeader(os, headerInfo, width, height);
+}
+
+bool WriteHDRScanlines(std::ostream& os, const RGBPixel* pixels, size_t nPixels)
+{
+    return WritePixels(os, pixels, nPixels);
+}
 }
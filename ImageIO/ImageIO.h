@@ -22,6 +22,7 @@
 #define RENDERBLISS_IMAGEIO_H
 
 #include "renderbliss/Colour/Pixel.h"
+#include <ostream>
 #include <string>
 #include "renderbliss/Types.h"
 
@@ -56,6 +57,10 @@ bool SavePNG(const std::string& fileName, const RGBPixelList& pixels, uint32 wid
 bool SaveTGA(const std::string& fileName, const RGBPixelList& pixels, uint32 width, uint32 height); // Only true-color images are supported
 bool SaveImage(const std::string& fileName, const RGBPixelList& pixels, uint32 width, uint32 height); // Will deduce the image format from the file extension
 bool SaveImage(const std::string& fileName, ImageFormat::Enum format, const RGBPixelList& pixels, uint32 width, uint32 height);
+
+// Writes an HDR image to a stream in parts: the header first, then the pixels of the scanlines from top to bottom
+bool WriteHDRHeader(std::ostream& os, uint32 width, uint32 height);
+bool WriteHDRScanlines(std::ostream& os, const RGBPixel* pixels, size_t nPixels);
 }
 
 #endif
@@ -0,0 +1,332 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/ImageIO/TileImageWriter.h"
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <vector>
+#include <IlmImf/ImfHeader.h>
+#include <IlmImf/ImfTiledRgbaFile.h>
+#include <log++/log++.h>
+#include "renderbliss/Macros.h"
+
+namespace renderbliss
+{
+// Writes the tiles of an image in one file format
+class TileImageWriter::Encoder
+{
+public:
+
+    virtual ~Encoder() {}
+    virtual bool WriteTile(const ImageTile& tile) = 0;
+    // Writes the missing tiles and completes the file
+    virtual bool Finish() = 0;
+};
+}
+
+namespace
+{
+using namespace renderbliss;
+
+// Tiled EXR file, with a tile description matching the image tiles
+class TiledEXREncoder : public TileImageWriter::Encoder
+{
+public:
+
+    TiledEXREncoder(const std::string& fileName, uint32 width, uint32 height, uint32 tileSize)
+        : file(fileName.c_str(), MakeHeader(width, height), Imf::WRITE_RGBA, tileSize, tileSize, Imf::ONE_LEVEL),
+          written(file.numXTiles()*file.numYTiles(), false)
+    {
+    }
+
+    bool WriteTile(const ImageTile& tile)
+    {
+        int xTile = static_cast<int>(tile.x/file.tileXSize());
+        int yTile = static_cast<int>(tile.y/file.tileYSize());
+        if (!file.isValidTile(xTile, yTile, 0, 0))
+        {
+            GLOG_ERROR << "Tile at " << tile.x << ", " << tile.y << " is outside the EXR image";
+            return false;
+        }
+        imfPixels.clear();
+        foreach (const RGBPixel& p, tile.pixels)
+        {
+            imfPixels.push_back(Imf::Rgba(p.colour.r, p.colour.g, p.colour.b, p.opacity));
+        }
+        written[yTile*file.numXTiles() + xTile] = true;
+        return Write(xTile, yTile, tile.x, tile.y, tile.width);
+    }
+
+    bool Finish()
+    {
+        for (int yTile = 0; yTile < file.numYTiles(); ++yTile)
+        {
+            for (int xTile = 0; xTile < file.numXTiles(); ++xTile)
+            {
+                if (!written[yTile*file.numXTiles() + xTile])
+                {
+                    imfPixels.assign(file.tileXSize()*file.tileYSize(), Imf::Rgba(0.0f, 0.0f, 0.0f, 0.0f));
+                    uint32 x = xTile*file.tileXSize();
+                    uint32 y = yTile*file.tileYSize();
+                    if (!Write(xTile, yTile, x, y, file.tileXSize()))
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+
+    Imf::TiledRgbaOutputFile file;
+    std::vector<bool> written;
+    std::vector<Imf::Rgba> imfPixels;
+
+    // Tiles are written in the order they arrive, rather than by increasing y
+    static Imf::Header MakeHeader(uint32 width, uint32 height)
+    {
+        Imf::Header header(static_cast<int>(width), static_cast<int>(height));
+        header.lineOrder() = Imf::RANDOM_Y;
+        return header;
+    }
+
+    bool Write(int xTile, int yTile, uint32 x, uint32 y, uint32 tileWidth)
+    {
+        try
+        {
+            file.setFrameBuffer(&imfPixels[0] - x - y*tileWidth, 1, tileWidth);
+            file.writeTile(xTile, yTile);
+        }
+        catch(std::exception& exc)
+        {
+            GLOG_ERROR << "Error occurred while writing an EXR tile";
+            if (strlen(exc.what()))
+            {
+                GLOG_ERROR << exc.what();
+            }
+            return false;
+        }
+        return true;
+    }
+};
+
+// HDR file, whose scanlines are written once complete and all the scanlines above are written
+class ScanlineHDREncoder : public TileImageWriter::Encoder
+{
+public:
+
+    ScanlineHDREncoder(const std::string& fileName, uint32 width, uint32 height)
+        : fout(fileName.c_str(), std::ios_base::binary | std::ios_base::trunc),
+          width(width), scanlines(height), pixelCounts(height, 0), nextScanline(0)
+    {
+        succeeded = WriteHDRHeader(fout, width, height);
+    }
+
+    bool WriteTile(const ImageTile& tile)
+    {
+        for (uint32 j = 0; j < tile.height; ++j)
+        {
+            RGBPixelList& scanline = scanlines[tile.y+j];
+            scanline.resize(width, RGBPixel(RGB::black, 0.0f));
+            std::copy(tile.pixels.begin() + j*tile.width, tile.pixels.begin() + (j+1)*tile.width, scanline.begin() + tile.x);
+            pixelCounts[tile.y+j] += tile.width;
+        }
+        while (succeeded && (nextScanline < scanlines.size()) && (pixelCounts[nextScanline] >= width))
+        {
+            WriteNextScanline();
+        }
+        return succeeded;
+    }
+
+    bool Finish()
+    {
+        while (succeeded && (nextScanline < scanlines.size()))
+        {
+            scanlines[nextScanline].resize(width, RGBPixel(RGB::black, 0.0f));
+            WriteNextScanline();
+        }
+        fout.close();
+        return succeeded;
+    }
+
+private:
+
+    std::ofstream fout;
+    uint32 width;
+    std::vector<RGBPixelList> scanlines;
+    std::vector<uint32> pixelCounts;
+    size_t nextScanline;
+    bool succeeded;
+
+    // The pixels of written scanlines are released
+    void WriteNextScanline()
+    {
+        succeeded = WriteHDRScanlines(fout, &scanlines[nextScanline][0], width);
+        RGBPixelList().swap(scanlines[nextScanline]);
+        ++nextScanline;
+    }
+};
+
+// Any other format, whose image is kept in memory and saved once complete
+class BufferedEncoder : public TileImageWriter::Encoder
+{
+public:
+
+    BufferedEncoder(const std::string& fileName, uint32 width, uint32 height)
+        : fileName(fileName), width(width), height(height), pixels(width*height, RGBPixel(RGB::black, 0.0f))
+    {
+    }
+
+    bool WriteTile(const ImageTile& tile)
+    {
+        for (uint32 j = 0; j < tile.height; ++j)
+        {
+            std::copy(tile.pixels.begin() + j*tile.width, tile.pixels.begin() + (j+1)*tile.width,
+                      pixels.begin() + (tile.y+j)*width + tile.x);
+        }
+        return true;
+    }
+
+    bool Finish()
+    {
+        return SaveImage(fileName, pixels, width, height);
+    }
+
+private:
+
+    std::string fileName;
+    uint32 width, height;
+    RGBPixelList pixels;
+};
+}
+
+namespace renderbliss
+{
+TileImageWriter::TileImageWriter(const std::string& fileName, uint32 width, uint32 height, uint32 tileSize)
+    : fileName(fileName), width(width), height(height), tileSize(std::max(1u, tileSize)), succeeded(true), done(false)
+{
+    GLOG_INFO << "Streaming image tiles to " << fileName;
+
+    try
+    {
+        switch (GetImageFormat(fileName))
+        {
+        case ImageFormat::EXR:
+            encoder.reset(new TiledEXREncoder(fileName, width, height, this->tileSize));
+            break;
+
+        case ImageFormat::HDR:
+            encoder.reset(new ScanlineHDREncoder(fileName, width, height));
+            break;
+
+        default:
+            encoder.reset(new BufferedEncoder(fileName, width, height));
+            break;
+        }
+    }
+    catch(std::exception& exc)
+    {
+        succeeded = false;
+        GLOG_ERROR << "Error occurred while opening " << fileName;
+        if (strlen(exc.what()))
+        {
+            GLOG_ERROR << exc.what();
+        }
+    }
+
+    thread = boost::thread(&TileImageWriter::WriteQueuedTiles, this);
+}
+
+TileImageWriter::~TileImageWriter()
+{
+    Close();
+}
+
+void TileImageWriter::Write(ImageTile& tile)
+{
+    RB_ASSERT((tile.x%tileSize == 0) && (tile.y%tileSize == 0));
+    RB_ASSERT((tile.x + tile.width <= width) && (tile.y + tile.height <= height));
+    RB_ASSERT(tile.pixels.size() == tile.width*tile.height);
+    boost::shared_ptr<ImageTile> queuedTile(new ImageTile);
+    queuedTile->x = tile.x;
+    queuedTile->y = tile.y;
+    queuedTile->width = tile.width;
+    queuedTile->height = tile.height;
+    queuedTile->pixels.swap(tile.pixels);
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        queuedTiles.push_back(queuedTile);
+    }
+    tileQueued.notify_one();
+}
+
+bool TileImageWriter::Close()
+{
+    if (thread.joinable())
+    {
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            done = true;
+        }
+        tileQueued.notify_one();
+        thread.join();
+        if (!succeeded)
+        {
+            GLOG_ERROR << "File " << fileName << ": failed to write the image tiles.";
+        }
+    }
+    return succeeded;
+}
+
+void TileImageWriter::WriteQueuedTiles()
+{
+    for (;;)
+    {
+        boost::shared_ptr<ImageTile> tile;
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            while (queuedTiles.empty() && !done)
+            {
+                tileQueued.wait(lock);
+            }
+            if (queuedTiles.empty())
+            {
+                break;
+            }
+            tile = queuedTiles.front();
+            queuedTiles.pop_front();
+        }
+        if (succeeded)
+        {
+            succeeded = encoder->WriteTile(*tile);
+        }
+    }
+
+    // The encoder closes its file when destroyed
+    if (succeeded)
+    {
+        succeeded = encoder->Finish();
+    }
+    encoder.reset();
+}
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_TILEIMAGEWRITER_H
+#define RENDERBLISS_TILEIMAGEWRITER_H
+
+#include <deque>
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Colour/Pixel.h"
+#include "renderbliss/ImageIO/ImageIO.h"
+
+namespace renderbliss
+{
+// A rectangle of pixels of an image, in scanline order
+struct ImageTile
+{
+    uint32 x, y;
+    uint32 width, height;
+    RGBPixelList pixels;
+};
+
+// Writes an image on a background thread as its tiles are rendered, so that output overlaps with rendering.
+// Tiles must lie on a grid of square tiles of a given size, and may be written in any order.
+// EXR images are written as tiled files in the order the tiles arrive, and HDR images scanline by scanline,
+// as soon as the tiles of all the scanlines above are written. Other formats are saved once the image is closed.
+// Tiles missing when the image is closed are left black.
+class TileImageWriter : boost::noncopyable
+{
+public:
+
+    TileImageWriter(const std::string& fileName, uint32 width, uint32 height, uint32 tileSize);
+    // Closes the image if it is still open
+    ~TileImageWriter();
+
+    // Queues a tile for writing. Its pixels are swapped out, to avoid copying them. Can be called from any thread.
+    void Write(ImageTile& tile);
+
+    // Waits for the queued tiles to be written and completes the image. Returns false if the image could not be written.
+    bool Close();
+
+    class Encoder;
+
+private:
+
+    std::string fileName;
+    uint32 width, height;
+    uint32 tileSize;
+    boost::scoped_ptr<Encoder> encoder;
+    bool succeeded;
+    boost::mutex mutex;
+    boost::condition_variable tileQueued;
+    std::deque<boost::shared_ptr<ImageTile> > queuedTiles;
+    bool done;
+    boost::thread thread;
+
+    void WriteQueuedTiles();
+};
+}
+
+#endif
@@ -47,7 +47,7 @@ DirectIlluminationIntegrator::DirectIlluminationIntegrator(const PropertyMap& pr
 
 void DirectIlluminationIntegrator::PreProcess(const Scene& scene)
 {
-    powerDistribution.reset(PowerDistribution(scene).release());
+    lightBvh.reset(new LightBvh(scene.Lights()));
 }
 
 Spectrum DirectIlluminationIntegrator::Radiance(const Scene& scene, const Ray& ray, MersenneTwister& rng, real& opacity) const
@@ -56,7 +56,7 @@ Spectrum DirectIlluminationIntegrator::Radiance(const Scene& scene, const Ray& r
     Spectrum L;
     if (scene.Intersects(ray, hit))
     {
-        L = DirectIllumination(scene, -ray.Direction().GetNormalized(), hit, powerDistribution.get(), settings.numShadowRays, rng, opacity, stats.Counter("Rays", "Shadow rays traced"));
+        L = DirectIllumination(scene, -ray.Direction().GetNormalized(), hit, lightBvh.get(), settings.numShadowRays, rng, opacity, stats.Counter("Rays", "Shadow rays traced"));
     }
     ++stats.Counter("Rays", "Primary rays traced");
     return L;
@@ -23,6 +23,8 @@
 #include "renderbliss/Scene.h"
 #include "renderbliss/Interfaces/ILight.h"
 #include "renderbliss/Interfaces/IMaterial.h"
+#include "renderbliss/Lights/LightBvh.h"
+#include "renderbliss/Lights/Luminaire.h"
 #include "renderbliss/Lights/StepFunctionSampler.h"
 #include "renderbliss/Math/MersenneTwister.h"
 #include "renderbliss/Math/Geometry/Intersection.h"
@@ -30,6 +32,25 @@
 #include "renderbliss/Math/Sampling/SamplingFunctions.h"
 #include "renderbliss/Utils/AtomicOps.h"
 
+namespace
+{
+using namespace renderbliss;
+
+// Selects a light source for direct illumination sampling. Lights are picked uniformly without a light BVH.
+// Returns false if no light can illuminate the intersection.
+bool PickLight(const LightBvh* lightBvh, size_t numLights, const Intersection& hit, MersenneTwister& rng, size_t& pick, real& pickPdf)
+{
+    if (!lightBvh)
+    {
+        pick = rng.RandomUint(numLights-1);
+        pickPdf = 1.0f/numLights;
+        return true;
+    }
+    if (!lightBvh->SampleIndex(hit.point, hit.uvn.N(), rng.CanonicalRandom(), pick, pickPdf)) return false;
+    return pickPdf > 0.0f;
+}
+}
+
 namespace renderbliss
 {
 std::auto_ptr<StepFunctionSampler> PowerDistribution(const Scene& scene)
@@ -43,9 +64,10 @@ std::auto_ptr<StepFunctionSampler> PowerDistribution(const Scene& scene)
 }
 
 Spectrum DirectIllumination(const Scene& scene, const Vector3& toViewer, const Intersection& hit,
-                            const StepFunctionSampler* powerDistribution, uint32 numShadowRays,
+                            const LightBvh* lightBvh, uint32 numShadowRays,
                             MersenneTwister& rng, real& opacity, AtomicCounter& numTracedShadowRays)
 {
+    RB_UNUSED(opacity);
     Spectrum Ld(Spectrum::black);
     const LightPtrList& lights = scene.Lights();
     if (!hit.triangle || !hit.material || lights.empty() || !numShadowRays)
@@ -58,8 +80,10 @@ Spectrum DirectIllumination(const Scene& scene, const Vector3& toViewer, const I
     GenerateLatinHypercubeSamples(rng, lightSamples, numShadowRays, 2);
 
     // Select light source to sample
-    size_t pick = powerDistribution ? powerDistribution->SampleIndex(rng.CanonicalRandom()) : rng.RandomUint(lights.size()-1);
-    RB_ASSERT((pick >= 0) && (pick < lights.size()));
+    size_t pick;
+    real pickPdf;
+    if (!PickLight(lightBvh, lights.size(), hit, rng, pick, pickPdf)) return Ld;
+    RB_ASSERT(pick < lights.size());
     LightConstPtr lightToSample = lights[pick];
 
     // Accumulate the direct illumination
@@ -93,8 +117,87 @@ Spectrum DirectIllumination(const Scene& scene, const Vector3& toViewer, const I
         ++numTracedShadowRays;
     }
 
-    opacity *= 1.0f;
-    Ld *= static_cast<real>(lights.size())/numShadowRays;
+    Ld /= pickPdf*numShadowRays;
+    return Ld;
+}
+
+Spectrum MisDirectIllumination(const Scene& scene, const Vector3& toViewer, const Intersection& hit,
+                               const LightBvh* lightBvh, uint32 numShadowRays,
+                               MersenneTwister& rng, real& opacity, AtomicCounter& numTracedShadowRays)
+{
+    RB_UNUSED(opacity);
+    Spectrum Ld(Spectrum::black);
+    const LightPtrList& lights = scene.Lights();
+    if (!hit.triangle || !hit.material || lights.empty() || !numShadowRays)
+    {
+        return Ld;
+    }
+
+    // Delta components can only be handled by BSDF sampling, which is left to the integrators
+    const int bsdfFlags = BsdfCombinedFlags::All & ~BsdfCombinedFlags::Delta;
+    if (!hit.material->MatchesFlags(bsdfFlags))
+    {
+        return Ld;
+    }
+
+    // Request light and BSDF samples
+    std::vector<real> lightSamples, bsdfSamples;
+    GenerateLatinHypercubeSamples(rng, lightSamples, numShadowRays, 2);
+    GenerateLatinHypercubeSamples(rng, bsdfSamples, numShadowRays, 3);
+
+    // Select light source to sample
+    size_t pick;
+    real pickPdf;
+    if (!PickLight(lightBvh, lights.size(), hit, rng, pick, pickPdf)) return Ld;
+    RB_ASSERT(pick < lights.size());
+    LightConstPtr lightToSample = lights[pick];
+
+    // Accumulate the direct illumination
+    Sample2D lightSample;
+    for (size_t i = 0; i < numShadowRays; ++i)
+    {
+        // Sample the light source, and weight the sample against the BSDF PDF
+        lightSample[0] = lightSamples[2*i];
+        lightSample[1] = lightSamples[2*i+1];
+        LightSamplingRecord lrec(rng, hit, lightSample);
+        lightToSample->SampleIncidentDirection(hit, lrec);
+        if ((lrec.pdf > 0.0f) && !lrec.emittedRadiance.IsBlack())
+        {
+            Spectrum bsdfValue = hit.material->BsdfCombinedFlagsValue(lrec.toLight, toViewer, hit, bsdfFlags);
+            if (!bsdfValue.IsBlack())
+            {
+                if (!lrec.occlusionTester.FindOcclusion(scene))
+                {
+                    real bsdfPdf = hit.material->BsdfCombinedFlagsPdf(toViewer, lrec.toLight, hit, bsdfFlags);
+                    real weight = (bsdfPdf > 0.0f) ? PowerHeuristic(numShadowRays, lrec.pdf, numShadowRays, bsdfPdf) : 1.0f;
+                    Ld += weight*lrec.emittedRadiance*bsdfValue*AbsDotProduct(hit.uvn.N(), lrec.toLight) / lrec.pdf;
+                }
+                ++numTracedShadowRays;
+            }
+        }
+
+        // Sample the BSDF, and weight the sample against the light PDF
+        BsdfSamplingRecord brec(hit, &bsdfSamples[3*i], bsdfFlags);
+        hit.material->SampleBsdf(toViewer, brec);
+        if ((brec.pdf <= 0.0f) || brec.value.IsBlack()) continue;
+
+        // Skip the ray if the sampled direction cannot reach the light
+        real lightPdf = lightToSample->Pdf(hit.point, hit.triangle, brec.sampledDirection);
+        if (lightPdf <= 0.0f) continue;
+
+        Intersection lightHit;
+        Ray ray(hit.point, brec.sampledDirection);
+        if (scene.Intersects(ray, lightHit) && (lightHit.emitter == lightToSample.get()))
+        {
+            Spectrum Le = lightHit.emitter->EmittedRadiance(lightHit.uvn.N(), -brec.sampledDirection);
+            real weight = PowerHeuristic(numShadowRays, brec.pdf, numShadowRays, lightPdf);
+            Ld += weight*Le*brec.value*AbsDotProduct(hit.uvn.N(), brec.sampledDirection) / brec.pdf;
+        }
+        ++numTracedShadowRays;
+    }
+
+    // Both strategies are conditioned on the light pick
+    Ld /= pickPdf*numShadowRays;
     return Ld;
 }
 
@@ -29,6 +29,7 @@ namespace renderbliss
 {
 class  AtomicCounter;
 struct Intersection;
+class  LightBvh;
 class  MersenneTwister;
 class  Scene;
 class  StepFunctionSampler;
@@ -36,10 +37,17 @@ struct Vector3;
 
 std::auto_ptr<StepFunctionSampler> PowerDistribution(const Scene& scene);
 
+// Estimates the direct illumination from a single light source, picked with the light BVH if one is given.
 Spectrum DirectIllumination(const Scene& scene, const Vector3& toViewer, const Intersection& hit,
-                            const StepFunctionSampler* powerDistribution, uint32 numShadowRays,
+                            const LightBvh* lightBvh, uint32 numShadowRays,
                             MersenneTwister& rng, real& opacity, AtomicCounter& numTracedShadowRays);
 
+// Estimates the direct illumination by combining light and BSDF sampling with multiple importance sampling.
+// Each of the 'numShadowRays' light samples is paired with a BSDF sample, which is weighted with the power heuristic.
+Spectrum MisDirectIllumination(const Scene& scene, const Vector3& toViewer, const Intersection& hit,
+                               const LightBvh* lightBvh, uint32 numShadowRays,
+                               MersenneTwister& rng, real& opacity, AtomicCounter& numTracedShadowRays);
+
 Spectrum LightingPower(const Scene& scene);
 }
 
@@ -0,0 +1,166 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Integrators/IrradianceCache.h"
+#include <algorithm>
+#include <cmath>
+#include <boost/thread/locks.hpp>
+#include "renderbliss/Macros.h"
+#include "renderbliss/Math/MathUtils.h"
+
+namespace
+{
+    using namespace renderbliss;
+
+    // Returns the bound of one of the eight octants of a box
+    BoundingBox OctantBound(const BoundingBox& bound, uint32 octant)
+    {
+        Vector3 center = bound.Center();
+        Vector3 minCorner, maxCorner;
+        for (uint32 i = 0; i < 3; ++i)
+        {
+            bool upper = (octant & (1 << i)) != 0;
+            minCorner[i] = upper ? center[i] : bound.Min()[i];
+            maxCorner[i] = upper ? bound.Max()[i] : center[i];
+        }
+        return BoundingBox(minCorner, maxCorner);
+    }
+
+    bool Overlaps(const BoundingBox& a, const BoundingBox& b)
+    {
+        for (uint32 i = 0; i < 3; ++i)
+        {
+            if ((a.Max()[i] < b.Min()[i]) || (a.Min()[i] > b.Max()[i])) return false;
+        }
+        return true;
+    }
+
+    Spectrum GradientDotProduct(const boost::array<Spectrum, 3>& gradient, const Vector3& v)
+    {
+        return gradient[0]*v[0] + gradient[1]*v[1] + gradient[2]*v[2];
+    }
+}
+
+namespace renderbliss
+{
+IrradianceCache::Node::Node()
+{
+    children.assign(0);
+}
+
+IrradianceCache::IrradianceCache(const BoundingBox& bound, real maxError)
+    : bound(bound), maxError(maxError), nodes(1)
+{
+    RB_ASSERT(maxError > 0.0f);
+}
+
+bool IrradianceCache::Interpolate(const Vector3& point, const Vector3& normal, Spectrum& irradiance) const
+{
+    boost::shared_lock<boost::shared_mutex> lock(mutex);
+
+    Spectrum weightedIrradiance(Spectrum::black);
+    real sumWeights = 0.0f;
+    uint32 nodeIndex = 0;
+    BoundingBox nodeBound = bound;
+    for (;;)
+    {
+        foreach (uint32 recordIndex, nodes[nodeIndex].records)
+        {
+            const IrradianceRecord& record = records[recordIndex];
+
+            // Skip records in front of the point, which see surfaces that the point does not see
+            Vector3 offset = point - record.position;
+            if (DotProduct(offset, normal + record.normal) < -0.02f*record.harmonicMeanDistance) continue;
+
+            // Ward's error estimate, from the distance and the normal divergence
+            real error =   offset.Norm()/record.harmonicMeanDistance
+                         + std::sqrt(std::max(0.0f, 1.0f - DotProduct(normal, record.normal)));
+            if (error >= maxError) continue;
+
+            real weight = 1.0f / std::max(error, 1.0e-3f);
+            Spectrum E =   record.irradiance
+                         + GradientDotProduct(record.rotationalGradient, CrossProduct(record.normal, normal))
+                         + GradientDotProduct(record.translationalGradient, offset);
+            weightedIrradiance += weight*E;
+            sumWeights += weight;
+        }
+
+        // Descend into the octant holding the point
+        Vector3 center = nodeBound.Center();
+        uint32 octant = ((point[0] > center[0]) ? 1 : 0) | ((point[1] > center[1]) ? 2 : 0) | ((point[2] > center[2]) ? 4 : 0);
+        uint32 child = nodes[nodeIndex].children[octant];
+        if (!child) break;
+        nodeIndex = child;
+        nodeBound = OctantBound(nodeBound, octant);
+    }
+
+    if (sumWeights <= 0.0f) return false;
+    irradiance = weightedIrradiance / sumWeights;
+    irradiance.Clamp(0.0f, Infinity());
+    return true;
+}
+
+void IrradianceCache::Add(const IrradianceRecord& record)
+{
+    // The record is used within a distance of maxError times its harmonic mean distance
+    real validityRadius = maxError*record.harmonicMeanDistance;
+    Vector3 extent(validityRadius, validityRadius, validityRadius);
+    BoundingBox recordBound(record.position - extent, record.position + extent);
+
+    boost::unique_lock<boost::shared_mutex> lock(mutex);
+    uint32 recordIndex = static_cast<uint32>(records.size());
+    records.push_back(record);
+    Insert(0, bound, recordIndex, recordBound, 0);
+}
+
+void IrradianceCache::Insert(uint32 nodeIndex, const BoundingBox& nodeBound, uint32 recordIndex, const BoundingBox& recordBound, uint32 depth)
+{
+    // Records are kept in the deepest nodes that are still larger than their validity bound
+    if ((depth == MaxDepth) || (nodeBound.Extents().SquaredNorm() < 4.0f*recordBound.Extents().SquaredNorm()))
+    {
+        nodes[nodeIndex].records.push_back(recordIndex);
+        return;
+    }
+
+    for (uint32 octant = 0; octant < 8; ++octant)
+    {
+        BoundingBox childBound = OctantBound(nodeBound, octant);
+        if (!Overlaps(childBound, recordBound)) continue;
+        if (!nodes[nodeIndex].children[octant])
+        {
+            // Children are created before recursing, since the node storage may be reallocated
+            nodes[nodeIndex].children[octant] = static_cast<uint32>(nodes.size());
+            nodes.push_back(Node());
+        }
+        Insert(nodes[nodeIndex].children[octant], childBound, recordIndex, recordBound, depth+1);
+    }
+}
+
+size_t IrradianceCache::RecordCount() const
+{
+    boost::shared_lock<boost::shared_mutex> lock(mutex);
+    return records.size();
+}
+
+real IrradianceCache::MaxError() const
+{
+    return maxError;
+}
+}
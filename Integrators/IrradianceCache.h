@@ -0,0 +1,88 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_IRRADIANCE_CACHE_H
+#define RENDERBLISS_IRRADIANCE_CACHE_H
+
+#include <vector>
+#include <boost/array.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Colour/Spectrum.h"
+#include "renderbliss/Math/Geometry/BoundingBox.h"
+#include "renderbliss/Math/Geometry/Vector3.h"
+
+namespace renderbliss
+{
+// Irradiance sampled over the hemisphere of a surface point, along with its gradients
+struct IrradianceRecord
+{
+    Vector3 position;
+    Vector3 normal;
+    Spectrum irradiance;
+    boost::array<Spectrum, 3> rotationalGradient; // World space x, y and z components
+    boost::array<Spectrum, 3> translationalGradient;
+    real harmonicMeanDistance; // Harmonic mean distance to the surfaces seen from the record
+};
+
+// Irradiance cache after Ward et al., interpolating sparse irradiance records with their gradients.
+// Records are stored in an octree, which may be read and extended concurrently by several threads.
+class IrradianceCache : boost::noncopyable
+{
+public:
+
+    // The error bound, 'a' in Ward's paper, sets how far from a record its irradiance is interpolated
+    IrradianceCache(const BoundingBox& bound, real maxError);
+
+    // Interpolates the irradiance at a surface point from the records, and returns
+    // whether any record was close enough to the point, given the error bound.
+    bool Interpolate(const Vector3& point, const Vector3& normal, Spectrum& irradiance) const;
+
+    // Adds a record to the cache
+    void Add(const IrradianceRecord& record);
+
+    // Returns the number of records in the cache
+    size_t RecordCount() const;
+
+    real MaxError() const;
+
+private:
+
+    enum { MaxDepth = 16 };
+
+    struct Node
+    {
+        boost::array<uint32, 8> children; // Zero for missing children, since the root is nobody's child
+        std::vector<uint32> records; // Records whose validity bounds are about as large as the node
+        Node();
+    };
+
+    BoundingBox bound;
+    real maxError;
+    std::vector<Node> nodes;
+    std::vector<IrradianceRecord> records;
+    mutable boost::shared_mutex mutex;
+
+    void Insert(uint32 nodeIndex, const BoundingBox& nodeBound, uint32 recordIndex, const BoundingBox& recordBound, uint32 depth);
+};
+}
+
+#endif
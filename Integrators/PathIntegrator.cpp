@@ -68,7 +68,7 @@ Spectrum PathIntegrator::IndirectIllumination(const Scene& scene, const Vector3&
 
 void PathIntegrator::PreProcess(const Scene& scene, JobScheduler&)
 {
-    powerDistribution.reset(PowerDistribution(scene).release());
+    lightBvh.reset(new LightBvh(scene.Lights()));
 }
 
 Spectrum PathIntegrator::Radiance(const Scene& scene, const Ray& ray, MersenneTwister& rng, real& opacity) const
@@ -90,7 +90,7 @@ Spectrum PathIntegrator::Radiance(const Scene& scene, const Ray& ray, MersenneTw
         L += hit.emitter->EmittedRadiance(hit.uvn.N(), toViewer);
     }
 
-    L += DirectIllumination(scene, toViewer, hit, powerDistribution.get(), settings.numShadowRays, rng, opacity, stats.Counter("Rays", "Shadow rays traced"));
+    L += MisDirectIllumination(scene, toViewer, hit, lightBvh.get(), settings.numShadowRays, rng, opacity, stats.Counter("Rays", "Shadow rays traced"));
     L += IndirectIllumination(scene, toViewer, hit, ray.depth, rng, opacity);
 
     return L;
@@ -24,7 +24,7 @@
 #include <boost/scoped_ptr.hpp>
 #include "renderbliss/Types.h"
 #include "renderbliss/Integrators/SurfaceIntegrator.h"
-#include "renderbliss/Lights/StepFunctionSampler.h"
+#include "renderbliss/Lights/LightBvh.h"
 
 namespace renderbliss
 {
@@ -33,6 +33,7 @@ class StatsTracker;
 struct Vector3;
 
 // A surface integrator implementing stochastic path tracing
+// Direct illumination is estimated by multiple importance sampling of the lights and BSDFs
 // Mostly intended for rendering reference images
 class PathIntegrator : public SurfaceIntegrator
 {
@@ -54,7 +55,7 @@ private:
         uint32 numShadowRays;
         Settings(const PropertyMap& props);
     } settings;
-    boost::scoped_ptr<StepFunctionSampler> powerDistribution; // Lighting power distribution
+    boost::scoped_ptr<LightBvh> lightBvh; // Hierarchy for picking the lights to sample
 
     // Returns the indirect illumination along a ray being cast into the scene
     Spectrum IndirectIllumination(const Scene& scene, const Vector3& toViewer, const Intersection& hit, uint32 depth, MersenneTwister& rng, real& opacity) const;
@@ -20,283 +20,133 @@
 
 #include "renderbliss/Integrators/PhotonIntegrator.h"
 #include <algorithm>
+#include <cmath>
 #include <cstdlib>
-#include <boost/thread.hpp>
-#include <boost/thread/mutex.hpp>
+#include <cstring>
 #include <ctime>
+#include <fstream>
+#include <typeinfo>
+#include <log++/Log++.h>
 #include "renderbliss/Scene.h"
+#include "renderbliss/Accelerators/RaySorting.h"
 #include "renderbliss/Integrators/DirectIlluminationUtils.h"
+#include "renderbliss/Integrators/IrradianceCache.h"
 #include "renderbliss/Integrators/PhotonMapping/PhotonMap.h"
+#include "renderbliss/Integrators/PhotonMapping/PhotonShootingJob.h"
 #include "renderbliss/Interfaces/IJob.h"
 #include "renderbliss/Interfaces/ILight.h"
 #include "renderbliss/Interfaces/IMaterial.h"
 #include "renderbliss/Lights/Luminaire.h"
 #include "renderbliss/Math/MathUtils.h"
 #include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Math/Geometry/Basis3.h"
+#include "renderbliss/Math/Geometry/BoundingBox.h"
+#include "renderbliss/Math/Geometry/DirectionCone.h"
 #include "renderbliss/Math/Geometry/Intersection.h"
 #include "renderbliss/Math/Sampling/SamplingFunctions.h"
+#include "renderbliss/Primitives/MeshPrimitive.h"
 #include "renderbliss/Utils/Utils.h"
 #include "renderbliss/Utils/JobScheduler.h"
 #include "renderbliss/Utils/StatsTracker.h"
 
-namespace renderbliss
-{
-// Helper class to generate a scrambled Halton sequence as to minimize
-// correlation problems in higher dimensions and in a concurrent usage
-class PermutedHalton
+namespace
 {
-public:
-
-    PermutedHalton(uint32 numDimensions, MersenneTwister& rng);
-    template <unsigned NumSampledDimensions>
-    void NthSample(uint32 n, boost::array<real, NumSampledDimensions>& sample) const;
-
-private:
-
-    std::vector<uint32> bases;
-    std::vector<uint32> permutations;
-    uint32 numDimensions;
-    mutable MersenneTwister& rng;
-};
+    using namespace renderbliss;
 
-// Job class for photon shooting parallelization
-class PhotonShootingJob : public IJob
-{
-public:
-
-    PhotonShootingJob(uint32 maxPhotonDepth, const Scene& scene, const StepFunctionSampler* powerDistribution,
-                      StatsTracker& stats, IrradiancePhotonMap& sharedIndirectMap, CausticPhotonMap& sharedCausticMap,
-                      DirectPhotonMap& sharedDirectMap, boost::mutex& sharedMutex);
-    virtual void Run() const;
-
-private:
-
-    mutable MersenneTwister rng;
-    PermutedHalton halton;
-
-    // Local photon data for delayed storage into the shared photon maps
-    mutable struct
-    {
-        std::vector<Vector3> directions;
-        std::vector<Vector3> positions;
-        std::vector<Spectrum> powers;
-        void Clear() { directions.clear(), positions.clear(), powers.clear(); };
-    } causticPhotons, directPhotons;
-    mutable struct
-    {
-        std::vector<Vector3> directions;
-        std::vector<Vector3> positions;
-        std::vector<Vector3> normals;
-        std::vector<Spectrum> powers;
-        void Clear() { directions.clear(), positions.clear(), normals.clear(), powers.clear(); };
-    } indirectPhotons;
-
-    // Maximum number of bounces per photon
-    const uint32 maxPhotonDepth;
-
-    // Scene in which the photons will be emitted
-    const Scene& scene;
-
-    // Lighting power distribution
-    const StepFunctionSampler* powerDistribution;
-
-    // Shared members will be written concurrently
-    mutable StatsTracker& stats;
-    mutable IrradiancePhotonMap& sharedIndirectMap;
-    mutable CausticPhotonMap& sharedCausticMap;
-    mutable DirectPhotonMap& sharedDirectMap;
-    mutable boost::mutex& sharedMutex;
-
-    // Track whether the shared maps are full
-    mutable bool causticDone;
-    mutable bool indirectDone;
-};
-}
+    enum { PhotonMapFileMagic = 0x46505242 }; // "RBPF"
+    enum { PhotonMapFileVersion = 1 };
 
-namespace renderbliss
-{
-PermutedHalton::PermutedHalton(uint32 numDimensions, MersenneTwister& rng)
-    : numDimensions(numDimensions), rng(rng)
-{
-    // Initialize bases
-    uint32 sumBases = 0;
-    bases.reserve(this->numDimensions);
-    for (uint32 i = 0; i < numDimensions; ++i)
-    {
-        uint32 prime = Prime(i);
-        bases.push_back(prime);
-        sumBases += prime;
-    }
-
-    // Generate one permutation per dimension
-    permutations.reserve(sumBases);
-    uint32 permStart = 0;
-    for (uint32 i = 0; i < numDimensions; ++i)
+    // Accumulates bytes into a 32-bit FNV-1a hash
+    void HashBytes(const void* data, size_t size, uint32& hash)
     {
-        for (uint32 j = 0; j < bases[i]; ++j)
+        const byte* bytes = static_cast<const byte*>(data);
+        for (size_t i = 0; i < size; ++i)
         {
-            permutations.push_back(j);
+            hash = (hash ^ bytes[i]) * 16777619u;
         }
-        Shuffle(rng, &permutations[permStart], bases[i]);
-        permStart += bases[i];
     }
-}
 
-template <unsigned NumSampledDimensions>
-void PermutedHalton::NthSample(uint32 n, boost::array<real, NumSampledDimensions>& sample) const
-{
-    RB_ASSERT(NumSampledDimensions <= numDimensions);
-    const uint32* p = &permutations[0];
-    for (uint32 i = 0; i < numDimensions; ++i)
+    template <typename T>
+    void HashValue(const T& value, uint32& hash)
     {
-        sample[i] = std::min(PermutedRadicalInverse(n, bases[i], p), 1.0f-Epsilon());
-        p+=bases[i];
+        HashBytes(&value, sizeof(T), hash);
     }
-}
-
-PhotonShootingJob::PhotonShootingJob(uint32 maxPhotonDepth, const Scene& scene, const StepFunctionSampler* powerDistribution,
-                                     StatsTracker& stats, IrradiancePhotonMap& sharedIndirectMap, CausticPhotonMap& sharedCausticMap,
-                                     DirectPhotonMap& sharedDirectMap, boost::mutex& sharedMutex)
-    : rng(static_cast<uint>(rand())), halton(6,rng), maxPhotonDepth(maxPhotonDepth),
-      scene(scene), powerDistribution(powerDistribution), stats(stats),
-      sharedIndirectMap(sharedIndirectMap), sharedCausticMap(sharedCausticMap),
-      sharedDirectMap(sharedDirectMap), sharedMutex(sharedMutex),
-      causticDone(sharedCausticMap.Full()), indirectDone(sharedIndirectMap.Full())
-{
-}
-
-void PhotonShootingJob::Run() const
-{
-    const LightPtrList& lights = scene.Lights();
-    if (lights.empty()) return;
-
-    // Get photon tracing statistics trackers
-    AtomicCounter& causticPaths = stats.Counter("Photon Tracing", "Caustic paths");
-    AtomicCounter& directPaths = stats.Counter("Photon Tracing", "Direct paths");
-    AtomicCounter& emittedPhotons = stats.Counter("Photon Tracing", "Emitted photons");
-    AtomicCounter& indirectPaths = stats.Counter("Photon Tracing", "Indirect paths");
-    AtomicCounter& storedCausticPhotons = stats.Counter("Photon Tracing", "Stored caustic photons");
-    AtomicCounter& storedDirectPhotons = stats.Counter("Photon Tracing", "Stored direct photons");
-    AtomicCounter& storedIndirectPhotons = stats.Counter("Photon Tracing", "Stored global photons");
 
-    uint32 sampleNo = 0;
-
-    while (!(causticDone && indirectDone))
+    // Hashes a light through its type, power spectrum and bounds, and through the rays it emits for a fixed
+    // set of samples, which depend on its geometry and emission profile
+    void HashLight(const ILight& light, uint32& hash)
     {
-        const uint32 blockSize = 512; // Count of photons to emit at a time
-        for (uint32 i = 0; i < blockSize; ++i)
+        const char* type = typeid(light).name();
+        HashBytes(type, std::strlen(type), hash);
+        HashValue(light.Power(), hash);
+        BoundingBox bound = light.WorldBound();
+        HashValue(bound.Min(), hash);
+        HashValue(bound.Max(), hash);
+        DirectionCone normalBound = light.NormalBound();
+        HashValue(normalBound.Axis(), hash);
+        HashValue(normalBound.Spread(), hash);
+        for (uint32 i = 1; i <= 16; ++i)
         {
-            boost::array<real, 6> sample;
-            halton.NthSample(++sampleNo, sample);
-
-            // Pick the light to sample
-            size_t lightPick = powerDistribution ? powerDistribution->SampleIndex(sample[0]) : rng.RandomUint(lights.size()-1);
-            real lightPdf = powerDistribution ? powerDistribution->FunctionValue(lightPick)/powerDistribution->FunctionIntegral() : 1.0f/lights.size();
-
-            // Generate the photon ray
-            real photonRayPdf = 0.0f;
-            Vector3 lightNormal;
-            Vector3 photonRayOrigin;
-            Vector3 photonRayDirection;
-            const LightConstPtr& lightToSample = lights[lightPick];
-            lightToSample->SampleOutgoingRay(sample.data()+1, photonRayOrigin, photonRayDirection, lightNormal, photonRayPdf);
-            if (photonRayPdf <= 0.0f) continue;
-
-            // Proceed to photon tracing
-            Spectrum photonPower;
-            Intersection photonHit;
-            bool isPathSpecular = true; // We assume that the path is specular at the beginning for code simplicity
-            Ray photonRay(photonRayOrigin, photonRayDirection);
-            uint32 numBounces = 0;
-            while (scene.Intersects(photonRay, photonHit))
+            real samples[5];
+            for (uint32 j = 0; j < 5; ++j)
             {
-                RB_ASSERT(photonHit.material);
-                ++numBounces;
-                if (numBounces == 1) // The photon is just leaving the light, initialize its power
-                {
-                    photonPower = lightToSample->EmittedRadiance(lightNormal, photonRayDirection);
-                    if (photonPower.IsBlack()) break;
-                    photonPower *= AbsDotProduct(lightNormal, photonRayDirection);
-                    photonPower /= (lightPdf * photonRayPdf);
-                    if (!indirectDone)
-                    {
-                        directPhotons.directions.push_back(-photonRay.Direction().GetNormalized());
-                        directPhotons.positions.push_back(photonHit.point);
-                        directPhotons.powers.push_back(photonPower);
-                    }
-                }
-
-                Vector3 unitPhotonDir = photonRay.Direction().GetNormalized();
-
-                // Store photon after first bounce if surface hit has non-specular components
-                if ((numBounces > 1) && photonHit.material->MatchesFlags(~BsdfCombinedFlags::Delta))
-                {
-                    // If the photon has only specularly bounced so far, we must store it
-                    // in the caustic map. Otherwise, we must store it in the global map.
-                    if (isPathSpecular)
-                    {
-                        if (!causticDone)
-                        {
-                            causticPhotons.directions.push_back(-unitPhotonDir);
-                            causticPhotons.positions.push_back(photonHit.point);
-                            causticPhotons.powers.push_back(photonPower);
-                        }
-                    }
-                    else if (!indirectDone)
-                    {
-                        indirectPhotons.directions.push_back(-unitPhotonDir);
-                        indirectPhotons.positions.push_back(photonHit.point);
-                        indirectPhotons.normals.push_back(photonHit.uvn.N());
-                        indirectPhotons.powers.push_back(photonPower);
-                    }
-                }
-                if (numBounces >= maxPhotonDepth) break;
-                // Sample a new photon direction
-                BsdfSamplingRecord brec(photonHit, rng, BsdfCombinedFlags::All);
-                photonHit.material->SampleBsdf(-unitPhotonDir, brec);
-                if ((brec.pdf <= 0.0f) || (brec.value.IsBlack())) break;
-
-                // Use Russian roulette to decide whether to bounce or absorb the photon
-                Spectrum newPower = photonPower * brec.value * AbsDotProduct(brec.sampledDirection, photonHit.uvn.N()) / brec.pdf;
-                float bouncingProbability = std::min(1.0f, newPower.Luminance()/photonPower.Luminance());
-                if (rng.CanonicalRandom() > bouncingProbability) break;
-                photonPower = newPower/bouncingProbability;
-                isPathSpecular &= photonHit.material->MatchesFlags(brec.sampledComponentIndex, BsdfCombinedFlags::Delta); // Update path "specularity"
-                if (indirectDone && !isPathSpecular) break;
-                photonRay = Ray(photonHit.point, brec.sampledDirection);
+                samples[j] = RadicalInverse(i, Prime(j));
             }
+            Vector3 origin, direction, lightNormal;
+            real pdf = 0.0f;
+            light.SampleOutgoingRay(samples, origin, direction, lightNormal, pdf);
+            HashValue(origin, hash);
+            HashValue(direction, hash);
+            HashValue(pdf, hash);
+            HashValue(light.EmittedRadiance(lightNormal, direction), hash);
         }
+    }
 
-        emittedPhotons.Add(blockSize);
+    // Hashes the photon map properties that change the stored photons
+    void HashPhotonMapProperties(const PropertyMap& props, uint32& hash)
+    {
+        uint32 numPhotonsToStore = 0, spacing = 0;
+        props.Get<uint32>("photons_to_store", 0, numPhotonsToStore);
+        props.Get<uint32>("precomputed_irradiance_spacing", 4, spacing);
+        HashValue(numPhotonsToStore, hash);
+        HashValue(spacing, hash);
+    }
 
-        // Update the shared global and caustic photon maps
+    // Converts a gradient from the tangent plane of a basis to world space
+    void GradientToWorld(const Basis3& basis, const Spectrum& u, const Spectrum& v, boost::array<Spectrum, 3>& gradient)
+    {
+        for (uint32 i = 0; i < 3; ++i)
         {
-            boost::mutex::scoped_lock lock(sharedMutex);
-            if (!indirectDone)
-            {
-                sharedIndirectMap.StorePhotons(indirectPhotons.positions, indirectPhotons.directions, indirectPhotons.normals, indirectPhotons.powers);
-                indirectDone = sharedIndirectMap.Full();
-                indirectPaths.Add(blockSize);
-                storedIndirectPhotons.Add(static_cast<uint32>(indirectPhotons.positions.size()));
-
-                sharedDirectMap.StorePhotons(directPhotons.positions, directPhotons.directions, directPhotons.powers);
-                directPaths.Add(blockSize);
-                storedDirectPhotons.Add(static_cast<uint32>(directPhotons.positions.size()));
-            }
-            if (!causticDone)
-            {
-                sharedCausticMap.StorePhotons(causticPhotons.positions, causticPhotons.directions, causticPhotons.powers);
-                causticDone = sharedCausticMap.Full();
-                causticPaths.Add(blockSize);
-                storedCausticPhotons.Add(static_cast<uint32>(causticPhotons.positions.size()));
-            }
+            gradient[i] = u*basis.U()[i] + v*basis.V()[i];
         }
-        causticPhotons.Clear();
-        directPhotons.Clear();
-        indirectPhotons.Clear();
     }
 }
 
+namespace renderbliss
+{
+struct PhotonIntegrator::FinalGatheringBatch
+{
+    // A hit point gathering indirect illumination
+    struct Point
+    {
+        Intersection hit;
+        Vector3 outgoing;
+        Spectrum weight;      // Weight of the radiance leaving the point in the radiance of the batch ray
+        uint32 radianceIndex; // Index of the batch ray
+    };
+
+    // A gathering ray, weighted by the BSDF and cosine factors of its direction over its PDF
+    struct GatheringRay
+    {
+        Vector3 direction;
+        Spectrum weight;
+        uint32 point;
+    };
+
+    std::vector<Point> points;
+    std::vector<GatheringRay> rays;
+};
+
 PhotonIntegrator::Settings::Settings(const PropertyMap& props)
 {
     props.Get<PropertyMap>("global_photon_map", PropertyMap(), gpmProps);
@@ -305,98 +155,397 @@ PhotonIntegrator::Settings::Settings(const PropertyMap& props)
     props.Get<uint32>("shadow_rays", 4, numShadowRays);
     props.Get<uint32>("photon_depth", 4, maxPhotonDepth);
     props.Get<uint32>("final_gathering_samples", 16, numFinalGatheringSamples);
+    props.Get<std::string>("photon_map_file", "", photonMapFile);
+    props.Get<real>("irradiance_cache_error", 0.2f, irradianceCacheError);
+    props.Get<uint32>("irradiance_cache_samples", 256, numIrradianceCacheSamples);
+    props.Get<uint32>("irradiance_cache_spacing", 8, irradianceCachePixelSpacing);
+    props.Get<real>("irradiance_cache_min_distance", 0.002f, minRecordDistance);
+    props.Get<real>("irradiance_cache_max_distance", 0.1f, maxRecordDistance);
 }
 
 PhotonIntegrator::PhotonIntegrator(const PropertyMap& props, StatsTracker& stats)
-    : SurfaceIntegrator(stats), settings(props)
+    : SurfaceIntegrator(stats), settings(props), sceneSize(0.0f), seed(0)
 {
     causticPhotonMap.reset(new CausticPhotonMap(settings.cpmProps));
     indirectPhotonMap.reset(new IrradiancePhotonMap(settings.gpmProps));
     stats.AddCounter("Intersections", "Intersection tests");
     stats.AddCounter("Intersections", "Intersection hits");
+    stats.AddCounter("Irradiance Cache", "Interpolated lookups");
+    stats.AddCounter("Irradiance Cache", "Records");
     stats.AddCounter("Photon Tracing", "Caustic paths");
     stats.AddCounter("Photon Tracing", "Direct paths");
     stats.AddCounter("Photon Tracing", "Emitted photons");
     stats.AddCounter("Photon Tracing", "Indirect paths");
+    stats.AddCounter("Photon Tracing", "Precomputed irradiance photons");
     stats.AddCounter("Photon Tracing", "Stored caustic photons");
     stats.AddCounter("Photon Tracing", "Stored direct photons");
     stats.AddCounter("Photon Tracing", "Stored indirect photons");
     stats.AddCounter("Rays", "Final gathering rays traced");
+    stats.AddCounter("Rays", "Final gathering traversal steps");
     stats.AddCounter("Rays", "Primary rays traced");
     stats.AddCounter("Rays", "Secondary rays traced");
     stats.AddCounter("Rays", "Shadow rays traced");
+    stats.AddCounter("Ray Sorting", "Coherent rays after sorting");
+    stats.AddCounter("Ray Sorting", "Coherent rays before sorting");
+    stats.AddCounter("Ray Sorting", "Sorted rays");
 }
 
-Spectrum PhotonIntegrator::FinalGathering(const Scene& scene, const Intersection& hit, const Vector3& outgoing, MersenneTwister& rng) const
+PhotonIntegrator::~PhotonIntegrator()
+{
+}
+
+Spectrum PhotonIntegrator::FinalGathering(const Scene& scene, const Intersection& hit, const Vector3& outgoing, MersenneTwister& rng,
+                                          const Spectrum& weight, uint32 radianceIndex, FinalGatheringBatch* batch) const
 {
     if (!hit.material) { return Spectrum::black; }
     if (!settings.numFinalGatheringSamples) { return indirectPhotonMap->RadianceEstimate(hit, outgoing); }
 
-    uint32 numGathered = 0;
-    size_t sampleIndex = 0;
-    std::vector<real> samples;
-    Spectrum result = Spectrum::black;
+    // Indirect illumination varies slowly over diffuse surfaces, so its irradiance is interpolated there
+    if (UsesIrradianceCache(hit))
+    {
+        Vector3 normal = (DotProduct(hit.uvn.N(), outgoing) < 0.0f) ? -hit.uvn.N() : hit.uvn.N();
+        Spectrum irradiance = CachedIrradiance(scene, hit, normal, rng);
+        return irradiance * hit.material->BsdfCombinedFlagsValue(normal, outgoing, hit, BsdfComponent::DiffuseReflection);
+    }
 
-    GenerateLatinHypercubeSamples(rng, samples, settings.numFinalGatheringSamples, 3);
-    AtomicCounter& numFinalGatheringRays = stats.Counter("Rays", "Final gathering rays traced");
+    // Without a batch, the gathering rays of this point are traced on their own
+    FinalGatheringBatch pointBatch;
+    FinalGatheringBatch& gatheringBatch = batch ? *batch : pointBatch;
+    FinalGatheringBatch::Point point = {hit, outgoing, batch ? weight : Spectrum(1.0f), batch ? radianceIndex : 0};
+    const uint32 pointIndex = static_cast<uint32>(gatheringBatch.points.size());
+    gatheringBatch.points.push_back(point);
 
+    std::vector<real> samples;
+    GenerateLatinHypercubeSamples(rng, samples, settings.numFinalGatheringSamples, 3);
     for (uint32 i = 0; i < settings.numFinalGatheringSamples; ++i)
     {
-        BsdfSamplingRecord brec(hit, &samples[sampleIndex+3*i], BsdfCombinedFlags::Diffuse|BsdfCombinedFlags::Glossy);
+        BsdfSamplingRecord brec(hit, &samples[3*i], BsdfCombinedFlags::Diffuse|BsdfCombinedFlags::Glossy);
         hit.material->SampleBsdf(outgoing, brec);
         if ((brec.pdf==0.0f) || brec.value.IsBlack()) continue;
 
+        FinalGatheringBatch::GatheringRay ray = {brec.sampledDirection, brec.value * AbsDotProduct(hit.uvn.N(), brec.sampledDirection) / brec.pdf, pointIndex};
+        gatheringBatch.rays.push_back(ray);
+    }
+    if (batch) { return Spectrum::black; }
+
+    std::vector<Spectrum> result(1, Spectrum::black);
+    TraceFinalGatheringRays(scene, pointBatch, result);
+    return result[0];
+}
+
+void PhotonIntegrator::TraceFinalGatheringRays(const Scene& scene, const FinalGatheringBatch& batch, std::vector<Spectrum>& radiances) const
+{
+    // Rays leaving nearby points in similar directions visit the same BVH nodes, so they are traced one after the other
+    std::vector<RaySortEntry> entries(batch.rays.size());
+    for (size_t i = 0; i < batch.rays.size(); ++i)
+    {
+        entries[i].key = RaySortKey(batch.points[batch.rays[i].point].hit.point, batch.rays[i].direction, sceneBound);
+        entries[i].index = static_cast<uint32>(i);
+    }
+    stats.Counter("Ray Sorting", "Coherent rays before sorting").Add(CoherentRayCount(entries));
+    SortRays(entries);
+    stats.Counter("Ray Sorting", "Coherent rays after sorting").Add(CoherentRayCount(entries));
+    stats.Counter("Ray Sorting", "Sorted rays").Add(static_cast<uint32>(entries.size()));
+
+    std::vector<Spectrum> gathered(batch.points.size(), Spectrum::black);
+    std::vector<uint32> numGathered(batch.points.size(), 0);
+    uint32 numTraversalSteps = 0;
+    foreach (const RaySortEntry& entry, entries)
+    {
+        const FinalGatheringBatch::GatheringRay& ray = batch.rays[entry.index];
         Intersection finalGatheringHit;
-        Ray finalGatheringRay(hit.point, brec.sampledDirection);
+        Ray finalGatheringRay(batch.points[ray.point].hit.point, ray.direction);
         if (scene.Intersects(finalGatheringRay, finalGatheringHit))
         {
-            Spectrum indirectIllumination = indirectPhotonMap->RadianceEstimate(finalGatheringHit, -finalGatheringRay.Direction());
-            real cosFactor = AbsDotProduct(hit.uvn.N(), finalGatheringRay.Direction());
-            result += brec.value * indirectIllumination * cosFactor / brec.pdf;
-            ++numGathered;
+            gathered[ray.point] += ray.weight * indirectPhotonMap->RadianceEstimate(finalGatheringHit, -finalGatheringRay.Direction());
+            ++numGathered[ray.point];
+        }
+        numTraversalSteps += finalGatheringRay.traversalSteps;
+    }
+    stats.Counter("Rays", "Final gathering rays traced").Add(static_cast<uint32>(entries.size()));
+    stats.Counter("Rays", "Final gathering traversal steps").Add(numTraversalSteps);
+
+    // Points that gathered nothing fall back to their own radiance estimate
+    for (size_t i = 0; i < batch.points.size(); ++i)
+    {
+        const FinalGatheringBatch::Point& point = batch.points[i];
+        Spectrum L = numGathered[i] ? gathered[i] / static_cast<float>(numGathered[i])
+                                    : indirectPhotonMap->RadianceEstimate(point.hit, point.outgoing);
+        radiances[point.radianceIndex] += point.weight * L;
+    }
+}
+
+bool PhotonIntegrator::UsesIrradianceCache(const Intersection& hit) const
+{
+    return irradianceCache && hit.material->MatchesFlags(BsdfComponent::DiffuseReflection) &&
+           !hit.material->MatchesFlags(BsdfCombinedFlags::Glossy | BsdfComponent::DiffuseTransmission);
+}
+
+Spectrum PhotonIntegrator::CachedIrradiance(const Scene& scene, const Intersection& hit, const Vector3& normal, MersenneTwister& rng) const
+{
+    Spectrum irradiance(Spectrum::black);
+    if (irradianceCache->Interpolate(hit.point, normal, irradiance))
+    {
+        ++stats.Counter("Irradiance Cache", "Interpolated lookups");
+        return irradiance;
+    }
+
+    IrradianceRecord record;
+    ComputeIrradianceRecord(scene, hit, normal, rng, record);
+    irradianceCache->Add(record);
+    ++stats.Counter("Irradiance Cache", "Records");
+    return record.irradiance;
+}
+
+void PhotonIntegrator::ComputeIrradianceRecord(const Scene& scene, const Intersection& hit, const Vector3& normal, MersenneTwister& rng,
+                                               IrradianceRecord& record) const
+{
+    // Stratify the cosine-weighted hemisphere into M elevations by N azimuths, with N close to pi times M
+    const uint32 M = std::max(1u, static_cast<uint32>(std::sqrt(settings.numIrradianceCacheSamples*InvPi()) + 0.5f));
+    const uint32 N = std::max(1u, settings.numIrradianceCacheSamples/M);
+    std::vector<Spectrum> radiance(M*N, Spectrum::black);
+    std::vector<real> distances(M*N, Infinity());
+
+    Basis3 basis = Basis3::CreateFromN(normal);
+    Spectrum irradiance(Spectrum::black), rotationalU(Spectrum::black), rotationalV(Spectrum::black);
+    real sumInverseDistances = 0.0f;
+    AtomicCounter& numFinalGatheringRays = stats.Counter("Rays", "Final gathering rays traced");
+
+    for (uint32 j = 0; j < M; ++j)
+    {
+        for (uint32 k = 0; k < N; ++k)
+        {
+            real sqrSinTheta = (j + rng.CanonicalRandom())/M;
+            real sinTheta = std::sqrt(sqrSinTheta);
+            real cosTheta = std::sqrt(std::max(1.0e-6f, 1.0f - sqrSinTheta));
+            real phi = TwoPi()*(k + rng.CanonicalRandom())/N;
+            Ray gatheringRay(hit.point, basis.ToWorld(sinTheta*std::cos(phi), sinTheta*std::sin(phi), cosTheta));
+            ++numFinalGatheringRays;
+
+            Intersection gatheringHit;
+            if (!scene.Intersects(gatheringRay, gatheringHit)) continue;
+            Spectrum L = indirectPhotonMap->RadianceEstimate(gatheringHit, -gatheringRay.Direction());
+            real distance = Distance(hit.point, gatheringHit.point);
+            radiance[j*N+k] = L;
+            distances[j*N+k] = distance;
+            sumInverseDistances += 1.0f/distance;
+            irradiance += L;
+
+            // The rotational gradient follows the azimuthal tangent of each sample
+            real tanTheta = sinTheta/cosTheta;
+            rotationalU += (tanTheta*std::sin(phi))*L;
+            rotationalV -= (tanTheta*std::cos(phi))*L;
+        }
+    }
+
+    // Translational gradient after Ward and Heckbert, from the radiance changes across stratum boundaries
+    Spectrum translationalU(Spectrum::black), translationalV(Spectrum::black);
+    for (uint32 k = 0; k < N; ++k)
+    {
+        real phi = TwoPi()*(k + 0.5f)/N;
+        real boundaryPhi = TwoPi()*k/N;
+        uint32 previousK = (k + N - 1) % N;
+        Spectrum elevationChange(Spectrum::black), azimuthChange(Spectrum::black);
+        for (uint32 j = 0; j < M; ++j)
+        {
+            const Spectrum& L = radiance[j*N+k];
+            if (j > 0)
+            {
+                real sqrSinTheta = static_cast<real>(j)/M;
+                real minDistance = std::min(distances[j*N+k], distances[(j-1)*N+k]);
+                elevationChange += (std::sqrt(sqrSinTheta)*(1.0f - sqrSinTheta)/minDistance)*(L - radiance[(j-1)*N+k]);
+            }
+            real minDistance = std::min(distances[j*N+k], distances[j*N+previousK]);
+            real sinThetaDifference = std::sqrt(static_cast<real>(j+1)/M) - std::sqrt(static_cast<real>(j)/M);
+            azimuthChange += (sinThetaDifference/minDistance)*(L - radiance[j*N+previousK]);
+        }
+        elevationChange *= TwoPi()/N;
+        translationalU += std::cos(phi)*elevationChange - std::sin(boundaryPhi)*azimuthChange;
+        translationalV += std::sin(phi)*elevationChange + std::cos(boundaryPhi)*azimuthChange;
+    }
+
+    const real sampleWeight = Pi()/(M*N);
+    record.position = hit.point;
+    record.normal = normal;
+    record.irradiance = irradiance*sampleWeight;
+    GradientToWorld(basis, rotationalU*sampleWeight, rotationalV*sampleWeight, record.rotationalGradient);
+    GradientToWorld(basis, translationalU, translationalV, record.translationalGradient);
+
+    // Records see no farther than their harmonic mean distance, which is also bounded
+    // so that the translational gradient cannot extrapolate a negative irradiance
+    real minDistance = settings.minRecordDistance*sceneSize;
+    real maxDistance = settings.maxRecordDistance*sceneSize;
+    real distance = (sumInverseDistances > 0.0f) ? (M*N)/sumInverseDistances : maxDistance;
+    real gradientNorm = std::sqrt(translationalU.Luminance()*translationalU.Luminance() + translationalV.Luminance()*translationalV.Luminance());
+    if (gradientNorm > 0.0f)
+    {
+        distance = std::min(distance, record.irradiance.Luminance()/gradientNorm);
+    }
+    Clamp(minDistance, maxDistance, distance);
+    record.harmonicMeanDistance = distance;
+}
+
+uint32 PhotonIntegrator::PhotonMapHash(const Scene& scene) const
+{
+    // Materials cannot be hashed, so the photon map file must be changed along with them
+    uint32 hash = 2166136261u;
+    foreach (const MeshConstPtr& mesh, scene.Meshes())
+    {
+        HashValue(mesh->TriangleCount(), hash);
+        for (size_t i = 0; i < mesh->VertexCount(); ++i)
+        {
+            HashValue(mesh->Vertex(i), hash);
         }
-        ++numFinalGatheringRays;
     }
+    foreach (const LightConstPtr& light, scene.Lights())
+    {
+        HashLight(*light, hash);
+    }
+    HashValue(settings.maxPhotonDepth, hash);
+    HashPhotonMapProperties(settings.cpmProps, hash);
+    HashPhotonMapProperties(settings.gpmProps, hash);
+    return hash;
+}
 
-    if (numGathered)
+bool PhotonIntegrator::LoadPhotonMaps(uint32 hash, JobScheduler& scheduler)
+{
+    std::ifstream in(settings.photonMapFile.c_str(), std::ios::in | std::ios::binary);
+    if (!in) return false;
+
+    uint32 fileHeader[3] = {0};
+    in.read(reinterpret_cast<char*>(fileHeader), sizeof(fileHeader));
+    if (!in || (fileHeader[0] != PhotonMapFileMagic) || (fileHeader[1] != PhotonMapFileVersion))
+    {
+        GLOG_ERROR << "Ignoring invalid photon map file " << settings.photonMapFile;
+        return false;
+    }
+    if (fileHeader[2] != hash)
     {
-        result /= static_cast<float>(numGathered);
-        return result;
+        GLOG_INFO << "Ignoring photon map file " << settings.photonMapFile << " saved for another scene";
+        return false;
     }
 
-    return indirectPhotonMap->RadianceEstimate(hit, outgoing);
+    // Only keep the loaded maps if both could be read
+    boost::shared_ptr<CausticPhotonMap> loadedCausticMap(new CausticPhotonMap(settings.cpmProps));
+    boost::shared_ptr<IrradiancePhotonMap> loadedIndirectMap(new IrradiancePhotonMap(settings.gpmProps));
+    if (!loadedCausticMap->Load(in, scheduler) || !loadedIndirectMap->Load(in, scheduler))
+    {
+        GLOG_ERROR << "Failed to read photon map file " << settings.photonMapFile;
+        return false;
+    }
+    causticPhotonMap = loadedCausticMap;
+    indirectPhotonMap = loadedIndirectMap;
+    GLOG_INFO << "Loaded photon maps from " << settings.photonMapFile;
+    return true;
+}
+
+void PhotonIntegrator::SavePhotonMaps(uint32 hash) const
+{
+    std::ofstream out(settings.photonMapFile.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    uint32 fileHeader[3] = {PhotonMapFileMagic, PhotonMapFileVersion, hash};
+    out.write(reinterpret_cast<const char*>(fileHeader), sizeof(fileHeader));
+    causticPhotonMap->Save(out);
+    indirectPhotonMap->Save(out);
+    if (!out)
+    {
+        GLOG_ERROR << "Failed to write photon map file " << settings.photonMapFile;
+    }
+}
+
+void PhotonIntegrator::SetSeed(uint32 seed)
+{
+    this->seed = seed;
 }
 
 void PhotonIntegrator::PreProcess(const Scene& scene, JobScheduler& scheduler)
 {
     powerDistribution.reset(PowerDistribution(scene).release());
+    lightBvh.reset(new LightBvh(scene.Lights()));
+
+    // Final gathering rays are sorted over the scene bound, which the irradiance cache octree also covers
+    sceneBound = BoundingBox();
+    foreach (const MeshConstPtr& mesh, scene.Meshes())
+    {
+        sceneBound.Enclose(mesh->WorldBound());
+    }
+    irradianceCache.reset();
+    if ((settings.irradianceCacheError > 0.0f) && settings.numFinalGatheringSamples && !scene.Meshes().empty())
+    {
+        sceneSize = sceneBound.Extents().Norm();
+        irradianceCache.reset(new IrradianceCache(sceneBound, settings.irradianceCacheError));
+    }
+
+    // Lighting is static across the renders of a scene, so its photon maps may be reused
+    uint32 hash = PhotonMapHash(scene);
+    if (!settings.photonMapFile.empty() && LoadPhotonMaps(hash, scheduler))
+    {
+        return;
+    }
     boost::shared_ptr<DirectPhotonMap> directPhotonMap(new DirectPhotonMap(settings.gpmProps));
+
+    // The path counters are shared with other integrators, so only the paths shot here scale the photon powers
+    AtomicCounter& causticPaths = stats.Counter("Photon Tracing", "Caustic paths");
+    AtomicCounter& directPaths = stats.Counter("Photon Tracing", "Direct paths");
+    AtomicCounter& indirectPaths = stats.Counter("Photon Tracing", "Indirect paths");
+    const uint32 numPreviousCausticPaths = causticPaths;
+    const uint32 numPreviousDirectPaths = directPaths;
+    const uint32 numPreviousIndirectPaths = indirectPaths;
+
     // Schedule photon shooting jobs
-    boost::mutex mutex;
+    MersenneTwister seedRng(seed);
     unsigned numThreads = HardwareThreadCount();
     for (unsigned i = 0; i < numThreads; ++i)
     {
-        JobConstPtr job(new PhotonShootingJob(settings.maxPhotonDepth, scene, powerDistribution.get(), stats,
-                                              *indirectPhotonMap, *causticPhotonMap, *directPhotonMap, mutex));
+        JobConstPtr job(new PhotonShootingJob(seedRng.RandomBits(), settings.maxPhotonDepth, scene, powerDistribution.get(), stats,
+                                              *indirectPhotonMap, *causticPhotonMap, directPhotonMap.get()));
         scheduler.Spawn(job);
     }
     scheduler.WaitForAllJobs();
 
-    const uint32 numCausticPaths = stats.Counter("Photon Tracing", "Caustic paths");
-    causticPhotonMap->ScalePower(1.0f/numCausticPaths);
-    causticPhotonMap->Balance();
+    const uint32 numCausticPaths = causticPaths - numPreviousCausticPaths;
+    if (numCausticPaths) causticPhotonMap->ScalePower(1.0f/numCausticPaths);
+    const uint32 numDirectPaths = directPaths - numPreviousDirectPaths;
+    if (numDirectPaths) directPhotonMap->ScalePower(1.0f/numDirectPaths);
+    const uint32 numIndirectPaths = indirectPaths - numPreviousIndirectPaths;
+    if (numIndirectPaths) indirectPhotonMap->ScalePower(1.0f/numIndirectPaths);
+
+    // Balance the photon maps concurrently
+    causticPhotonMap->SpawnBalancingJobs(scheduler);
+    directPhotonMap->SpawnBalancingJobs(scheduler);
+    indirectPhotonMap->SpawnBalancingJobs(scheduler);
+    scheduler.WaitForAllJobs();
+    causticPhotonMap->FinishBalancing();
+    directPhotonMap->FinishBalancing();
+    indirectPhotonMap->FinishBalancing();
 
-    const uint32 numDirectPaths = stats.Counter("Photon Tracing", "Direct paths");
-    directPhotonMap->ScalePower(1.0f/numDirectPaths);
-    directPhotonMap->Balance();
+    indirectPhotonMap->PrecomputeIrradianceEstimate(*causticPhotonMap.get(), *directPhotonMap.get(), scheduler,
+                                                    stats.Counter("Photon Tracing", "Precomputed irradiance photons"));
 
-    const uint32 numIndirectPaths = stats.Counter("Photon Tracing", "Indirect paths");
-    indirectPhotonMap->ScalePower(1.0f/numIndirectPaths);
-    indirectPhotonMap->Balance();
-    indirectPhotonMap->PrecomputeIrradianceEstimate(*causticPhotonMap.get(), *directPhotonMap.get());
+    if (!settings.photonMapFile.empty())
+    {
+        SavePhotonMaps(hash);
+    }
 }
 
 Spectrum PhotonIntegrator::Radiance(const Scene& scene, const Ray& ray, MersenneTwister& rng, real& opacity) const
+{
+    return Radiance(scene, ray, rng, opacity, Spectrum(1.0f), 0, 0);
+}
+
+void PhotonIntegrator::Radiances(const Scene& scene, const std::vector<Ray>& rays, MersenneTwister& rng, std::vector<Spectrum>& radiances) const
+{
+    FinalGatheringBatch batch;
+    radiances.resize(rays.size());
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        real opacity = 1.0f;
+        radiances[i] = Radiance(scene, rays[i], rng, opacity, Spectrum(1.0f), static_cast<uint32>(i), &batch);
+    }
+    TraceFinalGatheringRays(scene, batch, radiances);
+}
+
+Spectrum PhotonIntegrator::Radiance(const Scene& scene, const Ray& ray, MersenneTwister& rng, real& opacity,
+                                    const Spectrum& weight, uint32 radianceIndex, FinalGatheringBatch* batch) const
 {
     Spectrum L(Spectrum::black);
 
@@ -420,12 +569,12 @@ Spectrum PhotonIntegrator::Radiance(const Scene& scene, const Ray& ray, Mersenne
     }
 
     // Add direct illumination
-    L += DirectIllumination(scene, toViewer, hit, powerDistribution.get(), settings.numShadowRays, rng, opacity, stats.Counter("Rays", "Shadow rays traced"));
+    L += DirectIllumination(scene, toViewer, hit, lightBvh.get(), settings.numShadowRays, rng, opacity, stats.Counter("Rays", "Shadow rays traced"));
 
     // Add indirect illumination using one-bounce final gathering
     if (!indirectPhotonMap->Empty())
     {
-        L += settings.numFinalGatheringSamples ? FinalGathering(scene, hit, toViewer, rng)
+        L += settings.numFinalGatheringSamples ? FinalGathering(scene, hit, toViewer, rng, weight, radianceIndex, batch)
                                                : indirectPhotonMap->RadianceEstimate(hit, toViewer);
     }
 
@@ -446,7 +595,8 @@ Spectrum PhotonIntegrator::Radiance(const Scene& scene, const Ray& ray, Mersenne
         {
             Ray r(hit.point, brec1.sampledDirection);
             r.depth = ray.depth+1;
-            L += brec1.value * AbsDotProduct(brec1.sampledDirection, hit.uvn.N()) * Radiance(scene, r, rng, opacity);
+            Spectrum reflectance = brec1.value * AbsDotProduct(brec1.sampledDirection, hit.uvn.N());
+            L += reflectance * Radiance(scene, r, rng, opacity, weight*reflectance, radianceIndex, batch);
             ++numSecondaryRays;
         }
 
@@ -457,11 +607,27 @@ Spectrum PhotonIntegrator::Radiance(const Scene& scene, const Ray& ray, Mersenne
         {
             Ray r(hit.point, brec2.sampledDirection);
             r.depth = ray.depth+1;
-            L += brec2.value * AbsDotProduct(brec2.sampledDirection, hit.uvn.N()) * Radiance(scene, r, rng, opacity);
+            Spectrum transmittance = brec2.value * AbsDotProduct(brec2.sampledDirection, hit.uvn.N());
+            L += transmittance * Radiance(scene, r, rng, opacity, weight*transmittance, radianceIndex, batch);
             ++numSecondaryRays;
         }
     }
 
     return L;
 };
+
+uint32 PhotonIntegrator::PrePassPixelSpacing() const
+{
+    return (irradianceCache && !indirectPhotonMap->Empty()) ? settings.irradianceCachePixelSpacing : 0;
+}
+
+void PhotonIntegrator::PrePassRay(const Scene& scene, const Ray& ray, MersenneTwister& rng) const
+{
+    Intersection hit;
+    if (!scene.Intersects(ray, hit) || !hit.material || !UsesIrradianceCache(hit)) return;
+
+    Vector3 toViewer = -ray.Direction().GetNormalized();
+    Vector3 normal = (DotProduct(hit.uvn.N(), toViewer) < 0.0f) ? -hit.uvn.N() : hit.uvn.N();
+    CachedIrradiance(scene, hit, normal, rng);
+}
 }
@@ -21,16 +21,21 @@
 #ifndef RENDERBLISS_PHOTON_INTEGRATOR_H
 #define RENDERBLISS_PHOTON_INTEGRATOR_H
 
+#include <string>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 #include "renderbliss/Types.h"
 #include "renderbliss/Integrators/SurfaceIntegrator.h"
+#include "renderbliss/Lights/LightBvh.h"
 #include "renderbliss/Lights/StepFunctionSampler.h"
+#include "renderbliss/Math/Geometry/BoundingBox.h"
 #include "renderbliss/Utils/PropertyMap.h"
 
 namespace renderbliss
 {
 struct Intersection;
+class  IrradianceCache;
+struct IrradianceRecord;
 class  PhotonMap;
 class  IrradiancePhotonMap;
 class  StatsTracker;
@@ -44,6 +49,11 @@ class PhotonIntegrator : public SurfaceIntegrator
 public:
 
     PhotonIntegrator(const PropertyMap& props, StatsTracker& stats);
+    // Defined where the irradiance cache is a complete type
+    ~PhotonIntegrator();
+
+    // Seeds photon shooting
+    virtual void SetSeed(uint32 seed);
 
     // Should be called before rendering a scene
     virtual void PreProcess(const Scene& scene, JobScheduler& scheduler);
@@ -51,6 +61,13 @@ public:
     // Returns the radiance along a ray being cast into the scene
     virtual Spectrum Radiance(const Scene& scene, const Ray& ray, MersenneTwister& rng, real& opacity) const;
 
+    // Collects the final gathering rays of every hit point of the batch, and traces them together sorted for coherence
+    virtual void Radiances(const Scene& scene, const std::vector<Ray>& rays, MersenneTwister& rng, std::vector<Spectrum>& radiances) const;
+
+    // The irradiance cache is filled in a sparse pre-pass
+    virtual uint32 PrePassPixelSpacing() const;
+    virtual void PrePassRay(const Scene& scene, const Ray& ray, MersenneTwister& rng) const;
+
 private:
 
     struct Settings
@@ -61,14 +78,56 @@ private:
         uint32 numShadowRays;
         uint32 maxPhotonDepth;
         uint32 numFinalGatheringSamples;
+        std::string photonMapFile; // Balanced photon maps are loaded from or saved to this file, if any
+        real irradianceCacheError; // Zero disables the irradiance cache
+        uint32 numIrradianceCacheSamples;
+        uint32 irradianceCachePixelSpacing;
+        real minRecordDistance; // Bounds of the record harmonic mean distances, relative to the scene size
+        real maxRecordDistance;
         Settings(const PropertyMap& props);
     } settings;
     boost::shared_ptr<CausticPhotonMap> causticPhotonMap;
     boost::shared_ptr<IrradiancePhotonMap> indirectPhotonMap;
-    boost::scoped_ptr<StepFunctionSampler> powerDistribution; // Lighting power distribution
+    boost::scoped_ptr<StepFunctionSampler> powerDistribution; // Lighting power distribution, for emitting photons
+    boost::scoped_ptr<LightBvh> lightBvh; // Hierarchy for picking the lights to sample
+    boost::scoped_ptr<IrradianceCache> irradianceCache; // Shared by all rendering threads
+    BoundingBox sceneBound;
+    real sceneSize;
+    uint32 seed; // Seeds the photon shooting jobs
+
+    // Returns a hash of the scene geometry and lights, and of the photon map settings
+    uint32 PhotonMapHash(const Scene& scene) const;
+
+    // Loads the photon maps from the photon map file, and returns whether it succeeded
+    bool LoadPhotonMaps(uint32 hash, JobScheduler& scheduler);
+
+    // Saves the photon maps to the photon map file
+    void SavePhotonMaps(uint32 hash) const;
+
+    // The final gathering rays of a batch of rays, and the hit points they gather for
+    struct FinalGatheringBatch;
+
+    // Returns the radiance along a ray. Unless the batch is null, the final gathering rays are added to it instead of
+    // being traced, with the weight of the ray in the radiance of the given index, to which they contribute once traced.
+    Spectrum Radiance(const Scene& scene, const Ray& ray, MersenneTwister& rng, real& opacity,
+                      const Spectrum& weight, uint32 radianceIndex, FinalGatheringBatch* batch) const;
+
+    // Implements one-bounce final gathering. The gathering rays are either added to a batch, or traced right away.
+    Spectrum FinalGathering(const Scene& scene, const Intersection& hit, const Vector3& outgoing, MersenneTwister& rng,
+                            const Spectrum& weight, uint32 radianceIndex, FinalGatheringBatch* batch) const;
+
+    // Traces the gathering rays of a batch in sorted order, and adds the gathered radiance of each hit point to its radiance
+    void TraceFinalGatheringRays(const Scene& scene, const FinalGatheringBatch& batch, std::vector<Spectrum>& radiances) const;
+
+    // Returns whether the irradiance cache may be used at a surface point, which requires a purely diffuse reflector
+    bool UsesIrradianceCache(const Intersection& hit) const;
+
+    // Returns the irradiance at a surface point, interpolated from the cache or else computed and cached
+    Spectrum CachedIrradiance(const Scene& scene, const Intersection& hit, const Vector3& normal, MersenneTwister& rng) const;
 
-    // Implements one-bounce final gathering
-    Spectrum FinalGathering(const Scene& scene, const Intersection& hit, const Vector3& outgoing, MersenneTwister& rng) const;
+    // Computes the irradiance at a surface point, and its gradients, by gathering over a stratified hemisphere
+    void ComputeIrradianceRecord(const Scene& scene, const Intersection& hit, const Vector3& normal, MersenneTwister& rng,
+                                 IrradianceRecord& record) const;
 };
 }
 
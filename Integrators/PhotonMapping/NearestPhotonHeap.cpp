@@ -0,0 +1,77 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Integrators/PhotonMapping/NearestPhotonHeap.h"
+#include <boost/thread/tss.hpp>
+
+namespace renderbliss
+{
+NearestPhotonHeap::NearestPhotonHeap(uint32 capacity) : photons(0), capacity(0), size(0), maxSqrDist(0.0f)
+{
+    Reset(capacity);
+}
+
+void NearestPhotonHeap::Reset(uint32 capacity)
+{
+    // Over-allocate so that the photons can start on a cache line boundary
+    const size_t photonsPerLine = CacheLineSize / sizeof(NearestPhoton);
+    if (storage.size() < capacity + photonsPerLine)
+    {
+        storage.resize(capacity + photonsPerLine);
+        size_t address = reinterpret_cast<size_t>(&storage[0]);
+        size_t misalignment = address % CacheLineSize;
+        photons = &storage[0] + (misalignment ? (CacheLineSize - misalignment) / sizeof(NearestPhoton) : 0);
+    }
+    this->capacity = capacity;
+    size = 0;
+    maxSqrDist = 0.0f;
+}
+
+void NearestPhotonHeap::SiftDown()
+{
+    // Moves the root down until both of its children are nearer
+    uint32 parent = 0;
+    NearestPhoton root = photons[0];
+    for (;;)
+    {
+        uint32 child = 2*parent + 1;
+        if (child >= size) break;
+        if ((child+1 < size) && (photons[child] < photons[child+1])) ++child;
+        if (!(root < photons[child])) break;
+        photons[parent] = photons[child];
+        parent = child;
+    }
+    photons[parent] = root;
+}
+NearestPhotonHeap& ThreadNearestPhotonHeap(uint32 capacity)
+{
+    // Each heap is deleted when its thread exits
+    static boost::thread_specific_ptr<NearestPhotonHeap> heaps;
+    if (!heaps.get())
+    {
+        heaps.reset(new NearestPhotonHeap(capacity));
+    }
+    else
+    {
+        heaps->Reset(capacity);
+    }
+    return *heaps;
+}
+}
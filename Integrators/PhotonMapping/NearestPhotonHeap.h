@@ -0,0 +1,111 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_NEAREST_PHOTON_HEAP_H
+#define RENDERBLISS_NEAREST_PHOTON_HEAP_H
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Math/MathUtils.h"
+
+namespace renderbliss
+{
+// Used to locate nearest photons when computing a radiance estimate
+struct NearestPhoton
+{
+    real sqrDist; // Squared distance from query location
+    uint32 index; // Photon index in the photon map
+    NearestPhoton(real sqrDist = Infinity(), uint32 index = 0) : sqrDist(sqrDist), index(index) {}
+    bool operator<(const NearestPhoton& np) const { return sqrDist < np.sqrDist; }
+};
+
+// Fixed-capacity collection of the nearest photons found by a photon map lookup. Photons are appended
+// until the capacity is reached, after which the collection is turned into a max-heap so that the
+// farthest photon can be replaced in logarithmic time. The storage is aligned on cache lines.
+class NearestPhotonHeap : boost::noncopyable
+{
+public:
+
+    NearestPhotonHeap(uint32 capacity);
+
+    // Removes all photons, and sets a new capacity
+    void Reset(uint32 capacity);
+
+    uint32 Capacity() const;
+    uint32 Size() const;
+    bool Empty() const;
+    bool Full() const;
+
+    // Adds a photon when the heap is not full, or replaces the farthest photon otherwise.
+    // The photon is expected to be closer than the farthest photon of a full heap.
+    void Insert(real sqrDist, uint32 index);
+
+    // Returns the squared distance of the farthest photon
+    real MaxSqrDist() const;
+
+    const NearestPhoton& operator[](uint32 i) const;
+
+private:
+
+    enum { CacheLineSize = 64 };
+
+    std::vector<NearestPhoton> storage;
+    NearestPhoton* photons; // Points to the first cache-aligned photon in the storage
+    uint32 capacity;
+    uint32 size;
+    real maxSqrDist;
+
+    void SiftDown();
+};
+
+// Returns a heap owned by the calling thread, reset to a capacity, so that lookups which are not given
+// a heap do not allocate one per call. A thread must be done with the heap before asking for it again.
+NearestPhotonHeap& ThreadNearestPhotonHeap(uint32 capacity);
+
+// Visitor inserting the photons within a search radius into a nearest photon heap.
+// The radius shrinks to the farthest photon of the heap once it is full.
+class NearestPhotonGatherer
+{
+public:
+
+    NearestPhotonGatherer(NearestPhotonHeap& heap, real sqrMaxRadius) : heap(heap), sqrMaxRadius(sqrMaxRadius) {}
+
+    void operator()(uint32 index, real sqrDist)
+    {
+        if (sqrDist < sqrMaxRadius)
+        {
+            heap.Insert(sqrDist, index);
+            if (heap.Full()) sqrMaxRadius = heap.MaxSqrDist();
+        }
+    }
+
+    real SqrMaxRadius() const { return sqrMaxRadius; }
+
+private:
+
+    NearestPhotonHeap& heap;
+    real sqrMaxRadius;
+};
+}
+
+#include "renderbliss/Integrators/PhotonMapping/NearestPhotonHeap.inl"
+
+#endif
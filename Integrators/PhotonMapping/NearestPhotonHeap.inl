@@ -0,0 +1,77 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <algorithm>
+#include "renderbliss/Macros.h"
+
+namespace renderbliss
+{
+inline uint32 NearestPhotonHeap::Capacity() const
+{
+    return capacity;
+}
+
+inline uint32 NearestPhotonHeap::Size() const
+{
+    return size;
+}
+
+inline bool NearestPhotonHeap::Empty() const
+{
+    return size == 0;
+}
+
+inline bool NearestPhotonHeap::Full() const
+{
+    return size == capacity;
+}
+
+inline void NearestPhotonHeap::Insert(real sqrDist, uint32 index)
+{
+    if (size < capacity)
+    {
+        photons[size++] = NearestPhoton(sqrDist, index);
+        maxSqrDist = std::max(maxSqrDist, sqrDist);
+        if (size == capacity)
+        {
+            std::make_heap(photons, photons+size);
+            maxSqrDist = photons[0].sqrDist;
+        }
+    }
+    else
+    {
+        RB_ASSERT(capacity && (sqrDist <= maxSqrDist));
+        photons[0] = NearestPhoton(sqrDist, index);
+        SiftDown();
+        maxSqrDist = photons[0].sqrDist;
+    }
+}
+
+inline real NearestPhotonHeap::MaxSqrDist() const
+{
+    return maxSqrDist;
+}
+
+inline const NearestPhoton& NearestPhotonHeap::operator[](uint32 i) const
+{
+    RB_ASSERT(i < size);
+    return photons[i];
+}
+}
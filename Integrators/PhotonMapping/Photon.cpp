@@ -19,6 +19,7 @@
 // THE SOFTWARE.
 
 #include "renderbliss/Integrators/PhotonMapping/Photon.h"
+#include <algorithm>
 #include <cmath>
 #include "renderbliss/Interfaces/IMaterial.h"
 #include "renderbliss/Math/MathUtils.h"
@@ -26,28 +27,78 @@
 #include "renderbliss/Math/Geometry/Vector3.h"
 #include "renderbliss/Utils/PropertyMap.h"
 
+namespace
+{
+using namespace renderbliss;
+
+// Cosine and sine tables for the 8-bit spherical coordinates of packed directions.
+// Polar angles cover [0, pi] in 255 steps, and azimuthal angles cover [0, 2pi) in 256 steps.
+struct DirectionTables
+{
+    real cosTheta[256], sinTheta[256];
+    real cosPhi[256], sinPhi[256];
+
+    DirectionTables()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            real theta = i*(Pi()/255.0f);
+            real phi = i*(TwoPi()/256.0f);
+            cosTheta[i] = cos(theta);
+            sinTheta[i] = sin(theta);
+            cosPhi[i] = cos(phi);
+            sinPhi[i] = sin(phi);
+        }
+    }
+};
+
+// Built on first use, so that photons unpacked during the static initialization of other files find them ready
+const DirectionTables& PackedDirectionTables()
+{
+    static const DirectionTables tables;
+    return tables;
+}
+}
+
 namespace renderbliss
 {
-Photon::Photon(const Vector3& position, const Vector3& direction, const Spectrum& power)
-    : position(position),
+PackedDirection::PackedDirection() : theta(0), phi(0)
+{
+}
+
+PackedDirection::PackedDirection(const Vector3& direction)
+{
+    real t = acos(std::max(static_cast<real>(-1.0f), std::min(static_cast<real>(1.0f), direction.z)));
+    real p = atan2(direction.y, direction.x);
+    if (p < 0.0f) p += TwoPi();
+    theta = static_cast<byte>(std::min(255, static_cast<int>(t*(255.0f/Pi()) + 0.5f)));
+    phi = static_cast<byte>(static_cast<int>(p*(256.0f/TwoPi()) + 0.5f) & 255);
+}
+
+Vector3 PackedDirection::Unpack() const
+{
+    const DirectionTables& t = PackedDirectionTables();
+    return SphericalToCartesian(t.cosPhi[phi], t.sinPhi[phi], t.cosTheta[theta], t.sinTheta[theta], 1.0f);
+}
+
+Photon::Photon() : power(RGB().ToRGBE())
+{
+}
+
+Photon::Photon(const Vector3& direction, const Spectrum& power)
+    :
 #ifdef SPECTRUM_IS_RGB
-      power(power.ToRGBE())
+      power(power.ToRGBE()),
 #else
-    power(power.ToRGB().ToRGBE())
+      power(power.ToRGB().ToRGBE()),
 #endif
+      direction(direction)
 {
-    dirTheta = acosf(direction.z);
-    dirPhi = atan2(direction.y, direction.x);
 }
 
 Vector3 Photon::Direction() const
 {
-    return SphericalToCartesian(dirPhi, dirTheta);
-}
-
-const Vector3& Photon::Position() const
-{
-    return position;
+    return direction.Unpack();
 }
 
 Spectrum Photon::Power() const
@@ -60,16 +111,18 @@ void Photon::ScalePower(float scale)
     power = (RGB(power)*scale).ToRGBE();
 }
 
-IrradiancePhoton::IrradiancePhoton(const Vector3& position, const Vector3& direction, const Vector3& normal, const Spectrum& power)
-    : Photon(position, direction, power)
+IrradiancePhoton::IrradiancePhoton()
+{
+}
+
+IrradiancePhoton::IrradiancePhoton(const Vector3& direction, const Vector3& normal, const Spectrum& power)
+    : Photon(direction, power), normal(normal)
 {
-    normalTheta = acosf(normal.z);
-    normalPhi = atan2(normal.y, normal.x);
 }
 
 Vector3 IrradiancePhoton::Normal() const
 {
-    return SphericalToCartesian(normalPhi, normalTheta);
+    return normal.Unpack();
 }
 
 PhotonNode::PhotonNode()
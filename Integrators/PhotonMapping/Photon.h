@@ -28,22 +28,39 @@
 
 namespace renderbliss
 {
+// A unit vector compactly stored as 8-bit spherical coordinates, which are decoded
+// with precomputed cosine and sine tables as in Jensen's photon map implementation
+class PackedDirection
+{
+public:
+
+    PackedDirection();
+    // The constructor assumes that the direction is of unit length.
+    PackedDirection(const Vector3& direction);
+    Vector3 Unpack() const;
+
+private:
+
+    byte theta, phi;
+};
+
+// Photon data other than the position, which photon maps store separately for their kd-tree lookups
 class Photon
 {
 public:
 
+    // Constructs a photon without power, as a placeholder in preallocated photon storage
+    Photon();
     // The constructor assumes that the direction is of unit length.
-    Photon(const Vector3& position, const Vector3& direction, const Spectrum& power);
+    Photon(const Vector3& direction, const Spectrum& power);
     Vector3 Direction() const;
-    const Vector3& Position() const;
     Spectrum Power() const;
     void ScalePower(float scale);
 
 private:
 
-    Vector3 position;
-    float dirPhi, dirTheta; // Direction in spherical coordinates
     RGBE power;
+    PackedDirection direction;
 };
 
 typedef Photon CausticPhoton;
@@ -53,13 +70,14 @@ typedef Photon DirectPhoton;
 class IrradiancePhoton : public Photon
 {
 public:
+    IrradiancePhoton();
     // The constructor assumes that the direction and normal are of unit length.
-    IrradiancePhoton(const Vector3& position, const Vector3& direction, const Vector3& normal, const Spectrum& power);
+    IrradiancePhoton(const Vector3& direction, const Vector3& normal, const Spectrum& power);
     Vector3 Normal() const;
 
 private:
 
-    float normalPhi, normalTheta; // Normal in spherical coordinates
+    PackedDirection normal;
 };
 
 // Helper data structure for cache-efficient photon lookup in the photon map
@@ -0,0 +1,175 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Integrators/PhotonMapping/PhotonHashGrid.h"
+#include <algorithm>
+#include <limits>
+#include "renderbliss/Interfaces/IJob.h"
+#include "renderbliss/Math/MathUtils.h"
+#include "renderbliss/Utils/AtomicOps.h"
+#include "renderbliss/Utils/JobScheduler.h"
+
+namespace renderbliss
+{
+class PhotonHashGrid::CountingJob : public IJob
+{
+public:
+
+    CountingJob(PhotonHashGrid& grid, uint32 job, JobScheduler& scheduler) : grid(grid), job(job), scheduler(scheduler) {}
+
+    virtual void Run() const
+    {
+        grid.CountPhotons(job, scheduler);
+    }
+
+private:
+
+    // Jobs write to disjoint ranges of the shared grid
+    mutable PhotonHashGrid& grid;
+    uint32 job;
+    mutable JobScheduler& scheduler;
+};
+
+class PhotonHashGrid::ScatteringJob : public IJob
+{
+public:
+
+    ScatteringJob(PhotonHashGrid& grid, uint32 job) : grid(grid), job(job) {}
+
+    virtual void Run() const
+    {
+        grid.ScatterPhotons(job);
+    }
+
+private:
+
+    mutable PhotonHashGrid& grid;
+    uint32 job;
+};
+
+PhotonHashGrid::PhotonHashGrid()
+    : cellSize(1.0f), invCellSize(1.0f), numBuckets(1), buildPositions(0), numBuildPhotons(0), numJobs(0), numCountedJobs(0)
+{
+    std::fill(minCell, minCell+3, 0);
+    std::fill(maxCell, maxCell+3, -1);
+}
+
+void PhotonHashGrid::SpawnBuildingJobs(const Vector3* positions, uint32 numPhotons, real cellSize, JobScheduler& scheduler)
+{
+    RB_ASSERT(cellSize > 0.0f);
+    this->cellSize = cellSize;
+    invCellSize = 1.0f / cellSize;
+
+    // About four photons per bucket, since most cells hold many photons
+    numBuckets = RoundToPowerOfTwo(std::max(numPhotons/4, 1u));
+    bucketStarts.assign(numBuckets+1, 0);
+
+    buildPositions = positions;
+    numBuildPhotons = numPhotons;
+    numJobs = std::min(std::max((numPhotons + MinPhotonsPerJob-1) / MinPhotonsPerJob, 1u), static_cast<uint32>(MaxJobs));
+    numCountedJobs = 0;
+    photonBuckets.resize(numPhotons);
+    jobOffsets.assign(numJobs*numBuckets, 0);
+    jobCellRanges.resize(6*numJobs);
+    order.resize(numPhotons);
+
+    // The last counting job computes the bucket offsets, and spawns the scattering jobs
+    for (uint32 job = 0; job < numJobs; ++job)
+    {
+        scheduler.Spawn(JobConstPtr(new CountingJob(*this, job, scheduler)));
+    }
+}
+
+void PhotonHashGrid::FinishBuilding(std::vector<uint32>& order)
+{
+    order.swap(this->order);
+    std::vector<uint32>().swap(this->order);
+    std::vector<uint32>().swap(photonBuckets);
+    std::vector<uint32>().swap(jobOffsets);
+    std::vector<int>().swap(jobCellRanges);
+    buildPositions = 0;
+}
+
+void PhotonHashGrid::CountPhotons(uint32 job, JobScheduler& scheduler)
+{
+    uint32 start = static_cast<uint32>(static_cast<size_t>(numBuildPhotons)*job / numJobs);
+    uint32 end = static_cast<uint32>(static_cast<size_t>(numBuildPhotons)*(job+1) / numJobs);
+    uint32* counts = &jobOffsets[job*numBuckets];
+    int* cellRange = &jobCellRanges[6*job];
+    std::fill(cellRange, cellRange+3, std::numeric_limits<int>::max());
+    std::fill(cellRange+3, cellRange+6, std::numeric_limits<int>::min());
+    for (uint32 i = start; i < end; ++i)
+    {
+        const Vector3& p = buildPositions[i];
+        int cell[3] = {CellCoordinate(p[0]), CellCoordinate(p[1]), CellCoordinate(p[2])};
+        uint32 bucket = Bucket(cell[0], cell[1], cell[2]);
+        photonBuckets[i] = bucket;
+        ++counts[bucket];
+        for (unsigned axis = 0; axis < 3; ++axis)
+        {
+            cellRange[axis] = std::min(cellRange[axis], cell[axis]);
+            cellRange[3+axis] = std::max(cellRange[3+axis], cell[axis]);
+        }
+    }
+
+    if (AtomicIncrement(&numCountedJobs) != numJobs-1) return;
+
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+        minCell[axis] = std::numeric_limits<int>::max();
+        maxCell[axis] = std::numeric_limits<int>::min();
+        for (uint32 j = 0; j < numJobs; ++j)
+        {
+            minCell[axis] = std::min(minCell[axis], jobCellRanges[6*j+axis]);
+            maxCell[axis] = std::max(maxCell[axis], jobCellRanges[6*j+3+axis]);
+        }
+    }
+
+    // Buckets are laid out in order, and the photons of a bucket in job order, which keeps the sort stable
+    uint32 offset = 0;
+    for (uint32 bucket = 0; bucket < numBuckets; ++bucket)
+    {
+        bucketStarts[bucket] = offset;
+        for (uint32 j = 0; j < numJobs; ++j)
+        {
+            uint32 count = jobOffsets[j*numBuckets + bucket];
+            jobOffsets[j*numBuckets + bucket] = offset;
+            offset += count;
+        }
+    }
+    bucketStarts[numBuckets] = offset;
+
+    for (uint32 j = 0; j < numJobs; ++j)
+    {
+        scheduler.Spawn(JobConstPtr(new ScatteringJob(*this, j)));
+    }
+}
+
+void PhotonHashGrid::ScatterPhotons(uint32 job)
+{
+    uint32 start = static_cast<uint32>(static_cast<size_t>(numBuildPhotons)*job / numJobs);
+    uint32 end = static_cast<uint32>(static_cast<size_t>(numBuildPhotons)*(job+1) / numJobs);
+    uint32* offsets = &jobOffsets[job*numBuckets];
+    for (uint32 i = start; i < end; ++i)
+    {
+        order[offsets[photonBuckets[i]]++] = i;
+    }
+}
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_PHOTON_HASH_GRID_H
+#define RENDERBLISS_PHOTON_HASH_GRID_H
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Math/Geometry/Vector3.h"
+
+namespace renderbliss
+{
+class JobScheduler;
+
+// Uniform grid of photons, whose cells are hashed into a fixed number of buckets. Suited to fixed-radius
+// lookups, where a query only visits the few cells overlapping its search sphere. The photons are sorted
+// into buckets by a parallel counting sort, and the photons of every bucket are expected to be stored
+// consecutively by the photon map once the grid is built.
+class PhotonHashGrid : boost::noncopyable
+{
+public:
+
+    PhotonHashGrid();
+
+    // Spawns the jobs sorting photon positions into the buckets of a grid of a given cell size.
+    // The positions must stay alive until the scheduler has run the jobs, after which FinishBuilding must be called.
+    void SpawnBuildingJobs(const Vector3* positions, uint32 numPhotons, real cellSize, JobScheduler& scheduler);
+
+    // Outputs the order in which photons are to be stored: the i-th photon of the grid is the photon
+    // at index order[i] of the positions passed to SpawnBuildingJobs.
+    void FinishBuilding(std::vector<uint32>& order);
+
+    // Calls visitor(index, sqrDist) for the photons of the cells overlapping a sphere, where sqrDist is
+    // the squared distance from the photon to the sphere center. Since cells may share buckets, photons
+    // farther away from the sphere may be visited too, but every photon is visited at most once.
+    // Only the cells within the bound of the photons are visited, so that large spheres cost at most a scan of the buckets.
+    template <typename Visitor>
+    void Visit(const Vector3* positions, const Vector3& center, real radius, Visitor& visitor) const;
+
+private:
+
+    enum { MinPhotonsPerJob = 16384 };
+    enum { MaxJobs = 8 };
+    enum { MaxVisitedBuckets = 64 }; // Larger queries sort their buckets on the heap
+
+    // Jobs counting and scattering a range of photons
+    class CountingJob;
+    class ScatteringJob;
+
+    real cellSize;
+    real invCellSize;
+    uint32 numBuckets; // Power of two
+    std::vector<uint32> bucketStarts; // Index of the first photon of every bucket, and past the last bucket
+    int minCell[3], maxCell[3]; // Range of the cells holding photons
+
+    // Counting sort state, released by FinishBuilding
+    const Vector3* buildPositions;
+    uint32 numBuildPhotons;
+    uint32 numJobs;
+    volatile uint32 numCountedJobs;
+    std::vector<uint32> photonBuckets;
+    std::vector<uint32> jobOffsets; // Photon count, then next photon index, of every bucket for every job
+    std::vector<int> jobCellRanges; // Minimum then maximum cell coordinates of the photons of every job
+    std::vector<uint32> order;
+
+    int CellCoordinate(real x) const;
+    uint32 Bucket(int x, int y, int z) const;
+    template <typename Visitor>
+    void VisitBuckets(const Vector3* positions, const Vector3& center, const uint32* buckets, uint32 numVisitedBuckets, Visitor& visitor) const;
+    void CountPhotons(uint32 job, JobScheduler& scheduler);
+    void ScatterPhotons(uint32 job);
+};
+}
+
+#include "renderbliss/Integrators/PhotonMapping/PhotonHashGrid.inl"
+
+#endif
@@ -0,0 +1,117 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace renderbliss
+{
+inline int PhotonHashGrid::CellCoordinate(real x) const
+{
+    // Clamped so that remote photons do not overflow the cell coordinates
+    real c = std::floor(x*invCellSize);
+    return static_cast<int>((c < -1.0e9f) ? -1.0e9f : (c > 1.0e9f) ? 1.0e9f : c);
+}
+
+inline uint32 PhotonHashGrid::Bucket(int x, int y, int z) const
+{
+    uint32 hash = (static_cast<uint32>(x)*73856093u) ^ (static_cast<uint32>(y)*19349663u) ^ (static_cast<uint32>(z)*83492791u);
+    return hash & (numBuckets-1);
+}
+
+template <typename Visitor>
+void PhotonHashGrid::Visit(const Vector3* positions, const Vector3& center, real radius, Visitor& visitor) const
+{
+    if (bucketStarts.empty()) return;
+
+    // Cells outside the range of the photons are empty
+    int minX = std::max(CellCoordinate(center[0]-radius), minCell[0]), maxX = std::min(CellCoordinate(center[0]+radius), maxCell[0]);
+    int minY = std::max(CellCoordinate(center[1]-radius), minCell[1]), maxY = std::min(CellCoordinate(center[1]+radius), maxCell[1]);
+    int minZ = std::max(CellCoordinate(center[2]-radius), minCell[2]), maxZ = std::min(CellCoordinate(center[2]+radius), maxCell[2]);
+    if ((minX > maxX) || (minY > maxY) || (minZ > maxZ)) return;
+    real numCells = (static_cast<real>(maxX)-minX+1.0f) * (static_cast<real>(maxY)-minY+1.0f) * (static_cast<real>(maxZ)-minZ+1.0f);
+
+    // Spheres overlapping as many cells as there are buckets visit every bucket
+    if (numCells >= numBuckets)
+    {
+        uint32 numPhotons = bucketStarts[numBuckets];
+        for (uint32 i = 0; i < numPhotons; ++i)
+        {
+            visitor(i, SquaredDistance(positions[i], center));
+        }
+        return;
+    }
+
+    // Gather the distinct buckets of the overlapped cells
+    if (numCells <= MaxVisitedBuckets)
+    {
+        uint32 buckets[MaxVisitedBuckets];
+        uint32 numVisitedBuckets = 0;
+        for (int z = minZ; z <= maxZ; ++z)
+        {
+            for (int y = minY; y <= maxY; ++y)
+            {
+                for (int x = minX; x <= maxX; ++x)
+                {
+                    uint32 bucket = Bucket(x, y, z);
+                    uint32* last = buckets + numVisitedBuckets;
+                    if (std::find(buckets, last, bucket) == last)
+                    {
+                        buckets[numVisitedBuckets++] = bucket;
+                    }
+                }
+            }
+        }
+        VisitBuckets(positions, center, buckets, numVisitedBuckets, visitor);
+    }
+    else
+    {
+        std::vector<uint32> buckets;
+        buckets.reserve(static_cast<size_t>(numCells));
+        for (int z = minZ; z <= maxZ; ++z)
+        {
+            for (int y = minY; y <= maxY; ++y)
+            {
+                for (int x = minX; x <= maxX; ++x)
+                {
+                    buckets.push_back(Bucket(x, y, z));
+                }
+            }
+        }
+        std::sort(buckets.begin(), buckets.end());
+        buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+        VisitBuckets(positions, center, &buckets[0], static_cast<uint32>(buckets.size()), visitor);
+    }
+}
+
+template <typename Visitor>
+void PhotonHashGrid::VisitBuckets(const Vector3* positions, const Vector3& center, const uint32* buckets, uint32 numVisitedBuckets, Visitor& visitor) const
+{
+    for (uint32 b = 0; b < numVisitedBuckets; ++b)
+    {
+        uint32 end = bucketStarts[buckets[b]+1];
+        for (uint32 i = bucketStarts[buckets[b]]; i < end; ++i)
+        {
+            visitor(i, SquaredDistance(positions[i], center));
+        }
+    }
+}
+}
@@ -20,18 +20,150 @@
 
 #include "renderbliss/Integrators/PhotonMapping/PhotonMap.h"
 #include <algorithm>
+#include <cmath>
 #include <functional>
+#include "renderbliss/Interfaces/IJob.h"
 #include "renderbliss/Interfaces/IMaterial.h"
 #include "renderbliss/Math/MathUtils.h"
 #include "renderbliss/Math/Geometry/Intersection.h"
+#include "renderbliss/Utils/AtomicOps.h"
+#include "renderbliss/Utils/JobScheduler.h"
 
 namespace
 {
     using namespace renderbliss;
+
+    // Visitor keeping the nearest irradiance photon facing a normal.
+    // The radius shrinks to the nearest photon found so far.
+    class NearestIrradiancePhotonGatherer
+    {
+    public:
+
+        NearestIrradiancePhotonGatherer(const std::vector<IrradiancePhoton>& photons, const Vector3& normal, real normalThreshold,
+                                        real sqrMaxRadius, NearestPhoton& nearest)
+            : found(false), photons(photons), normal(normal), normalThreshold(normalThreshold), sqrMaxRadius(sqrMaxRadius), nearest(nearest) {}
+
+        void operator()(uint32 index, real sqrDist)
+        {
+            if (   (sqrDist < nearest.sqrDist) && (sqrDist < sqrMaxRadius)
+                && (DotProduct(photons[index].Direction(), normal) > 0.0f)
+                && (DotProduct(photons[index].Normal(), normal) > normalThreshold))
+            {
+                nearest.index = index;
+                nearest.sqrDist = sqrMaxRadius = sqrDist;
+                found = true;
+            }
+        }
+
+        real SqrMaxRadius() const { return sqrMaxRadius; }
+
+        bool found;
+
+    private:
+
+        const std::vector<IrradiancePhoton>& photons;
+        Vector3 normal;
+        real normalThreshold;
+        real sqrMaxRadius;
+        NearestPhoton& nearest;
+    };
+
+    // Visitor summing the radiance reflected by a surface from the photons within a fixed radius
+    class FixedRadiusRadianceGatherer
+    {
+    public:
+
+        FixedRadiusRadianceGatherer(const std::vector<Photon>& photons, const Intersection& hit, const Vector3& outgoingDirection,
+                                    const Vector3& shadingNormal, real sqrRadius)
+            : photons(photons), hit(hit), outgoingDirection(outgoingDirection), shadingNormal(shadingNormal), sqrRadius(sqrRadius) {}
+
+        void operator()(uint32 index, real sqrDist)
+        {
+            if (sqrDist >= sqrRadius) return;
+
+            // Depending on the orientation of the photon direction with respect
+            // to the hit normal either reflection or refraction will be eliminated
+            const Photon& photon = photons[index];
+            int bsdfFlags = BsdfCombinedFlags::Diffuse | BsdfCombinedFlags::Glossy; // Only evaluate non-specular BSDFs
+            bsdfFlags &= ((DotProduct(photon.Direction(), shadingNormal) > 0.0f) ? ~BsdfCombinedFlags::Transmission : ~BsdfCombinedFlags::Reflection);
+            radiance += hit.material->BsdfCombinedFlagsValue(photon.Direction(), outgoingDirection, hit, bsdfFlags) * photon.Power();
+        }
+
+        real SqrMaxRadius() const { return sqrRadius; }
+
+        Spectrum radiance;
+
+    private:
+
+        const std::vector<Photon>& photons;
+        const Intersection& hit;
+        Vector3 outgoingDirection;
+        Vector3 shadingNormal;
+        real sqrRadius;
+    };
 }
 
 namespace renderbliss
 {
+class IrradiancePhotonMap::PrecomputationJob : public IJob
+{
+public:
+
+    PrecomputationJob(const IrradiancePhotonMap& indirectPhotonMap, const CausticPhotonMap& causticPhotonMap,
+                      const DirectPhotonMap& directPhotonMap, size_t start, size_t end,
+                      std::vector<Vector3>& irradiancePositions, std::vector<IrradiancePhoton>& irradiancePhotons,
+                      AtomicCounter& numPrecomputedPhotons);
+    virtual void Run() const;
+
+private:
+
+    const IrradiancePhotonMap& indirectPhotonMap;
+    const CausticPhotonMap& causticPhotonMap;
+    const DirectPhotonMap& directPhotonMap;
+    size_t start, end; // Range of irradiance photons to precompute
+
+    // Shared members will be written concurrently, each job writing its own range of photons
+    mutable std::vector<Vector3>& irradiancePositions;
+    mutable std::vector<IrradiancePhoton>& irradiancePhotons;
+    mutable AtomicCounter& numPrecomputedPhotons;
+};
+}
+
+namespace renderbliss
+{
+IrradiancePhotonMap::PrecomputationJob::PrecomputationJob(const IrradiancePhotonMap& indirectPhotonMap, const CausticPhotonMap& causticPhotonMap,
+                                                          const DirectPhotonMap& directPhotonMap, size_t start, size_t end,
+                                                          std::vector<Vector3>& irradiancePositions, std::vector<IrradiancePhoton>& irradiancePhotons,
+                                                          AtomicCounter& numPrecomputedPhotons)
+    : indirectPhotonMap(indirectPhotonMap), causticPhotonMap(causticPhotonMap), directPhotonMap(directPhotonMap),
+      start(start), end(end), irradiancePositions(irradiancePositions), irradiancePhotons(irradiancePhotons),
+      numPrecomputedPhotons(numPrecomputedPhotons)
+{
+}
+
+void IrradiancePhotonMap::PrecomputationJob::Run() const
+{
+    const Settings& settings = indirectPhotonMap.settings;
+
+    // The nearest photon heap is reused by all lookups of the job
+    NearestPhotonHeap heap(settings.numPhotonsToGather);
+
+    for (size_t i = start; i < end; ++i)
+    {
+        const Vector3& position = irradiancePositions[i];
+        const IrradiancePhoton& ip = indirectPhotonMap.photons[i*indirectPhotonMap.spacing];
+        Vector3 normal = ip.Normal();
+
+        Spectrum irradiance =   indirectPhotonMap.IrradianceEstimate(position, normal, settings.numPhotonsToGather, settings.gatherRadius, heap)
+                              + causticPhotonMap.IrradianceEstimate(position, normal, settings.numPhotonsToGather, settings.gatherRadius, heap)
+                              + directPhotonMap.IrradianceEstimate(position, normal, settings.numPhotonsToGather, settings.gatherRadius, heap);
+
+        irradiancePhotons[i] = IrradiancePhoton(ip.Direction(), normal, irradiance);
+    }
+
+    numPrecomputedPhotons.Add(static_cast<uint32>(end-start));
+}
+
 // Caustic/Direct photon map implementation
 
 PhotonMap::PhotonMap(const PropertyMap& props) : PhotonMapTemplate<CausticPhoton>(props)
@@ -48,31 +180,23 @@ Spectrum PhotonMap::RadianceEstimate(const Intersection& hit, const Vector3& out
         return Spectrum::black;
     }
 
-    std::vector<NearestPhoton> heap;
-    heap.reserve(settings.numPhotonsToGather);
-    real sqrMaxRadius = Sqr(settings.gatherRadius);
-
-    LocatePhotons(hit.point, settings.numPhotonsToGather, sqrMaxRadius, 0, heap);
+    NearestPhotonHeap& heap = ThreadNearestPhotonHeap(settings.numPhotonsToGather);
+    LocatePhotons(hit.point, Sqr(settings.gatherRadius), heap);
 
-    if (heap.empty())
+    if (heap.Empty())
     {
         return Spectrum::black;
     }
 
-    RB_ASSERT(heap.size() <= settings.numPhotonsToGather);
-    if (heap.size() < settings.numPhotonsToGather-1)
-    {
-        std::make_heap(heap.begin(), heap.end());
-        sqrMaxRadius = heap[0].sqrDist;
-    }
-
     // Get forward facing shading normal
     Vector3 shadingNormal = DotProduct(outgoingDirection, hit.uvn.N()) < 0.0f ? -hit.uvn.N() : hit.uvn.N();
 
     // Sum weighted irradiance from all nearest photons
+    real sqrMaxRadius = heap.MaxSqrDist();
     Spectrum radiance;
-    foreach (const NearestPhoton& np, heap)
+    for (uint32 i = 0; i < heap.Size(); ++i)
     {
+        const NearestPhoton& np = heap[i];
         const Photon& heapPhoton = photons[np.index];
 
         // Depending on the orientation of the photon direction with respect
@@ -94,17 +218,37 @@ Spectrum PhotonMap::RadianceEstimate(const Intersection& hit, const Vector3& out
     return radiance;
 }
 
-void PhotonMap::StorePhotons(const std::vector<Vector3>& positions, const std::vector<Vector3>& directions, const std::vector<Spectrum>& powers)
+Spectrum PhotonMap::FixedRadiusRadianceEstimate(const Intersection& hit, const Vector3& outgoingDirection, real radius) const
 {
-    if (!Full() && (positions.size() == directions.size()) && (directions.size() == powers.size()))
+    if (    Empty()
+        || (radius <= 0.0f)
+        || !hit.material
+        || !hit.material->MatchesFlags(BsdfCombinedFlags::Diffuse | BsdfCombinedFlags::Glossy) /* Only evaluate non-specular BSDFs*/)
     {
-        size_t count = positions.size();
-        for (size_t i = 0; i < count; ++i)
-        {
-            if (PhotonCount() >= PhotonMapTemplate<CausticPhoton>::MaxStoredPhotons) break;
-            photons.push_back(Photon(positions[i], directions[i], powers[i]));
-        }
+        return Spectrum::black;
+    }
+
+    // Get forward facing shading normal
+    Vector3 shadingNormal = DotProduct(outgoingDirection, hit.uvn.N()) < 0.0f ? -hit.uvn.N() : hit.uvn.N();
+
+    FixedRadiusRadianceGatherer gatherer(photons, hit, outgoingDirection, shadingNormal, Sqr(radius));
+    VisitPhotons(hit.point, gatherer);
+    return gatherer.radiance / (Pi()*Sqr(radius));
+}
+
+size_t PhotonMap::StorePhotons(const std::vector<Vector3>& positions, const std::vector<Vector3>& directions, const std::vector<Spectrum>& powers)
+{
+    if ((positions.size() != directions.size()) || (directions.size() != powers.size())) return 0;
+
+    // Only the reservation is synchronized, the photons are converted into their own slots
+    uint32 first = 0;
+    uint32 count = ReservePhotons(static_cast<uint32>(positions.size()), first);
+    for (uint32 i = 0; i < count; ++i)
+    {
+        this->positions[first+i] = positions[i];
+        photons[first+i] = Photon(directions[i], powers[i]);
     }
+    return count;
 }
 
 // Global photon map implementation
@@ -116,80 +260,43 @@ IrradiancePhotonMap::IrradiancePhotonMap(const PropertyMap& props) : PhotonMapTe
     Clamp(0.0f, 0.95f, normalThreshold);
 }
 
-bool IrradiancePhotonMap::LocateNearestPhoton(const Vector3& queryLocation, const Vector3& normal, real& sqrMaxRadius, size_t nodeIndex, NearestPhoton& nearest) const
+bool IrradiancePhotonMap::LocateNearestPhoton(const Vector3& queryLocation, const Vector3& normal, real sqrMaxRadius, NearestPhoton& nearest) const
 {
-    bool result = false;
-    const PhotonNode& currentNode = nodes[nodeIndex];
-    if (!currentNode.IsLeaf())
-    {
-        int splitAxis = currentNode.SplitAxis();
-        real splitPosition = currentNode.SplitPosition();
-        real sqrRadius = Sqr(queryLocation[splitAxis] - splitPosition);
-        if (queryLocation[splitAxis] <= splitPosition)
-        {
-            if (currentNode.HasNearChild())
-            {
-                result |= LocateNearestPhoton(queryLocation, normal, sqrMaxRadius, nodeIndex+1, nearest);
-            }
-            if ((sqrRadius < sqrMaxRadius) && currentNode.HasFarChild())
-            {
-                result |= LocateNearestPhoton(queryLocation, normal, sqrMaxRadius, currentNode.FarChildIndex(), nearest);
-            }
-        }
-        else
-        {
-            if (currentNode.HasFarChild())
-            {
-                result |= LocateNearestPhoton(queryLocation, normal, sqrMaxRadius, currentNode.FarChildIndex(), nearest);
-            }
-            if ((sqrRadius < sqrMaxRadius) && currentNode.HasNearChild())
-            {
-                result |= LocateNearestPhoton(queryLocation, normal, sqrMaxRadius, nodeIndex+1, nearest);
-            }
-        }
-    }
-
-    real sqrDistToPhoton = SquaredDistance(photons[nodeIndex].Position(), queryLocation);
-    if ((sqrDistToPhoton < nearest.sqrDist) && (sqrDistToPhoton <= sqrMaxRadius))
-    {
-        if (   (DotProduct(photons[nodeIndex].Direction(), normal) > 0.0f)
-            && (DotProduct(photons[nodeIndex].Normal(), normal) > normalThreshold))
-        {
-            nearest.index = nodeIndex;
-            nearest.sqrDist = sqrMaxRadius = sqrDistToPhoton;
-            result = true;
-        }
-    }
-
-    return result;
+    NearestIrradiancePhotonGatherer gatherer(photons, normal, normalThreshold, sqrMaxRadius, nearest);
+    VisitPhotons(queryLocation, gatherer);
+    return gatherer.found;
 }
 
-void IrradiancePhotonMap::PrecomputeIrradianceEstimate(const CausticPhotonMap& causticPhotonMap, const DirectPhotonMap& directPhotonMap)
+void IrradiancePhotonMap::PrecomputeIrradianceEstimate(const CausticPhotonMap& causticPhotonMap, const DirectPhotonMap& directPhotonMap,
+                                                       JobScheduler& scheduler, AtomicCounter& numPrecomputedPhotons)
 {
-    std::vector<NearestPhoton> causticHeap, directHeap, indirectHeap;
-    causticHeap.reserve(settings.numPhotonsToGather);
-    directHeap.reserve(settings.numPhotonsToGather);
-    indirectHeap.reserve(settings.numPhotonsToGather);
-
+    // Every 'spacing'-th photon is copied, and then overwritten with its estimate by one of the jobs.
+    // Each job owns a fixed range of photons, so the result does not depend on the job execution order.
     size_t numStoredPhotons = PhotonCount();
+    std::vector<Vector3> irradiancePositions;
     std::vector<IrradiancePhoton> irradiancePhotons;
-    irradiancePhotons.reserve(numStoredPhotons/spacing);
-
+    irradiancePositions.reserve((numStoredPhotons+spacing-1)/spacing);
+    irradiancePhotons.reserve((numStoredPhotons+spacing-1)/spacing);
     for (size_t i = 0; i < numStoredPhotons; i += spacing)
     {
-        indirectHeap.clear();
-        const IrradiancePhoton& ip = photons[i];
-
-        Spectrum irradiance =   IrradianceEstimate(ip.Position(), ip.Normal(), settings.numPhotonsToGather, settings.gatherRadius)
-                              + causticPhotonMap.IrradianceEstimate(ip.Position(), ip.Normal(), settings.numPhotonsToGather, settings.gatherRadius)
-                              + directPhotonMap.IrradianceEstimate(ip.Position(), ip.Normal(), settings.numPhotonsToGather, settings.gatherRadius);
+        irradiancePositions.push_back(positions[i]);
+        irradiancePhotons.push_back(photons[i]);
+    }
 
-        irradiancePhotons.push_back(IrradiancePhoton(ip.Position(), ip.Direction(), ip.Normal(), irradiance));
+    size_t numIrradiancePhotons = irradiancePhotons.size();
+    for (size_t start = 0; start < numIrradiancePhotons; start += PhotonsPerPrecomputationJob)
+    {
+        size_t end = std::min(start + PhotonsPerPrecomputationJob, numIrradiancePhotons);
+        scheduler.Spawn(JobConstPtr(new PrecomputationJob(*this, causticPhotonMap, directPhotonMap, start, end,
+                                                          irradiancePositions, irradiancePhotons, numPrecomputedPhotons)));
     }
+    scheduler.WaitForAllJobs();
 
+    positions.swap(irradiancePositions);
     photons.swap(irradiancePhotons);
+    std::vector<Vector3>().swap(irradiancePositions);
     std::vector<IrradiancePhoton>().swap(irradiancePhotons);
-    Balance();
+    Balance(scheduler);
 }
 
 Spectrum IrradiancePhotonMap::RadianceEstimate(const Intersection& hit, const Vector3& outgoingDirection)
@@ -203,8 +310,7 @@ Spectrum IrradiancePhotonMap::RadianceEstimate(const Intersection& hit, const Ve
     }
 
     NearestPhoton nearest;
-    real sqrMaxRadius = settings.gatherRadius*settings.gatherRadius;
-    if (!LocateNearestPhoton(hit.point, hit.uvn.N(), sqrMaxRadius, 0, nearest))
+    if (!LocateNearestPhoton(hit.point, hit.uvn.N(), Sqr(settings.gatherRadius), nearest))
     {
         return Spectrum::black;
     }
@@ -224,16 +330,18 @@ Spectrum IrradiancePhotonMap::RadianceEstimate(const Intersection& hit, const Ve
     return photons[nearest.index].Power()*bsdf;
 }
 
-void IrradiancePhotonMap::StorePhotons(const std::vector<Vector3>& positions, const std::vector<Vector3>& directions, const std::vector<Vector3>& normals, const std::vector<Spectrum>& powers)
+size_t IrradiancePhotonMap::StorePhotons(const std::vector<Vector3>& positions, const std::vector<Vector3>& directions, const std::vector<Vector3>& normals, const std::vector<Spectrum>& powers)
 {
-    if (!Full() && (positions.size() == directions.size()) && (directions.size() == powers.size()))
+    if ((positions.size() != directions.size()) || (directions.size() != normals.size()) || (normals.size() != powers.size())) return 0;
+
+    // Only the reservation is synchronized, the photons are converted into their own slots
+    uint32 first = 0;
+    uint32 count = ReservePhotons(static_cast<uint32>(positions.size()), first);
+    for (uint32 i = 0; i < count; ++i)
     {
-        size_t count = positions.size();
-        for (size_t i = 0; i < count; ++i)
-        {
-            if (PhotonCount() >= PhotonMapTemplate<IrradiancePhoton>::MaxStoredPhotons) break;
-            photons.push_back(IrradiancePhoton(positions[i], directions[i], normals[i], powers[i]));
-        }
+        this->positions[first+i] = positions[i];
+        photons[first+i] = IrradiancePhoton(directions[i], normals[i], powers[i]);
     }
+    return count;
 }
 }
@@ -29,6 +29,8 @@
 
 namespace renderbliss
 {
+class AtomicCounter;
+
 class PhotonMap : public PhotonMapTemplate<CausticPhoton>
 {
 public:
@@ -36,8 +38,10 @@ public:
     PhotonMap(const PropertyMap& props);
     // Estimates the radiance at a surface intersection towrads a given direction
     Spectrum RadianceEstimate(const Intersection& hit, const Vector3& outgoingDirection);
-    // Creates and stores photons
-    void StorePhotons(const std::vector<Vector3>& positions, const std::vector<Vector3>& directions, const std::vector<Spectrum>& powers);
+    // Same as above, but from all the photons within a fixed radius and with a constant kernel, as progressive photon mapping requires
+    Spectrum FixedRadiusRadianceEstimate(const Intersection& hit, const Vector3& outgoingDirection, real radius) const;
+    // Creates and stores photons, and returns the number of photons stored. Can be called concurrently.
+    size_t StorePhotons(const std::vector<Vector3>& positions, const std::vector<Vector3>& directions, const std::vector<Spectrum>& powers);
 };
 
 typedef PhotonMap CausticPhotonMap;
@@ -48,19 +52,29 @@ class IrradiancePhotonMap : public PhotonMapTemplate<IrradiancePhoton>
 public:
 
     IrradiancePhotonMap(const PropertyMap& props);
-    // Precomputes the irradiance estimate at every 'spacing'-th photon, given a caustic and a direct photon map for the same scene
-    void PrecomputeIrradianceEstimate(const CausticPhotonMap& causticPhotonMap, const DirectPhotonMap& directPhotonMap);
+    // Precomputes the irradiance estimate at every 'spacing'-th photon, given a caustic and a direct photon map for the same scene.
+    // The estimates are split into jobs, and 'numPrecomputedPhotons' counts the estimates completed so far.
+    void PrecomputeIrradianceEstimate(const CausticPhotonMap& causticPhotonMap, const DirectPhotonMap& directPhotonMap,
+                                      JobScheduler& scheduler, AtomicCounter& numPrecomputedPhotons);
     // Estimates the radiance at a surface intersection towards a given direction
     Spectrum RadianceEstimate(const Intersection& hit, const Vector3& outgoingDirection);
-    // Creates and stores photons
-    void StorePhotons(const std::vector<Vector3>& positions, const std::vector<Vector3>& directions, const std::vector<Vector3>& normals, const std::vector<Spectrum>& powers);
+    // Creates and stores photons, and returns the number of photons stored. Can be called concurrently.
+    size_t StorePhotons(const std::vector<Vector3>& positions, const std::vector<Vector3>& directions, const std::vector<Vector3>& normals, const std::vector<Spectrum>& powers);
 
-private:
+protected:
+
+    // Finds the photon nearest to the hit location within a search radius
+    bool LocateNearestPhoton(const Vector3& queryLocation, const Vector3& normal, real sqrMaxRadius, NearestPhoton& nearest) const;
 
     uint32 spacing;
     float normalThreshold; // Normal threshold for irradiance photon lookup
-    // Finds the photon nearest to the hit location within a search radius
-    bool LocateNearestPhoton(const Vector3& queryLocation, const Vector3& normal, real& sqrMaxRadius, size_t nodeIndex, NearestPhoton& nearest) const;
+
+private:
+
+    enum { PhotonsPerPrecomputationJob = 2048 };
+
+    // Job precomputing the irradiance estimate of a range of photons
+    class PrecomputationJob;
 };
 }
 
@@ -21,23 +21,30 @@
 #ifndef RENDERBLISS_PHOTON_MAP_TEMPLATE_H
 #define RENDERBLISS_PHOTON_MAP_TEMPLATE_H
 
+#include <iosfwd>
 #include <vector>
+#include <boost/atomic.hpp>
 #include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
 #include "renderbliss/Types.h"
 #include "renderbliss/Colour/Spectrum.h"
 #include "renderbliss/Math/MathUtils.h"
 #include "renderbliss/Math/Geometry/BoundingBox.h"
+#include "renderbliss/Math/Geometry/Vector3.h"
+#include "renderbliss/Integrators/PhotonMapping/NearestPhotonHeap.h"
 #include "renderbliss/Integrators/PhotonMapping/Photon.h"
+#include "renderbliss/Integrators/PhotonMapping/PhotonHashGrid.h"
 
 namespace renderbliss
 {
 struct Intersection;
+class  JobScheduler;
 class  PropertyMap;
-struct Vector3;
 
 // Building blocks of photon map data structure based on Henrik Wann Jensen's
 // implementation in the book "Realistic Image Synthesis Using Photon Mapping".
 // To be overriden for caustic and global photon storage.
+// Photons are looked up through a balanced kd-tree, or a hash grid when the "photon_lookup" property is "hash_grid".
 template <typename PhotonType>
 class PhotonMapTemplate
 {
@@ -45,67 +52,178 @@ public:
 
     PhotonMapTemplate(const PropertyMap& props);
 
-    // Creates a left-balanced kd-tree from the photon array. Must be called *once* after
-    // all photons have been stored, *and* before the photon map is used for rendering.
-    void Balance();
+    // Creates a left-balanced kd-tree from the photon array, balancing large subtrees in parallel, or builds the
+    // hash grid. Must be called *once* after all photons have been stored, *and* before the photon map is used for rendering.
+    void Balance(JobScheduler& scheduler);
+
+    // Split version of Balance, so that several photon maps can be balanced concurrently. FinishBalancing
+    // must be called after the scheduler has run the jobs spawned by SpawnBalancingJobs.
+    void SpawnBalancingJobs(JobScheduler& scheduler);
+    void FinishBalancing();
 
     // Returns whether the photon map is empty
     bool Empty() const;
 
-    // Returns whether the target number of photons to store has been reached
+    // Returns whether the target number of photons to store has been reached.
+    // Can be called concurrently with photon storage.
     bool Full() const;
 
     // Returns the number of photons stored
     size_t PhotonCount() const;
 
-    // Estimates the irradiance at a surface position and normal
+    // Estimates the irradiance at a surface position and normal, with the nearest photon heap of the calling thread
     Spectrum IrradianceEstimate(const Vector3& point, const Vector3& normal, uint32 numLookup, real gatherRadius) const;
 
+    // Same as above, but reuses the storage of a caller-provided heap for the nearest photons
+    Spectrum IrradianceEstimate(const Vector3& point, const Vector3& normal, uint32 numLookup, real gatherRadius, NearestPhotonHeap& heap) const;
+
+    // Estimates the irradiance from all the photons within a fixed radius, divided by the area of the disc of that radius,
+    // as progressive photon mapping requires. Unlike above, the estimate does not adapt its radius to the photon density.
+    Spectrum FixedRadiusIrradianceEstimate(const Vector3& point, const Vector3& normal, real radius) const;
+
     // Estimates the radiance at a surface intersection towards a given direction
     virtual Spectrum RadianceEstimate(const Intersection& hit, const Vector3& outgoingDirection) = 0;
 
     // Scales photon power (must be called immediately before or immediately after balancing)
     void ScalePower(float scale);
 
+    // Returns the product of the scales applied to the photon power
+    real PowerScale() const;
+
+    // Writes the balanced photon map in binary form. The photon records and kd-tree nodes are written as is,
+    // with every array aligned on 64 bytes from the start of the stream, so that a file can be memory-mapped.
+    void Save(std::ostream& out) const;
+
+    // Reads a photon map written by Save, and returns whether it succeeded. The photon map is left unchanged on failure.
+    // Photon maps using a hash grid rebuild it on the scheduler, since only the kd-tree nodes are stored.
+    bool Load(std::istream& in, JobScheduler& scheduler);
+
 protected:
 
     enum { MaxNearestPhotons = 5000 };
     enum { MaxStoredPhotons = 50000000 };
 
-    // Used to locate nearest photons when computing a radiance estimate
-    struct NearestPhoton
+    // Atomically reserves up to 'count' consecutive slots of the photon storage, so that
+    // concurrent threads can store photons without locking. Returns the number of reserved slots,
+    // starting at 'first', which is less than 'count' when the target number of photons is reached.
+    uint32 ReservePhotons(uint32 count, uint32& first);
+
+    enum { MaxTraversalDepth = 64 }; // Exceeds the depth of a balanced kd-tree of MaxStoredPhotons photons
+
+    // Node left to visit during a kd-tree traversal
+    struct TraversalEntry
     {
-        real sqrDist; // Squared distance from query location
-        size_t index; // PhotonType index in the photon map
-        NearestPhoton(real sqrDist = Infinity(), size_t index = 0) : sqrDist(sqrDist), index(index) {}
-        bool operator<(const NearestPhoton& np) const { return sqrDist < np.sqrDist; }
+        uint32 nodeIndex;
+        real sqrPlaneDist; // Squared distance from the query location to the splitting plane of the parent node
     };
 
-    // Finds 'numLookup' photons that are nearest to a given location, and within a given radius
-    void LocatePhotons(const Vector3& queryLocation, uint32 numLookup, real& sqrMaxRadius, size_t nodeIndex, std::vector<NearestPhoton>& heap) const;
+    // Fills the heap with the photons that are nearest to a given location, and within a given radius.
+    void LocatePhotons(const Vector3& queryLocation, real sqrMaxRadius, NearestPhotonHeap& heap) const;
+
+    // Calls gatherer(index, sqrDist) for the photons which may lie within gatherer.SqrMaxRadius() of a location.
+    // The radius is read again after every photon, so that gatherers may shrink it. The kd-tree is walked
+    // iteratively, with an explicit stack of the subtrees left to visit.
+    template <typename Gatherer>
+    void VisitPhotons(const Vector3& queryLocation, Gatherer& gatherer) const;
 
     struct Settings
     {
         real gatherRadius;
         uint32 numPhotonsToGather;
         uint32 numPhotonsToStore;
+        bool useHashGrid;
         Settings(const PropertyMap& props);
     } settings;
 
+    // Photon positions are stored apart from the other photon data, so that kd-tree lookups only
+    // walk the positions. Both arrays are sized to the target number of photons by the first photon
+    // reservation, so that photon maps which are loaded or never filled do not allocate it.
     std::vector<PhotonNode> nodes;
+    PhotonHashGrid hashGrid; // Used instead of the kd-tree nodes if selected
+    std::vector<Vector3> positions;
     std::vector<PhotonType> photons;
+    volatile uint32 numReservedPhotons; // May exceed the size of the photon storage
+    real powerScale;
 
 private:
 
-    // Recursively balances a segment of the photon array:
+    enum { MinParallelSegmentSize = 16384 }; // Smaller segments are balanced by a single job
+
+    // Sizes the photon storage to the target number of photons, if it was not yet.
+    // Only the first call locks, later ones merely check the flag.
+    void AllocateStorage();
+    boost::mutex storageMutex;
+    boost::atomic<bool> storageAllocated;
+
+    enum { FileMagic = 0x4d505242 }; // "RBPM"
+    enum { FileVersion = 1 };
+    enum { FileAlignment = 64 };
+
+    struct FileHeader
+    {
+        uint32 magic;
+        uint32 version;
+        uint32 photonSize;
+        uint32 nodeSize;
+        uint32 numPhotons;
+        uint32 numNodes; // Zero for photon maps without kd-tree
+        real powerScale;
+        uint32 reserved;
+    };
+
+    // Write and read arrays of plain records, preceded by padding up to the file alignment
+    template <typename T> static void WriteArray(std::ostream& out, const std::vector<T>& array);
+    template <typename T> static bool ReadArray(std::istream& in, std::vector<T>& array);
+
+    // Job balancing a segment of the photon array
+    class BalancingJob;
+
+    // While balancing, segments of photon indices are partitioned and the photons are copied in kd-tree order.
+    // The hash grid reuses the photon indices for the order of its buckets.
+    std::vector<uint32> balancingIndices;
+    std::vector<Vector3> balancedPositions;
+    std::vector<PhotonType> balancedPhotons;
+
+    // Recursively balances a segment of the photon index array:
     // - "start" points to the starting index of the segment
     // - "end" points one location past the end of the segment
     // - "nodeIndex" is the index of the kd-node being built
-    void BalanceSegment(size_t nodeIndex, size_t start, size_t end, std::vector<PhotonType>& balancedPhotons);
+    // - "segmentBound" bounds the photons of the segment
+    // Since a subtree has one node per photon, the subtree of every segment can be built independently.
+    // Large far segments are balanced by jobs spawned on the scheduler, if any.
+    void BalanceSegment(size_t nodeIndex, size_t start, size_t end, const BoundingBox& segmentBound, JobScheduler* scheduler);
 };
 
 // Returns a density estimate using a Simpson kernel function
 real Kernel(real sqrDist, real sqrMaxDist);
+
+// Visitor summing the power of the photons within a fixed radius which arrive on the front side of a surface
+template <typename PhotonType>
+class FixedRadiusPowerGatherer
+{
+public:
+
+    FixedRadiusPowerGatherer(const std::vector<PhotonType>& photons, const Vector3& normal, real sqrRadius)
+        : photons(photons), normal(normal), sqrRadius(sqrRadius) {}
+
+    void operator()(uint32 index, real sqrDist)
+    {
+        if ((sqrDist < sqrRadius) && (DotProduct(photons[index].Direction(), normal) > 0.0f))
+        {
+            power += photons[index].Power();
+        }
+    }
+
+    real SqrMaxRadius() const { return sqrRadius; }
+
+    Spectrum power;
+
+private:
+
+    const std::vector<PhotonType>& photons;
+    Vector3 normal;
+    real sqrRadius;
+};
 }
 
 #include "renderbliss/Integrators/PhotonMapping/PhotonMapTemplate.inl"
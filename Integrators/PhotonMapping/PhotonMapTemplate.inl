@@ -19,8 +19,15 @@
 // THE SOFTWARE.
 
 #include <algorithm>
+#include <cmath>
 #include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include "renderbliss/Interfaces/IJob.h"
 #include "renderbliss/Math/Geometry/Vector3.h"
+#include "renderbliss/Utils/AtomicOps.h"
+#include "renderbliss/Utils/JobScheduler.h"
 #include "renderbliss/Utils/PropertyMap.h"
 
 namespace renderbliss
@@ -47,128 +54,247 @@ PhotonMapTemplate<PhotonType>::Settings::Settings(const PropertyMap& props)
     {
         numPhotonsToStore = PhotonMapTemplate<PhotonType>::MaxStoredPhotons;
     }
+
+    std::string lookup;
+    props.Get<std::string>("photon_lookup", "kd_tree", lookup);
+    useHashGrid = (lookup == "hash_grid");
 }
 
+template <typename PhotonType>
+class PhotonMapTemplate<PhotonType>::BalancingJob : public IJob
+{
+public:
+
+    BalancingJob(PhotonMapTemplate<PhotonType>& photonMap, size_t nodeIndex, size_t start, size_t end,
+                 const BoundingBox& segmentBound, JobScheduler& scheduler)
+        : photonMap(photonMap), nodeIndex(nodeIndex), start(start), end(end), segmentBound(segmentBound), scheduler(scheduler) {}
+
+    virtual void Run() const
+    {
+        photonMap.BalanceSegment(nodeIndex, start, end, segmentBound, &scheduler);
+    }
+
+private:
+
+    // Jobs write to disjoint segments of the shared photon map
+    mutable PhotonMapTemplate<PhotonType>& photonMap;
+    size_t nodeIndex, start, end;
+    BoundingBox segmentBound;
+    mutable JobScheduler& scheduler;
+};
+
 template <typename PhotonType>
 PhotonMapTemplate<PhotonType>::PhotonMapTemplate(const PropertyMap& props)
-    : settings(props)
+    : settings(props), numReservedPhotons(0), powerScale(1.0f), storageAllocated(false)
+{
+}
+
+template <typename PhotonType>
+void PhotonMapTemplate<PhotonType>::AllocateStorage()
+{
+    if (storageAllocated.load(boost::memory_order_acquire)) return;
+    boost::mutex::scoped_lock lock(storageMutex);
+    if (!storageAllocated.load(boost::memory_order_relaxed))
+    {
+        positions.resize(settings.numPhotonsToStore);
+        photons.resize(settings.numPhotonsToStore);
+        storageAllocated.store(true, boost::memory_order_release);
+    }
+}
+
+template <typename PhotonType>
+void PhotonMapTemplate<PhotonType>::Balance(JobScheduler& scheduler)
 {
+    SpawnBalancingJobs(scheduler);
+    scheduler.WaitForAllJobs();
+    FinishBalancing();
 }
 
 template <typename PhotonType>
-void PhotonMapTemplate<PhotonType>::Balance()
+void PhotonMapTemplate<PhotonType>::SpawnBalancingJobs(JobScheduler& scheduler)
 {
     nodes.clear();
+
+    // Release the storage that was not reserved for photons, and keep later reservations from sizing it again
+    storageAllocated.store(true);
+    size_t numPhotons = PhotonCount();
+    positions.erase(positions.begin() + numPhotons, positions.end());
+    std::vector<Vector3>(positions).swap(positions);
+    photons.erase(photons.begin() + numPhotons, photons.end());
+    std::vector<PhotonType>(photons).swap(photons);
     if (photons.empty()) return;
-    std::vector<PhotonType> balancedPhotons;
-    balancedPhotons.reserve(PhotonCount());
-    BalanceSegment(0, 0, PhotonCount(), balancedPhotons);
-    RB_ASSERT(photons.size() == nodes.size());
-    RB_ASSERT(balancedPhotons.size() == nodes.size());
+
+    // Grid cells span the gather diameter, so that lookups visit at most eight cells
+    if (settings.useHashGrid)
+    {
+        hashGrid.SpawnBuildingJobs(&positions[0], static_cast<uint32>(numPhotons), settings.gatherRadius, scheduler);
+        return;
+    }
+
+    // Every node and balanced photon is written exactly once by the balancing jobs
+    nodes.resize(numPhotons);
+    balancedPositions.resize(numPhotons);
+    balancedPhotons.resize(numPhotons);
+    balancingIndices.resize(numPhotons);
+    for (uint32 i = 0; i < numPhotons; ++i)
+    {
+        balancingIndices[i] = i;
+    }
+
+    BoundingBox photonBound;
+    foreach (const Vector3& p, positions)
+    {
+        photonBound.Enclose(p);
+    }
+    scheduler.Spawn(JobConstPtr(new BalancingJob(*this, 0, 0, PhotonCount(), photonBound, scheduler)));
+}
+
+template <typename PhotonType>
+void PhotonMapTemplate<PhotonType>::FinishBalancing()
+{
+    if (settings.useHashGrid && !photons.empty())
+    {
+        // Store the photons of every grid bucket consecutively
+        hashGrid.FinishBuilding(balancingIndices);
+        size_t numPhotons = photons.size();
+        balancedPositions.resize(numPhotons);
+        balancedPhotons.resize(numPhotons);
+        for (size_t i = 0; i < numPhotons; ++i)
+        {
+            balancedPositions[i] = positions[balancingIndices[i]];
+            balancedPhotons[i] = photons[balancingIndices[i]];
+        }
+    }
+
+    RB_ASSERT(balancedPhotons.size() == photons.size());
+    positions.swap(balancedPositions);
     photons.swap(balancedPhotons);
-    std::vector<PhotonNode>(nodes).swap(nodes); // Shrink node storage capacity to fit contents
+    std::vector<Vector3>().swap(balancedPositions);
+    std::vector<PhotonType>().swap(balancedPhotons);
+    std::vector<uint32>().swap(balancingIndices);
 }
 
 template <typename PhotonType>
-void PhotonMapTemplate<PhotonType>::BalanceSegment(size_t nodeIndex, size_t start, size_t end, std::vector<PhotonType>& balancedPhotons)
+void PhotonMapTemplate<PhotonType>::BalanceSegment(size_t nodeIndex, size_t start, size_t end, const BoundingBox& segmentBound, JobScheduler* scheduler)
 {
     // Predicate functor for photon map balancing
-    struct PhotonPositionComparer : public std::binary_function<PhotonType, PhotonType, bool>
+    struct PhotonPositionComparer : public std::binary_function<uint32, uint32, bool>
     {
+        const Vector3* positions;
         uint32 axis;
-        PhotonPositionComparer(uint32 axis) : axis(axis) {}
-        bool operator()(const PhotonType& lhs, const PhotonType& rhs) const
+        PhotonPositionComparer(const Vector3* positions, uint32 axis) : positions(positions), axis(axis) {}
+        bool operator()(uint32 lhs, uint32 rhs) const
         {
-            return lhs.Position()[axis] < rhs.Position()[axis];
+            return positions[lhs][axis] < positions[rhs][axis];
         }
     };
 
-    RB_ASSERT(nodeIndex==nodes.size());
-    nodes.push_back(PhotonNode());
+    RB_ASSERT(nodeIndex < nodes.size());
+    RB_ASSERT(start < end);
+    PhotonNode& node = nodes[nodeIndex];
     if (start+1 == end)
     {
-        nodes[nodeIndex].SetLeaf();
-        balancedPhotons.push_back(photons[start]);
+        node.SetLeaf();
+        balancedPositions[nodeIndex] = positions[balancingIndices[start]];
+        balancedPhotons[nodeIndex] = photons[balancingIndices[start]];
         return;
     }
 
     size_t median = (end+start) / 2;
-    std::vector<PhotonType>::iterator begIter = photons.begin() + start;
-    std::vector<PhotonType>::iterator medIter = photons.begin() + median;
-    std::vector<PhotonType>::iterator endIter = photons.begin() + end;
+    std::vector<uint32>::iterator begIter = balancingIndices.begin() + start;
+    std::vector<uint32>::iterator medIter = balancingIndices.begin() + median;
+    std::vector<uint32>::iterator endIter = balancingIndices.begin() + end;
 
     // Partition photon block around the median
-    BoundingBox segmentBound;
-    for (size_t i = start; i < end; ++i)
-    {
-        segmentBound.Enclose(photons[i].Position());
-    }
     Vector3 ext = segmentBound.Extents();
     uint32 splitAxis =   ((ext[0] > ext[1]) && (ext[0] > ext[2])) ? 0
                         : (ext[1] > ext[2]) ? 1
                         : 2;
-    std::nth_element(begIter, medIter, endIter, PhotonPositionComparer(splitAxis));
-    real splitPosition = photons[median].Position()[splitAxis];
-    nodes[nodeIndex].SetSplitInfo(splitPosition, splitAxis);
-    balancedPhotons.push_back(photons[median]);
+    std::nth_element(begIter, medIter, endIter, PhotonPositionComparer(&positions[0], splitAxis));
+    uint32 medianPhoton = balancingIndices[median];
+    real splitPosition = positions[medianPhoton][splitAxis];
+    node.SetSplitInfo(splitPosition, splitAxis);
+    balancedPositions[nodeIndex] = positions[medianPhoton];
+    balancedPhotons[nodeIndex] = photons[medianPhoton];
 
-    // Balance left segment
-    if (start < median)
+    // Balance right segment, whose subtree follows the left one.
+    // Its bound is the segment bound clipped by the splitting plane, as in Jensen's implementation.
+    if (median+1 < end)
     {
-        nodes[nodeIndex].SetNearChildBit();
-        BalanceSegment(nodes.size(), start, median, balancedPhotons);
+        node.SetFarChildIndex(static_cast<uint32>(nodeIndex + 1 + (median-start)));
+        Vector3 farMin = segmentBound.Min();
+        farMin[splitAxis] = splitPosition;
+        BoundingBox farBound(farMin, segmentBound.Max());
+        if (scheduler && (end-median-1 >= MinParallelSegmentSize))
+        {
+            scheduler->Spawn(JobConstPtr(new BalancingJob(*this, node.FarChildIndex(), median+1, end, farBound, *scheduler)));
+        }
+        else
+        {
+            BalanceSegment(node.FarChildIndex(), median+1, end, farBound, scheduler);
+        }
     }
 
-    // Balance right segment
-    if (median+1 < end)
+    // Balance left segment
+    if (start < median)
     {
-        nodes[nodeIndex].SetFarChildIndex(static_cast<uint32>(nodes.size()));
-        BalanceSegment(nodes[nodeIndex].FarChildIndex(), median+1, end, balancedPhotons);
+        node.SetNearChildBit();
+        Vector3 nearMax = segmentBound.Max();
+        nearMax[splitAxis] = splitPosition;
+        BalanceSegment(nodeIndex+1, start, median, BoundingBox(segmentBound.Min(), nearMax), scheduler);
     }
 }
 
 template <typename PhotonType>
 bool PhotonMapTemplate<PhotonType>::Empty() const
 {
-    return photons.empty();
+    return PhotonCount() == 0;
 }
 
 template <typename PhotonType>
 bool PhotonMapTemplate<PhotonType>::Full() const
 {
-    return PhotonCount() >= settings.numPhotonsToStore;
+    return numReservedPhotons >= settings.numPhotonsToStore;
+}
+
+template <typename PhotonType>
+uint32 PhotonMapTemplate<PhotonType>::ReservePhotons(uint32 count, uint32& first)
+{
+    if (!count || Full()) return 0;
+    AllocateStorage();
+    first = AtomicAdd(&numReservedPhotons, count);
+    if (first >= photons.size()) return 0;
+    return std::min(count, static_cast<uint32>(photons.size()) - first);
 }
 
 template <typename PhotonType>
 Spectrum PhotonMapTemplate<PhotonType>::IrradianceEstimate(const Vector3& point, const Vector3& normal, uint32 numLookup, real gatherRadius) const
+{
+    return IrradianceEstimate(point, normal, numLookup, gatherRadius, ThreadNearestPhotonHeap(numLookup));
+}
+
+template <typename PhotonType>
+Spectrum PhotonMapTemplate<PhotonType>::IrradianceEstimate(const Vector3& point, const Vector3& normal, uint32 numLookup, real gatherRadius, NearestPhotonHeap& heap) const
 {
     if (Empty() || !numLookup)
     {
         return Spectrum::black;
     }
 
-    std::vector<NearestPhoton> heap;
-    heap.reserve(numLookup);
-    real sqrMaxRadius = Sqr(gatherRadius);
-
-    LocatePhotons(point, numLookup, sqrMaxRadius, 0, heap);
+    heap.Reset(numLookup);
+    LocatePhotons(point, Sqr(gatherRadius), heap);
 
-    if (heap.empty())
+    if (heap.Empty())
     {
         return Spectrum::black;
     }
 
-    RB_ASSERT(heap.size() <= numLookup);
-    if (heap.size() < numLookup-1)
-    {
-        std::make_heap(heap.begin(), heap.end());
-        sqrMaxRadius = heap[0].sqrDist;
-    }
-
     // Sum weighted irradiance from all nearest photons
+    real sqrMaxRadius = heap.MaxSqrDist();
     Spectrum irradiance;
-    foreach (const NearestPhoton& np, heap)
+    for (uint32 i = 0; i < heap.Size(); ++i)
     {
+        const NearestPhoton& np = heap[i];
         const PhotonType& heapPhoton = photons[np.index];
         if (DotProduct(heapPhoton.Direction(), normal) > 0.0f)
         {
@@ -182,73 +308,179 @@ Spectrum PhotonMapTemplate<PhotonType>::IrradianceEstimate(const Vector3& point,
 }
 
 template <typename PhotonType>
-void PhotonMapTemplate<PhotonType>::LocatePhotons(const Vector3& queryLocation, uint32 numLookup, real& sqrMaxRadius, size_t nodeIndex, std::vector<NearestPhoton>& heap) const
+Spectrum PhotonMapTemplate<PhotonType>::FixedRadiusIrradianceEstimate(const Vector3& point, const Vector3& normal, real radius) const
 {
-    const PhotonNode& currentNode = nodes[nodeIndex];
-    if (!currentNode.IsLeaf())
+    if (Empty() || (radius <= 0.0f))
     {
-        uint32 splitAxis = currentNode.SplitAxis();
-        real splitPosition = currentNode.SplitPosition();
-        real sqrRadius = Sqr(queryLocation[splitAxis] - splitPosition);
-        if (queryLocation[splitAxis] <= splitPosition)
+        return Spectrum::black;
+    }
+
+    FixedRadiusPowerGatherer<PhotonType> gatherer(photons, normal, Sqr(radius));
+    VisitPhotons(point, gatherer);
+    return gatherer.power / (Pi()*Sqr(radius));
+}
+
+template <typename PhotonType>
+void PhotonMapTemplate<PhotonType>::LocatePhotons(const Vector3& queryLocation, real sqrMaxRadius, NearestPhotonHeap& heap) const
+{
+    // Only photons nearer than the farthest one of a full heap are of interest
+    NearestPhotonGatherer gatherer(heap, sqrMaxRadius);
+    VisitPhotons(queryLocation, gatherer);
+}
+
+template <typename PhotonType>
+template <typename Gatherer>
+void PhotonMapTemplate<PhotonType>::VisitPhotons(const Vector3& queryLocation, Gatherer& gatherer) const
+{
+    if (settings.useHashGrid)
+    {
+        hashGrid.Visit(&positions[0], queryLocation, std::sqrt(gatherer.SqrMaxRadius()), gatherer);
+        return;
+    }
+
+    real sqrMaxRadius = gatherer.SqrMaxRadius();
+    TraversalEntry stack[MaxTraversalDepth];
+    uint32 stackSize = 0;
+    uint32 nodeIndex = 0;
+    for (;;)
+    {
+        real sqrDistToPhoton = SquaredDistance(positions[nodeIndex], queryLocation);
+        if (sqrDistToPhoton < sqrMaxRadius)
         {
-            if (currentNode.HasNearChild())
-            {
-                LocatePhotons(queryLocation, numLookup, sqrMaxRadius, nodeIndex+1, heap);
-            }
-            if ((sqrRadius < sqrMaxRadius) && currentNode.HasFarChild())
-            {
-                LocatePhotons(queryLocation, numLookup, sqrMaxRadius, currentNode.FarChildIndex(), heap);
-            }
+            gatherer(nodeIndex, sqrDistToPhoton);
+            sqrMaxRadius = gatherer.SqrMaxRadius();
         }
-        else
+
+        // Descend into the child on the query side of the splitting plane, and defer the other one
+        const PhotonNode& currentNode = nodes[nodeIndex];
+        if (!currentNode.IsLeaf())
         {
-            if (currentNode.HasFarChild())
+            real planeDist = queryLocation[currentNode.SplitAxis()] - currentNode.SplitPosition();
+            bool nearSide = (planeDist <= 0.0f);
+            bool hasFirstChild = nearSide ? currentNode.HasNearChild() : currentNode.HasFarChild();
+            bool hasSecondChild = nearSide ? currentNode.HasFarChild() : currentNode.HasNearChild();
+            uint32 firstChild = nearSide ? nodeIndex+1 : currentNode.FarChildIndex();
+            uint32 secondChild = nearSide ? currentNode.FarChildIndex() : nodeIndex+1;
+            real sqrPlaneDist = Sqr(planeDist);
+            if (hasSecondChild && (sqrPlaneDist < sqrMaxRadius))
             {
-                LocatePhotons(queryLocation, numLookup, sqrMaxRadius, currentNode.FarChildIndex(), heap);
+                RB_ASSERT(stackSize < MaxTraversalDepth);
+                stack[stackSize].nodeIndex = secondChild;
+                stack[stackSize].sqrPlaneDist = sqrPlaneDist;
+                ++stackSize;
             }
-            if ((sqrRadius < sqrMaxRadius) && currentNode.HasNearChild())
+            if (hasFirstChild)
             {
-                LocatePhotons(queryLocation, numLookup, sqrMaxRadius, nodeIndex+1, heap);
+                nodeIndex = firstChild;
+                continue;
             }
         }
-    }
 
-    real sqrDistToPhoton = SquaredDistance(photons[nodeIndex].Position(), queryLocation);
-    if (sqrDistToPhoton < sqrMaxRadius)
-    {
-        heap.push_back(NearestPhoton(sqrDistToPhoton, nodeIndex));
-        if (heap.size() < numLookup)
+        // Resume with the last deferred subtree that may still hold photons within the search radius
+        do
         {
-            if (heap.size() == numLookup-1)
-            {
-                std::make_heap(heap.begin(), heap.end());
-                sqrMaxRadius = heap[0].sqrDist;
-            }
-        }
-        else
-        {
-            std::push_heap(heap.begin(), heap.end());
-            if (heap.size() > numLookup)
-            {
-                // The heap is full, pop farthest photon
-                std::pop_heap(heap.begin(), heap.end());
-                heap.pop_back();
-            }
-            sqrMaxRadius = heap[0].sqrDist;
-        }
+            if (!stackSize) return;
+            --stackSize;
+        } while (stack[stackSize].sqrPlaneDist >= sqrMaxRadius);
+        nodeIndex = stack[stackSize].nodeIndex;
     }
 }
 
 template <typename PhotonType>
 size_t PhotonMapTemplate<PhotonType>::PhotonCount() const
 {
-    return photons.size();
+    return std::min(static_cast<size_t>(numReservedPhotons), photons.size());
 }
 
 template <typename PhotonType>
 void PhotonMapTemplate<PhotonType>::ScalePower(float scale)
 {
-    foreach (PhotonType& p, photons) { p.ScalePower(scale); }
+    size_t numPhotons = PhotonCount();
+    for (size_t i = 0; i < numPhotons; ++i) { photons[i].ScalePower(scale); }
+    powerScale *= scale;
+}
+
+template <typename PhotonType>
+real PhotonMapTemplate<PhotonType>::PowerScale() const
+{
+    return powerScale;
+}
+
+template <typename PhotonType>
+template <typename T>
+void PhotonMapTemplate<PhotonType>::WriteArray(std::ostream& out, const std::vector<T>& array)
+{
+    static const char padding[FileAlignment] = {0};
+    std::streamoff misalignment = static_cast<std::streamoff>(out.tellp()) % FileAlignment;
+    if (misalignment)
+    {
+        out.write(padding, FileAlignment - misalignment);
+    }
+    if (!array.empty())
+    {
+        out.write(reinterpret_cast<const char*>(&array[0]), static_cast<std::streamsize>(array.size()*sizeof(T)));
+    }
+}
+
+template <typename PhotonType>
+template <typename T>
+bool PhotonMapTemplate<PhotonType>::ReadArray(std::istream& in, std::vector<T>& array)
+{
+    std::streamoff misalignment = static_cast<std::streamoff>(in.tellg()) % FileAlignment;
+    if (misalignment)
+    {
+        in.ignore(FileAlignment - misalignment);
+    }
+    if (!array.empty())
+    {
+        in.read(reinterpret_cast<char*>(&array[0]), static_cast<std::streamsize>(array.size()*sizeof(T)));
+    }
+    return !in.fail();
+}
+
+template <typename PhotonType>
+void PhotonMapTemplate<PhotonType>::Save(std::ostream& out) const
+{
+    uint32 numPhotons = static_cast<uint32>(PhotonCount());
+    FileHeader header = { FileMagic, FileVersion, sizeof(PhotonType), sizeof(PhotonNode),
+                          numPhotons, static_cast<uint32>(nodes.size()), powerScale, 0 };
+    WriteArray(out, std::vector<FileHeader>(1, header));
+    WriteArray(out, nodes);
+    WriteArray(out, positions);
+    WriteArray(out, photons);
+}
+
+template <typename PhotonType>
+bool PhotonMapTemplate<PhotonType>::Load(std::istream& in, JobScheduler& scheduler)
+{
+    std::vector<FileHeader> header(1);
+    if (!ReadArray(in, header)) return false;
+    const FileHeader& h = header[0];
+    if (   (h.magic != FileMagic) || (h.version != FileVersion)
+        || (h.photonSize != sizeof(PhotonType)) || (h.nodeSize != sizeof(PhotonNode))
+        || (h.numPhotons > MaxStoredPhotons) || (h.numNodes && (h.numNodes != h.numPhotons)))
+    {
+        return false;
+    }
+
+    std::vector<PhotonNode> loadedNodes(h.numNodes);
+    std::vector<Vector3> loadedPositions(h.numPhotons);
+    std::vector<PhotonType> loadedPhotons(h.numPhotons);
+    if (!ReadArray(in, loadedNodes) || !ReadArray(in, loadedPositions) || !ReadArray(in, loadedPhotons))
+    {
+        return false;
+    }
+
+    nodes.swap(loadedNodes);
+    positions.swap(loadedPositions);
+    photons.swap(loadedPhotons);
+    numReservedPhotons = h.numPhotons;
+    storageAllocated.store(true);
+    powerScale = h.powerScale;
+    if (settings.useHashGrid || (nodes.size() != photons.size()))
+    {
+        Balance(scheduler);
+    }
+    return true;
 }
 }
@@ -0,0 +1,220 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Integrators/PhotonMapping/PhotonShootingJob.h"
+#include <algorithm>
+#include "renderbliss/Scene.h"
+#include "renderbliss/Integrators/PhotonMapping/PhotonMap.h"
+#include "renderbliss/Interfaces/ILight.h"
+#include "renderbliss/Interfaces/IMaterial.h"
+#include "renderbliss/Lights/StepFunctionSampler.h"
+#include "renderbliss/Math/MathUtils.h"
+#include "renderbliss/Math/Geometry/Intersection.h"
+#include "renderbliss/Math/Geometry/Ray.h"
+#include "renderbliss/Utils/AtomicOps.h"
+#include "renderbliss/Utils/StatsTracker.h"
+
+namespace renderbliss
+{
+PermutedHalton::PermutedHalton(uint32 numDimensions, MersenneTwister& rng)
+    : numDimensions(numDimensions), rng(rng)
+{
+    // Initialize bases
+    uint32 sumBases = 0;
+    bases.reserve(this->numDimensions);
+    for (uint32 i = 0; i < numDimensions; ++i)
+    {
+        uint32 prime = Prime(i);
+        bases.push_back(prime);
+        sumBases += prime;
+    }
+
+    // Generate one permutation per dimension
+    permutations.reserve(sumBases);
+    uint32 permStart = 0;
+    for (uint32 i = 0; i < numDimensions; ++i)
+    {
+        for (uint32 j = 0; j < bases[i]; ++j)
+        {
+            permutations.push_back(j);
+        }
+        Shuffle(rng, &permutations[permStart], bases[i]);
+        permStart += bases[i];
+    }
+}
+
+template <std::size_t NumSampledDimensions>
+void PermutedHalton::NthSample(uint32 n, boost::array<real, NumSampledDimensions>& sample) const
+{
+    RB_ASSERT(NumSampledDimensions <= numDimensions);
+    const uint32* p = &permutations[0];
+    for (uint32 i = 0; i < numDimensions; ++i)
+    {
+        sample[i] = std::min(PermutedRadicalInverse(n, bases[i], p), 1.0f-Epsilon());
+        p+=bases[i];
+    }
+}
+
+PhotonShootingJob::PhotonShootingJob(uint seed, uint32 maxPhotonDepth, const Scene& scene, const StepFunctionSampler* powerDistribution,
+                                     StatsTracker& stats, IrradiancePhotonMap& sharedIndirectMap, CausticPhotonMap& sharedCausticMap,
+                                     DirectPhotonMap* sharedDirectMap, uint32 numPhotonsToEmit)
+    : rng(seed), halton(6,rng), maxPhotonDepth(maxPhotonDepth), numPhotonsToEmit(numPhotonsToEmit),
+      scene(scene), powerDistribution(powerDistribution), stats(stats),
+      sharedIndirectMap(sharedIndirectMap), sharedCausticMap(sharedCausticMap),
+      sharedDirectMap(sharedDirectMap),
+      causticDone(sharedCausticMap.Full()), indirectDone(sharedIndirectMap.Full())
+{
+}
+
+void PhotonShootingJob::Run() const
+{
+    const LightPtrList& lights = scene.Lights();
+    if (lights.empty()) return;
+
+    // Get photon tracing statistics trackers
+    AtomicCounter& causticPaths = stats.Counter("Photon Tracing", "Caustic paths");
+    AtomicCounter& directPaths = stats.Counter("Photon Tracing", "Direct paths");
+    AtomicCounter& emittedPhotons = stats.Counter("Photon Tracing", "Emitted photons");
+    AtomicCounter& indirectPaths = stats.Counter("Photon Tracing", "Indirect paths");
+    AtomicCounter& storedCausticPhotons = stats.Counter("Photon Tracing", "Stored caustic photons");
+    AtomicCounter& storedDirectPhotons = stats.Counter("Photon Tracing", "Stored direct photons");
+    AtomicCounter& storedIndirectPhotons = stats.Counter("Photon Tracing", "Stored global photons");
+
+    uint32 sampleNo = 0;
+    uint32 numEmitted = 0;
+
+    while (!(causticDone && indirectDone) && (!numPhotonsToEmit || (numEmitted < numPhotonsToEmit)))
+    {
+        const uint32 blockSize = 512; // Count of photons to emit at a time
+        for (uint32 i = 0; i < blockSize; ++i)
+        {
+            boost::array<real, 6> sample;
+            halton.NthSample(++sampleNo, sample);
+
+            // Pick the light to sample
+            size_t lightPick = powerDistribution ? powerDistribution->SampleIndex(sample[0]) : rng.RandomUint(lights.size()-1);
+            real lightPdf = powerDistribution ? powerDistribution->FunctionValue(lightPick)/powerDistribution->FunctionIntegral() : 1.0f/lights.size();
+
+            // Generate the photon ray
+            real photonRayPdf = 0.0f;
+            Vector3 lightNormal;
+            Vector3 photonRayOrigin;
+            Vector3 photonRayDirection;
+            const LightConstPtr& lightToSample = lights[lightPick];
+            lightToSample->SampleOutgoingRay(sample.data()+1, photonRayOrigin, photonRayDirection, lightNormal, photonRayPdf);
+            if (photonRayPdf <= 0.0f) continue;
+
+            // Proceed to photon tracing
+            Spectrum photonPower;
+            Intersection photonHit;
+            bool isPathSpecular = true; // We assume that the path is specular at the beginning for code simplicity
+            Ray photonRay(photonRayOrigin, photonRayDirection);
+            uint32 numBounces = 0;
+            while (scene.Intersects(photonRay, photonHit))
+            {
+                RB_ASSERT(photonHit.material);
+                ++numBounces;
+                if (numBounces == 1) // The photon is just leaving the light, initialize its power
+                {
+                    photonPower = lightToSample->EmittedRadiance(lightNormal, photonRayDirection);
+                    if (photonPower.IsBlack()) break;
+                    photonPower *= AbsDotProduct(lightNormal, photonRayDirection);
+                    photonPower /= (lightPdf * photonRayPdf);
+                    if (!indirectDone && sharedDirectMap)
+                    {
+                        directPhotons.directions.push_back(-photonRay.Direction().GetNormalized());
+                        directPhotons.positions.push_back(photonHit.point);
+                        directPhotons.powers.push_back(photonPower);
+                    }
+                }
+
+                Vector3 unitPhotonDir = photonRay.Direction().GetNormalized();
+
+                // Store photon after first bounce if surface hit has non-specular components
+                if ((numBounces > 1) && photonHit.material->MatchesFlags(~BsdfCombinedFlags::Delta))
+                {
+                    // If the photon has only specularly bounced so far, we must store it
+                    // in the caustic map. Otherwise, we must store it in the global map.
+                    if (isPathSpecular)
+                    {
+                        if (!causticDone)
+                        {
+                            causticPhotons.directions.push_back(-unitPhotonDir);
+                            causticPhotons.positions.push_back(photonHit.point);
+                            causticPhotons.powers.push_back(photonPower);
+                        }
+                    }
+                    else if (!indirectDone)
+                    {
+                        indirectPhotons.directions.push_back(-unitPhotonDir);
+                        indirectPhotons.positions.push_back(photonHit.point);
+                        indirectPhotons.normals.push_back(photonHit.uvn.N());
+                        indirectPhotons.powers.push_back(photonPower);
+                    }
+                }
+                if (numBounces >= maxPhotonDepth) break;
+                // Sample a new photon direction
+                BsdfSamplingRecord brec(photonHit, rng, BsdfCombinedFlags::All);
+                photonHit.material->SampleBsdf(-unitPhotonDir, brec);
+                if ((brec.pdf <= 0.0f) || (brec.value.IsBlack())) break;
+
+                // Use Russian roulette to decide whether to bounce or absorb the photon
+                Spectrum newPower = photonPower * brec.value * AbsDotProduct(brec.sampledDirection, photonHit.uvn.N()) / brec.pdf;
+                float bouncingProbability = std::min(1.0f, newPower.Luminance()/photonPower.Luminance());
+                if (rng.CanonicalRandom() > bouncingProbability) break;
+                photonPower = newPower/bouncingProbability;
+                isPathSpecular &= photonHit.material->MatchesFlags(brec.sampledComponentIndex, BsdfCombinedFlags::Delta); // Update path "specularity"
+                if (indirectDone && !isPathSpecular) break;
+                photonRay = Ray(photonHit.point, brec.sampledDirection);
+            }
+        }
+
+        emittedPhotons.Add(blockSize);
+        numEmitted += blockSize;
+
+        // Update the shared global and caustic photon maps. The maps reserve storage atomically,
+        // and the path counts used to scale the photon powers are updated regardless of the remaining storage.
+        if (!indirectDone)
+        {
+            size_t numStored = sharedIndirectMap.StorePhotons(indirectPhotons.positions, indirectPhotons.directions, indirectPhotons.normals, indirectPhotons.powers);
+            indirectDone = sharedIndirectMap.Full();
+            indirectPaths.Add(blockSize);
+            storedIndirectPhotons.Add(static_cast<uint32>(numStored));
+
+            if (sharedDirectMap)
+            {
+                numStored = sharedDirectMap->StorePhotons(directPhotons.positions, directPhotons.directions, directPhotons.powers);
+                directPaths.Add(blockSize);
+                storedDirectPhotons.Add(static_cast<uint32>(numStored));
+            }
+        }
+        if (!causticDone)
+        {
+            size_t numStored = sharedCausticMap.StorePhotons(causticPhotons.positions, causticPhotons.directions, causticPhotons.powers);
+            causticDone = sharedCausticMap.Full();
+            causticPaths.Add(blockSize);
+            storedCausticPhotons.Add(static_cast<uint32>(numStored));
+        }
+        causticPhotons.Clear();
+        directPhotons.Clear();
+        indirectPhotons.Clear();
+    }
+}
+}
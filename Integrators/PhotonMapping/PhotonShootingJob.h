@@ -0,0 +1,120 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_PHOTON_SHOOTING_JOB_H
+#define RENDERBLISS_PHOTON_SHOOTING_JOB_H
+
+#include <cstddef>
+#include <vector>
+#include <boost/array.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Colour/Spectrum.h"
+#include "renderbliss/Interfaces/IJob.h"
+#include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Math/Geometry/Vector3.h"
+
+namespace renderbliss
+{
+class IrradiancePhotonMap;
+class PhotonMap;
+class Scene;
+class StatsTracker;
+class StepFunctionSampler;
+
+typedef PhotonMap CausticPhotonMap;
+typedef PhotonMap DirectPhotonMap;
+
+// Helper class to generate a scrambled Halton sequence as to minimize
+// correlation problems in higher dimensions and in a concurrent usage
+class PermutedHalton
+{
+public:
+
+    PermutedHalton(uint32 numDimensions, MersenneTwister& rng);
+    template <std::size_t NumSampledDimensions>
+    void NthSample(uint32 n, boost::array<real, NumSampledDimensions>& sample) const;
+
+private:
+
+    std::vector<uint32> bases;
+    std::vector<uint32> permutations;
+    uint32 numDimensions;
+    mutable MersenneTwister& rng;
+};
+
+// Job class for photon shooting parallelization. Photons are shot until the shared maps are full,
+// or until the job has emitted 'numPhotonsToEmit' photons (rounded up to whole blocks) if it is not zero.
+// Direct photons are not stored if no direct photon map is given. The emitted photons only depend on the seed of the job.
+class PhotonShootingJob : public IJob
+{
+public:
+
+    PhotonShootingJob(uint seed, uint32 maxPhotonDepth, const Scene& scene, const StepFunctionSampler* powerDistribution,
+                      StatsTracker& stats, IrradiancePhotonMap& sharedIndirectMap, CausticPhotonMap& sharedCausticMap,
+                      DirectPhotonMap* sharedDirectMap, uint32 numPhotonsToEmit = 0);
+    virtual void Run() const;
+
+private:
+
+    mutable MersenneTwister rng;
+    PermutedHalton halton;
+
+    // Local photon data for delayed storage into the shared photon maps
+    mutable struct
+    {
+        std::vector<Vector3> directions;
+        std::vector<Vector3> positions;
+        std::vector<Spectrum> powers;
+        void Clear() { directions.clear(), positions.clear(), powers.clear(); };
+    } causticPhotons, directPhotons;
+    mutable struct
+    {
+        std::vector<Vector3> directions;
+        std::vector<Vector3> positions;
+        std::vector<Vector3> normals;
+        std::vector<Spectrum> powers;
+        void Clear() { directions.clear(), positions.clear(), normals.clear(), powers.clear(); };
+    } indirectPhotons;
+
+    // Maximum number of bounces per photon
+    const uint32 maxPhotonDepth;
+
+    // Emission budget of the job, or zero for no budget
+    const uint32 numPhotonsToEmit;
+
+    // Scene in which the photons will be emitted
+    const Scene& scene;
+
+    // Lighting power distribution
+    const StepFunctionSampler* powerDistribution;
+
+    // Shared members will be written concurrently, without locking
+    mutable StatsTracker& stats;
+    mutable IrradiancePhotonMap& sharedIndirectMap;
+    mutable CausticPhotonMap& sharedCausticMap;
+    mutable DirectPhotonMap* sharedDirectMap;
+
+    // Track whether the shared maps are full
+    mutable bool causticDone;
+    mutable bool indirectDone;
+};
+}
+
+#endif
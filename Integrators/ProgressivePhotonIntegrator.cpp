@@ -0,0 +1,234 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Integrators/ProgressivePhotonIntegrator.h"
+#include <algorithm>
+#include <cmath>
+#include "renderbliss/Scene.h"
+#include "renderbliss/Integrators/DirectIlluminationUtils.h"
+#include "renderbliss/Integrators/PhotonMapping/PhotonMap.h"
+#include "renderbliss/Integrators/PhotonMapping/PhotonShootingJob.h"
+#include "renderbliss/Interfaces/ILight.h"
+#include "renderbliss/Interfaces/IMaterial.h"
+#include "renderbliss/Lights/Luminaire.h"
+#include "renderbliss/Math/MathUtils.h"
+#include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Math/Geometry/Intersection.h"
+#include "renderbliss/Math/Geometry/Ray.h"
+#include "renderbliss/Utils/AtomicOps.h"
+#include "renderbliss/Utils/JobScheduler.h"
+#include "renderbliss/Utils/StatsTracker.h"
+
+namespace renderbliss
+{
+real ProgressiveGatherRadius(real initialRadius, uint32 pass, real radiusReduction)
+{
+    real sqrScale = 1.0f;
+    for (uint32 i = 1; i <= pass; ++i)
+    {
+        sqrScale *= (i + radiusReduction) / (i + 1);
+    }
+    return initialRadius*std::sqrt(sqrScale);
+}
+
+ProgressivePhotonIntegrator::Settings::Settings(const PropertyMap& props)
+{
+    props.Get<PropertyMap>("global_photon_map", PropertyMap(), gpmProps);
+    props.Get<PropertyMap>("caustic_photon_map", PropertyMap(), cpmProps);
+    props.Get<uint32>("specular_depth", 4, specularDepth);
+    props.Get<uint32>("shadow_rays", 4, numShadowRays);
+    props.Get<uint32>("photon_depth", 4, maxPhotonDepth);
+    props.Get<uint32>("photon_passes", 16, numPasses);
+    props.Get<uint32>("photons_per_pass", 100000, numPhotonsPerPass);
+    props.Get<real>("radius_reduction", 0.7f, radiusReduction);
+    Clamp(0.01f, 0.99f, radiusReduction);
+    cpmProps.Get<real>("gather_radius", 100.0f, causticGatherRadius);
+    gpmProps.Get<real>("gather_radius", 100.0f, indirectGatherRadius);
+}
+
+ProgressivePhotonIntegrator::ProgressivePhotonIntegrator(const PropertyMap& props, StatsTracker& stats)
+    : SurfaceIntegrator(stats), settings(props),
+      causticGatherRadius(settings.causticGatherRadius), indirectGatherRadius(settings.indirectGatherRadius), seed(0)
+{
+    stats.AddCounter("Intersections", "Intersection tests");
+    stats.AddCounter("Intersections", "Intersection hits");
+    stats.AddCounter("Photon Tracing", "Caustic paths");
+    stats.AddCounter("Photon Tracing", "Direct paths");
+    stats.AddCounter("Photon Tracing", "Emitted photons");
+    stats.AddCounter("Photon Tracing", "Indirect paths");
+    stats.AddCounter("Photon Tracing", "Photon passes");
+    stats.AddCounter("Photon Tracing", "Stored caustic photons");
+    stats.AddCounter("Photon Tracing", "Stored direct photons");
+    stats.AddCounter("Photon Tracing", "Stored indirect photons");
+    stats.AddCounter("Rays", "Primary rays traced");
+    stats.AddCounter("Rays", "Secondary rays traced");
+    stats.AddCounter("Rays", "Shadow rays traced");
+}
+
+ProgressivePhotonIntegrator::~ProgressivePhotonIntegrator()
+{
+}
+
+void ProgressivePhotonIntegrator::SetSeed(uint32 seed)
+{
+    this->seed = seed;
+}
+
+void ProgressivePhotonIntegrator::PreProcess(const Scene& scene, JobScheduler&)
+{
+    powerDistribution.reset(PowerDistribution(scene).release());
+    lightBvh.reset(new LightBvh(scene.Lights()));
+}
+
+uint32 ProgressivePhotonIntegrator::PassCount() const
+{
+    return settings.numPasses;
+}
+
+void ProgressivePhotonIntegrator::PrePass(const Scene& scene, JobScheduler& scheduler, uint32 pass)
+{
+    // Release the photons of the previous pass before shooting new ones
+    causticPhotonMap.reset();
+    indirectPhotonMap.reset();
+
+    // The gather radii also size the cells of hash grid photon maps
+    causticGatherRadius = ProgressiveGatherRadius(settings.causticGatherRadius, pass, settings.radiusReduction);
+    indirectGatherRadius = ProgressiveGatherRadius(settings.indirectGatherRadius, pass, settings.radiusReduction);
+    PropertyMap cpmProps(settings.cpmProps);
+    PropertyMap gpmProps(settings.gpmProps);
+    cpmProps.Set<real>("gather_radius", causticGatherRadius);
+    gpmProps.Set<real>("gather_radius", indirectGatherRadius);
+    causticPhotonMap.reset(new CausticPhotonMap(cpmProps));
+    indirectPhotonMap.reset(new IrradiancePhotonMap(gpmProps));
+
+    // The path counts of this pass scale the photon powers
+    AtomicCounter& causticPaths = stats.Counter("Photon Tracing", "Caustic paths");
+    AtomicCounter& indirectPaths = stats.Counter("Photon Tracing", "Indirect paths");
+    const uint32 numPreviousCausticPaths = causticPaths;
+    const uint32 numPreviousIndirectPaths = indirectPaths;
+
+    // The photons of a pass are split into a fixed number of jobs, seeded from the pass,
+    // so that they do not depend on the number of threads of the machine
+    const uint32 numJobs = 16;
+    uint32 numPhotonsPerJob = (settings.numPhotonsPerPass + numJobs-1) / numJobs;
+    MersenneTwister seedRng(seed ^ (pass*0x9e3779b9u));
+    for (uint32 i = 0; i < numJobs; ++i)
+    {
+        JobConstPtr job(new PhotonShootingJob(seedRng.RandomBits(), settings.maxPhotonDepth, scene, powerDistribution.get(), stats,
+                                              *indirectPhotonMap, *causticPhotonMap, 0 /* Direct illumination is sampled with shadow rays */, numPhotonsPerJob));
+        scheduler.Spawn(job);
+    }
+    scheduler.WaitForAllJobs();
+
+    const uint32 numCausticPaths = causticPaths - numPreviousCausticPaths;
+    if (numCausticPaths) causticPhotonMap->ScalePower(1.0f/numCausticPaths);
+    const uint32 numIndirectPaths = indirectPaths - numPreviousIndirectPaths;
+    if (numIndirectPaths) indirectPhotonMap->ScalePower(1.0f/numIndirectPaths);
+
+    // Balance the photon maps concurrently
+    causticPhotonMap->SpawnBalancingJobs(scheduler);
+    indirectPhotonMap->SpawnBalancingJobs(scheduler);
+    scheduler.WaitForAllJobs();
+    causticPhotonMap->FinishBalancing();
+    indirectPhotonMap->FinishBalancing();
+
+    ++stats.Counter("Photon Tracing", "Photon passes");
+}
+
+Spectrum ProgressivePhotonIntegrator::IndirectRadiance(const Intersection& hit, const Vector3& outgoing) const
+{
+    if (   indirectPhotonMap->Empty()
+        || !hit.material
+        || !hit.material->MatchesFlags(BsdfCombinedFlags::Diffuse | BsdfCombinedFlags::Glossy) /* Only evaluate non-specular BSDFs*/)
+    {
+        return Spectrum::black;
+    }
+
+    // As for precomputed irradiance photons, the BSDF is evaluated along the forward facing shading normal
+    Vector3 shadingNormal = DotProduct(outgoing, hit.uvn.N()) < 0.0f ? -hit.uvn.N() : hit.uvn.N();
+    Spectrum irradiance = indirectPhotonMap->FixedRadiusIrradianceEstimate(hit.point, shadingNormal, indirectGatherRadius);
+    if (irradiance.IsBlack())
+    {
+        return Spectrum::black;
+    }
+    int bsdfFlags = (BsdfCombinedFlags::Diffuse | BsdfCombinedFlags::Glossy) & ~BsdfCombinedFlags::Transmission;
+    return irradiance*hit.material->BsdfCombinedFlagsValue(shadingNormal, outgoing, hit, bsdfFlags);
+}
+
+Spectrum ProgressivePhotonIntegrator::Radiance(const Scene& scene, const Ray& ray, MersenneTwister& rng, real& opacity) const
+{
+    Spectrum L(Spectrum::black);
+
+    Intersection hit;
+
+    if (ray.depth == 0)
+    {
+        ++stats.Counter("Rays", "Primary rays traced");
+    }
+
+    if (!scene.Intersects(ray, hit))
+    {
+        return L;
+    }
+
+    Vector3 toViewer = -ray.Direction().GetNormalized();
+
+    if (hit.emitter && (ray.depth==0))
+    {
+        L += hit.emitter->EmittedRadiance(hit.uvn.N(), toViewer);
+    }
+
+    // Add direct illumination
+    L += DirectIllumination(scene, toViewer, hit, lightBvh.get(), settings.numShadowRays, rng, opacity, stats.Counter("Rays", "Shadow rays traced"));
+
+    // Add indirect illumination and caustics from the photons of the current pass
+    L += IndirectRadiance(hit, toViewer);
+    L += causticPhotonMap->FixedRadiusRadianceEstimate(hit, toViewer, causticGatherRadius);
+
+    if (ray.depth+1 < settings.specularDepth)
+    {
+        AtomicCounter& numSecondaryRays = stats.Counter("Rays", "Secondary rays traced");
+
+        // Trace a ray for specular reflection
+        BsdfSamplingRecord brec1(hit, rng, BsdfComponent::DeltaReflection);
+        hit.material->SampleBsdf(toViewer, brec1);
+        if ((brec1.pdf > 0.0f) && !brec1.value.IsBlack())
+        {
+            Ray r(hit.point, brec1.sampledDirection);
+            r.depth = ray.depth+1;
+            L += brec1.value * AbsDotProduct(brec1.sampledDirection, hit.uvn.N()) * Radiance(scene, r, rng, opacity);
+            ++numSecondaryRays;
+        }
+
+        // Trace a ray for specular transmission
+        BsdfSamplingRecord brec2(hit, rng, BsdfComponent::DeltaTransmission);
+        hit.material->SampleBsdf(toViewer, brec2);
+        if ((brec2.pdf > 0.0f) && !brec2.value.IsBlack())
+        {
+            Ray r(hit.point, brec2.sampledDirection);
+            r.depth = ray.depth+1;
+            L += brec2.value * AbsDotProduct(brec2.sampledDirection, hit.uvn.N()) * Radiance(scene, r, rng, opacity);
+            ++numSecondaryRays;
+        }
+    }
+
+    return L;
+}
+}
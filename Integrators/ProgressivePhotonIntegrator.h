@@ -0,0 +1,100 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_PROGRESSIVE_PHOTON_INTEGRATOR_H
+#define RENDERBLISS_PROGRESSIVE_PHOTON_INTEGRATOR_H
+
+#include <boost/scoped_ptr.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Integrators/SurfaceIntegrator.h"
+#include "renderbliss/Lights/LightBvh.h"
+#include "renderbliss/Lights/StepFunctionSampler.h"
+#include "renderbliss/Utils/PropertyMap.h"
+
+namespace renderbliss
+{
+struct Intersection;
+class  PhotonMap;
+class  IrradiancePhotonMap;
+class  StatsTracker;
+struct Vector3;
+
+typedef PhotonMap CausticPhotonMap;
+
+// Returns the gather radius of a 0-based progressive photon mapping pass. Every pass keeps a fraction
+// 'radiusReduction' of the photons of the previous ones: r(i+1)^2 = r(i)^2 * (i+alpha)/(i+1), for 1-based passes.
+real ProgressiveGatherRadius(real initialRadius, uint32 pass, real radiusReduction);
+
+// A surface integrator implementing progressive photon mapping, after Knaus and Zwicker's probabilistic
+// formulation. Every rendering pass shoots a bounded number of photons into new caustic and global photon maps,
+// and gathers all the photons within radii shrinking from one pass to the next. Since the image is the average of
+// all passes, the quality improves with the number of passes, while the photon storage is bounded by a single pass.
+class ProgressivePhotonIntegrator : public SurfaceIntegrator
+{
+public:
+
+    ProgressivePhotonIntegrator(const PropertyMap& props, StatsTracker& stats);
+    ~ProgressivePhotonIntegrator();
+
+    // Seeds photon shooting
+    virtual void SetSeed(uint32 seed);
+
+    // Should be called before rendering a scene
+    virtual void PreProcess(const Scene& scene, JobScheduler& scheduler);
+
+    // Returns the number of photon passes
+    virtual uint32 PassCount() const;
+
+    // Shoots the photons of a pass
+    virtual void PrePass(const Scene& scene, JobScheduler& scheduler, uint32 pass);
+
+    // Returns the radiance along a ray being cast into the scene
+    virtual Spectrum Radiance(const Scene& scene, const Ray& ray, MersenneTwister& rng, real& opacity) const;
+
+private:
+
+    struct Settings
+    {
+        PropertyMap cpmProps; // Caustic photon map properties, for every pass
+        PropertyMap gpmProps; // Global photon map properties, for every pass
+        uint32 specularDepth;
+        uint32 numShadowRays;
+        uint32 maxPhotonDepth;
+        uint32 numPasses;
+        uint32 numPhotonsPerPass; // Number of photons emitted per pass
+        real radiusReduction; // Fraction of the photons kept from one pass to the next, in ]0, 1[
+        real causticGatherRadius; // Initial gather radii
+        real indirectGatherRadius;
+        Settings(const PropertyMap& props);
+    } settings;
+    real causticGatherRadius; // Gather radii of the current pass
+    real indirectGatherRadius;
+    uint32 seed; // Seeds the photon shooting jobs of every pass
+    boost::scoped_ptr<CausticPhotonMap> causticPhotonMap;
+    boost::scoped_ptr<IrradiancePhotonMap> indirectPhotonMap;
+    boost::scoped_ptr<StepFunctionSampler> powerDistribution; // Lighting power distribution, for emitting photons
+    boost::scoped_ptr<LightBvh> lightBvh; // Hierarchy for picking the lights to sample
+
+    // Estimates the radiance reflected from the global photons, through the irradiance at the hit point
+    Spectrum IndirectRadiance(const Intersection& hit, const Vector3& outgoing) const;
+};
+}
+
+#endif
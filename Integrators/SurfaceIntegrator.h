@@ -21,15 +21,16 @@
 #ifndef RENDERBLISS_SURFACE_INTEGRATOR_H
 #define RENDERBLISS_SURFACE_INTEGRATOR_H
 
+#include <vector>
 #include "renderbliss/Types.h"
 #include "renderbliss/Colour/Spectrum.h"
 #include "renderbliss/Interfaces/IIntegrator.h"
+#include "renderbliss/Math/Geometry/Ray.h"
 
 namespace renderbliss
 {
 struct Intersection;
 class  MersenneTwister;
-struct Ray;
 class  Scene;
 class  StatsTracker;
 
@@ -41,6 +42,21 @@ public:
     SurfaceIntegrator(StatsTracker& stats) : IIntegrator(stats) {}
     // Returns the radiance along a ray being cast into the scene
     virtual Spectrum Radiance(const Scene& scene, const Ray& ray, MersenneTwister& rng, real& opacity) const = 0;
+    // Returns the radiance along each ray of a batch. Integrators may override it to collect
+    // the secondary rays of the whole batch and trace them together.
+    virtual void Radiances(const Scene& scene, const std::vector<Ray>& rays, MersenneTwister& rng, std::vector<Spectrum>& radiances) const
+    {
+        radiances.resize(rays.size());
+        for (size_t i = 0; i < rays.size(); ++i)
+        {
+            real opacity = 1.0f;
+            radiances[i] = Radiance(scene, rays[i], rng, opacity);
+        }
+    }
+    // Returns the pixel spacing of the sparse pre-pass traced before rendering, or zero to skip it
+    virtual uint32 PrePassPixelSpacing() const { return 0; }
+    // Traces a ray of the sparse pre-pass, to fill caches shared by the rendering jobs
+    virtual void PrePassRay(const Scene&, const Ray&, MersenneTwister&) const {}
 };
 }
 
@@ -50,7 +50,7 @@ WhittedIntegrator::WhittedIntegrator(const PropertyMap& props, StatsTracker& sta
 
 void WhittedIntegrator::PreProcess(const Scene& scene, JobScheduler&)
 {
-    powerDistribution.reset(PowerDistribution(scene).release());
+    lightBvh.reset(new LightBvh(scene.Lights()));
 }
 
 Spectrum WhittedIntegrator::Radiance(const Scene& scene, const Ray& ray, MersenneTwister& rng, real& opacity) const
@@ -75,7 +75,7 @@ Spectrum WhittedIntegrator::Radiance(const Scene& scene, const Ray& ray, Mersenn
         L += hit.emitter->EmittedRadiance(hit.uvn.N(), toViewer);
     }
 
-    L += DirectIllumination(scene, toViewer, hit, powerDistribution.get(), settings.numShadowRays, rng, opacity, stats.Counter("Rays", "Shadow rays traced"));
+    L += DirectIllumination(scene, toViewer, hit, lightBvh.get(), settings.numShadowRays, rng, opacity, stats.Counter("Rays", "Shadow rays traced"));
 
     if (ray.depth+1 < settings.specularDepth)
     {
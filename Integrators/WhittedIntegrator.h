@@ -24,7 +24,7 @@
 #include <boost/scoped_ptr.hpp>
 #include "renderbliss/Types.h"
 #include "renderbliss/Integrators/SurfaceIntegrator.h"
-#include "renderbliss/Lights/StepFunctionSampler.h"
+#include "renderbliss/Lights/LightBvh.h"
 
 namespace renderbliss
 {
@@ -52,7 +52,7 @@ private:
         uint32 numShadowRays;
         Settings(const PropertyMap& props);
     } settings;
-    boost::scoped_ptr<StepFunctionSampler> powerDistribution; // Lighting power distribution
+    boost::scoped_ptr<LightBvh> lightBvh; // Hierarchy for picking the lights to sample
 };
 }
 
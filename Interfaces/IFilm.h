@@ -24,6 +24,7 @@
 #include <boost/shared_ptr.hpp>
 #include "renderbliss/Colour/Pixel.h"
 #include "renderbliss/Colour/Spectrum.h"
+#include "renderbliss/Interfaces/IRenderingJob.h"
 #include "renderbliss/Math/Sampling/Sampling.h"
 
 namespace renderbliss
@@ -57,6 +58,27 @@ public:
 
     virtual void StorePixels(RGBPixelList& pixels) const = 0;
 
+    // Stores the linear colours of a region of pixels, which must lie within the film, in scanline order.
+    // Unlike StorePixels, no tone mapping is applied, since it depends on the whole image.
+    virtual void StoreRegion(const RenderingWorkArea& region, RGBPixelList& pixels) const = 0;
+
+    // Returns the standard error of the mean luminance of the samples taken in a pixel, relative to that mean
+    virtual real RelativeError(uint32 x, uint32 y) const = 0;
+
+    // Copies the samples accumulated by the film into a buffer, from which they can be restored later.
+    // Should not be called while samples are being added.
+    virtual void StoreState(std::vector<byte>& state) const = 0;
+    // Replaces the accumulated samples with those of a buffer filled by StoreState.
+    // Returns false, leaving the film unchanged, if the buffer was not stored by a film of the same kind and resolution.
+    virtual bool RestoreState(const std::vector<byte>& state) = 0;
+
+    // Moves the samples accumulated in a region of pixels, which must lie within the film, into a buffer
+    // and clears them from the film. Should not be called while samples are being added to the region.
+    virtual void TakeRegion(const RenderingWorkArea& region, std::vector<byte>& samples) = 0;
+    // Adds the samples of a buffer filled by TakeRegion to the same region of the film.
+    // Returns false if the buffer does not match the region. Can be called while samples are being added.
+    virtual bool MergeRegion(const RenderingWorkArea& region, const std::vector<byte>& samples) = 0;
+
     uint32 XResolution() const;
     uint32 YResolution() const;
 
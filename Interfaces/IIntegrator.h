@@ -21,6 +21,8 @@
 #ifndef RENDERBLISS_IINTEGRATOR_H
 #define RENDERBLISS_IINTEGRATOR_H
 
+#include "renderbliss/Types.h"
+
 namespace renderbliss
 {
 class JobScheduler;
@@ -33,10 +35,17 @@ public:
 
     IIntegrator(StatsTracker& stats) : stats(stats) {}
     virtual ~IIntegrator() {}
+    // Seeds the random choices made by PreProcess and PrePass, such as photon paths,
+    // so that processes rendering parts of one image make the same choices
+    virtual void SetSeed(uint32 /*seed*/) {}
     // Should be called before rendering a scene
     virtual void PreProcess(const Scene&, JobScheduler&) {}
     // Should be called after rendering a scene
     virtual void PostProcess() {}
+    // Returns the number of rendering passes, the image being the average of all passes
+    virtual uint32 PassCount() const { return 1; }
+    // Should be called before rendering each pass
+    virtual void PrePass(const Scene&, JobScheduler&, uint32 /*pass*/) {}
 
 protected:
 
@@ -31,9 +31,12 @@
 
 namespace renderbliss
 {
+class  BoundingBox;
+class  DirectionCone;
 struct Intersection;
 class  MersenneTwister;
 class  Scene;
+class  TrianglePrimitive;
 struct Vector2;
 
 // Helper class meant to test light occlusion along a segment or direction
@@ -74,7 +77,8 @@ public:
 
     // Returns the PDF with respect to solid angle for sampling a particular direction towards
     // a surface point receiving light. The sampling direction points away towards the light sourcce.
-    virtual real Pdf(const Vector3& surfacePoint, const Vector3& toLight) const = 0;
+    // The triangle of the surface point, if any, is the one the incident directions were sampled for.
+    virtual real Pdf(const Vector3& surfacePoint, const TrianglePrimitive* surfaceTriangle, const Vector3& toLight) const = 0;
 
     // Returns the power of the light source in Watt.
     virtual Spectrum Power() const = 0;
@@ -87,6 +91,12 @@ public:
 
     // Returns the radiance emitted toward in a viewing direction.
     virtual Spectrum EmittedRadiance(const Vector3& lightNormal, const Vector3& toViewer) const = 0;
+
+    // Returns a cone bounding the surface normals of the light source.
+    virtual DirectionCone NormalBound() const = 0;
+
+    // Returns a bounding box enclosing the light source.
+    virtual BoundingBox WorldBound() const = 0;
 };
 }
 
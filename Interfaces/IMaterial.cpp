@@ -83,6 +83,29 @@ Spectrum IMaterial::BsdfCombinedFlagsValue(const Vector3& wi, const Vector3& wo,
     return result;
 }
 
+real IMaterial::BsdfCombinedFlagsPdf(const Vector3& wi, const Vector3& wo, const Intersection& hit, int flags) const
+{
+    RB_ASSERT(numComponents);
+
+    // SampleBsdf picks a matching component uniformly, and then averages
+    // the PDF over the matching non-delta components: we do the same here
+    uint numMatching = MatchingComponentCount(flags);
+    if (!numMatching) return 0.0f;
+
+    real pdf = 0.0f;
+    Vector3 li = hit.uvn.ToLocal(wi);
+    Vector3 lo = hit.uvn.ToLocal(wo);
+    for (size_t i = 0; i < numComponents; ++i)
+    {
+        if ((components[i] & flags) && !(components[i] & BsdfCombinedFlags::Delta))
+        {
+            pdf += Pdf(li, lo, i);
+        }
+    }
+
+    return pdf/numMatching;
+}
+
 uint IMaterial::ComponentCount() const
 {
     return numComponents;
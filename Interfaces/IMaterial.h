@@ -43,6 +43,10 @@ public:
     // Both directions are of unit length and are expressed in world space.
     Spectrum BsdfCombinedFlagsValue(const Vector3& wi, const Vector3& wo, const Intersection& hit, int flags) const;
 
+    // Returns the PDF with respect to solid angle of SampleBsdf generating the outgoing direction for the input flags.
+    // Both directions are of unit length and are expressed in world space. Delta components are ignored.
+    real BsdfCombinedFlagsPdf(const Vector3& wi, const Vector3& wo, const Intersection& hit, int flags) const;
+
     // Returns the total number of BSDF components for this material.
     uint ComponentCount() const;
 
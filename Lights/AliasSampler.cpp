@@ -0,0 +1,111 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Lights/AliasSampler.h"
+#include <algorithm>
+#include <cmath>
+#include "renderbliss/Macros.h"
+
+namespace renderbliss
+{
+AliasSampler::AliasSampler(const std::vector<real>& function) : function(function), integral(0.0f)
+{
+    RB_ASSERT(!function.empty());
+
+    size_t numSteps = function.size();
+    double sum = 0.0;
+    for (size_t i = 0; i < numSteps; ++i)
+    {
+        sum += function[i];
+    }
+    integral = static_cast<real>(sum);
+
+    // Scale the probabilities so that their average is one, and split the steps
+    // into those below and above the average
+    std::vector<double> scaledProbabilities(numSteps, 1.0);
+    std::vector<uint32> small, large;
+    for (uint32 i = 0; i < numSteps; ++i)
+    {
+        if (sum > 0.0) scaledProbabilities[i] = function[i]*numSteps/sum;
+        if (scaledProbabilities[i] < 1.0) small.push_back(i);
+        else                              large.push_back(i);
+    }
+
+    // Each small step is topped up with the excess probability of a large step
+    table.resize(numSteps);
+    while (!small.empty() && !large.empty())
+    {
+        uint32 s = small.back(); small.pop_back();
+        uint32 l = large.back(); large.pop_back();
+        table[s].threshold = static_cast<real>(scaledProbabilities[s]);
+        table[s].alias = l;
+        scaledProbabilities[l] = (scaledProbabilities[l] + scaledProbabilities[s]) - 1.0;
+        if (scaledProbabilities[l] < 1.0) small.push_back(l);
+        else                              large.push_back(l);
+    }
+
+    // Exactly, the pairing would end with both lists empty. The steps left over in either list
+    // have a scaled probability which only drifted away from one through floating-point rounding
+    // of the repeated subtractions above, so they are kept with certainty.
+    while (!large.empty())
+    {
+        uint32 l = large.back(); large.pop_back();
+        RB_ASSERT(std::abs(scaledProbabilities[l] - 1.0) < 1.0e-6);
+        table[l].threshold = 1.0f;
+        table[l].alias = l;
+    }
+    while (!small.empty())
+    {
+        uint32 s = small.back(); small.pop_back();
+        RB_ASSERT(std::abs(scaledProbabilities[s] - 1.0) < 1.0e-6);
+        table[s].threshold = 1.0f;
+        table[s].alias = s;
+    }
+}
+
+real AliasSampler::FunctionIntegral() const
+{
+    return integral;
+}
+
+real AliasSampler::FunctionValue(size_t index) const
+{
+    RB_ASSERT(index < function.size());
+    return function[index];
+}
+
+size_t AliasSampler::SampleIndex(real canonicalRandom) const
+{
+    RB_ASSERT(canonicalRandom >= 0.0f);
+    RB_ASSERT(canonicalRandom <  1.0f);
+
+    // The integer part of the scaled random number selects a step, and its fractional part
+    // decides between the step and its alias
+    double scaledRandom = static_cast<double>(canonicalRandom)*table.size();
+    size_t index = std::min(static_cast<size_t>(scaledRandom), table.size()-1);
+    real u = static_cast<real>(scaledRandom - index);
+    return (u < table[index].threshold) ? index : table[index].alias;
+}
+
+size_t AliasSampler::StepCount() const
+{
+    return table.size();
+}
+}
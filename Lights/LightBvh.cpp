@@ -0,0 +1,206 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Lights/LightBvh.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include "renderbliss/Macros.h"
+#include "renderbliss/Interfaces/ILight.h"
+#include "renderbliss/Math/MathUtils.h"
+
+namespace
+{
+using namespace renderbliss;
+
+// Predicate functor splitting lights around a pivot along an axis
+struct LightCentroidPredicate : std::unary_function<uint32, bool>
+{
+    const LightPtrList* lights;
+    real pivot;
+    unsigned axis;
+
+    LightCentroidPredicate(const LightPtrList* lights, real pivot, unsigned axis)
+        : lights(lights), pivot(pivot), axis(axis) {}
+
+    bool operator()(uint32 index) const
+    {
+        return (*lights)[index]->WorldBound().Center()[axis] < pivot;
+    }
+};
+}
+
+namespace renderbliss
+{
+LightBvh::LightBvh(const LightPtrList& lights)
+{
+    if (lights.empty()) return;
+
+    std::vector<uint32> lightIndices;
+    for (uint32 i = 0; i < lights.size(); ++i)
+    {
+        RB_ASSERT(lights[i].get());
+        lightIndices.push_back(i);
+    }
+
+    leafIndices.resize(lights.size());
+    nodes.reserve(2*lights.size()-1);
+    Build(lights, lightIndices, 0, lightIndices.size(), 0);
+}
+
+uint32 LightBvh::Build(const LightPtrList& lights, std::vector<uint32>& lightIndices, size_t start, size_t end, uint32 parentIndex)
+{
+    RB_ASSERT(start < end);
+
+    uint32 nodeIndex = static_cast<uint32>(nodes.size());
+    nodes.push_back(Node());
+    nodes[nodeIndex].parentIndex = parentIndex;
+
+    if (start+1 == end) // This is a leaf node
+    {
+        const LightConstPtr& l = lights[lightIndices[start]];
+        nodes[nodeIndex].worldBound = l->WorldBound();
+        nodes[nodeIndex].normalBound = l->NormalBound();
+        nodes[nodeIndex].power = l->Power().Luminance();
+        nodes[nodeIndex].lightIndex = lightIndices[start];
+        nodes[nodeIndex].leaf = 1;
+        leafIndices[lightIndices[start]] = nodeIndex;
+        return nodeIndex;
+    }
+
+    // Split the lights at the midpoint of the widest axis of their centroids
+    BoundingBox centroidBound;
+    for (size_t i = start; i < end; ++i)
+    {
+        centroidBound.Enclose(lights[lightIndices[i]]->WorldBound().Center());
+    }
+    Vector3 ext = centroidBound.Extents();
+    unsigned splitAxis =   ((ext[0] > ext[1]) && (ext[0] > ext[2])) ? 0
+                         : (ext[1] > ext[2]) ? 1
+                         : 2;
+    real pivot = centroidBound.Center()[splitAxis];
+    std::vector<uint32>::iterator begIter = lightIndices.begin() + start;
+    std::vector<uint32>::iterator endIter = lightIndices.begin() + end;
+    std::vector<uint32>::iterator midIter = std::partition(begIter, endIter, LightCentroidPredicate(&lights, pivot, splitAxis));
+    size_t midpoint = ((midIter == begIter) || (midIter == endIter)) ? (start+end)/2 : midIter-lightIndices.begin();
+
+    // The left child immediately follows its parent
+    nodes[nodeIndex].leaf = 0;
+    uint32 leftIndex = Build(lights, lightIndices, start, midpoint, nodeIndex);
+    uint32 rightIndex = Build(lights, lightIndices, midpoint, end, nodeIndex);
+    RB_ASSERT(leftIndex == nodeIndex+1);
+    nodes[nodeIndex].rightChildIndex = rightIndex;
+    nodes[nodeIndex].worldBound = nodes[leftIndex].worldBound;
+    nodes[nodeIndex].worldBound.Enclose(nodes[rightIndex].worldBound);
+    nodes[nodeIndex].normalBound = nodes[leftIndex].normalBound;
+    nodes[nodeIndex].normalBound.Enclose(nodes[rightIndex].normalBound);
+    nodes[nodeIndex].power = nodes[leftIndex].power + nodes[rightIndex].power;
+    return nodeIndex;
+}
+
+real LightBvh::Importance(const Vector3& point, const Vector3& normal, uint32 nodeIndex) const
+{
+    const Node& node = nodes[nodeIndex];
+    if ((node.power <= 0.0f) || node.worldBound.IsCollapsed()) return 0.0f;
+
+    // The squared distance is clamped so that it does not vanish inside the bounds
+    Vector3 toLight = node.worldBound.Center() - point;
+    real distance = toLight.Norm();
+    real radius = 0.5f*node.worldBound.Extents().Norm();
+    real sqrDistance = std::max(Sqr(distance), Sqr(radius));
+    if (distance <= radius)
+    {
+        return node.power/sqrDistance;
+    }
+    toLight /= distance;
+
+    // Angle subtended by the bounding sphere of the node
+    real boundAngle = asin(radius/distance);
+
+    // The smallest angle between a light normal and the direction towards the point
+    real emissionAngle = AngleBetween(node.normalBound.Axis(), -toLight);
+    emissionAngle = std::max(static_cast<real>(0.0f), emissionAngle - node.normalBound.Spread() - boundAngle);
+    if (emissionAngle >= HalfPi()) return 0.0f; // All lights face away from the point
+
+    // The smallest angle between the surface normal and a direction towards the lights
+    real incidenceAngle = acos(std::min(static_cast<real>(1.0f), AbsDotProduct(normal, toLight)));
+    incidenceAngle = std::max(static_cast<real>(0.0f), incidenceAngle - boundAngle);
+
+    return node.power*cos(emissionAngle)*cos(incidenceAngle)/sqrDistance;
+}
+
+real LightBvh::Pdf(const Vector3& point, const Vector3& normal, size_t lightIndex) const
+{
+    if (lightIndex >= leafIndices.size()) return 0.0f;
+
+    // Walk up from the leaf, accumulating the probability of the traversal choices
+    real pdf = 1.0f;
+    uint32 nodeIndex = leafIndices[lightIndex];
+    while (nodeIndex != 0)
+    {
+        uint32 parentIndex = nodes[nodeIndex].parentIndex;
+        real leftImportance = Importance(point, normal, parentIndex+1);
+        real rightImportance = Importance(point, normal, nodes[parentIndex].rightChildIndex);
+        real importanceSum = leftImportance + rightImportance;
+        if (importanceSum <= 0.0f) return 0.0f;
+        pdf *= ((nodeIndex == parentIndex+1) ? leftImportance : rightImportance) / importanceSum;
+        nodeIndex = parentIndex;
+    }
+    return pdf;
+}
+
+bool LightBvh::SampleIndex(const Vector3& point, const Vector3& normal, real canonicalRandom, size_t& lightIndex, real& pdf) const
+{
+    RB_ASSERT(canonicalRandom >= 0.0f);
+    RB_ASSERT(canonicalRandom <  1.0f);
+
+    if (nodes.empty()) return false;
+
+    // The canonical random is remapped at each level, so that it can be reused for the next choice
+    pdf = 1.0f;
+    uint32 nodeIndex = 0;
+    while (!nodes[nodeIndex].IsLeaf())
+    {
+        uint32 leftIndex = nodeIndex+1;
+        uint32 rightIndex = nodes[nodeIndex].rightChildIndex;
+        real leftImportance = Importance(point, normal, leftIndex);
+        real rightImportance = Importance(point, normal, rightIndex);
+        if (leftImportance + rightImportance <= 0.0f) return false;
+
+        real leftProbability = leftImportance / (leftImportance + rightImportance);
+        if (canonicalRandom < leftProbability)
+        {
+            canonicalRandom /= leftProbability;
+            pdf *= leftProbability;
+            nodeIndex = leftIndex;
+        }
+        else
+        {
+            canonicalRandom = (canonicalRandom - leftProbability) / (1.0f - leftProbability);
+            pdf *= 1.0f - leftProbability;
+            nodeIndex = rightIndex;
+        }
+        canonicalRandom = std::min(canonicalRandom, 1.0f-Epsilon());
+    }
+
+    lightIndex = nodes[nodeIndex].lightIndex;
+    return true;
+}
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_LIGHT_BVH_H
+#define RENDERBLISS_LIGHT_BVH_H
+
+#include <vector>
+#include "renderbliss/Scene.h"
+#include "renderbliss/Types.h"
+#include "renderbliss/Math/Geometry/BoundingBox.h"
+#include "renderbliss/Math/Geometry/DirectionCone.h"
+
+namespace renderbliss
+{
+
+// A bounding volume hierarchy over light sources, for picking a light with a probability
+// that depends on its power, as well as its distance and orientation relative to a shading point.
+// Each node bounds the positions and the surface normals of the lights below it.
+// From "Importance Sampling of Many Lights with Adaptive Tree Splitting" by Alejandro Conty Estevez and Christopher Kulla
+class LightBvh
+{
+public:
+
+    LightBvh(const LightPtrList& lights);
+
+    // Returns the probability of picking the light at the given index for a shading point.
+    real Pdf(const Vector3& point, const Vector3& normal, size_t lightIndex) const;
+
+    // Stochastically traverses the hierarchy to pick a light for a shading point. Returns false if
+    // no light can illuminate the point. Otherwise, fills the light index and the probability of picking it.
+    bool SampleIndex(const Vector3& point, const Vector3& normal, real canonicalRandom, size_t& lightIndex, real& pdf) const;
+
+private:
+
+    struct Node
+    {
+        BoundingBox worldBound;
+        DirectionCone normalBound;
+        real power; // Luminance of the power emitted by the lights below the node
+        uint32 parentIndex;
+        union { uint32 lightIndex, rightChildIndex; };
+        uint32 leaf; // 0 for interior nodes, 1 for leaf nodes
+        bool IsLeaf() const { return leaf != 0; }
+    };
+
+    std::vector<Node> nodes;
+    std::vector<uint32> leafIndices; // Leaf node index for each light
+
+    // Builds the subtree over a range of light indices, and returns the index of its root node
+    uint32 Build(const LightPtrList& lights, std::vector<uint32>& lightIndices, size_t start, size_t end, uint32 parentIndex);
+
+    // Returns an estimate of the contribution of the lights below a node to a shading point
+    real Importance(const Vector3& point, const Vector3& normal, uint32 nodeIndex) const;
+};
+}
+
+#endif
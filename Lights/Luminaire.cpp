@@ -40,6 +40,12 @@ void PhongSampleHemisphere(real exponent, real u1, real u2, Vector3& sampledDire
     sampledDirection = SphericalToCartesian(cos(phi), sin(phi), cosTheta, sinTheta);
     solidAnglePdf = InvTwoPi() * (exponent + 1) * pow(cosTheta, exponent);
 }
+
+// Converts a PDF with respect to surface area into a PDF with respect to solid angle
+real SolidAnglePdf(real areaPdf, real sqrDistance, real cosine)
+{
+    return (cosine > 0.0f) ? areaPdf*sqrDistance/cosine : 0.0f;
+}
 }
 
 namespace renderbliss
@@ -54,9 +60,12 @@ Luminaire::Luminaire(const TrianglePrimitiveList& triangles, const Spectrum& rad
     {
         RB_ASSERT(t.get());
         areaFunction.push_back(t->Area());
+        normalBound.Enclose(t->GeometricNormal());
         const_cast<TrianglePrimitive*>(t.get())->SetEmissionProfile(this);
     }
     areaDistribution.reset(new StepFunctionSampler(areaFunction));
+    triangleBvh.reset(new BvhAccelerator);
+    triangleBvh->Build(PrimitiveList(this->triangles.begin(), this->triangles.end()));
 }
 
 Spectrum Luminaire::EmittedRadiance(const Vector3& lightNormal, const Vector3& toViewer) const
@@ -67,26 +76,23 @@ Spectrum Luminaire::EmittedRadiance(const Vector3& lightNormal, const Vector3& t
     return radiantExitance*phongDensity/dot;
 }
 
-real Luminaire::Pdf(const Vector3& surfacePoint, const Vector3& toLight) const
+DirectionCone Luminaire::NormalBound() const
 {
-    real pdf = 0.0f;
-    const size_t numTriangles = triangles.size();
-    for (size_t i = 0; i < numTriangles; ++i)
-    {
-        // Check if the triangle is intersected at all
-        Ray r(surfacePoint, toLight);
-        Intersection lightHit;
-        if (!triangles[i]->Intersects(r, lightHit)) continue;
-        // Accumulate the PDF with respect to solid angle
-        RB_ASSERT(i < areaDistribution->StepCount());
-        real area = areaDistribution->FunctionValue(i);
-        real d2 = SquaredDistance(r(r.tmax), surfacePoint);
-        real dot = AbsDotProduct(-toLight, lightHit.uvn.N());
-        real solidAnglePdf = (dot > 0.0f) ? d2/(dot*area) : 0.0f;
-        pdf += area*solidAnglePdf;
-    }
-    pdf /= areaDistribution->FunctionIntegral();
-    return pdf;
+    return normalBound;
+}
+
+real Luminaire::Pdf(const Vector3& surfacePoint, const TrianglePrimitive* surfaceTriangle, const Vector3& toLight) const
+{
+    // Find the closest luminaire point along the direction, which is the only one that can contribute
+    Ray r(surfacePoint, toLight);
+    Intersection lightHit;
+    if (!triangleBvh->Intersects(r, lightHit)) return 0.0f;
+    if (lightHit.triangle == surfaceTriangle) return 0.0f; // Never sampled, to avoid self-illumination
+
+    // Points are sampled uniformly over the luminaire surface
+    real d2 = SquaredDistance(r(r.tmax), surfacePoint);
+    real dot = AbsDotProduct(-toLight, lightHit.uvn.N());
+    return SolidAnglePdf(1.0f/areaDistribution->FunctionIntegral(), d2, dot);
 }
 
 Spectrum Luminaire::Power() const
@@ -113,7 +119,12 @@ void Luminaire::SampleIncidentDirection(const Intersection& hit, LightSamplingRe
 
     lrec.toLight = (lightPoint-hit.point).GetNormalized();
     lrec.occlusionTester.InitForOcclusionAlongSegment(hit.point, lightPoint);
-    lrec.pdf = Pdf(hit.point, lrec.toLight);
+
+    // Picking the triangle with a probability proportional to its area and sampling it uniformly
+    // amounts to sampling the luminaire uniformly, so the PDF follows from the sampled point alone
+    real d2 = SquaredDistance(lightPoint, hit.point);
+    real dot = AbsDotProduct(-lrec.toLight, lrec.shadingNormal.GetNormalized());
+    lrec.pdf = SolidAnglePdf(1.0f/areaDistribution->FunctionIntegral(), d2, dot);
 
     if (lrec.pdf > 0.0f)
     {
@@ -121,6 +132,11 @@ void Luminaire::SampleIncidentDirection(const Intersection& hit, LightSamplingRe
     }
 }
 
+BoundingBox Luminaire::WorldBound() const
+{
+    return triangleBvh->WorldBound();
+}
+
 void Luminaire::SampleOutgoingRay(const real canonicalRandom[5], Vector3& origin, Vector3& direction, Vector3& lightNormal, real& pdf) const
 {
     pdf = 0.0f;
@@ -25,8 +25,10 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/scoped_ptr.hpp>
 #include "renderbliss/Interfaces/ILight.h"
+#include "renderbliss/Accelerators/BvhAccelerator.h"
 #include "renderbliss/Colour/Spectrum.h"
 #include "renderbliss/Lights/StepFunctionSampler.h"
+#include "renderbliss/Math/Geometry/DirectionCone.h"
 
 namespace renderbliss
 {
@@ -43,12 +45,15 @@ public:
 
     // Returns the PDF with respect to solid angle for sampling a particular direction towards
     // a surface point receiving light. The sampling direction points away towards the light sourcce.
-    virtual real Pdf(const Vector3& surfacePoint, const Vector3& toLight) const;
+    // The luminaire point seen along the direction is found with a BVH over the emitting triangles.
+    // As in SampleIncidentDirection, the triangle of the surface point is never sampled.
+    virtual real Pdf(const Vector3& surfacePoint, const TrianglePrimitive* surfaceTriangle, const Vector3& toLight) const;
 
     // Returns the power of the light source in Watt.
     virtual Spectrum Power() const;
 
     // Samples the light source in order to obtain an incident direction.
+    // The PDF of the sampled point is computed directly, without searching for the triangle it lies on.
     virtual void SampleIncidentDirection(const Intersection& hit, LightSamplingRecord& lrec) const;
 
     // Samples the light source in order to generate a ray leaving the light.
@@ -57,11 +62,19 @@ public:
     // Returns the radiance emitted toward in a viewing direction.
     virtual Spectrum EmittedRadiance(const Vector3& lightNormal, const Vector3& toViewer) const;
 
+    // Returns a cone bounding the surface normals of the light source.
+    virtual DirectionCone NormalBound() const;
+
+    // Returns a bounding box enclosing the light source.
+    virtual BoundingBox WorldBound() const;
+
 private:
 
     Spectrum radiantExitance;
     TrianglePrimitiveList triangles;
     boost::scoped_ptr<StepFunctionSampler> areaDistribution;
+    boost::scoped_ptr<BvhAccelerator> triangleBvh; // Used to evaluate the PDF of directions sampled by other means
+    DirectionCone normalBound; // Bounds the geometric normals of the triangles
     // With a control exponent of 1, the luminaire has a diffuse emission profile.
     // With a large control exponent, the light is concentrated near the surface normal of the emission point.
     real controlExponent;
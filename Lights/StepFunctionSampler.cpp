@@ -23,10 +23,17 @@
 
 namespace renderbliss
 {
-StepFunctionSampler::StepFunctionSampler(const std::vector<real>& function) : integral(0.0f)
+StepFunctionSampler::StepFunctionSampler(const std::vector<real>& function, size_t aliasTableThreshold) : integral(0.0f)
 {
     RB_ASSERT(!function.empty());
 
+    if (function.size() >= aliasTableThreshold)
+    {
+        aliasSampler.reset(new AliasSampler(function));
+        integral = aliasSampler->FunctionIntegral();
+        return;
+    }
+
     size_t numSteps = function.size();
     normalizedCdf.reserve(numSteps + 1);
     normalizedCdf.push_back(0.0f);
@@ -51,6 +58,7 @@ real StepFunctionSampler::FunctionIntegral() const
 
 real StepFunctionSampler::FunctionValue(size_t index) const
 {
+    if (aliasSampler) return aliasSampler->FunctionValue(index);
     RB_ASSERT(index+1 < normalizedCdf.size());
     return integral*(normalizedCdf[index+1] - normalizedCdf[index]);
 }
@@ -59,6 +67,7 @@ size_t StepFunctionSampler::SampleIndex(real canonicalRandom) const
 {
     RB_ASSERT(canonicalRandom >= 0.0f);
     RB_ASSERT(canonicalRandom <  1.0f);
+    if (aliasSampler) return aliasSampler->SampleIndex(canonicalRandom);
     std::vector<real>::const_iterator ubIter = std::upper_bound(normalizedCdf.begin(), normalizedCdf.end(), canonicalRandom);
     RB_ASSERT(ubIter != normalizedCdf.end());
     return ubIter-normalizedCdf.begin()-1;
@@ -66,6 +75,7 @@ size_t StepFunctionSampler::SampleIndex(real canonicalRandom) const
 
 size_t StepFunctionSampler::StepCount() const
 {
+    if (aliasSampler) return aliasSampler->StepCount();
     return normalizedCdf.size() - 1;
 }
 }
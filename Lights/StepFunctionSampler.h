@@ -22,16 +22,22 @@
 #define RENDERBLISS_STEP_FUNCTION_SAMPLER_H
 
 #include <vector>
+#include <boost/scoped_ptr.hpp>
 #include "renderbliss/Types.h"
+#include "renderbliss/Lights/AliasSampler.h"
 
 namespace renderbliss
 {
-// Helper class to sample the values of a step function with a probability proportional to their relative weight
+// Helper class to sample the values of a step function with a probability proportional to their relative weight.
+// Sampling searches the cumulative distribution function, unless the function has at least 'aliasTableThreshold'
+// steps, in which case it is delegated to an alias table. This avoids cache misses with large step counts.
 class StepFunctionSampler
 {
 public:
 
-    StepFunctionSampler(const std::vector<real>& function);
+    enum { DefaultAliasTableThreshold = 64 };
+
+    StepFunctionSampler(const std::vector<real>& function, size_t aliasTableThreshold=DefaultAliasTableThreshold);
     real FunctionIntegral() const;
     real FunctionValue(size_t index) const;
     size_t SampleIndex(real canonicalRandom) const;
@@ -41,6 +47,7 @@ private:
 
     std::vector<real> normalizedCdf; // Cumulative distribution function divided by the function integral
     real integral;
+    boost::scoped_ptr<AliasSampler> aliasSampler; // Replaces the CDF for large step counts
 };
 }
 
@@ -46,7 +46,7 @@ real LambertianMaterial::Pdf(const Vector3& li, const Vector3& lo, size_t compon
 {
     RB_ASSERT(componentIndex==0);
     bool sameHemisphere = li.z*lo.z > 0.0f;
-    return sameHemisphere ? fabs(li.z)*InvPi() : 0.0f;
+    return sameHemisphere ? fabs(lo.z)*InvPi() : 0.0f; // Outgoing directions are cosine-weighted
 }
 
 Vector3 LambertianMaterial::SampleDirection(const Vector3& li, real directionSamples[2], size_t componentIndex) const
@@ -0,0 +1,123 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Math/Geometry/DirectionCone.h"
+#include <algorithm>
+#include <cmath>
+#include "renderbliss/Macros.h"
+#include "renderbliss/Math/MathUtils.h"
+#include "renderbliss/Math/Geometry/Basis3.h"
+
+namespace
+{
+using namespace renderbliss;
+
+// Rotates a vector around a unit axis, using Rodrigues' rotation formula
+Vector3 Rotate(const Vector3& v, const Vector3& axis, real angle)
+{
+    real c = cos(angle);
+    real s = sin(angle);
+    return c*v + s*CrossProduct(axis, v) + (1.0f-c)*DotProduct(axis, v)*axis;
+}
+}
+
+namespace renderbliss
+{
+DirectionCone::DirectionCone() : axis(Vector3::unitZ), spread(0.0f), empty(true)
+{
+}
+
+DirectionCone::DirectionCone(const Vector3& axis, real spread)
+    : axis(axis.GetNormalized()), spread(spread), empty(false)
+{
+    Clamp(static_cast<real>(0.0f), Pi(), this->spread);
+}
+
+const Vector3& DirectionCone::Axis() const
+{
+    return axis;
+}
+
+real DirectionCone::Spread() const
+{
+    return spread;
+}
+
+bool DirectionCone::Contains(const Vector3& direction) const
+{
+    return !empty && (AngleBetween(axis, direction.GetNormalized()) <= spread + Epsilon());
+}
+
+bool DirectionCone::IsEmpty() const
+{
+    return empty;
+}
+
+void DirectionCone::Enclose(const Vector3& direction)
+{
+    Enclose(DirectionCone(direction, 0.0f));
+}
+
+void DirectionCone::Enclose(const DirectionCone& cone)
+{
+    // From:
+    // "Importance Sampling of Many Lights with Adaptive Tree Splitting". Alejandro Conty Estevez and Christopher Kulla
+
+    if (cone.IsEmpty()) return;
+    if (IsEmpty())
+    {
+        *this = cone;
+        return;
+    }
+
+    // Let 'a' be the widest cone
+    DirectionCone a = (spread >= cone.spread) ? *this : cone;
+    const DirectionCone& b = (spread >= cone.spread) ? cone : *this;
+
+    // Check if the widest cone already encloses the other one
+    real axesAngle = AngleBetween(a.axis, b.axis);
+    if (std::min(axesAngle + b.spread, Pi()) <= a.spread)
+    {
+        *this = a;
+        return;
+    }
+
+    real newSpread = 0.5f*(a.spread + axesAngle + b.spread);
+    if (newSpread >= Pi())
+    {
+        *this = DirectionCone(a.axis, Pi());
+        return;
+    }
+
+    // Rotate the axis of the widest cone towards the other one. For opposite
+    // axes, any direction orthogonal to the axis is a valid rotation axis.
+    Vector3 rotationAxis = CrossProduct(a.axis, b.axis);
+    rotationAxis = (rotationAxis.SquaredNorm() > Sqr(Epsilon())) ? rotationAxis.GetNormalized()
+                                                                  : Basis3::CreateFromN(a.axis).U();
+    *this = DirectionCone(Rotate(a.axis, rotationAxis, newSpread - a.spread), newSpread);
+}
+
+real AngleBetween(const Vector3& a, const Vector3& b)
+{
+    real dot = DotProduct(a, b);
+    Clamp(static_cast<real>(-1.0f), static_cast<real>(1.0f), dot);
+    return acos(dot);
+}
+}
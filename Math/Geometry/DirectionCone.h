@@ -0,0 +1,57 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_DIRECTION_CONE_H
+#define RENDERBLISS_DIRECTION_CONE_H
+
+#include "renderbliss/Math/Geometry/Vector3.h"
+
+namespace renderbliss
+{
+// A cone bounding a set of unit directions, defined by a unit axis and a spread angle in radians.
+// The spread is the half-angle at the apex of the cone, and ranges from 0 (single direction) to pi (all directions).
+class DirectionCone
+{
+public:
+
+    DirectionCone(); // Constructs an empty cone, which bounds nothing
+    DirectionCone(const Vector3& axis, real spread);
+
+    const Vector3& Axis() const;
+    real Spread() const;
+
+    bool Contains(const Vector3& direction) const;
+    bool IsEmpty() const;
+
+    void Enclose(const Vector3& direction);
+    void Enclose(const DirectionCone& cone);
+
+private:
+
+    Vector3 axis;
+    real spread;
+    bool empty;
+};
+
+// Returns the angle in radians between two unit vectors
+real AngleBetween(const Vector3& a, const Vector3& b);
+}
+
+#endif
@@ -31,6 +31,7 @@ struct Ray
     mutable real tmin, tmax; // The user is responsible for maintaining a (tmin <= tmax) state if they so wish
     mutable uint32 depth;
     mutable bool lookingForShadowHit;
+    mutable uint32 traversalSteps; // Number of acceleration structure nodes visited by intersection tests
     Ray();
     Ray(const Vector3& origin, const Vector3& direction);
     Vector3 operator()(real t) const;
@@ -23,7 +23,7 @@
 namespace renderbliss
 {
 inline Ray::Ray()
-    : tmin(Epsilon()), tmax(Infinity()), depth(0), lookingForShadowHit(false)
+    : tmin(Epsilon()), tmax(Infinity()), depth(0), lookingForShadowHit(false), traversalSteps(0)
 {
     invDirection.x = 1.0f/this->direction.x;
     invDirection.y = 1.0f/this->direction.y;
@@ -31,7 +31,7 @@ inline Ray::Ray()
 }
 
 inline Ray::Ray(const Vector3& origin, const Vector3& direction)
-    : origin(origin), direction(direction), tmin(Epsilon()), tmax(Infinity()), depth(0), lookingForShadowHit(false)
+    : origin(origin), direction(direction), tmin(Epsilon()), tmax(Infinity()), depth(0), lookingForShadowHit(false), traversalSteps(0)
 {
     invDirection.x = 1.0f/this->direction.x;
     invDirection.y = 1.0f/this->direction.y;
@@ -20,6 +20,7 @@
 
 #include "renderbliss/Math/MersenneTwister.h"
 #include <algorithm>
+#include <sstream>
 #include "renderbliss/Math/MathUtils.h"
 #include "renderbliss/Math/Geometry/Vector2.h"
 #include "renderbliss/Math/Geometry/Vector3.h"
@@ -65,4 +66,33 @@ uint MersenneTwister::RandomUint(uint min, uint max)
     max = std::max(min, max) + 1;
     return static_cast<uint>(RandomReal(static_cast<real>(min), static_cast<real>(max)));
 }
+
+uint32 MersenneTwister::RandomBits()
+{
+    return static_cast<uint32>(realGenerator.base()());
+}
+
+std::string MersenneTwister::State() const
+{
+    std::ostringstream os;
+    os << realGenerator.base();
+    return os.str();
+}
+
+bool MersenneTwister::RestoreState(const std::string& state)
+{
+    // The stream fails at its end when reading a valid state,
+    // so the state read is checked by writing it back instead
+    boost::mt19937 engine;
+    std::istringstream is(state);
+    is >> engine;
+    std::ostringstream os;
+    os << engine;
+    if (os.str() != state)
+    {
+        return false;
+    }
+    realGenerator.base() = engine;
+    return true;
+}
 }
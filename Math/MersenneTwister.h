@@ -22,6 +22,7 @@
 #define RENDERBLISS_MERSENNE_TWISTER_H
 
 #include <ctime>
+#include <string>
 #include <boost/random.hpp>
 #include "renderbliss/Types.h"
 
@@ -48,6 +49,13 @@ public:
     uint RandomUint(uint min, uint max);
     // Generates an real in the range [min,max)
     real RandomReal(real min, real max);
+    // Generates an unsigned integer with 32 random bits, e.g. for seeding other generators
+    uint32 RandomBits();
+
+    // Returns the state of the generator as a string, from which its sequence can be resumed
+    std::string State() const;
+    // Restores a state returned by State(). Returns false if the string is not a valid state.
+    bool RestoreState(const std::string& state);
 
 private:
 
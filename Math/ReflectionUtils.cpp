@@ -44,8 +44,9 @@ Vector3 DiffuseDirection(const Vector2& canonicalRandom)
 {
     RB_ASSERT((canonicalRandom[0] >= 0.0f) &&(canonicalRandom[0] < 1.0f));
     RB_ASSERT((canonicalRandom[1] >= 0.0f) &&(canonicalRandom[1] < 1.0f));
+    // Cosine-weighted sampling of the hemisphere, the PDF being cos(theta)/pi
     real phi = TwoPi()*canonicalRandom[0];
-    real cosTheta = canonicalRandom[1];
+    real cosTheta = sqrt(canonicalRandom[1]);
     real sinTheta = sqrt(1.0f - cosTheta*cosTheta);
     return SphericalToCartesian(cos(phi), sin(phi), cosTheta, sinTheta);
 }
@@ -21,6 +21,7 @@
 #include "renderbliss/Math/Sampling/SamplingFunctions.h"
 #include <algorithm>
 #include <functional>
+#include <limits>
 #include <boost/function.hpp>
 #include "renderbliss/Macros.h"
 #include "renderbliss/Math/MersenneTwister.h"
@@ -89,12 +90,14 @@ void GenerateLatinHypercubeSamples(MersenneTwister& rng, std::vector<real>& samp
 {
     std::vector<real>(nSamples*nDimensions, 0.0f).swap(samples);
     real delta = 1.0f/nSamples;
+    // Rounding may take samples of the last stratum up to one, so they are kept below the largest value under one
+    const real maxSample = 1.0f - 0.5f*std::numeric_limits<real>::epsilon();
     // Generate samples along diagonal
     for (size_t i = 0; i < nSamples; ++i)
     {
         for (size_t j = 0; j < nDimensions; ++j)
         {
-            real s = (i + rng.CanonicalRandom())*delta;
+            real s = std::min((i + rng.CanonicalRandom())*delta, maxSample);
             samples[nDimensions*i + j] = s;
         }
     }
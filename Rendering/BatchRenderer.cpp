@@ -0,0 +1,116 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Rendering/BatchRenderer.h"
+#include <ctime>
+#include "renderbliss/Macros.h"
+#include "renderbliss/Scene.h"
+#include "renderbliss/Interfaces/ICamera.h"
+#include "renderbliss/Integrators/SurfaceIntegrator.h"
+#include "renderbliss/Rendering/RenderingJob.h"
+#include "renderbliss/Utils/JobScheduler.h"
+#include "renderbliss/Utils/PropertyMap.h"
+#include "renderbliss/Utils/StatsTracker.h"
+
+namespace renderbliss
+{
+BatchRenderer::Settings::Settings(const PropertyMap& props)
+{
+    GetTileSettings(props, tileSize, tileOrder);
+}
+
+BatchRenderer::BatchRenderer(const PropertyMap& props, const std::vector<CameraConstPtr>& cameras,
+                             const SceneConstPtr& scene, const SurfaceIntegratorPtr& surfaceIntegrator,
+                             JobScheduler& jobScheduler, StatsTracker& stats)
+    : settings(props), cameras(cameras), scene(scene), surfaceIntegrator(surfaceIntegrator), jobScheduler(jobScheduler), stats(stats)
+{
+    RB_ASSERT(this->scene.get());
+    RB_ASSERT(this->surfaceIntegrator.get());
+    foreach (const CameraConstPtr& camera, this->cameras)
+    {
+        RB_ASSERT(camera.get());
+    }
+    stats.AddCounter("Batch Rendering", "Cameras");
+    stats.AddCounter("Batch Rendering", "Work areas");
+}
+
+void BatchRenderer::Render()
+{
+    if (cameras.empty() || !scene || !surfaceIntegrator)
+    {
+        return;
+    }
+
+    seedRng = MersenneTwister(static_cast<uint>(std::time(0)));
+
+    stats.Timer("Preprocessing", "Preprocessing time").Start();
+    surfaceIntegrator->PreProcess(*scene, jobScheduler);
+    PrePass();
+    stats.Timer("Preprocessing", "Preprocessing time").Stop();
+
+    stats.Timer("Rendering", "Rendering time").Start();
+
+    // The work areas of each camera are made once, and listed camera after camera
+    std::vector<const ICamera*> workAreaCameras;
+    std::vector<RenderingWorkArea> workAreas;
+    foreach (const CameraConstPtr& camera, cameras)
+    {
+        int xStart=0, xEnd=0, yStart=0, yEnd=0;
+        camera->GetPixelSampleExtents(xStart, yStart, xEnd, yEnd);
+        std::vector<RenderingWorkArea> cameraWorkAreas;
+        MakeTiles(xStart, yStart, xEnd, yEnd, settings.tileSize, settings.tileOrder, cameraWorkAreas);
+        workAreas.insert(workAreas.end(), cameraWorkAreas.begin(), cameraWorkAreas.end());
+        workAreaCameras.insert(workAreaCameras.end(), cameraWorkAreas.size(), camera.get());
+    }
+    stats.Counter("Batch Rendering", "Cameras").Add(static_cast<uint32>(cameras.size()));
+
+    // Each pass takes all the samples of every pixel, and the jobs of all cameras are spawned at once
+    uint32 numIntegratorPasses = surfaceIntegrator->PassCount();
+    for (uint32 pass = 0; pass < numIntegratorPasses; ++pass)
+    {
+        surfaceIntegrator->PrePass(*scene, jobScheduler, pass);
+        JobList jobs;
+        jobs.reserve(workAreas.size());
+        for (size_t i = 0; i < workAreas.size(); ++i)
+        {
+            const ICamera* camera = workAreaCameras[i];
+            RenderingPass renderingPass = {0, 0, camera->SamplesPerPixel(), 0.0f};
+            JobConstPtr job(new RenderingJob(seedRng.RandomBits(), workAreas[i], 0, camera, scene.get(), surfaceIntegrator.get(), renderingPass));
+            jobs.push_back(job);
+        }
+        jobScheduler.Spawn(jobs);
+        jobScheduler.WaitForAllJobs();
+        stats.Counter("Batch Rendering", "Work areas").Add(static_cast<uint32>(jobs.size()));
+    }
+
+    stats.Timer("Rendering", "Rendering time").Stop();
+}
+
+void BatchRenderer::PrePass()
+{
+    JobList jobs;
+    foreach (const CameraConstPtr& camera, cameras)
+    {
+        MakePrePassJobs(camera.get(), scene.get(), surfaceIntegrator.get(), settings.tileSize, settings.tileOrder, seedRng, jobs);
+    }
+    jobScheduler.Spawn(jobs);
+    jobScheduler.WaitForAllJobs();
+}
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_BATCH_RENDERER_H
+#define RENDERBLISS_BATCH_RENDERER_H
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Interfaces/IRenderer.h"
+#include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Rendering/TileOrder.h"
+
+namespace renderbliss
+{
+class JobScheduler;
+class PropertyMap;
+class StatsTracker;
+class SurfaceIntegrator;
+typedef boost::shared_ptr<SurfaceIntegrator> SurfaceIntegratorPtr;
+
+// Renders the images of several cameras of one scene with one integrator, each into the film of its camera.
+// The integrator is preprocessed once for all cameras, and the work areas of all cameras are scheduled
+// in a single pool of jobs per integrator pass, camera after camera, so that threads done with
+// the work areas of an image carry on with the next image instead of waiting for the last ones.
+class BatchRenderer : boost::noncopyable
+{
+public:
+
+    BatchRenderer(const PropertyMap& props, const std::vector<CameraConstPtr>& cameras,
+                  const SceneConstPtr& scene, const SurfaceIntegratorPtr& surfaceIntegrator,
+                  JobScheduler& jobScheduler, StatsTracker& stats);
+    void Render();
+
+private:
+
+    struct Settings
+    {
+        uint32 tileSize;           // Side length of the square work areas, in pixels
+        TileOrder::Enum tileOrder; // Order in which the work areas of each camera are scheduled
+        Settings(const PropertyMap& props);
+    } settings;
+    std::vector<CameraConstPtr> cameras;
+    SceneConstPtr scene;
+    SurfaceIntegratorPtr surfaceIntegrator;
+    MersenneTwister seedRng;
+    mutable JobScheduler& jobScheduler;
+    mutable StatsTracker& stats;
+
+    // Runs the sparse pre-pass of the integrator, if any, through the pixels of every camera
+    void PrePass();
+};
+}
+
+#endif
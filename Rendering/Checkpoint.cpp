@@ -0,0 +1,206 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Rendering/Checkpoint.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <log++/Log++.h>
+#include "renderbliss/Macros.h"
+
+namespace
+{
+    using namespace renderbliss;
+
+    const char checkpointTag[4] = {'R', 'B', 'C', 'P'};
+    const uint32 checkpointVersion = 1;
+
+    void WriteUint32(std::ostream& os, uint32 value)
+    {
+        os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    bool ReadUint32(std::istream& is, uint32& value)
+    {
+        return !is.read(reinterpret_cast<char*>(&value), sizeof(value)).fail();
+    }
+
+    // Reads a buffer preceded by its size, refusing sizes larger than the rest of the stream
+    template <typename Buffer>
+    bool ReadBuffer(std::istream& is, std::streamoff endOffset, Buffer& buffer)
+    {
+        uint32 size = 0;
+        if (!ReadUint32(is, size) || (size > endOffset - static_cast<std::streamoff>(is.tellg())))
+        {
+            return false;
+        }
+        buffer.resize(size);
+        return !size || !is.read(reinterpret_cast<char*>(&buffer[0]), size).fail();
+    }
+
+    template <typename Buffer>
+    void WriteBuffer(std::ostream& os, const Buffer& buffer)
+    {
+        WriteUint32(os, static_cast<uint32>(buffer.size()));
+        if (!buffer.empty())
+        {
+            os.write(reinterpret_cast<const char*>(&buffer[0]), buffer.size());
+        }
+    }
+}
+
+namespace renderbliss
+{
+RenderCheckpoint::RenderCheckpoint()
+    : xResolution(0), yResolution(0), samplesPerPixel(0), samplePasses(0), completedPasses(0), pixelSeed(0)
+{
+}
+
+void RenderCheckpoint::Swap(RenderCheckpoint& other)
+{
+    std::swap(xResolution, other.xResolution);
+    std::swap(yResolution, other.yResolution);
+    std::swap(samplesPerPixel, other.samplesPerPixel);
+    std::swap(samplePasses, other.samplePasses);
+    std::swap(completedPasses, other.completedPasses);
+    std::swap(pixelSeed, other.pixelSeed);
+    rngState.swap(other.rngState);
+    filmState.swap(other.filmState);
+}
+
+bool SaveCheckpoint(const std::string& fileName, const RenderCheckpoint& checkpoint)
+{
+    // A crash while writing must not destroy the previous checkpoint, so it is only replaced at the end
+    std::string tempFileName = fileName + ".tmp";
+    {
+        std::ofstream os(tempFileName.c_str(), std::ios::binary | std::ios::trunc);
+        os.write(checkpointTag, sizeof(checkpointTag));
+        WriteUint32(os, checkpointVersion);
+        WriteUint32(os, checkpoint.xResolution);
+        WriteUint32(os, checkpoint.yResolution);
+        WriteUint32(os, checkpoint.samplesPerPixel);
+        WriteUint32(os, checkpoint.samplePasses);
+        WriteUint32(os, checkpoint.completedPasses);
+        WriteUint32(os, checkpoint.pixelSeed);
+        WriteBuffer(os, checkpoint.rngState);
+        WriteBuffer(os, checkpoint.filmState);
+        os.flush();
+        if (os.fail())
+        {
+            GLOG_ERROR << "Error occurred while saving checkpoint " << tempFileName << ".";
+            return false;
+        }
+    }
+
+    std::remove(fileName.c_str());
+    if (std::rename(tempFileName.c_str(), fileName.c_str()))
+    {
+        GLOG_ERROR << "Error occurred while saving checkpoint " << fileName << ": failed to rename " << tempFileName << ".";
+        return false;
+    }
+    return true;
+}
+
+bool LoadCheckpoint(const std::string& fileName, RenderCheckpoint& checkpoint)
+{
+    std::ifstream is(fileName.c_str(), std::ios::binary);
+    if (!is)
+    {
+        GLOG_ERROR << "Error occurred while loading checkpoint " << fileName << ": failed to open file.";
+        return false;
+    }
+    is.seekg(0, std::ios::end);
+    std::streamoff endOffset = is.tellg();
+    is.seekg(0, std::ios::beg);
+
+    char tag[4] = {0};
+    uint32 version = 0;
+    if (is.read(tag, sizeof(tag)).fail() || !std::equal(tag, tag+4, checkpointTag) ||
+        !ReadUint32(is, version) || (version != checkpointVersion))
+    {
+        GLOG_ERROR << "Error occurred while loading checkpoint " << fileName << ": not a checkpoint of this version.";
+        return false;
+    }
+
+    RenderCheckpoint result;
+    if (!ReadUint32(is, result.xResolution) || !ReadUint32(is, result.yResolution) ||
+        !ReadUint32(is, result.samplesPerPixel) || !ReadUint32(is, result.samplePasses) ||
+        !ReadUint32(is, result.completedPasses) ||
+        !ReadUint32(is, result.pixelSeed) ||
+        !ReadBuffer(is, endOffset, result.rngState) || !ReadBuffer(is, endOffset, result.filmState))
+    {
+        GLOG_ERROR << "Error occurred while loading checkpoint " << fileName << ": file is truncated.";
+        return false;
+    }
+
+    checkpoint.Swap(result);
+    return true;
+}
+
+CheckpointWriter::CheckpointWriter(const std::string& fileName)
+    : fileName(fileName), done(false), thread(&CheckpointWriter::SaveQueuedCheckpoints, this)
+{
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        done = true;
+    }
+    checkpointQueued.notify_one();
+    thread.join();
+}
+
+void CheckpointWriter::Write(RenderCheckpoint& checkpoint)
+{
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        if (!queuedCheckpoint)
+        {
+            queuedCheckpoint.reset(new RenderCheckpoint);
+        }
+        queuedCheckpoint->Swap(checkpoint);
+    }
+    checkpointQueued.notify_one();
+}
+
+void CheckpointWriter::SaveQueuedCheckpoints()
+{
+    boost::scoped_ptr<RenderCheckpoint> checkpoint;
+    for (;;)
+    {
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            while (!queuedCheckpoint && !done)
+            {
+                checkpointQueued.wait(lock);
+            }
+            if (!queuedCheckpoint)
+            {
+                return;
+            }
+            checkpoint.swap(queuedCheckpoint);
+            queuedCheckpoint.reset();
+        }
+        SaveCheckpoint(fileName, *checkpoint);
+    }
+}
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_CHECKPOINT_H
+#define RENDERBLISS_CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include "renderbliss/Types.h"
+
+namespace renderbliss
+{
+// State of a rendering after a number of passes, from which it can be resumed
+struct RenderCheckpoint
+{
+    uint32 xResolution;     // Resolution of the film
+    uint32 yResolution;
+    uint32 samplesPerPixel; // Samples per pixel of the camera
+    uint32 samplePasses;    // Number of passes splitting the samples of each pixel
+    uint32 completedPasses; // Number of passes whose samples are held by the film state
+    uint32 pixelSeed;       // Seed of the camera samples of the integrator pass in progress
+    std::string rngState;   // State of the generator seeding the rendering jobs
+    std::vector<byte> filmState;
+    RenderCheckpoint();
+    void Swap(RenderCheckpoint& other); // Swaps the buffers instead of copying them
+};
+
+// Each of the below functions returns true for success, and false for failure.
+// The file is written in the byte order of the machine, and replaced only once fully written.
+
+bool SaveCheckpoint(const std::string& fileName, const RenderCheckpoint& checkpoint);
+bool LoadCheckpoint(const std::string& fileName, RenderCheckpoint& checkpoint);
+
+// Saves checkpoints on a background thread, so that rendering does not wait for the disk.
+// If checkpoints are written faster than they are saved, only the latest one is saved.
+class CheckpointWriter : boost::noncopyable
+{
+public:
+
+    CheckpointWriter(const std::string& fileName);
+    // Waits for the latest checkpoint to be saved
+    ~CheckpointWriter();
+
+    // Queues a checkpoint for saving. Its content is swapped out, to avoid copying the film state.
+    void Write(RenderCheckpoint& checkpoint);
+
+private:
+
+    std::string fileName;
+    boost::mutex mutex;
+    boost::condition_variable checkpointQueued;
+    boost::scoped_ptr<RenderCheckpoint> queuedCheckpoint;
+    bool done;
+    boost::thread thread;
+
+    void SaveQueuedCheckpoints();
+};
+}
+
+#endif
@@ -0,0 +1,335 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Rendering/RenderProtocol.h"
+#include <algorithm>
+#include <cstring>
+#include <boost/lexical_cast.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_service.hpp>
+#include <log++/Log++.h>
+#include "renderbliss/Macros.h"
+#include "renderbliss/Rendering/TileProtocol.h"
+#include "renderbliss/Utils/PropertyMap.h"
+
+namespace
+{
+    using namespace renderbliss;
+
+    // Longer strings and larger maps are taken for a corrupted payload
+    const uint32 maxStringLength = 1u << 16;
+    const uint32 maxSettingCount = 1u << 10;
+
+    template <typename T>
+    void Put(std::vector<byte>& payload, const T& value)
+    {
+        size_t offset = payload.size();
+        payload.resize(offset + sizeof(value));
+        memcpy(&payload[offset], &value, sizeof(value));
+    }
+
+    template <typename T>
+    bool Get(const std::vector<byte>& payload, size_t& offset, T& value)
+    {
+        if (offset + sizeof(value) > payload.size())
+        {
+            return false;
+        }
+        memcpy(&value, &payload[offset], sizeof(value));
+        offset += sizeof(value);
+        return true;
+    }
+
+    void PutString(std::vector<byte>& payload, const std::string& s)
+    {
+        Put(payload, static_cast<uint32>(s.size()));
+        payload.insert(payload.end(), s.begin(), s.end());
+    }
+
+    bool GetString(const std::vector<byte>& payload, size_t& offset, std::string& s)
+    {
+        uint32 length = 0;
+        if (!Get(payload, offset, length) || (length > maxStringLength) || (offset + length > payload.size()))
+        {
+            return false;
+        }
+        s.assign(payload.begin() + offset, payload.begin() + offset + length);
+        offset += length;
+        return true;
+    }
+
+    void PutVector(std::vector<byte>& payload, const Vector3& v)
+    {
+        Put(payload, v.x);
+        Put(payload, v.y);
+        Put(payload, v.z);
+    }
+
+    bool GetVector(const std::vector<byte>& payload, size_t& offset, Vector3& v)
+    {
+        return Get(payload, offset, v.x) && Get(payload, offset, v.y) && Get(payload, offset, v.z);
+    }
+
+    template <typename T>
+    void PutMap(std::vector<byte>& payload, const std::map<std::string, T>& values)
+    {
+        Put(payload, static_cast<uint32>(values.size()));
+        for (typename std::map<std::string, T>::const_iterator i = values.begin(); i != values.end(); ++i)
+        {
+            PutString(payload, i->first);
+            Put(payload, i->second);
+        }
+    }
+
+    template <typename T>
+    bool GetMap(const std::vector<byte>& payload, size_t& offset, std::map<std::string, T>& values)
+    {
+        uint32 count = 0;
+        if (!Get(payload, offset, count) || (count > maxSettingCount))
+        {
+            return false;
+        }
+        values.clear();
+        for (uint32 i = 0; i < count; ++i)
+        {
+            std::string name;
+            T value;
+            if (!GetString(payload, offset, name) || !Get(payload, offset, value))
+            {
+                return false;
+            }
+            values[name] = value;
+        }
+        return true;
+    }
+
+    void PutStringMap(std::vector<byte>& payload, const std::map<std::string, std::string>& values)
+    {
+        Put(payload, static_cast<uint32>(values.size()));
+        for (std::map<std::string, std::string>::const_iterator i = values.begin(); i != values.end(); ++i)
+        {
+            PutString(payload, i->first);
+            PutString(payload, i->second);
+        }
+    }
+
+    bool GetStringMap(const std::vector<byte>& payload, size_t& offset, std::map<std::string, std::string>& values)
+    {
+        uint32 count = 0;
+        if (!Get(payload, offset, count) || (count > maxSettingCount))
+        {
+            return false;
+        }
+        values.clear();
+        for (uint32 i = 0; i < count; ++i)
+        {
+            std::string name, value;
+            if (!GetString(payload, offset, name) || !GetString(payload, offset, value))
+            {
+                return false;
+            }
+            values[name] = value;
+        }
+        return true;
+    }
+
+    bool GetSettings(const std::vector<byte>& payload, size_t& offset, RenderSettings& settings)
+    {
+        return GetMap(payload, offset, settings.uints) && GetMap(payload, offset, settings.reals) &&
+               GetStringMap(payload, offset, settings.strings);
+    }
+}
+
+namespace renderbliss
+{
+void RenderSettings::Apply(PropertyMap& props) const
+{
+    for (std::map<std::string, uint32>::const_iterator i = uints.begin(); i != uints.end(); ++i)
+    {
+        props.Set<uint32>(i->first, i->second);
+    }
+    for (std::map<std::string, real>::const_iterator i = reals.begin(); i != reals.end(); ++i)
+    {
+        props.Set<real>(i->first, i->second);
+    }
+    for (std::map<std::string, std::string>::const_iterator i = strings.begin(); i != strings.end(); ++i)
+    {
+        props.Set<std::string>(i->first, i->second);
+    }
+}
+
+RenderRequest::RenderRequest()
+    : eye(0.0f, 0.0f, 0.0f), lookAt(0.0f, 0.0f, 1.0f), up(0.0f, 1.0f, 0.0f), horizontalFieldOfView(45.0f),
+      focusDistance(1.0f), aperture(0.0f), xResolution(0), yResolution(0), pixelSamplerWidth(1)
+{
+}
+
+void EncodeRenderSettings(const RenderSettings& settings, std::vector<byte>& payload)
+{
+    PutMap(payload, settings.uints);
+    PutMap(payload, settings.reals);
+    PutStringMap(payload, settings.strings);
+}
+
+void EncodeRenderRequest(const RenderRequest& request, std::vector<byte>& payload)
+{
+    payload.clear();
+    PutVector(payload, request.eye);
+    PutVector(payload, request.lookAt);
+    PutVector(payload, request.up);
+    Put(payload, request.horizontalFieldOfView);
+    Put(payload, request.focusDistance);
+    Put(payload, request.aperture);
+    Put(payload, request.xResolution);
+    Put(payload, request.yResolution);
+    Put(payload, request.pixelSamplerWidth);
+    PutString(payload, request.integrator);
+    EncodeRenderSettings(request.rendererSettings, payload);
+    EncodeRenderSettings(request.integratorSettings, payload);
+}
+
+bool DecodeRenderRequest(const std::vector<byte>& payload, RenderRequest& request)
+{
+    size_t offset = 0;
+    RenderRequest result;
+    if (!GetVector(payload, offset, result.eye) || !GetVector(payload, offset, result.lookAt) ||
+        !GetVector(payload, offset, result.up) || !Get(payload, offset, result.horizontalFieldOfView) ||
+        !Get(payload, offset, result.focusDistance) || !Get(payload, offset, result.aperture) ||
+        !Get(payload, offset, result.xResolution) || !Get(payload, offset, result.yResolution) ||
+        !Get(payload, offset, result.pixelSamplerWidth) || !GetString(payload, offset, result.integrator) ||
+        !GetSettings(payload, offset, result.rendererSettings) || !GetSettings(payload, offset, result.integratorSettings) ||
+        (offset != payload.size()))
+    {
+        return false;
+    }
+    request = result;
+    return true;
+}
+
+void EncodeImageTile(const ImageTile& tile, std::vector<byte>& payload)
+{
+    payload.clear();
+    payload.reserve(4*sizeof(uint32) + 4*sizeof(float)*tile.pixels.size());
+    Put(payload, tile.x);
+    Put(payload, tile.y);
+    Put(payload, tile.width);
+    Put(payload, tile.height);
+    foreach (const RGBPixel& p, tile.pixels)
+    {
+        Put(payload, p.colour.r);
+        Put(payload, p.colour.g);
+        Put(payload, p.colour.b);
+        Put(payload, p.opacity);
+    }
+}
+
+bool DecodeImageTile(const std::vector<byte>& payload, ImageTile& tile)
+{
+    size_t offset = 0;
+    ImageTile result;
+    if (!Get(payload, offset, result.x) || !Get(payload, offset, result.y) ||
+        !Get(payload, offset, result.width) || !Get(payload, offset, result.height) ||
+        (payload.size() - offset != 4*sizeof(float)*static_cast<size_t>(result.width)*result.height))
+    {
+        return false;
+    }
+    result.pixels.resize(result.width*result.height);
+    foreach (RGBPixel& p, result.pixels)
+    {
+        Get(payload, offset, p.colour.r);
+        Get(payload, offset, p.colour.g);
+        Get(payload, offset, p.colour.b);
+        Get(payload, offset, p.opacity);
+    }
+    tile.x = result.x;
+    tile.y = result.y;
+    tile.width = result.width;
+    tile.height = result.height;
+    tile.pixels.swap(result.pixels);
+    return true;
+}
+
+bool WriteRenderMessage(boost::asio::ip::tcp::socket& socket, RenderMessage::Enum type, const std::vector<byte>& payload)
+{
+    return WriteMessage(socket, static_cast<uint32>(type), payload);
+}
+
+bool ReadRenderMessage(boost::asio::ip::tcp::socket& socket, RenderMessage::Enum& type, std::vector<byte>& payload)
+{
+    uint32 messageType = 0;
+    if (!ReadMessage(socket, RenderMessage::Invalid, messageType, payload))
+    {
+        return false;
+    }
+    type = static_cast<RenderMessage::Enum>(messageType);
+    return true;
+}
+
+bool RequestRender(const std::string& host, uint32 port, const RenderRequest& request, RGBPixelList& pixels,
+                   const ImageTileCallback& tileCallback)
+{
+    boost::asio::io_service ioService;
+    boost::asio::ip::tcp::resolver resolver(ioService);
+    boost::asio::ip::tcp::resolver::query query(host, boost::lexical_cast<std::string>(port));
+    boost::asio::ip::tcp::socket socket(ioService);
+    boost::system::error_code error;
+    boost::asio::connect(socket, resolver.resolve(query, error), error);
+    if (error)
+    {
+        GLOG_ERROR << "Failed to connect to the render server " << host << ":" << port << ": " << error.message();
+        return false;
+    }
+
+    std::vector<byte> payload;
+    EncodeRenderRequest(request, payload);
+    if (!WriteRenderMessage(socket, RenderMessage::Request, payload))
+    {
+        return false;
+    }
+
+    pixels.assign(request.xResolution*request.yResolution, RGBPixel(RGB::black, 0.0f));
+    RenderMessage::Enum type = RenderMessage::Invalid;
+    while (ReadRenderMessage(socket, type, payload))
+    {
+        if (type == RenderMessage::Done)
+        {
+            return (payload.size() == 1) && payload[0];
+        }
+        ImageTile tile;
+        if ((type != RenderMessage::Tile) || !DecodeImageTile(payload, tile) ||
+            (tile.x + tile.width > request.xResolution) || (tile.y + tile.height > request.yResolution))
+        {
+            GLOG_ERROR << "Received an invalid tile from the render server.";
+            return false;
+        }
+        for (uint32 j = 0; j < tile.height; ++j)
+        {
+            std::copy(tile.pixels.begin() + j*tile.width, tile.pixels.begin() + (j+1)*tile.width,
+                      pixels.begin() + (tile.y+j)*request.xResolution + tile.x);
+        }
+        if (tileCallback)
+        {
+            tileCallback(tile);
+        }
+    }
+    GLOG_ERROR << "Lost the connection to the render server.";
+    return false;
+}
+}
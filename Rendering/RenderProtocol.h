@@ -0,0 +1,102 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_RENDER_PROTOCOL_H
+#define RENDERBLISS_RENDER_PROTOCOL_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/ImageIO/TileImageWriter.h"
+#include "renderbliss/Math/Geometry/Vector3.h"
+
+namespace renderbliss
+{
+class PropertyMap;
+
+// Messages exchanged by a render server and its clients.
+// A client sends a request, then receives the tiles of the image as they are rendered,
+// followed by Done, after which it may send another request on the same connection.
+struct RenderMessage : NonConstructible
+{
+    enum Enum
+    {
+        Request,
+        Tile,
+        Done,
+        Invalid
+    };
+};
+
+// Typed settings, set in the property maps of the renderer or the integrator
+struct RenderSettings
+{
+    std::map<std::string, uint32> uints;
+    std::map<std::string, real> reals;
+    std::map<std::string, std::string> strings;
+    void Apply(PropertyMap& props) const;
+};
+
+// A camera to render with a thin lens model, and how to render it
+struct RenderRequest
+{
+    Vector3 eye;                    // Position of the camera
+    Vector3 lookAt;                 // A point the camera is looking at
+    Vector3 up;                     // View up vector
+    real horizontalFieldOfView;     // In degrees
+    real focusDistance;
+    real aperture;
+    uint32 xResolution;
+    uint32 yResolution;
+    uint32 pixelSamplerWidth;       // Square root of the number of samples per pixel
+    std::string integrator;         // Name of the surface integrator
+    RenderSettings rendererSettings;
+    RenderSettings integratorSettings;
+    RenderRequest();
+};
+
+// Payloads are written in the byte order of the machine, as for tile messages.
+// Decoding returns false if a payload is malformed.
+// Tiles hold the linear colours of film pixels, and Done holds whether rendering succeeded.
+
+void EncodeRenderRequest(const RenderRequest& request, std::vector<byte>& payload);
+bool DecodeRenderRequest(const std::vector<byte>& payload, RenderRequest& request);
+void EncodeRenderSettings(const RenderSettings& settings, std::vector<byte>& payload); // Appends to the payload
+void EncodeImageTile(const ImageTile& tile, std::vector<byte>& payload);
+bool DecodeImageTile(const std::vector<byte>& payload, ImageTile& tile);
+
+// Each of the below functions returns true for success, and false if the connection failed
+
+bool WriteRenderMessage(boost::asio::ip::tcp::socket& socket, RenderMessage::Enum type, const std::vector<byte>& payload);
+bool ReadRenderMessage(boost::asio::ip::tcp::socket& socket, RenderMessage::Enum& type, std::vector<byte>& payload);
+
+// Called with each tile of an image as it is received from a render server
+typedef boost::function<void (const ImageTile& tile)> ImageTileCallback;
+
+// Sends a request to a render server, and assembles the linear image from the tiles it streams back.
+// Returns false if the connection failed or the server could not render the request.
+bool RequestRender(const std::string& host, uint32 port, const RenderRequest& request, RGBPixelList& pixels,
+                   const ImageTileCallback& tileCallback = ImageTileCallback());
+}
+
+#endif
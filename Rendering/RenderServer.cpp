@@ -0,0 +1,217 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Rendering/RenderServer.h"
+#include <boost/bind.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/thread/thread.hpp>
+#include <log++/Log++.h>
+#include "renderbliss/Macros.h"
+#include "renderbliss/Camera/ThinLensCamera.h"
+#include "renderbliss/Camera/Film/ImageFilm.h"
+#include "renderbliss/Integrators/DirectIlluminationIntegrator.h"
+#include "renderbliss/Integrators/PathIntegrator.h"
+#include "renderbliss/Integrators/PhotonIntegrator.h"
+#include "renderbliss/Integrators/ProgressivePhotonIntegrator.h"
+#include "renderbliss/Integrators/WhittedIntegrator.h"
+#include "renderbliss/Interfaces/IToneMapper.h"
+#include "renderbliss/Rendering/Renderer.h"
+#include "renderbliss/Utils/StatsTracker.h"
+
+namespace
+{
+    using namespace renderbliss;
+
+    // Larger images are taken for a mistaken request
+    const uint32 maxResolution = 1u << 14;
+    const uint32 maxPixelSamplerWidth = 64;
+
+    SurfaceIntegratorPtr CreateIntegrator(const std::string& name, const PropertyMap& props, StatsTracker& stats)
+    {
+        if (name == "whitted")
+        {
+            return SurfaceIntegratorPtr(new WhittedIntegrator(props, stats));
+        }
+        if (name == "direct")
+        {
+            return SurfaceIntegratorPtr(new DirectIlluminationIntegrator(props, stats));
+        }
+        if (name == "path")
+        {
+            return SurfaceIntegratorPtr(new PathIntegrator(props, stats));
+        }
+        if (name == "photon")
+        {
+            return SurfaceIntegratorPtr(new PhotonIntegrator(props, stats));
+        }
+        if (name == "progressive_photon")
+        {
+            return SurfaceIntegratorPtr(new ProgressivePhotonIntegrator(props, stats));
+        }
+        return SurfaceIntegratorPtr();
+    }
+}
+
+namespace renderbliss
+{
+RenderServer::Settings::Settings(const PropertyMap& props)
+{
+    props.Get<std::string>("server_address", "127.0.0.1", address);
+    props.Get<uint32>("server_port", 7374, port);
+}
+
+RenderServer::RenderServer(const PropertyMap& props, const SceneConstPtr& scene, const boost::shared_ptr<IFilter>& filter,
+                           JobScheduler& jobScheduler, StatsTracker& stats)
+    : settings(props), props(props), scene(scene), filter(filter), stopped(false), jobScheduler(jobScheduler), stats(stats)
+{
+    RB_ASSERT(this->scene.get());
+    stats.AddCounter("Render Server", "Clients");
+    stats.AddCounter("Render Server", "Rendered requests");
+    stats.AddCounter("Render Server", "Integrator preprocessings");
+}
+
+void RenderServer::Serve()
+{
+    boost::asio::io_service ioService;
+    boost::asio::ip::tcp::acceptor acceptor(ioService);
+    boost::system::error_code error;
+    boost::asio::ip::address address = boost::asio::ip::address::from_string(settings.address, error);
+    boost::asio::ip::tcp::endpoint endpoint(address, static_cast<unsigned short>(settings.port));
+    if (!error) acceptor.open(endpoint.protocol(), error);
+    if (!error) acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true), error);
+    if (!error) acceptor.bind(endpoint, error);
+    if (!error) acceptor.listen(boost::asio::socket_base::max_connections, error);
+    if (!error) acceptor.non_blocking(true, error);
+    if (error)
+    {
+        GLOG_ERROR << "Failed to listen for clients on " << settings.address << ":" << settings.port << ": " << error.message();
+        return;
+    }
+    GLOG_INFO << "Serving render requests on " << settings.address << ":" << settings.port;
+
+    while (!stopped)
+    {
+        boost::asio::ip::tcp::socket socket(ioService);
+        acceptor.accept(socket, error);
+        if (error)
+        {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+            continue;
+        }
+        ++stats.Counter("Render Server", "Clients");
+        socket.non_blocking(false, error);
+        ServeClient(socket);
+    }
+    acceptor.close();
+}
+
+void RenderServer::Stop()
+{
+    stopped = true;
+}
+
+void RenderServer::ServeClient(boost::asio::ip::tcp::socket& socket)
+{
+    std::vector<byte> payload;
+    RenderMessage::Enum type = RenderMessage::Invalid;
+    while (ReadRenderMessage(socket, type, payload) && (type == RenderMessage::Request))
+    {
+        RenderRequest request;
+        bool succeeded = DecodeRenderRequest(payload, request) && Render(request, socket);
+        if (!succeeded)
+        {
+            GLOG_ERROR << "Failed to render a request.";
+        }
+        payload.assign(1, succeeded ? 1 : 0);
+        if (!WriteRenderMessage(socket, RenderMessage::Done, payload))
+        {
+            break;
+        }
+    }
+}
+
+bool RenderServer::Render(const RenderRequest& request, boost::asio::ip::tcp::socket& socket)
+{
+    if (!request.xResolution || !request.yResolution || (request.xResolution > maxResolution) ||
+        (request.yResolution > maxResolution) || !request.pixelSamplerWidth || (request.pixelSamplerWidth > maxPixelSamplerWidth))
+    {
+        return false;
+    }
+    bool preProcessed = false;
+    SurfaceIntegratorPtr integrator = Integrator(request, preProcessed);
+    if (!integrator)
+    {
+        GLOG_ERROR << "Unknown integrator " << request.integrator;
+        return false;
+    }
+
+    // The film is not tone mapped, as tiles are streamed with their linear colours
+    boost::shared_ptr<IFilm> film(new ImageFilm(request.xResolution, request.yResolution, filter, boost::shared_ptr<IToneMapper>()));
+    CameraConstPtr camera(new ThinLensCamera(film, request.pixelSamplerWidth, request.eye, request.lookAt, request.up,
+                                             request.horizontalFieldOfView, request.focusDistance, request.aperture));
+    PropertyMap rendererProps(props);
+    request.rendererSettings.Apply(rendererProps);
+    rendererProps.Set<bool>("preprocess", !preProcessed);
+    Renderer renderer(rendererProps, camera, scene, integrator, jobScheduler, stats);
+    renderer.SetTileCallback(boost::bind(&RenderServer::SendTile, this, film.get(), &socket, _1));
+    renderer.Render();
+    ++stats.Counter("Render Server", "Rendered requests");
+    return true;
+}
+
+SurfaceIntegratorPtr RenderServer::Integrator(const RenderRequest& request, bool& preProcessed)
+{
+    std::vector<byte> settingsKey;
+    EncodeRenderSettings(request.integratorSettings, settingsKey);
+    CachedIntegrator& cached = integrators[request.integrator];
+    preProcessed = cached.integrator && (cached.settingsKey == settingsKey);
+    if (!preProcessed)
+    {
+        PropertyMap integratorProps(props);
+        request.integratorSettings.Apply(integratorProps);
+        cached.integrator = CreateIntegrator(request.integrator, integratorProps, stats);
+        cached.settingsKey.swap(settingsKey);
+        if (!cached.integrator)
+        {
+            integrators.erase(request.integrator);
+            return SurfaceIntegratorPtr();
+        }
+        ++stats.Counter("Render Server", "Integrator preprocessings");
+    }
+    return cached.integrator;
+}
+
+void RenderServer::SendTile(const IFilm* film, boost::asio::ip::tcp::socket* socket, const RenderingWorkArea& region)
+{
+    ImageTile tile;
+    tile.x = static_cast<uint32>(region.xStart);
+    tile.y = static_cast<uint32>(region.yStart);
+    tile.width = static_cast<uint32>(region.xEnd - region.xStart + 1);
+    tile.height = static_cast<uint32>(region.yEnd - region.yStart + 1);
+    film->StoreRegion(region, tile.pixels);
+    std::vector<byte> payload;
+    EncodeImageTile(tile, payload);
+
+    // Tiles are completed by the rendering threads, which take turns to write them.
+    // A client that disconnected is noticed when the next request is read.
+    boost::mutex::scoped_lock lock(socketMutex);
+    WriteRenderMessage(*socket, RenderMessage::Tile, payload);
+}
+}
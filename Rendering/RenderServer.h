@@ -0,0 +1,105 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_RENDER_SERVER_H
+#define RENDERBLISS_RENDER_SERVER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/thread/mutex.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Colour/Pixel.h"
+#include "renderbliss/Interfaces/IRenderer.h"
+#include "renderbliss/Interfaces/IRenderingJob.h"
+#include "renderbliss/Rendering/RenderProtocol.h"
+#include "renderbliss/Utils/PropertyMap.h"
+
+namespace renderbliss
+{
+class IFilm;
+class IFilter;
+class JobScheduler;
+class StatsTracker;
+class SurfaceIntegrator;
+typedef boost::shared_ptr<SurfaceIntegrator> SurfaceIntegratorPtr;
+
+// Renders the requests of clients connecting to a local port, keeping the preprocessed scene and integrators
+// in memory between requests, so that repeat renders only pay for tracing.
+// An integrator is only preprocessed again when requested with other settings than the last time.
+// Clients are served one at a time, and their requests rendered with all the threads of the job scheduler.
+class RenderServer : boost::noncopyable
+{
+public:
+
+    // The scene must already be preprocessed. Requests are rendered with the given properties,
+    // overridden by the settings of each request.
+    RenderServer(const PropertyMap& props, const SceneConstPtr& scene, const boost::shared_ptr<IFilter>& filter,
+                 JobScheduler& jobScheduler, StatsTracker& stats);
+
+    // Serves clients until stopped
+    void Serve();
+
+    // Makes Serve return once the client being served disconnects. Can be called from any thread.
+    void Stop();
+
+private:
+
+    struct Settings
+    {
+        std::string address; // Address on which clients connect, the loopback address by default
+        uint32 port;         // TCP port on which clients connect
+        Settings(const PropertyMap& props);
+    } settings;
+
+    // An integrator, and the settings it was created and preprocessed with
+    struct CachedIntegrator
+    {
+        std::vector<byte> settingsKey;
+        SurfaceIntegratorPtr integrator;
+    };
+
+    PropertyMap props;
+    SceneConstPtr scene;
+    boost::shared_ptr<IFilter> filter;
+    std::map<std::string, CachedIntegrator> integrators;
+    boost::mutex socketMutex;
+    volatile bool stopped;
+    mutable JobScheduler& jobScheduler;
+    mutable StatsTracker& stats;
+
+    // Renders the requests of a client until it disconnects
+    void ServeClient(boost::asio::ip::tcp::socket& socket);
+
+    // Renders a request, streaming the tiles of the image to the client. Returns false if the request cannot be rendered.
+    bool Render(const RenderRequest& request, boost::asio::ip::tcp::socket& socket);
+
+    // Returns the integrator of a request, and whether it was already preprocessed, or null if its name is unknown
+    SurfaceIntegratorPtr Integrator(const RenderRequest& request, bool& preProcessed);
+
+    // Sends the final pixels of a film tile to the client
+    void SendTile(const IFilm* film, boost::asio::ip::tcp::socket* socket, const RenderingWorkArea& region);
+};
+}
+
+#endif
@@ -19,89 +19,84 @@
 // THE SOFTWARE.
 
 #include "renderbliss/Rendering/Renderer.h"
+#include <algorithm>
 #include <cstdlib>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include <log++/Log++.h>
 #include "renderbliss/Macros.h"
 #include "renderbliss/Scene.h"
-#include "renderbliss/Colour/Spectrum.h"
 #include "renderbliss/Interfaces/ICamera.h"
 #include "renderbliss/Interfaces/IFilm.h"
-#include "renderbliss/Interfaces/IRenderingJob.h"
+#include "renderbliss/Interfaces/IFilter.h"
 #include "renderbliss/Integrators/SurfaceIntegrator.h"
 #include "renderbliss/Math/MersenneTwister.h"
-#include "renderbliss/Math/Geometry/Ray.h"
+#include "renderbliss/Rendering/Checkpoint.h"
+#include "renderbliss/Rendering/TileTracker.h"
 #include "renderbliss/Utils/JobScheduler.h"
 #include "renderbliss/Utils/PropertyMap.h"
 #include "renderbliss/Utils/StatsTracker.h"
 
-namespace renderbliss
+namespace
 {
-// Default rendering job class
-class RenderingJob : public IRenderingJob
+using namespace renderbliss;
+
+// Reports the tiles completed by a rendering job once it has run
+class TrackedRenderingJob : public IRenderingJob
 {
 public:
 
-    RenderingJob(uint seed, const RenderingWorkArea& workArea, const ICamera* camera,
-                 const Scene* scene, const SurfaceIntegrator* surfaceIntegrator);
-    virtual void Run() const;
+    TrackedRenderingJob(const JobConstPtr& job, const RenderingWorkArea& workArea, TileTracker& tracker, const TileCallback& callback)
+        : IRenderingJob(workArea), job(job), tracker(tracker), callback(callback)
+    {
+    }
+
+    void Run() const
+    {
+        job->Run();
+        std::vector<RenderingWorkArea> tiles;
+        tracker.Complete(workArea, tiles);
+        foreach (const RenderingWorkArea& tile, tiles)
+        {
+            callback(tile);
+        }
+    }
 
 private:
 
-    mutable MersenneTwister rng;
-    const ICamera* camera;
-    const Scene* scene;
-    const SurfaceIntegrator* surfaceIntegrator;
+    JobConstPtr job;
+    TileTracker& tracker;
+    const TileCallback& callback;
 };
 }
 
 namespace renderbliss
 {
-RenderingJob::RenderingJob(uint seed, const RenderingWorkArea& workArea, const ICamera* camera,
-                           const Scene* scene, const SurfaceIntegrator* surfaceIntegrator)
-    : IRenderingJob(workArea), rng(seed), camera(camera), scene(scene), surfaceIntegrator(surfaceIntegrator)
-{
-    RB_ASSERT(camera);
-    RB_ASSERT(scene);
-    RB_ASSERT(surfaceIntegrator);
-}
-
-void RenderingJob::Run() const
-{
-    Ray ray;
-    CameraSample cs;
-    uint32 nSamplesPerPixel = camera->SamplesPerPixel();
-    for (int y = workArea.yStart; y <= workArea.yEnd; ++y)
-    {
-        for (int x = workArea.xStart; x <= workArea.xEnd; ++x)
-        {
-            camera->GeneratePixelSamples(x, y, rng, cs);
-            for (uint32 iSample = 0; iSample < nSamplesPerPixel; ++iSample)
-            {
-                RB_ASSERT(iSample < cs.imageSamples.size());
-                RB_ASSERT(iSample < cs.lensSamples.size());
-                RB_ASSERT(iSample < cs.timeSamples.size());
-                PixelSample ps = {cs.imageSamples[iSample], cs.lensSamples[iSample], cs.timeSamples[iSample]};
-                camera->GenerateRay(ps, ray);
-                real opacity = 1.0f;
-                FilmSample s = { surfaceIntegrator->Radiance(*scene, ray, rng, opacity).ToXYZ(),
-                                 ps.imageSample,
-                                 1.0f };
-                camera->Film()->AddSample(s);
-            }
-        }
-    }
-}
-
-Renderer::Settings::Settings(const PropertyMap&)
+Renderer::Settings::Settings(const PropertyMap& props)
 {
+    GetTileSettings(props, tileSize, tileOrder);
+    props.Get<uint32>("progressive_passes", 1, numProgressivePasses);
+    props.Get<real>("adaptive_error", 0.0f, adaptiveErrorThreshold);
+    props.Get<uint32>("adaptive_passes", 8, numAdaptivePasses);
+    props.Get<real>("time_budget", 0.0f, timeBudget);
+    props.Get<std::string>("checkpoint_file", "", checkpointFile);
+    props.Get<real>("checkpoint_interval", 600.0f, checkpointInterval);
+    props.Get<bool>("resume", false, resume);
+    props.Get<bool>("preprocess", true, preProcess);
 }
 
 Renderer::Renderer(const PropertyMap& props, const CameraConstPtr& camera,
                    const SceneConstPtr& scene, const SurfaceIntegratorPtr& surfaceIntegrator, JobScheduler& jobScheduler, StatsTracker& stats)
-    : IRenderer(camera, scene), settings(props), surfaceIntegrator(surfaceIntegrator), jobScheduler(jobScheduler), stats(stats)
+    : IRenderer(camera, scene), settings(props), cancelled(false), workAreaSampleTime(0.0),
+      surfaceIntegrator(surfaceIntegrator), jobScheduler(jobScheduler), stats(stats)
 {
     RB_ASSERT(this->camera.get());
     RB_ASSERT(this->scene.get());
     RB_ASSERT(this->surfaceIntegrator.get());
+    stats.AddCounter("Adaptive Sampling", "Adaptive passes");
+    stats.AddCounter("Adaptive Sampling", "Resampled work areas");
+    stats.AddCounter("Time Budget", "Refinement passes");
+    stats.AddCounter("Time Budget", "Skipped passes");
 }
 
 void Renderer::Render()
@@ -111,30 +106,338 @@ void Renderer::Render()
         return;
     }
 
-    srand(std::time(0));
+    seedRng = MersenneTwister(static_cast<uint>(std::time(0)));
+
+    // The budget is split into whole seconds and microseconds, so that long budgets do not overflow a 32-bit count.
+    // A cancellation issued before rendering starts is kept, and skips all the work below.
+    using namespace boost::posix_time;
+    workAreaSampleTime = 0.0;
+    long budgetSeconds = static_cast<long>(settings.timeBudget);
+    long budgetMicroseconds = static_cast<long>((settings.timeBudget-budgetSeconds)*1.0e6);
+    deadline = microsec_clock::universal_time() + seconds(budgetSeconds) + microseconds(budgetMicroseconds);
 
     stats.Timer("Preprocessing", "Preprocessing time").Start();
-    surfaceIntegrator->PreProcess(*scene, jobScheduler);
-    stats.Timer("Preprocessing", "Preprocessing time").Stop();
+    if (settings.preProcess && !Cancelled())
+    {
+        surfaceIntegrator->PreProcess(*scene, jobScheduler);
+    }
 
-    stats.Timer("Rendering", "Rendering time").Start();
-    // Initialize rendering jobs
-    // Each job covers a square work area with a side length of 16 pixels
-    JobList jobs;
     int xStart=0, xEnd=0, yStart=0, yEnd=0;
     camera->GetPixelSampleExtents(xStart, yStart, xEnd, yEnd);
-    for (int y = yStart; y <= yEnd; y += 16)
+
+    // Run the sparse pre-pass of the integrator, if any
+    if (!Cancelled())
     {
-        for (int x = xStart; x <= xEnd; x += 16)
+        JobList jobs;
+        MakePrePassJobs(camera.get(), scene.get(), surfaceIntegrator.get(), settings.tileSize, settings.tileOrder, seedRng, jobs);
+        jobScheduler.Spawn(jobs);
+        jobScheduler.WaitForAllJobs();
+    }
+    stats.Timer("Preprocessing", "Preprocessing time").Stop();
+    if (!cancelled && Cancelled())
+    {
+        GLOG_ERROR << "Preprocessing used up the time budget of " << settings.timeBudget << " seconds, no pass will be rendered.";
+    }
+
+    stats.Timer("Rendering", "Rendering time").Start();
+
+    // The jobs of a pass are run in the order of their work areas
+    std::vector<RenderingWorkArea> workAreas;
+    MakeTiles(xStart, yStart, xEnd, yEnd, settings.tileSize, settings.tileOrder, workAreas);
+
+    // A time budget needs progressive passes to stop with a complete image,
+    // so unless told otherwise, each pass takes one sample per pixel
+    uint32 numSamplesPerPixel = camera->SamplesPerPixel();
+    uint32 numProgressivePasses = settings.numProgressivePasses;
+    if ((settings.timeBudget > 0.0f) && (numProgressivePasses == 1))
+    {
+        numProgressivePasses = numSamplesPerPixel;
+    }
+    uint32 numSamplePasses = std::max(1u, std::min(numProgressivePasses, numSamplesPerPixel));
+    uint32 numIntegratorPasses = surfaceIntegrator->PassCount();
+    uint32 numAdaptivePasses = (settings.adaptiveErrorThreshold > 0.0f) ? settings.numAdaptivePasses : 0;
+    uint32 numPasses = numIntegratorPasses*numSamplePasses + numAdaptivePasses;
+    uint32 pass = 0;
+    bool stopped = false;
+    bool fixedPassCount = !numAdaptivePasses && (settings.timeBudget <= 0.0f);
+    boost::scoped_ptr<TileTracker> tileTracker;
+    RenderingPass renderingPass = {0, 0, numSamplesPerPixel, 0.0f};
+
+    // Integrators do not save their state, so the integrator pass of a resumed rendering is prepared again
+    // if the resumed pass does not start it
+    if (settings.resume && !settings.checkpointFile.empty() && Resume(numSamplePasses, numIntegratorPasses, pass, renderingPass))
+    {
+        if (pass%numSamplePasses)
+        {
+            surfaceIntegrator->PrePass(*scene, jobScheduler, pass/numSamplePasses);
+        }
+    }
+    boost::scoped_ptr<CheckpointWriter> checkpointWriter;
+    if (!settings.checkpointFile.empty())
+    {
+        checkpointWriter.reset(new CheckpointWriter(settings.checkpointFile));
+        lastCheckpointTime = microsec_clock::universal_time();
+    }
+
+    for (; !stopped && (pass < numIntegratorPasses*numSamplePasses); ++pass)
+    {
+        uint32 integratorPass = pass/numSamplePasses;
+        uint32 samplePass = pass%numSamplePasses;
+        renderingPass.firstSample = numSamplesPerPixel*samplePass/numSamplePasses;
+        renderingPass.endSample = numSamplesPerPixel*(samplePass+1)/numSamplePasses;
+        if (!PassFitsBudget(workAreas.size(), renderingPass))
+        {
+            stats.Counter("Time Budget", "Skipped passes").Add(numPasses-pass);
+            stopped = true;
+            break;
+        }
+
+        // The pixel seed is shared by the sample passes of an integrator pass
+        if (!samplePass)
         {
-            RenderingWorkArea workArea = {x, std::min(xEnd, x+15), y, std::min(yEnd, y+15)};
-            JobConstPtr job(new RenderingJob(rand(), workArea, camera.get(), scene.get(), surfaceIntegrator.get()));
-            jobs.push_back(job);
+            surfaceIntegrator->PrePass(*scene, jobScheduler, integratorPass);
+            renderingPass.pixelSeed = seedRng.RandomBits();
         }
+        if (tileCallback && fixedPassCount && (pass+1 == numPasses))
+        {
+            const IFilm& film = *camera->Film();
+            tileTracker.reset(new TileTracker(film.XResolution(), film.YResolution(), settings.tileSize,
+                                              film.Filter().XWidth(), film.Filter().YWidth(), workAreas));
+        }
+        RenderPass(workAreas, renderingPass, tileTracker.get());
+        WriteCheckpoint(checkpointWriter.get(), numSamplePasses, pass+1, renderingPass, false);
+
+        stopped = passCallback && !passCallback(pass+1, numPasses);
     }
+
+    // Adaptive passes add all the samples of a pixel again, only where the film is still too noisy
+    renderingPass.firstSample = 0;
+    renderingPass.endSample = numSamplesPerPixel;
+    renderingPass.errorThreshold = settings.adaptiveErrorThreshold;
+    for (; !stopped && (pass < numPasses); ++pass)
+    {
+        std::vector<RenderingWorkArea> noisyWorkAreas;
+        foreach (const RenderingWorkArea& workArea, workAreas)
+        {
+            if (WorkAreaError(workArea) > settings.adaptiveErrorThreshold)
+            {
+                noisyWorkAreas.push_back(workArea);
+            }
+        }
+        if (noisyWorkAreas.empty())
+        {
+            break;
+        }
+        if (!PassFitsBudget(noisyWorkAreas.size(), renderingPass))
+        {
+            stats.Counter("Time Budget", "Skipped passes").Add(numPasses-pass);
+            stopped = true;
+            break;
+        }
+        RenderPass(noisyWorkAreas, renderingPass);
+        WriteCheckpoint(checkpointWriter.get(), numSamplePasses, pass+1, renderingPass, false);
+        ++stats.Counter("Adaptive Sampling", "Adaptive passes");
+        stats.Counter("Adaptive Sampling", "Resampled work areas").Add(static_cast<uint32>(noisyWorkAreas.size()));
+
+        stopped = passCallback && !passCallback(pass+1, numPasses);
+    }
+
+    // Spend the rest of the time budget adding all the samples of every pixel again,
+    // or only those of the pixels still too noisy if adaptive sampling is enabled
+    while (!stopped && (settings.timeBudget > 0.0f))
+    {
+        std::vector<RenderingWorkArea> refinedWorkAreas;
+        foreach (const RenderingWorkArea& workArea, workAreas)
+        {
+            if ((settings.adaptiveErrorThreshold <= 0.0f) || (WorkAreaError(workArea) > settings.adaptiveErrorThreshold))
+            {
+                refinedWorkAreas.push_back(workArea);
+            }
+        }
+        if (refinedWorkAreas.empty() || !PassFitsBudget(refinedWorkAreas.size(), renderingPass))
+        {
+            break;
+        }
+        RenderPass(refinedWorkAreas, renderingPass);
+        ++stats.Counter("Time Budget", "Refinement passes");
+        ++pass;
+        WriteCheckpoint(checkpointWriter.get(), numSamplePasses, pass, renderingPass, false);
+
+        stopped = passCallback && !passCallback(pass, 0);
+    }
+
+    // The writer waits for the final checkpoint to be saved when destroyed
+    WriteCheckpoint(checkpointWriter.get(), numSamplePasses, pass, renderingPass, true);
+    checkpointWriter.reset();
+    ReportRemainingTiles(tileTracker.get());
+    stats.Timer("Rendering", "Rendering time").Stop();
+}
+
+void Renderer::RenderPass(const std::vector<RenderingWorkArea>& workAreas, const RenderingPass& pass, TileTracker* tileTracker)
+{
     // Schedule and run the jobs
+    JobList jobs;
+    foreach (const RenderingWorkArea& workArea, workAreas)
+    {
+        JobConstPtr job(new RenderingJob(seedRng.RandomBits(), workArea, this, camera.get(), scene.get(), surfaceIntegrator.get(), pass));
+        if (tileTracker)
+        {
+            job.reset(new TrackedRenderingJob(job, workArea, *tileTracker, tileCallback));
+        }
+        jobs.push_back(job);
+    }
+    Timer& passTimer = stats.Timer("Rendering", "Pass time");
+    passTimer.Start();
     jobScheduler.Spawn(jobs);
     jobScheduler.WaitForAllJobs();
-    stats.Timer("Rendering", "Rendering time").Stop();
+    passTimer.Stop();
+
+    // A cancelled pass skips some of its work areas, so it would underestimate their cost
+    if (!Cancelled() && !workAreas.empty())
+    {
+        workAreaSampleTime = passTimer.Elapsed()/(workAreas.size()*(pass.endSample-pass.firstSample));
+    }
+}
+
+void Renderer::ReportRemainingTiles(TileTracker* tileTracker)
+{
+    if (!tileCallback)
+    {
+        return;
+    }
+
+    // Without a tracked pass, every tile is reported now
+    std::vector<RenderingWorkArea> tiles;
+    if (tileTracker)
+    {
+        tileTracker->TakeRemaining(tiles);
+    }
+    else
+    {
+        const IFilm& film = *camera->Film();
+        TileTracker tracker(film.XResolution(), film.YResolution(), settings.tileSize, 0.0f, 0.0f, std::vector<RenderingWorkArea>());
+        tracker.TakeRemaining(tiles);
+    }
+    foreach (const RenderingWorkArea& tile, tiles)
+    {
+        tileCallback(tile);
+    }
+}
+
+bool Renderer::PassFitsBudget(size_t numWorkAreas, const RenderingPass& pass) const
+{
+    if (Cancelled())
+    {
+        return false;
+    }
+    if (settings.timeBudget <= 0.0f)
+    {
+        return true;
+    }
+    // Without a previous pass to estimate its cost from, a pass is always started
+    using namespace boost::posix_time;
+    double remainingTime = (deadline - microsec_clock::universal_time()).total_microseconds()*1.0e-6;
+    return workAreaSampleTime*numWorkAreas*(pass.endSample-pass.firstSample) <= remainingTime;
+}
+
+bool Renderer::Resume(uint32 numSamplePasses, uint32 numIntegratorPasses, uint32& completedPasses, RenderingPass& pass)
+{
+    RenderCheckpoint checkpoint;
+    if (!LoadCheckpoint(settings.checkpointFile, checkpoint))
+    {
+        return false;
+    }
+
+    // The film is restored last, so that a rejected checkpoint leaves it untouched.
+    // A checkpoint saved once the integrator passes were done is not resumed, since only those passes are resumable.
+    MersenneTwister rng;
+    if ((checkpoint.samplesPerPixel != camera->SamplesPerPixel()) || (checkpoint.samplePasses != numSamplePasses) ||
+        (checkpoint.completedPasses >= numIntegratorPasses*numSamplePasses) ||
+        !rng.RestoreState(checkpoint.rngState) || !camera->Film()->RestoreState(checkpoint.filmState))
+    {
+        GLOG_ERROR << "Checkpoint " << settings.checkpointFile << " does not match the rendering settings, rendering from scratch.";
+        return false;
+    }
+    GLOG_INFO << "Resuming rendering from checkpoint " << settings.checkpointFile << " after "
+              << checkpoint.completedPasses << " passes.";
+    seedRng = rng;
+    completedPasses = checkpoint.completedPasses;
+    pass.pixelSeed = checkpoint.pixelSeed;
+    return true;
+}
+
+void Renderer::WriteCheckpoint(CheckpointWriter* writer, uint32 numSamplePasses, uint32 completedPasses,
+                               const RenderingPass& pass, bool force)
+{
+    using namespace boost::posix_time;
+    if (!writer || Cancelled())
+    {
+        return;
+    }
+    ptime now = microsec_clock::universal_time();
+    if (!force && ((now - lastCheckpointTime).total_microseconds()*1.0e-6 < settings.checkpointInterval))
+    {
+        return;
+    }
+    lastCheckpointTime = now;
+
+    // Copying the film between passes is quick, while the file is saved during the next passes
+    RenderCheckpoint checkpoint;
+    checkpoint.xResolution = camera->Film()->XResolution();
+    checkpoint.yResolution = camera->Film()->YResolution();
+    checkpoint.samplesPerPixel = camera->SamplesPerPixel();
+    checkpoint.samplePasses = numSamplePasses;
+    checkpoint.completedPasses = completedPasses;
+    checkpoint.pixelSeed = pass.pixelSeed;
+    checkpoint.rngState = seedRng.State();
+    camera->Film()->StoreState(checkpoint.filmState);
+    writer->Write(checkpoint);
+}
+
+real Renderer::WorkAreaError(const RenderingWorkArea& workArea) const
+{
+    real maxError = 0.0f;
+    for (int y = workArea.yStart; y <= workArea.yEnd; ++y)
+    {
+        for (int x = workArea.xStart; x <= workArea.xEnd; ++x)
+        {
+            maxError = std::max(maxError, PixelError(*camera->Film(), x, y));
+        }
+    }
+    return maxError;
+}
+
+void Renderer::SetPassCallback(const PassCallback& callback)
+{
+    passCallback = callback;
+}
+
+void Renderer::SetTileCallback(const TileCallback& callback)
+{
+    tileCallback = callback;
+}
+
+uint32 Renderer::TileSize() const
+{
+    return settings.tileSize;
+}
+
+void Renderer::Snapshot(RGBPixelList& pixels) const
+{
+    camera->Film()->StorePixels(pixels);
+}
+
+void Renderer::Cancel()
+{
+    cancelled = true;
+}
+
+bool Renderer::Cancelled() const
+{
+    if (cancelled)
+    {
+        return true;
+    }
+    return (settings.timeBudget > 0.0f) && (boost::posix_time::microsec_clock::universal_time() >= deadline);
 }
 }
@@ -22,19 +22,46 @@
 #define RENDERBLISS_RENDERER_H
 
 #include <string>
+#include <vector>
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Colour/Pixel.h"
 #include "renderbliss/Interfaces/IRenderer.h"
+#include "renderbliss/Interfaces/IRenderingJob.h"
+#include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Rendering/RenderingJob.h"
+#include "renderbliss/Rendering/TileOrder.h"
 
 namespace renderbliss
 {
+class CheckpointWriter;
 class JobScheduler;
-class MersenneTwister;
 class PropertyMap;
 class StatsTracker;
 class SurfaceIntegrator;
+class TileTracker;
 typedef boost::shared_ptr<SurfaceIntegrator> SurfaceIntegratorPtr;
 
+// Called after each rendering pass with the number of completed passes and the total number of passes,
+// which is zero for the open-ended passes of a time-budgeted rendering. Rendering stops early if it returns false.
+typedef boost::function<bool (uint32 completedPasses, uint32 numPasses)> PassCallback;
+
+// Called with each tile of film pixels once its pixels are final, from the thread that completed it
+typedef boost::function<void (const RenderingWorkArea& tile)> TileCallback;
+
 // Default renderer
+// In progressive mode, the samples of every pixel are split into passes over the whole image,
+// so that the film holds a complete, if noisy, image after each pass.
+// Adaptive sampling then adds passes over the work areas holding pixels whose relative error
+// is above a threshold, until none is left or the maximum number of adaptive passes is reached.
+// With a time budget, passes are only started if their estimated cost fits in the remaining time,
+// and once the scheduled passes are done, whole passes are added again until the deadline.
+// With a checkpoint file, the state of the rendering is saved periodically between passes,
+// and rendering can be resumed from it after the pass of the latest checkpoint saved during the integrator passes.
+// Tiles of the film are reported during the last pass as soon as all the work areas reaching them are rendered,
+// unless adaptive sampling or a time budget may add passes, in which case they are reported once rendering ends.
 class Renderer : public IRenderer
 {
 public:
@@ -44,15 +71,73 @@ public:
              JobScheduler& jobScheduler, StatsTracker& stats);
     void Render();
 
+    // Sets a function to be called between rendering passes
+    void SetPassCallback(const PassCallback& callback);
+
+    // Sets a function to be called with each tile of final pixels
+    void SetTileCallback(const TileCallback& callback);
+
+    // Returns the side length of the work areas and of the reported tiles, which lie on a grid starting at the film origin
+    uint32 TileSize() const;
+
+    // Stores the pixels rendered so far. Should be called between passes, or once rendering is done.
+    void Snapshot(RGBPixelList& pixels) const;
+
+    // Stops rendering as soon as the jobs being run finish their work areas. Can be called from any thread,
+    // including before Render starts, in which case nothing is rendered.
+    void Cancel();
+
+    // Returns true once rendering was cancelled or the time budget is exhausted
+    bool Cancelled() const;
+
 private:
 
     struct Settings
     {
+        uint32 tileSize;             // Side length of the square work areas, in pixels
+        TileOrder::Enum tileOrder;   // Order in which the work areas of a pass are scheduled
+        uint32 numProgressivePasses; // Number of passes splitting the samples of each pixel
+        real adaptiveErrorThreshold; // Zero disables adaptive sampling
+        uint32 numAdaptivePasses;    // Maximum number of adaptive passes
+        real timeBudget;             // In seconds, including preprocessing. Zero disables the time budget.
+        std::string checkpointFile;  // An empty file name disables checkpoints
+        real checkpointInterval;     // Minimum time between checkpoints, in seconds
+        bool resume;                 // Whether to resume rendering from the checkpoint file, if it matches the camera
+        bool preProcess;             // Whether to preprocess the integrator, which can be skipped if it was for the same scene
         Settings(const PropertyMap& props);
     } settings;
+    PassCallback passCallback;
+    TileCallback tileCallback;
+    volatile bool cancelled;
+    boost::posix_time::ptime deadline;
+    double workAreaSampleTime; // Time taken per work area and sample per pixel during the last pass, in seconds
+    boost::posix_time::ptime lastCheckpointTime;
+    MersenneTwister seedRng;   // Seeds the rendering jobs, and is saved in checkpoints
     SurfaceIntegratorPtr surfaceIntegrator;
     mutable JobScheduler& jobScheduler;
     mutable StatsTracker& stats;
+
+    // Renders a pass over a list of work areas, reporting the tiles they complete if given a tracker
+    void RenderPass(const std::vector<RenderingWorkArea>& workAreas, const RenderingPass& pass, TileTracker* tileTracker=0);
+
+    // Reports the tiles not reported during the last pass
+    void ReportRemainingTiles(TileTracker* tileTracker);
+
+    // Returns true if a pass over a number of work areas is expected to end before the deadline
+    bool PassFitsBudget(size_t numWorkAreas, const RenderingPass& pass) const;
+
+    // Restores the film and seed generator from the checkpoint file, and returns the number of passes
+    // it holds and the pixel seed of their integrator pass. Returns false if the checkpoint cannot be resumed,
+    // including when it was saved after the last integrator pass.
+    bool Resume(uint32 numSamplePasses, uint32 numIntegratorPasses, uint32& completedPasses, RenderingPass& pass);
+
+    // Queues a checkpoint after a number of completed passes,
+    // unless the last one is too recent or rendering was cancelled in the middle of a pass
+    void WriteCheckpoint(CheckpointWriter* writer, uint32 numSamplePasses, uint32 completedPasses,
+                         const RenderingPass& pass, bool force);
+
+    // Returns the largest relative error of the pixels in a work area
+    real WorkAreaError(const RenderingWorkArea& workArea) const;
 };
 }
 
@@ -0,0 +1,162 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Rendering/RenderingJob.h"
+#include <algorithm>
+#include <vector>
+#include "renderbliss/Macros.h"
+#include "renderbliss/Scene.h"
+#include "renderbliss/Colour/Spectrum.h"
+#include "renderbliss/Interfaces/ICamera.h"
+#include "renderbliss/Interfaces/IFilm.h"
+#include "renderbliss/Integrators/SurfaceIntegrator.h"
+#include "renderbliss/Math/Geometry/Ray.h"
+#include "renderbliss/Rendering/Renderer.h"
+
+namespace renderbliss
+{
+RenderingJob::RenderingJob(uint seed, const RenderingWorkArea& workArea, const Renderer* renderer, const ICamera* camera,
+                           const Scene* scene, const SurfaceIntegrator* surfaceIntegrator, const RenderingPass& pass)
+    : IRenderingJob(workArea), rng(seed), pass(pass), renderer(renderer), camera(camera), scene(scene), surfaceIntegrator(surfaceIntegrator)
+{
+    RB_ASSERT(camera);
+    RB_ASSERT(scene);
+    RB_ASSERT(surfaceIntegrator);
+    RB_ASSERT(pass.firstSample < pass.endSample);
+    RB_ASSERT(pass.endSample <= camera->SamplesPerPixel());
+}
+
+void RenderingJob::Run() const
+{
+    if (renderer && renderer->Cancelled())
+    {
+        return;
+    }
+
+    // The rays of the whole work area are shaded as a batch
+    std::vector<Ray> rays;
+    std::vector<Sample2D> imageSamples;
+
+    Ray ray;
+    CameraSample cs;
+    uint32 nSamplesPerPixel = camera->SamplesPerPixel();
+    bool partialPixels = (pass.firstSample > 0) || (pass.endSample < nSamplesPerPixel);
+    std::vector<uint32> sampleOrder(nSamplesPerPixel);
+    for (int y = workArea.yStart; y <= workArea.yEnd; ++y)
+    {
+        for (int x = workArea.xStart; x <= workArea.xEnd; ++x)
+        {
+            if ((pass.errorThreshold > 0.0f) && (PixelError(*camera->Film(), x, y) <= pass.errorThreshold))
+            {
+                continue;
+            }
+
+            if (partialPixels)
+            {
+                // Each pass takes a different subset of the stratified samples, spread over the pixel
+                MersenneTwister pixelRng(pass.pixelSeed ^ (static_cast<uint>(x)*73856093u) ^ (static_cast<uint>(y)*19349663u));
+                camera->GeneratePixelSamples(x, y, pixelRng, cs);
+                for (uint32 i = 0; i < nSamplesPerPixel; ++i)
+                {
+                    sampleOrder[i] = i;
+                }
+                Shuffle(pixelRng, sampleOrder);
+            }
+            else
+            {
+                camera->GeneratePixelSamples(x, y, rng, cs);
+            }
+            for (uint32 iPassSample = pass.firstSample; iPassSample < pass.endSample; ++iPassSample)
+            {
+                uint32 iSample = partialPixels ? sampleOrder[iPassSample] : iPassSample;
+                RB_ASSERT(iSample < cs.imageSamples.size());
+                RB_ASSERT(iSample < cs.lensSamples.size());
+                RB_ASSERT(iSample < cs.timeSamples.size());
+                PixelSample ps = {cs.imageSamples[iSample], cs.lensSamples[iSample], cs.timeSamples[iSample]};
+                camera->GenerateRay(ps, ray);
+                rays.push_back(ray);
+                imageSamples.push_back(ps.imageSample);
+            }
+        }
+    }
+
+    std::vector<Spectrum> radiances;
+    surfaceIntegrator->Radiances(*scene, rays, rng, radiances);
+    std::vector<FilmSample> samples(rays.size());
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        FilmSample s = { radiances[i].ToXYZ(), imageSamples[i], 1.0f };
+        samples[i] = s;
+    }
+    camera->Film()->AddSamples(samples);
+}
+
+PrePassJob::PrePassJob(uint seed, const RenderingWorkArea& workArea, uint32 pixelSpacing, const ICamera* camera,
+                       const Scene* scene, const SurfaceIntegrator* surfaceIntegrator)
+    : IRenderingJob(workArea), rng(seed), pixelSpacing(pixelSpacing), camera(camera), scene(scene), surfaceIntegrator(surfaceIntegrator)
+{
+    RB_ASSERT(pixelSpacing);
+    RB_ASSERT(camera);
+    RB_ASSERT(scene);
+    RB_ASSERT(surfaceIntegrator);
+}
+
+void PrePassJob::Run() const
+{
+    Ray ray;
+    CameraSample cs;
+    for (int y = workArea.yStart; y <= workArea.yEnd; y += pixelSpacing)
+    {
+        for (int x = workArea.xStart; x <= workArea.xEnd; x += pixelSpacing)
+        {
+            camera->GeneratePixelSamples(x, y, rng, cs);
+            PixelSample ps = {cs.imageSamples[0], cs.lensSamples[0], cs.timeSamples[0]};
+            camera->GenerateRay(ps, ray);
+            surfaceIntegrator->PrePassRay(*scene, ray, rng);
+        }
+    }
+}
+
+void MakePrePassJobs(const ICamera* camera, const Scene* scene, const SurfaceIntegrator* surfaceIntegrator,
+                     uint32 tileSize, TileOrder::Enum tileOrder, MersenneTwister& seedRng, JobList& jobs)
+{
+    uint32 pixelSpacing = surfaceIntegrator->PrePassPixelSpacing();
+    if (!pixelSpacing)
+    {
+        return;
+    }
+    int xStart=0, xEnd=0, yStart=0, yEnd=0;
+    camera->GetPixelSampleExtents(xStart, yStart, xEnd, yEnd);
+    std::vector<RenderingWorkArea> workAreas;
+    MakeTiles(xStart, yStart, xEnd, yEnd, tileSize*pixelSpacing, tileOrder, workAreas);
+    foreach (const RenderingWorkArea& workArea, workAreas)
+    {
+        JobConstPtr job(new PrePassJob(seedRng.RandomBits(), workArea, pixelSpacing, camera, scene, surfaceIntegrator));
+        jobs.push_back(job);
+    }
+}
+
+real PixelError(const IFilm& film, int x, int y)
+{
+    x = std::min(std::max(x, 0), static_cast<int>(film.XResolution())-1);
+    y = std::min(std::max(y, 0), static_cast<int>(film.YResolution())-1);
+    return film.RelativeError(x, y);
+}
+}
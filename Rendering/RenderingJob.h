@@ -0,0 +1,100 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_RENDERINGJOB_H
+#define RENDERBLISS_RENDERINGJOB_H
+
+#include "renderbliss/Types.h"
+#include "renderbliss/Interfaces/IRenderingJob.h"
+#include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Rendering/TileOrder.h"
+#include "renderbliss/Utils/JobScheduler.h"
+
+namespace renderbliss
+{
+class ICamera;
+class IFilm;
+class Renderer;
+class Scene;
+class SurfaceIntegrator;
+
+// The samples taken by a rendering pass in each pixel of its work areas
+struct RenderingPass
+{
+    uint pixelSeed;      // Seed of the camera samples, shared by the passes splitting the samples of pixels
+    uint32 firstSample;  // Range of the camera samples taken in each pixel
+    uint32 endSample;
+    real errorThreshold; // If positive, pixels whose relative error is below the threshold are skipped
+};
+
+// Default rendering job class
+// Samples every pixel of a work area, either fully or with a range of its samples,
+// and hands the camera rays of the whole work area to the integrator as one batch.
+// When the range does not cover all samples, the camera samples of each pixel are generated from
+// a seed shared by all passes, so that each sample of the pixel is taken in exactly one pass.
+// A job rendering for a Renderer does nothing once rendering is cancelled,
+// so that cancellation happens between work areas. The renderer may be null.
+class RenderingJob : public IRenderingJob
+{
+public:
+
+    RenderingJob(uint seed, const RenderingWorkArea& workArea, const Renderer* renderer, const ICamera* camera,
+                 const Scene* scene, const SurfaceIntegrator* surfaceIntegrator, const RenderingPass& pass);
+    virtual void Run() const;
+
+private:
+
+    mutable MersenneTwister rng;
+    RenderingPass pass;
+    const Renderer* renderer;
+    const ICamera* camera;
+    const Scene* scene;
+    const SurfaceIntegrator* surfaceIntegrator;
+};
+
+// Traces one ray through every few pixels of a work area for the sparse pre-pass of an integrator
+class PrePassJob : public IRenderingJob
+{
+public:
+
+    PrePassJob(uint seed, const RenderingWorkArea& workArea, uint32 pixelSpacing, const ICamera* camera,
+               const Scene* scene, const SurfaceIntegrator* surfaceIntegrator);
+    virtual void Run() const;
+
+private:
+
+    mutable MersenneTwister rng;
+    uint32 pixelSpacing;
+    const ICamera* camera;
+    const Scene* scene;
+    const SurfaceIntegrator* surfaceIntegrator;
+};
+
+// Appends the jobs of the sparse pre-pass of an integrator through the pixels of a camera,
+// over work areas whose side length is a multiple of the pixel spacing of the pre-pass.
+// Appends nothing if the integrator has no pre-pass.
+void MakePrePassJobs(const ICamera* camera, const Scene* scene, const SurfaceIntegrator* surfaceIntegrator,
+                     uint32 tileSize, TileOrder::Enum tileOrder, MersenneTwister& seedRng, JobList& jobs);
+
+// Returns the relative error of the film pixel nearest to a pixel of the sample extents
+real PixelError(const IFilm& film, int x, int y);
+}
+
+#endif
@@ -0,0 +1,320 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Rendering/TileCoordinator.h"
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/thread/thread.hpp>
+#include <log++/Log++.h>
+#include "renderbliss/Macros.h"
+#include "renderbliss/Interfaces/ICamera.h"
+#include "renderbliss/Interfaces/IFilm.h"
+#include "renderbliss/Utils/PropertyMap.h"
+#include "renderbliss/Utils/StatsTracker.h"
+
+namespace renderbliss
+{
+TileCoordinator::Settings::Settings(const PropertyMap& props)
+{
+    props.Get<uint32>("coordinator_port", 7373, port);
+    GetTileSettings(props, tileSize, tileOrder);
+    props.Get<uint32>("tile_seed", 0, seed);
+    props.Get<real>("worker_timeout", 600.0f, workerTimeout);
+}
+
+TileCoordinator::TileCoordinator(const PropertyMap& props, const CameraConstPtr& camera, uint32 numIntegratorPasses, StatsTracker& stats)
+    : settings(props), camera(camera), numIntegratorPasses(numIntegratorPasses), stats(stats), numCompletedTasks(0),
+      listening(false), listeningPort(0)
+{
+    RB_ASSERT(this->camera.get());
+    stats.AddCounter("Tile Coordinator", "Workers");
+    stats.AddCounter("Tile Coordinator", "Late workers");
+    stats.AddCounter("Tile Coordinator", "Merged tiles");
+    stats.AddCounter("Tile Coordinator", "Reassigned tiles");
+}
+
+void TileCoordinator::Render()
+{
+    if (!camera)
+    {
+        SetListeningPort(0);
+        return;
+    }
+
+    // Tasks are handed out pass after pass, so that workers prepare each integrator pass once
+    int xStart=0, xEnd=0, yStart=0, yEnd=0;
+    camera->GetPixelSampleExtents(xStart, yStart, xEnd, yEnd);
+    std::vector<RenderingWorkArea> tiles;
+    MakeTiles(xStart, yStart, xEnd, yEnd, settings.tileSize, settings.tileOrder, tiles);
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        pendingTasks.clear();
+        for (uint32 pass = 0; pass < numIntegratorPasses; ++pass)
+        {
+            foreach (const RenderingWorkArea& tile, tiles)
+            {
+                TileTask task = {static_cast<uint32>(pendingTasks.size()), pass, TileSeed(settings.seed, pass, tile), tile};
+                pendingTasks.push_back(task);
+            }
+        }
+        completedTasks.assign(pendingTasks.size(), false);
+        numCompletedTasks = 0;
+    }
+
+    stats.Timer("Rendering", "Rendering time").Start();
+    boost::asio::io_service ioService;
+    boost::asio::ip::tcp::acceptor acceptor(ioService);
+    boost::system::error_code error;
+    boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::tcp::v4(), static_cast<unsigned short>(settings.port));
+    acceptor.open(endpoint.protocol(), error);
+    if (!error) acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true), error);
+    if (!error) acceptor.bind(endpoint, error);
+    if (!error) acceptor.listen(boost::asio::socket_base::max_connections, error);
+    if (!error) acceptor.non_blocking(true, error);
+    uint32 port = error ? 0 : acceptor.local_endpoint(error).port();
+    if (error)
+    {
+        GLOG_ERROR << "Failed to listen for workers on port " << settings.port << ": " << error.message();
+        SetListeningPort(0);
+        stats.Timer("Rendering", "Rendering time").Stop();
+        return;
+    }
+    SetListeningPort(port);
+    GLOG_INFO << "Handing out " << tiles.size()*numIntegratorPasses << " tiles to the workers connecting on port " << port;
+
+    // Workers are accepted until every task is completed, as they may connect at any time
+    boost::thread_group workerThreads;
+    while (!Done())
+    {
+        DisconnectLateWorkers();
+        SocketPtr socket(new boost::asio::ip::tcp::socket(ioService));
+        acceptor.accept(*socket, error);
+        if (!error)
+        {
+            ++stats.Counter("Tile Coordinator", "Workers");
+            workerThreads.create_thread(boost::bind(&TileCoordinator::ServeWorker, this, socket));
+            continue;
+        }
+        boost::mutex::scoped_lock lock(mutex);
+        if (numCompletedTasks < completedTasks.size())
+        {
+            tasksChanged.timed_wait(lock, boost::posix_time::milliseconds(50));
+        }
+    }
+    acceptor.close();
+    workerThreads.join_all();
+    stats.Timer("Rendering", "Rendering time").Stop();
+}
+
+void TileCoordinator::ServeWorker(SocketPtr socket)
+{
+    TileTask task;
+    bool taskAssigned = false;
+    bool seedSent = false;
+    std::vector<byte> payload;
+    for (;;)
+    {
+        TileMessage::Enum type = TileMessage::Invalid;
+        bool received = ReadTileMessage(*socket, type, payload);
+        WatchWorker(socket, false);
+        if (!received)
+        {
+            break;
+        }
+        if (type == TileMessage::Result)
+        {
+            TileResult result;
+            if (!taskAssigned || !DecodeTileResult(payload, result) || !CompleteTask(task, result))
+            {
+                GLOG_ERROR << "Received an invalid tile from a worker.";
+                break;
+            }
+            taskAssigned = false;
+        }
+        else if (type != TileMessage::Request)
+        {
+            break;
+        }
+
+        // The first request is answered with the seed of the integrator, which the worker may take long to prepare
+        if (!seedSent)
+        {
+            seedSent = true;
+            EncodeTileSeed(settings.seed, payload);
+            if (!WriteTileMessage(*socket, TileMessage::Seed, payload))
+            {
+                break;
+            }
+            continue;
+        }
+
+        if (!NextTask(task))
+        {
+            payload.clear();
+            WriteTileMessage(*socket, TileMessage::Done, payload);
+            return;
+        }
+        taskAssigned = true;
+        WatchWorker(socket, true);
+        EncodeTileTask(task, payload);
+        if (!WriteTileMessage(*socket, TileMessage::Task, payload))
+        {
+            break;
+        }
+    }
+
+    GLOG_ERROR << "Lost the connection to a worker.";
+    if (taskAssigned)
+    {
+        AbandonTask(task);
+    }
+}
+
+void TileCoordinator::WatchWorker(const SocketPtr& socket, bool renderingTask)
+{
+    if (settings.workerTimeout <= 0.0f)
+    {
+        return;
+    }
+    boost::mutex::scoped_lock lock(mutex);
+    if (!renderingTask)
+    {
+        taskDeadlines.erase(socket);
+        return;
+    }
+    using namespace boost::posix_time;
+    long timeoutSeconds = static_cast<long>(settings.workerTimeout);
+    long timeoutMicroseconds = static_cast<long>((settings.workerTimeout-timeoutSeconds)*1.0e6);
+    taskDeadlines[socket] = microsec_clock::universal_time() + seconds(timeoutSeconds) + microseconds(timeoutMicroseconds);
+}
+
+void TileCoordinator::DisconnectLateWorkers()
+{
+    using namespace boost::posix_time;
+    boost::mutex::scoped_lock lock(mutex);
+    ptime now = microsec_clock::universal_time();
+    std::map<SocketPtr, ptime>::iterator it = taskDeadlines.begin();
+    while (it != taskDeadlines.end())
+    {
+        if (it->second > now)
+        {
+            ++it;
+            continue;
+        }
+        // The thread serving the worker is blocked reading its result, which fails once the socket is shut down
+        GLOG_ERROR << "A worker did not return its tile within " << settings.workerTimeout << " seconds, disconnecting it.";
+        boost::system::error_code error;
+        it->first->shutdown(boost::asio::ip::tcp::socket::shutdown_both, error);
+        ++stats.Counter("Tile Coordinator", "Late workers");
+        taskDeadlines.erase(it++);
+    }
+}
+
+bool TileCoordinator::NextTask(TileTask& task)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    for (;;)
+    {
+        // Skip the tasks completed by another worker after being abandoned by a worker thought to have failed
+        while (!pendingTasks.empty() && completedTasks[pendingTasks.front().index])
+        {
+            pendingTasks.pop_front();
+        }
+        if (!pendingTasks.empty())
+        {
+            task = pendingTasks.front();
+            pendingTasks.pop_front();
+            return true;
+        }
+        if (numCompletedTasks == completedTasks.size())
+        {
+            return false;
+        }
+        // Tasks still being rendered may be abandoned and handed out again
+        tasksChanged.wait(lock);
+    }
+}
+
+bool TileCoordinator::CompleteTask(const TileTask& task, const TileResult& result)
+{
+    if (result.index != task.index)
+    {
+        return false;
+    }
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        if (completedTasks[task.index])
+        {
+            return true;
+        }
+        // Film merging adds samples atomically, but a task must not be merged twice
+        if (!camera->Film()->MergeRegion(result.region, result.samples))
+        {
+            return false;
+        }
+        completedTasks[task.index] = true;
+        ++numCompletedTasks;
+    }
+    ++stats.Counter("Tile Coordinator", "Merged tiles");
+    tasksChanged.notify_all();
+    return true;
+}
+
+void TileCoordinator::AbandonTask(const TileTask& task)
+{
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        if (completedTasks[task.index])
+        {
+            return;
+        }
+        pendingTasks.push_front(task);
+    }
+    ++stats.Counter("Tile Coordinator", "Reassigned tiles");
+    tasksChanged.notify_all();
+}
+
+bool TileCoordinator::Done()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    return numCompletedTasks == completedTasks.size();
+}
+
+uint32 TileCoordinator::ListeningPort()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    while (!listening)
+    {
+        tasksChanged.wait(lock);
+    }
+    return listeningPort;
+}
+
+void TileCoordinator::SetListeningPort(uint32 port)
+{
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        listening = true;
+        listeningPort = port;
+    }
+    tasksChanged.notify_all();
+}
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_TILE_COORDINATOR_H
+#define RENDERBLISS_TILE_COORDINATOR_H
+
+#include <deque>
+#include <map>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Interfaces/IRenderer.h"
+#include "renderbliss/Rendering/TileOrder.h"
+#include "renderbliss/Rendering/TileProtocol.h"
+
+namespace renderbliss
+{
+class PropertyMap;
+class StatsTracker;
+
+// Renders an image with worker processes, possibly running on other machines, instead of rendering it itself.
+// The tiles of every integrator pass are handed out to the workers connecting to the coordinator port,
+// and the samples they return are merged into the film of the camera. The tiles of a worker whose
+// connection fails, or which does not return its tile in time, are handed out again.
+// Each tile is rendered with the same seed whichever worker renders it, and all workers prepare
+// their integrator with the same seed.
+class TileCoordinator : boost::noncopyable
+{
+public:
+
+    TileCoordinator(const PropertyMap& props, const CameraConstPtr& camera, uint32 numIntegratorPasses, StatsTracker& stats);
+
+    // Returns once the samples of every tile were merged into the film
+    void Render();
+
+    // Waits until Render listens for workers, and returns the port it listens on, or zero if it failed to listen.
+    // A port setting of zero lets the system pick the port.
+    uint32 ListeningPort();
+
+private:
+
+    typedef boost::shared_ptr<boost::asio::ip::tcp::socket> SocketPtr;
+
+    struct Settings
+    {
+        uint32 port;               // TCP port on which workers connect
+        uint32 tileSize;           // Side length of the tiles, in pixels
+        TileOrder::Enum tileOrder; // Order in which the tiles of a pass are handed out
+        uint32 seed;               // Seed from which the seed of each tile and of the integrator are derived
+        real workerTimeout;        // Time a worker has to return a tile, in seconds. Zero disables the timeout.
+        Settings(const PropertyMap& props);
+    } settings;
+    CameraConstPtr camera;
+    uint32 numIntegratorPasses;
+    mutable StatsTracker& stats;
+
+    boost::mutex mutex;
+    boost::condition_variable tasksChanged;
+    std::deque<TileTask> pendingTasks;
+    std::vector<bool> completedTasks;
+    size_t numCompletedTasks;
+    std::map<SocketPtr, boost::posix_time::ptime> taskDeadlines; // Of the workers rendering a task
+    bool listening;
+    uint32 listeningPort;
+
+    // Talks to a worker until no task is left or its connection fails
+    void ServeWorker(SocketPtr socket);
+
+    // Starts or stops the timeout of the task being rendered by a worker
+    void WatchWorker(const SocketPtr& socket, bool renderingTask);
+    // Shuts down the connections of the workers whose task is late, so that their tasks are handed out again
+    void DisconnectLateWorkers();
+
+    // Waits for a task to hand out, and returns false once every task is completed
+    bool NextTask(TileTask& task);
+    // Merges the result of a task into the film. Returns false if the result does not match the task.
+    bool CompleteTask(const TileTask& task, const TileResult& result);
+    // Hands out a task again, after the connection to its worker failed
+    void AbandonTask(const TileTask& task);
+    bool Done();
+
+    // Records the port Render listens on, or zero if it failed to listen
+    void SetListeningPort(uint32 port);
+};
+}
+
+#endif
@@ -0,0 +1,170 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Rendering/TileOrder.h"
+#include <algorithm>
+#include <cmath>
+#include <log++/Log++.h>
+#include "renderbliss/Macros.h"
+#include "renderbliss/Utils/PropertyMap.h"
+
+namespace
+{
+    using namespace renderbliss;
+
+    // Sorting key of a tile, where ties of the first key are broken by the second one
+    struct TileKey
+    {
+        uint32 key;
+        real subKey;
+        size_t index;
+        bool operator<(const TileKey& other) const
+        {
+            return (key < other.key) || ((key == other.key) && (subKey < other.subKey));
+        }
+    };
+
+    // Inserts a zero bit between each of the lower 16 bits of an integer
+    uint32 SpreadBits(uint32 v)
+    {
+        v &= 0x0000ffff;
+        v = (v | (v << 8)) & 0x00ff00ff;
+        v = (v | (v << 4)) & 0x0f0f0f0f;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    }
+
+    // Returns the distance along the Hilbert curve filling a grid of side n, a power of two, to a cell of the grid
+    uint32 HilbertIndex(uint32 n, uint32 x, uint32 y)
+    {
+        uint32 d = 0;
+        for (uint32 s = n/2; s > 0; s /= 2)
+        {
+            uint32 rx = (x & s) ? 1 : 0;
+            uint32 ry = (y & s) ? 1 : 0;
+            d += s*s*((3*rx) ^ ry);
+
+            // Rotate the quadrant, so that the curve of the next level starts and ends next to its neighbours
+            if (!ry)
+            {
+                if (rx)
+                {
+                    x = n-1-x;
+                    y = n-1-y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return d;
+    }
+}
+
+namespace renderbliss
+{
+TileOrder::Enum GetTileOrder(const std::string& name)
+{
+    if (name == "scanline") return TileOrder::Scanline;
+    if (name == "morton") return TileOrder::Morton;
+    if (name == "hilbert") return TileOrder::Hilbert;
+    if (name == "spiral") return TileOrder::Spiral;
+    return TileOrder::Invalid;
+}
+
+void GetTileSettings(const PropertyMap& props, uint32& tileSize, TileOrder::Enum& tileOrder)
+{
+    props.Get<uint32>("tile_size", 16, tileSize);
+    tileSize = std::max(1u, tileSize);
+    std::string tileOrderName;
+    props.Get<std::string>("tile_order", "scanline", tileOrderName);
+    tileOrder = GetTileOrder(tileOrderName);
+    if (tileOrder == TileOrder::Invalid)
+    {
+        GLOG_ERROR << "Unknown tile order " << tileOrderName << ", using the scanline order.";
+        tileOrder = TileOrder::Scanline;
+    }
+}
+
+void MakeTiles(int xStart, int yStart, int xEnd, int yEnd, uint32 tileSize, TileOrder::Enum order,
+               std::vector<RenderingWorkArea>& tiles)
+{
+    RB_ASSERT(tileSize);
+    tiles.clear();
+    if ((xEnd < xStart) || (yEnd < yStart))
+    {
+        return;
+    }
+
+    int side = static_cast<int>(tileSize);
+    uint32 nTilesX = (xEnd-xStart)/side + 1;
+    uint32 nTilesY = (yEnd-yStart)/side + 1;
+    uint32 gridSide = 1;
+    while ((gridSide < nTilesX) || (gridSide < nTilesY))
+    {
+        gridSide *= 2;
+    }
+
+    std::vector<RenderingWorkArea> scanlineTiles;
+    std::vector<TileKey> keys;
+    for (uint32 ty = 0; ty < nTilesY; ++ty)
+    {
+        for (uint32 tx = 0; tx < nTilesX; ++tx)
+        {
+            int x = xStart + tx*side;
+            int y = yStart + ty*side;
+            RenderingWorkArea tile = {x, std::min(xEnd, x+side-1), y, std::min(yEnd, y+side-1)};
+            TileKey key = {0, 0.0f, scanlineTiles.size()};
+            switch (order)
+            {
+            case TileOrder::Morton:
+                key.key = SpreadBits(tx) | (SpreadBits(ty) << 1);
+                break;
+
+            case TileOrder::Hilbert:
+                key.key = HilbertIndex(gridSide, tx, ty);
+                break;
+
+            case TileOrder::Spiral:
+                {
+                    // Square rings around the centre of the image, each walked around by angle
+                    real dx = tx + 0.5f - 0.5f*nTilesX;
+                    real dy = ty + 0.5f - 0.5f*nTilesY;
+                    key.key = static_cast<uint32>(std::max(std::fabs(dx), std::fabs(dy)));
+                    key.subKey = std::atan2(dy, dx);
+                }
+                break;
+
+            default:
+                key.key = static_cast<uint32>(key.index);
+                break;
+            }
+            scanlineTiles.push_back(tile);
+            keys.push_back(key);
+        }
+    }
+
+    std::stable_sort(keys.begin(), keys.end());
+    tiles.reserve(keys.size());
+    foreach (const TileKey& key, keys)
+    {
+        tiles.push_back(scanlineTiles[key.index]);
+    }
+}
+}
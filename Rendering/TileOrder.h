@@ -0,0 +1,61 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_TILE_ORDER_H
+#define RENDERBLISS_TILE_ORDER_H
+
+#include <string>
+#include <vector>
+#include "renderbliss/Types.h"
+#include "renderbliss/Interfaces/IRenderingJob.h"
+
+namespace renderbliss
+{
+class PropertyMap;
+
+// Orders in which the tiles of an image are rendered.
+// Tiles along the Morton and Hilbert curves are usually neighbours, so consecutive jobs reuse the
+// scene data cached by the previous ones. The spiral starts from the centre of the image, for previews.
+struct TileOrder : NonConstructible
+{
+    enum Enum
+    {
+        Scanline,
+        Morton,
+        Hilbert,
+        Spiral,
+        Invalid
+    };
+};
+
+// Returns the order named "scanline", "morton", "hilbert" or "spiral", or Invalid for any other name
+TileOrder::Enum GetTileOrder(const std::string& name);
+
+// Reads the "tile_size" and "tile_order" settings, which default to 16 pixels and the scanline order.
+// An unknown order is logged and replaced with the scanline order.
+void GetTileSettings(const PropertyMap& props, uint32& tileSize, TileOrder::Enum& tileOrder);
+
+// Splits the pixels from (xStart, yStart) to (xEnd, yEnd) inclusive into square tiles of a given side length,
+// listed in a given order. Tiles on the right and bottom edges are clipped to the pixel extents.
+void MakeTiles(int xStart, int yStart, int xEnd, int yEnd, uint32 tileSize, TileOrder::Enum order,
+               std::vector<RenderingWorkArea>& tiles);
+}
+
+#endif
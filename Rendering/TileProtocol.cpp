@@ -0,0 +1,200 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Rendering/TileProtocol.h"
+#include <cstring>
+#include <boost/array.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+namespace
+{
+    using namespace renderbliss;
+
+    // Larger payloads are taken for a corrupted stream
+    const uint32 maxPayloadSize = 1u << 30;
+
+    // Scrambles the bits of an integer, so that nearby integers are hashed far apart
+    uint32 MixBits(uint32 v)
+    {
+        v ^= v >> 16;
+        v *= 0x7feb352du;
+        v ^= v >> 15;
+        v *= 0x846ca68bu;
+        v ^= v >> 16;
+        return v;
+    }
+
+    void PutUint32(std::vector<byte>& payload, uint32 value)
+    {
+        size_t offset = payload.size();
+        payload.resize(offset + sizeof(value));
+        memcpy(&payload[offset], &value, sizeof(value));
+    }
+
+    bool GetUint32(const std::vector<byte>& payload, size_t& offset, uint32& value)
+    {
+        if (offset + sizeof(value) > payload.size())
+        {
+            return false;
+        }
+        memcpy(&value, &payload[offset], sizeof(value));
+        offset += sizeof(value);
+        return true;
+    }
+
+    void PutWorkArea(std::vector<byte>& payload, const RenderingWorkArea& workArea)
+    {
+        PutUint32(payload, static_cast<uint32>(workArea.xStart));
+        PutUint32(payload, static_cast<uint32>(workArea.xEnd));
+        PutUint32(payload, static_cast<uint32>(workArea.yStart));
+        PutUint32(payload, static_cast<uint32>(workArea.yEnd));
+    }
+
+    bool GetWorkArea(const std::vector<byte>& payload, size_t& offset, RenderingWorkArea& workArea)
+    {
+        uint32 values[4] = {0};
+        for (size_t i = 0; i < 4; ++i)
+        {
+            if (!GetUint32(payload, offset, values[i]))
+            {
+                return false;
+            }
+        }
+        workArea.xStart = static_cast<int>(values[0]);
+        workArea.xEnd = static_cast<int>(values[1]);
+        workArea.yStart = static_cast<int>(values[2]);
+        workArea.yEnd = static_cast<int>(values[3]);
+        return true;
+    }
+}
+
+namespace renderbliss
+{
+uint32 TileSeed(uint32 seed, uint32 integratorPass, const RenderingWorkArea& workArea)
+{
+    uint32 h = MixBits(seed ^ 0x9e3779b9u);
+    h = MixBits(h ^ integratorPass);
+    h = MixBits(h ^ static_cast<uint32>(workArea.xStart));
+    h = MixBits(h ^ static_cast<uint32>(workArea.yStart));
+    return h;
+}
+
+void EncodeTileSeed(uint32 seed, std::vector<byte>& payload)
+{
+    payload.clear();
+    PutUint32(payload, seed);
+}
+
+bool DecodeTileSeed(const std::vector<byte>& payload, uint32& seed)
+{
+    size_t offset = 0;
+    return GetUint32(payload, offset, seed) && (offset == payload.size());
+}
+
+void EncodeTileTask(const TileTask& task, std::vector<byte>& payload)
+{
+    payload.clear();
+    PutUint32(payload, task.index);
+    PutUint32(payload, task.integratorPass);
+    PutUint32(payload, task.seed);
+    PutWorkArea(payload, task.workArea);
+}
+
+bool DecodeTileTask(const std::vector<byte>& payload, TileTask& task)
+{
+    size_t offset = 0;
+    TileTask result;
+    if (!GetUint32(payload, offset, result.index) || !GetUint32(payload, offset, result.integratorPass) ||
+        !GetUint32(payload, offset, result.seed) || !GetWorkArea(payload, offset, result.workArea) ||
+        (offset != payload.size()))
+    {
+        return false;
+    }
+    task = result;
+    return true;
+}
+
+void EncodeTileResult(const TileResult& result, std::vector<byte>& payload)
+{
+    payload.clear();
+    payload.reserve(5*sizeof(uint32) + result.samples.size());
+    PutUint32(payload, result.index);
+    PutWorkArea(payload, result.region);
+    payload.insert(payload.end(), result.samples.begin(), result.samples.end());
+}
+
+bool DecodeTileResult(const std::vector<byte>& payload, TileResult& result)
+{
+    size_t offset = 0;
+    if (!GetUint32(payload, offset, result.index) || !GetWorkArea(payload, offset, result.region))
+    {
+        return false;
+    }
+    result.samples.assign(payload.begin() + offset, payload.end());
+    return true;
+}
+
+bool WriteMessage(boost::asio::ip::tcp::socket& socket, uint32 type, const std::vector<byte>& payload)
+{
+    boost::array<uint32, 2> header = {{type, static_cast<uint32>(payload.size())}};
+    boost::system::error_code error;
+    boost::asio::write(socket, boost::asio::buffer(header), error);
+    if (!error && !payload.empty())
+    {
+        boost::asio::write(socket, boost::asio::buffer(payload), error);
+    }
+    return !error;
+}
+
+bool ReadMessage(boost::asio::ip::tcp::socket& socket, uint32 numTypes, uint32& type, std::vector<byte>& payload)
+{
+    boost::array<uint32, 2> header = {{0, 0}};
+    boost::system::error_code error;
+    boost::asio::read(socket, boost::asio::buffer(header), error);
+    if (error || (header[0] >= numTypes) || (header[1] > maxPayloadSize))
+    {
+        return false;
+    }
+    payload.resize(header[1]);
+    if (!payload.empty())
+    {
+        boost::asio::read(socket, boost::asio::buffer(payload), error);
+    }
+    type = header[0];
+    return !error;
+}
+
+bool WriteTileMessage(boost::asio::ip::tcp::socket& socket, TileMessage::Enum type, const std::vector<byte>& payload)
+{
+    return WriteMessage(socket, static_cast<uint32>(type), payload);
+}
+
+bool ReadTileMessage(boost::asio::ip::tcp::socket& socket, TileMessage::Enum& type, std::vector<byte>& payload)
+{
+    uint32 messageType = 0;
+    if (!ReadMessage(socket, TileMessage::Invalid, messageType, payload))
+    {
+        return false;
+    }
+    type = static_cast<TileMessage::Enum>(messageType);
+    return true;
+}
+}
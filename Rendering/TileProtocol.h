@@ -0,0 +1,89 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_TILE_PROTOCOL_H
+#define RENDERBLISS_TILE_PROTOCOL_H
+
+#include <vector>
+#include <boost/asio/ip/tcp.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Interfaces/IRenderingJob.h"
+
+namespace renderbliss
+{
+// Messages exchanged by a tile coordinator and its workers.
+// A worker sends a request once connected, which the coordinator answers with the seed of the integrator.
+// Once its integrator is prepared with that seed, the worker sends a request for a task, then the result
+// of each task it was handed, until the coordinator answers with Done.
+struct TileMessage : NonConstructible
+{
+    enum Enum
+    {
+        Request,
+        Task,
+        Result,
+        Done,
+        Seed,
+        Invalid
+    };
+};
+
+// A tile to render in an integrator pass, with the seed of its rendering jobs
+struct TileTask
+{
+    uint32 index;
+    uint32 integratorPass;
+    uint32 seed;
+    RenderingWorkArea workArea;
+};
+
+// The samples of a rendered tile, accumulated in the film region reached by the filter from the tile
+struct TileResult
+{
+    uint32 index;
+    RenderingWorkArea region;
+    std::vector<byte> samples;
+};
+
+// Returns the seed of the jobs rendering a tile in an integrator pass, so that a tile is
+// rendered the same way whichever worker renders it
+uint32 TileSeed(uint32 seed, uint32 integratorPass, const RenderingWorkArea& workArea);
+
+// Payloads are written in the byte order of the machine, so that workers must share the architecture of the coordinator.
+// Decoding returns false if a payload is malformed.
+
+void EncodeTileSeed(uint32 seed, std::vector<byte>& payload);
+bool DecodeTileSeed(const std::vector<byte>& payload, uint32& seed);
+void EncodeTileTask(const TileTask& task, std::vector<byte>& payload);
+bool DecodeTileTask(const std::vector<byte>& payload, TileTask& task);
+void EncodeTileResult(const TileResult& result, std::vector<byte>& payload);
+bool DecodeTileResult(const std::vector<byte>& payload, TileResult& result);
+
+// Each of the below functions returns true for success, and false if the connection failed.
+// A message is sent as its type and payload size, followed by the payload.
+// Reading a message fails if its type is not below the number of message types of the protocol.
+
+bool WriteMessage(boost::asio::ip::tcp::socket& socket, uint32 type, const std::vector<byte>& payload);
+bool ReadMessage(boost::asio::ip::tcp::socket& socket, uint32 numTypes, uint32& type, std::vector<byte>& payload);
+bool WriteTileMessage(boost::asio::ip::tcp::socket& socket, TileMessage::Enum type, const std::vector<byte>& payload);
+bool ReadTileMessage(boost::asio::ip::tcp::socket& socket, TileMessage::Enum& type, std::vector<byte>& payload);
+}
+
+#endif
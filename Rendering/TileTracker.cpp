@@ -0,0 +1,121 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Rendering/TileTracker.h"
+#include <algorithm>
+#include <cmath>
+#include "renderbliss/Macros.h"
+
+namespace renderbliss
+{
+TileTracker::TileTracker(uint32 xResolution, uint32 yResolution, uint32 tileSize, real xFilterWidth, real yFilterWidth,
+                         const std::vector<RenderingWorkArea>& workAreas)
+    : tileSize(std::max(1u, tileSize)), xResolution(static_cast<int>(xResolution)), yResolution(static_cast<int>(yResolution))
+{
+    xTiles = static_cast<int>((xResolution + this->tileSize - 1)/this->tileSize);
+    yTiles = static_cast<int>((yResolution + this->tileSize - 1)/this->tileSize);
+
+    // Samples of a pixel reach the pixels within the filter width of its centre, plus one for rounding
+    xMargin = static_cast<int>(std::ceil(xFilterWidth)) + 1;
+    yMargin = static_cast<int>(std::ceil(yFilterWidth)) + 1;
+
+    pendingWorkAreas.assign(xTiles*yTiles, 0);
+    reported.assign(xTiles*yTiles, false);
+    foreach (const RenderingWorkArea& workArea, workAreas)
+    {
+        int xFirst, yFirst, xLast, yLast;
+        if (TileRange(workArea, xFirst, yFirst, xLast, yLast))
+        {
+            for (int yTile = yFirst; yTile <= yLast; ++yTile)
+            {
+                for (int xTile = xFirst; xTile <= xLast; ++xTile)
+                {
+                    ++pendingWorkAreas[yTile*xTiles + xTile];
+                }
+            }
+        }
+    }
+}
+
+void TileTracker::Complete(const RenderingWorkArea& workArea, std::vector<RenderingWorkArea>& completedTiles)
+{
+    int xFirst, yFirst, xLast, yLast;
+    if (!TileRange(workArea, xFirst, yFirst, xLast, yLast))
+    {
+        return;
+    }
+    boost::mutex::scoped_lock lock(mutex);
+    for (int yTile = yFirst; yTile <= yLast; ++yTile)
+    {
+        for (int xTile = xFirst; xTile <= xLast; ++xTile)
+        {
+            int i = yTile*xTiles + xTile;
+            RB_ASSERT(pendingWorkAreas[i] > 0);
+            if (pendingWorkAreas[i] && !--pendingWorkAreas[i] && !reported[i])
+            {
+                reported[i] = true;
+                completedTiles.push_back(Tile(xTile, yTile));
+            }
+        }
+    }
+}
+
+void TileTracker::TakeRemaining(std::vector<RenderingWorkArea>& remainingTiles)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    for (int yTile = 0; yTile < yTiles; ++yTile)
+    {
+        for (int xTile = 0; xTile < xTiles; ++xTile)
+        {
+            int i = yTile*xTiles + xTile;
+            if (!reported[i])
+            {
+                reported[i] = true;
+                remainingTiles.push_back(Tile(xTile, yTile));
+            }
+        }
+    }
+}
+
+bool TileTracker::TileRange(const RenderingWorkArea& workArea, int& xFirst, int& yFirst, int& xLast, int& yLast) const
+{
+    int xStart = std::max(0, workArea.xStart - xMargin);
+    int yStart = std::max(0, workArea.yStart - yMargin);
+    int xEnd = std::min(xResolution-1, workArea.xEnd + xMargin);
+    int yEnd = std::min(yResolution-1, workArea.yEnd + yMargin);
+    if ((xEnd < xStart) || (yEnd < yStart))
+    {
+        return false;
+    }
+    xFirst = xStart/static_cast<int>(tileSize);
+    yFirst = yStart/static_cast<int>(tileSize);
+    xLast = xEnd/static_cast<int>(tileSize);
+    yLast = yEnd/static_cast<int>(tileSize);
+    return true;
+}
+
+RenderingWorkArea TileTracker::Tile(int xTile, int yTile) const
+{
+    int size = static_cast<int>(tileSize);
+    RenderingWorkArea tile = {xTile*size, std::min(xResolution, (xTile+1)*size) - 1,
+                              yTile*size, std::min(yResolution, (yTile+1)*size) - 1};
+    return tile;
+}
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_TILETRACKER_H
+#define RENDERBLISS_TILETRACKER_H
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Interfaces/IRenderingJob.h"
+
+namespace renderbliss
+{
+// Splits a film into square tiles, and finds when the last of the work areas whose samples reach
+// a tile within the filter width is rendered, after which the pixels of the tile are final.
+// Work areas are given in the pixel sample extents of the camera, and tiles in film pixels.
+class TileTracker : boost::noncopyable
+{
+public:
+
+    TileTracker(uint32 xResolution, uint32 yResolution, uint32 tileSize, real xFilterWidth, real yFilterWidth,
+                const std::vector<RenderingWorkArea>& workAreas);
+
+    // Marks a work area as rendered, and appends the tiles it completes. Can be called from any thread.
+    void Complete(const RenderingWorkArea& workArea, std::vector<RenderingWorkArea>& completedTiles);
+
+    // Appends the tiles not completed yet, in scanline order, and marks them as completed
+    void TakeRemaining(std::vector<RenderingWorkArea>& remainingTiles);
+
+private:
+
+    uint32 tileSize;
+    int xTiles, yTiles;
+    int xMargin, yMargin;
+    int xResolution, yResolution;
+    std::vector<uint32> pendingWorkAreas; // Per tile, the number of work areas left to render
+    std::vector<bool> reported;
+    boost::mutex mutex;
+
+    // Finds the range of tiles reached by the samples of a work area. Returns false if there is none.
+    bool TileRange(const RenderingWorkArea& workArea, int& xFirst, int& yFirst, int& xLast, int& yLast) const;
+    RenderingWorkArea Tile(int xTile, int yTile) const;
+};
+}
+
+#endif
@@ -0,0 +1,178 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Rendering/TileWorker.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <boost/lexical_cast.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_service.hpp>
+#include <log++/Log++.h>
+#include "renderbliss/Macros.h"
+#include "renderbliss/Scene.h"
+#include "renderbliss/Interfaces/ICamera.h"
+#include "renderbliss/Interfaces/IFilm.h"
+#include "renderbliss/Interfaces/IFilter.h"
+#include "renderbliss/Integrators/SurfaceIntegrator.h"
+#include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Rendering/RenderingJob.h"
+#include "renderbliss/Rendering/TileOrder.h"
+#include "renderbliss/Utils/JobScheduler.h"
+#include "renderbliss/Utils/PropertyMap.h"
+#include "renderbliss/Utils/StatsTracker.h"
+
+namespace renderbliss
+{
+TileWorker::Settings::Settings(const PropertyMap& props)
+{
+    props.Get<std::string>("coordinator_host", "127.0.0.1", host);
+    props.Get<uint32>("coordinator_port", 7373, port);
+    GetTileSettings(props, tileSize, tileOrder);
+}
+
+TileWorker::TileWorker(const PropertyMap& props, const CameraConstPtr& camera,
+                       const SceneConstPtr& scene, const SurfaceIntegratorPtr& surfaceIntegrator,
+                       JobScheduler& jobScheduler, StatsTracker& stats)
+    : IRenderer(camera, scene), settings(props), surfaceIntegrator(surfaceIntegrator),
+      jobScheduler(jobScheduler), stats(stats), succeeded(false)
+{
+    RB_ASSERT(this->camera.get());
+    RB_ASSERT(this->scene.get());
+    RB_ASSERT(this->surfaceIntegrator.get());
+    stats.AddCounter("Tile Worker", "Rendered tiles");
+}
+
+void TileWorker::Render()
+{
+    succeeded = false;
+    if (!camera || !scene || !surfaceIntegrator)
+    {
+        return;
+    }
+
+    boost::asio::io_service ioService;
+    boost::asio::ip::tcp::socket socket(ioService);
+    boost::asio::ip::tcp::resolver resolver(ioService);
+    boost::system::error_code error;
+    boost::asio::ip::tcp::resolver::query query(settings.host, boost::lexical_cast<std::string>(settings.port));
+    boost::asio::connect(socket, resolver.resolve(query, error), error);
+    if (error)
+    {
+        GLOG_ERROR << "Failed to connect to the coordinator " << settings.host << ":" << settings.port << ": " << error.message();
+        return;
+    }
+
+    // The integrator is prepared with the seed of the coordinator, so that all workers shoot the same photons
+    std::vector<byte> payload;
+    uint32 seed = 0;
+    TileMessage::Enum type = TileMessage::Request;
+    if (!WriteTileMessage(socket, type, payload) || !ReadTileMessage(socket, type, payload) ||
+        (type != TileMessage::Seed) || !DecodeTileSeed(payload, seed))
+    {
+        GLOG_ERROR << "Failed to receive the integrator seed from the coordinator.";
+        return;
+    }
+    stats.Timer("Preprocessing", "Preprocessing time").Start();
+    surfaceIntegrator->SetSeed(seed);
+    surfaceIntegrator->PreProcess(*scene, jobScheduler);
+    PrePass(seed);
+    stats.Timer("Preprocessing", "Preprocessing time").Stop();
+
+    stats.Timer("Rendering", "Rendering time").Start();
+    uint32 integratorPass = 0;
+    bool prepared = false;
+    payload.clear();
+    type = TileMessage::Request;
+    while (WriteTileMessage(socket, type, payload) && ReadTileMessage(socket, type, payload))
+    {
+        TileTask task;
+        if (type == TileMessage::Done)
+        {
+            succeeded = true;
+            break;
+        }
+        if ((type != TileMessage::Task) || !DecodeTileTask(payload, task))
+        {
+            GLOG_ERROR << "Received an invalid message from the coordinator.";
+            break;
+        }
+
+        if (!prepared || (task.integratorPass != integratorPass))
+        {
+            integratorPass = task.integratorPass;
+            surfaceIntegrator->PrePass(*scene, jobScheduler, integratorPass);
+            prepared = true;
+        }
+        TileResult result;
+        RenderTile(task, result);
+        ++stats.Counter("Tile Worker", "Rendered tiles");
+        EncodeTileResult(result, payload);
+        type = TileMessage::Result;
+    }
+    if (!succeeded)
+    {
+        GLOG_ERROR << "Lost the connection to the coordinator.";
+    }
+    stats.Timer("Rendering", "Rendering time").Stop();
+}
+
+bool TileWorker::Succeeded() const
+{
+    return succeeded;
+}
+
+void TileWorker::PrePass(uint32 seed)
+{
+    MersenneTwister rng(seed);
+    JobList jobs;
+    MakePrePassJobs(camera.get(), scene.get(), surfaceIntegrator.get(), settings.tileSize, settings.tileOrder, rng, jobs);
+    jobScheduler.Spawn(jobs);
+    jobScheduler.WaitForAllJobs();
+}
+
+void TileWorker::RenderTile(const TileTask& task, TileResult& result)
+{
+    const RenderingWorkArea& tile = task.workArea;
+    RenderingPass pass = {0, 0, camera->SamplesPerPixel(), 0.0f};
+    MersenneTwister rng(task.seed);
+    JobList jobs;
+    for (int y = tile.yStart; y <= tile.yEnd; ++y)
+    {
+        RenderingWorkArea row = {tile.xStart, tile.xEnd, y, y};
+        JobConstPtr job(new RenderingJob(rng.RandomBits(), row, 0, camera.get(), scene.get(), surfaceIntegrator.get(), pass));
+        jobs.push_back(job);
+    }
+    jobScheduler.Spawn(jobs);
+    jobScheduler.WaitForAllJobs();
+
+    // Samples reach the pixels around the tile within the filter width. The film holds no other samples,
+    // as the regions taken for the previous tiles covered every pixel their samples reached.
+    IFilm* film = camera->Film();
+    int xMargin = static_cast<int>(std::ceil(film->Filter().XWidth())) + 1;
+    int yMargin = static_cast<int>(std::ceil(film->Filter().YWidth())) + 1;
+    result.index = task.index;
+    result.region.xStart = std::max(0, tile.xStart - xMargin);
+    result.region.xEnd = std::min(static_cast<int>(film->XResolution())-1, tile.xEnd + xMargin);
+    result.region.yStart = std::max(0, tile.yStart - yMargin);
+    result.region.yEnd = std::min(static_cast<int>(film->YResolution())-1, tile.yEnd + yMargin);
+    film->TakeRegion(result.region, result.samples);
+}
+}
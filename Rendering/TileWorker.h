@@ -0,0 +1,80 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_TILE_WORKER_H
+#define RENDERBLISS_TILE_WORKER_H
+
+#include <string>
+#include <boost/shared_ptr.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Interfaces/IRenderer.h"
+#include "renderbliss/Rendering/TileOrder.h"
+#include "renderbliss/Rendering/TileProtocol.h"
+
+namespace renderbliss
+{
+class JobScheduler;
+class PropertyMap;
+class StatsTracker;
+class SurfaceIntegrator;
+typedef boost::shared_ptr<SurfaceIntegrator> SurfaceIntegratorPtr;
+
+// Renders the tiles handed out by a tile coordinator, and sends their samples back to it.
+// The scene, camera and integrator must be set up as in the other processes rendering the image.
+// The integrator is prepared once connected, with the seed sent by the coordinator.
+// Each tile is split into rows rendered concurrently, whose seeds are derived from the seed of the tile.
+class TileWorker : public IRenderer
+{
+public:
+
+    TileWorker(const PropertyMap& props, const CameraConstPtr& camera,
+               const SceneConstPtr& scene, const SurfaceIntegratorPtr& surfaceIntegrator,
+               JobScheduler& jobScheduler, StatsTracker& stats);
+
+    // Returns once the coordinator has no tile left, or the connection to it failed
+    void Render();
+
+    // Returns true if the last rendering ended because the coordinator had no tile left
+    bool Succeeded() const;
+
+private:
+
+    struct Settings
+    {
+        std::string host;          // Address of the coordinator
+        uint32 port;               // TCP port of the coordinator
+        uint32 tileSize;           // Side length of the work areas of the sparse pre-pass, in units of its pixel spacing
+        TileOrder::Enum tileOrder; // Order in which the work areas of the sparse pre-pass are scheduled
+        Settings(const PropertyMap& props);
+    } settings;
+    SurfaceIntegratorPtr surfaceIntegrator;
+    mutable JobScheduler& jobScheduler;
+    mutable StatsTracker& stats;
+    bool succeeded;
+
+    // Runs the sparse pre-pass of the integrator, if any, over the whole image
+    void PrePass(uint32 seed);
+
+    // Renders a tile, and takes its samples out of the film
+    void RenderTile(const TileTask& task, TileResult& result);
+};
+}
+
+#endif
@@ -0,0 +1,112 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Rendering/WavefrontQueues.h"
+#include <algorithm>
+#include "renderbliss/Macros.h"
+#include "renderbliss/Utils/AtomicOps.h"
+
+namespace renderbliss
+{
+void PathStates::Resize(uint32 count)
+{
+    origins.resize(count);
+    directions.resize(count);
+    previousNormals.resize(count);
+    previousTriangles.resize(count);
+    throughputs.resize(count);
+    radiances.resize(count);
+    bsdfPdfs.resize(count);
+    specularBounces.resize(count);
+    depths.resize(count);
+    imageSamples.resize(count);
+    hits.resize(count);
+}
+
+WorkQueue::WorkQueue() : size(0)
+{
+}
+
+void WorkQueue::Reset(uint32 capacity)
+{
+    items.resize(capacity);
+    size = 0;
+}
+
+void WorkQueue::Clear()
+{
+    size = 0;
+}
+
+uint32 WorkQueue::Size() const
+{
+    return size;
+}
+
+uint32 WorkQueue::operator[](uint32 i) const
+{
+    RB_ASSERT(i < size);
+    return items[i];
+}
+
+void WorkQueue::Append(const std::vector<uint32>& pathIndices)
+{
+    if (pathIndices.empty()) return;
+    uint32 first = AtomicAdd(&size, static_cast<uint32>(pathIndices.size()));
+    RB_ASSERT(first + pathIndices.size() <= items.size());
+    std::copy(pathIndices.begin(), pathIndices.end(), items.begin() + first);
+}
+
+void WorkQueue::Assign(const std::vector<uint32>& pathIndices)
+{
+    RB_ASSERT(pathIndices.size() <= items.size());
+    std::copy(pathIndices.begin(), pathIndices.end(), items.begin());
+    size = static_cast<uint32>(pathIndices.size());
+}
+
+ShadowRayQueue::ShadowRayQueue() : size(0)
+{
+}
+
+void ShadowRayQueue::Reset(uint32 capacity)
+{
+    occlusionTesters.resize(capacity);
+    contributions.resize(capacity);
+    pathIndices.resize(capacity);
+    size = 0;
+}
+
+void ShadowRayQueue::Clear()
+{
+    size = 0;
+}
+
+uint32 ShadowRayQueue::Size() const
+{
+    return size;
+}
+
+uint32 ShadowRayQueue::Reserve(uint32 count)
+{
+    uint32 first = AtomicAdd(&size, count);
+    RB_ASSERT(first + count <= pathIndices.size());
+    return first;
+}
+}
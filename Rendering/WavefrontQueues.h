@@ -0,0 +1,99 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_WAVEFRONT_QUEUES_H
+#define RENDERBLISS_WAVEFRONT_QUEUES_H
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Colour/Spectrum.h"
+#include "renderbliss/Interfaces/ILight.h"
+#include "renderbliss/Math/Geometry/Intersection.h"
+#include "renderbliss/Math/Geometry/Vector3.h"
+#include "renderbliss/Math/Sampling/Sampling.h"
+
+namespace renderbliss
+{
+// The states of the paths of a wavefront, stored as a structure of arrays indexed by path
+struct PathStates : boost::noncopyable
+{
+    std::vector<Vector3> origins;         // Origin of the ray extending the path
+    std::vector<Vector3> directions;      // Direction of the ray extending the path
+    std::vector<Vector3> previousNormals; // Shading normal at the origin, for picking lights
+    std::vector<const TrianglePrimitive*> previousTriangles; // Triangle of the origin, which its light samples skip
+    std::vector<Spectrum> throughputs;
+    std::vector<Spectrum> radiances;      // Radiance gathered along the path so far
+    std::vector<real> bsdfPdfs;           // PDF of the BSDF sample that chose the direction
+    std::vector<byte> specularBounces;    // Nonzero if the direction was chosen by a delta BSDF component
+    std::vector<uint32> depths;
+    std::vector<Sample2D> imageSamples;
+    std::vector<Intersection> hits;       // Closest hits found by the last extension
+
+    void Resize(uint32 count);
+};
+
+// A queue of path indices, which concurrent jobs append to by reserving ranges of slots
+class WorkQueue : boost::noncopyable
+{
+public:
+
+    WorkQueue();
+    void Reset(uint32 capacity);
+    void Clear();
+    uint32 Size() const;
+    uint32 operator[](uint32 i) const;
+
+    // Appends path indices to the queue
+    void Append(const std::vector<uint32>& pathIndices);
+
+    // Replaces the contents of the queue, which must not be appended to concurrently
+    void Assign(const std::vector<uint32>& pathIndices);
+
+private:
+
+    std::vector<uint32> items;
+    volatile uint32 size;
+};
+
+// A queue of shadow rays, each carrying the radiance it adds to a path if the light is not occluded
+class ShadowRayQueue : boost::noncopyable
+{
+public:
+
+    ShadowRayQueue();
+    void Reset(uint32 capacity);
+    void Clear();
+    uint32 Size() const;
+
+    // Reserves a range of slots, and returns the first one
+    uint32 Reserve(uint32 count);
+
+    std::vector<OcclusionTester> occlusionTesters;
+    std::vector<Spectrum> contributions;
+    std::vector<uint32> pathIndices;
+
+private:
+
+    volatile uint32 size;
+};
+}
+
+#endif
@@ -0,0 +1,408 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "renderbliss/Rendering/WavefrontRenderer.h"
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include "renderbliss/Macros.h"
+#include "renderbliss/Scene.h"
+#include "renderbliss/Accelerators/RaySorting.h"
+#include "renderbliss/Interfaces/ICamera.h"
+#include "renderbliss/Interfaces/IFilm.h"
+#include "renderbliss/Interfaces/IJob.h"
+#include "renderbliss/Interfaces/ILight.h"
+#include "renderbliss/Interfaces/IMaterial.h"
+#include "renderbliss/Lights/Luminaire.h"
+#include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Math/Geometry/Ray.h"
+#include "renderbliss/Math/Sampling/SamplingFunctions.h"
+#include "renderbliss/Primitives/MeshPrimitive.h"
+#include "renderbliss/Utils/JobScheduler.h"
+#include "renderbliss/Utils/PropertyMap.h"
+#include "renderbliss/Utils/StatsTracker.h"
+
+namespace renderbliss
+{
+// Runs a stage of the wavefront renderer over a range of queue items
+class WavefrontStageJob : public IJob
+{
+public:
+
+    WavefrontStageJob(WavefrontRenderer& renderer, WavefrontRenderer::Stage stage, uint32 begin, uint32 end, uint seed)
+        : renderer(renderer), stage(stage), begin(begin), end(end), rng(seed)
+    {
+    }
+
+    virtual void Run() const
+    {
+        switch (stage)
+        {
+        case WavefrontRenderer::GenerateCameraRays: renderer.GenerateCameraRaysKernel(begin, end, rng); break;
+        case WavefrontRenderer::ExtendPaths:        renderer.ExtendPathsKernel(begin, end); break;
+        case WavefrontRenderer::ShadeHits:          renderer.ShadeHitsKernel(begin, end, rng); break;
+        case WavefrontRenderer::TestShadowRays:     renderer.TestShadowRaysKernel(begin, end); break;
+        case WavefrontRenderer::AccumulateSamples:  renderer.AccumulateSamplesKernel(begin, end); break;
+        }
+    }
+
+private:
+
+    WavefrontRenderer& renderer;
+    WavefrontRenderer::Stage stage;
+    uint32 begin, end;
+    mutable MersenneTwister rng;
+};
+
+WavefrontRenderer::Settings::Settings(const PropertyMap& props)
+{
+    props.Get<uint32>("path_depth", 4, maxPathDepth);
+    props.Get<uint32>("wavefront_paths", 1 << 17, maxPathCount);
+    props.Get<uint32>("wavefront_job_items", 1024, itemsPerJob);
+    itemsPerJob = std::max(1u, itemsPerJob);
+    props.Get<bool>("wavefront_sort_rays", true, sortRays);
+}
+
+WavefrontRenderer::WavefrontRenderer(const PropertyMap& props, const CameraConstPtr& camera, const SceneConstPtr& scene,
+                                     JobScheduler& jobScheduler, StatsTracker& stats)
+    : IRenderer(camera, scene), settings(props), jobScheduler(jobScheduler), stats(stats),
+      xStart(0), yStart(0), width(0), firstWavePixel(0), currentRayQueue(0)
+{
+    RB_ASSERT(this->camera.get());
+    RB_ASSERT(this->scene.get());
+    stats.AddCounter("Intersections", "Intersection tests");
+    stats.AddCounter("Intersections", "Intersection hits");
+    stats.AddCounter("Rays", "Primary rays traced");
+    stats.AddCounter("Rays", "Secondary rays traced");
+    stats.AddCounter("Rays", "Secondary ray traversal steps");
+    stats.AddCounter("Rays", "Shadow rays traced");
+    stats.AddCounter("Ray Sorting", "Coherent rays after sorting");
+    stats.AddCounter("Ray Sorting", "Coherent rays before sorting");
+    stats.AddCounter("Ray Sorting", "Sorted rays");
+    stats.AddCounter("Wavefront", "Waves");
+    stats.AddCounter("Wavefront", "Path vertices shaded");
+}
+
+void WavefrontRenderer::Render()
+{
+    if (!camera || !scene)
+    {
+        return;
+    }
+
+    srand(std::time(0));
+
+    stats.Timer("Preprocessing", "Preprocessing time").Start();
+    lightBvh.reset(new LightBvh(scene->Lights()));
+    lightIndices.clear();
+    for (size_t i = 0; i < scene->Lights().size(); ++i)
+    {
+        lightIndices[scene->Lights()[i].get()] = i;
+    }
+    sceneBound = BoundingBox();
+    foreach (const MeshConstPtr& mesh, scene->Meshes())
+    {
+        sceneBound.Enclose(mesh->WorldBound());
+    }
+    stats.Timer("Preprocessing", "Preprocessing time").Stop();
+
+    stats.Timer("Rendering", "Rendering time").Start();
+    int xEnd=0, yEnd=0;
+    camera->GetPixelSampleExtents(xStart, yStart, xEnd, yEnd);
+    width = xEnd-xStart+1;
+    const uint32 numPixels = width*(yEnd-yStart+1);
+
+    // Waves hold whole pixels, so that their samples stay stratified
+    const uint32 numSamplesPerPixel = camera->SamplesPerPixel();
+    const uint32 numPixelsPerWave = std::max(1u, settings.maxPathCount/numSamplesPerPixel);
+    const uint32 numPaths = numPixelsPerWave*numSamplesPerPixel;
+    paths.Resize(numPaths);
+    rayQueues[0].Reset(numPaths);
+    rayQueues[1].Reset(numPaths);
+    hitQueue.Reset(numPaths);
+    shadowRayQueue.Reset(numPaths);
+
+    for (firstWavePixel = 0; firstWavePixel < numPixels; firstWavePixel += numPixelsPerWave)
+    {
+        const uint32 numWavePixels = std::min(numPixelsPerWave, numPixels-firstWavePixel);
+        currentRayQueue = 0;
+        rayQueues[currentRayQueue].Clear();
+        RunStage(GenerateCameraRays, numWavePixels);
+
+        // Bounce the paths of the wave until they all terminate
+        for (uint32 bounce = 0; rayQueues[currentRayQueue].Size(); ++bounce)
+        {
+            // Camera rays are already coherent, in pixel order
+            if (settings.sortRays && bounce)
+            {
+                SortRayQueue();
+            }
+            hitQueue.Clear();
+            RunStage(ExtendPaths, rayQueues[currentRayQueue].Size());
+
+            currentRayQueue = 1-currentRayQueue;
+            rayQueues[currentRayQueue].Clear();
+            shadowRayQueue.Clear();
+            RunStage(ShadeHits, hitQueue.Size());
+            RunStage(TestShadowRays, shadowRayQueue.Size());
+        }
+
+        RunStage(AccumulateSamples, numWavePixels*numSamplesPerPixel);
+        ++stats.Counter("Wavefront", "Waves");
+    }
+    stats.Timer("Rendering", "Rendering time").Stop();
+}
+
+void WavefrontRenderer::RunStage(Stage stage, uint32 itemCount)
+{
+    if (!itemCount) return;
+
+    // Camera rays are generated per pixel, which accounts for several paths
+    uint32 itemsPerJob = settings.itemsPerJob;
+    if (stage == GenerateCameraRays)
+    {
+        itemsPerJob = std::max(1u, itemsPerJob/camera->SamplesPerPixel());
+    }
+
+    JobList jobs;
+    for (uint32 begin = 0; begin < itemCount; begin += itemsPerJob)
+    {
+        JobConstPtr job(new WavefrontStageJob(*this, stage, begin, std::min(itemCount, begin+itemsPerJob), rand()));
+        jobs.push_back(job);
+    }
+    jobScheduler.Spawn(jobs);
+    jobScheduler.WaitForAllJobs();
+}
+
+void WavefrontRenderer::SortRayQueue()
+{
+    WorkQueue& rayQueue = rayQueues[currentRayQueue];
+    std::vector<RaySortEntry> entries(rayQueue.Size());
+    for (uint32 i = 0; i < rayQueue.Size(); ++i)
+    {
+        uint32 path = rayQueue[i];
+        entries[i].key = RaySortKey(paths.origins[path], paths.directions[path], sceneBound);
+        entries[i].index = path;
+    }
+    stats.Counter("Ray Sorting", "Coherent rays before sorting").Add(CoherentRayCount(entries));
+    SortRays(entries);
+    stats.Counter("Ray Sorting", "Coherent rays after sorting").Add(CoherentRayCount(entries));
+    stats.Counter("Ray Sorting", "Sorted rays").Add(rayQueue.Size());
+
+    std::vector<uint32> pathIndices(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        pathIndices[i] = entries[i].index;
+    }
+    rayQueue.Assign(pathIndices);
+}
+
+void WavefrontRenderer::GenerateCameraRaysKernel(uint32 begin, uint32 end, MersenneTwister& rng)
+{
+    const uint32 numSamplesPerPixel = camera->SamplesPerPixel();
+    std::vector<uint32> pathIndices;
+    pathIndices.reserve((end-begin)*numSamplesPerPixel);
+
+    Ray ray;
+    CameraSample cs;
+    for (uint32 i = begin; i < end; ++i)
+    {
+        uint32 pixel = firstWavePixel+i;
+        camera->GeneratePixelSamples(xStart + pixel%width, yStart + pixel/width, rng, cs);
+        for (uint32 iSample = 0; iSample < numSamplesPerPixel; ++iSample)
+        {
+            PixelSample ps = {cs.imageSamples[iSample], cs.lensSamples[iSample], cs.timeSamples[iSample]};
+            camera->GenerateRay(ps, ray);
+            uint32 path = i*numSamplesPerPixel + iSample;
+            paths.origins[path] = ray.Origin();
+            paths.directions[path] = ray.Direction();
+            paths.throughputs[path] = Spectrum(1.0f);
+            paths.radiances[path] = Spectrum::black;
+            paths.bsdfPdfs[path] = 0.0f;
+            paths.specularBounces[path] = 0;
+            paths.depths[path] = 0;
+            paths.imageSamples[path] = ps.imageSample;
+            pathIndices.push_back(path);
+        }
+    }
+    rayQueues[currentRayQueue].Append(pathIndices);
+}
+
+void WavefrontRenderer::ExtendPathsKernel(uint32 begin, uint32 end)
+{
+    const WorkQueue& rayQueue = rayQueues[currentRayQueue];
+    std::vector<uint32> pathIndices;
+    pathIndices.reserve(end-begin);
+
+    uint32 numPrimaryRays = 0, numSecondaryTraversalSteps = 0;
+    for (uint32 i = begin; i < end; ++i)
+    {
+        uint32 path = rayQueue[i];
+        Ray ray(paths.origins[path], paths.directions[path]);
+        ray.depth = paths.depths[path];
+
+        paths.hits[path] = Intersection();
+        if (scene->Intersects(ray, paths.hits[path]))
+        {
+            pathIndices.push_back(path);
+        }
+        if (ray.depth)
+        {
+            numSecondaryTraversalSteps += ray.traversalSteps;
+        }
+        else
+        {
+            ++numPrimaryRays;
+        }
+    }
+    hitQueue.Append(pathIndices);
+
+    stats.Counter("Rays", "Primary rays traced").Add(numPrimaryRays);
+    stats.Counter("Rays", "Secondary rays traced").Add(end-begin-numPrimaryRays);
+    stats.Counter("Rays", "Secondary ray traversal steps").Add(numSecondaryTraversalSteps);
+}
+
+void WavefrontRenderer::ShadeHitsKernel(uint32 begin, uint32 end, MersenneTwister& rng)
+{
+    // Delta components can only be reached by BSDF sampling
+    const int lightSamplingFlags = BsdfCombinedFlags::All & ~BsdfCombinedFlags::Delta;
+    const LightPtrList& lights = scene->Lights();
+
+    std::vector<uint32> continuedPaths;
+    continuedPaths.reserve(end-begin);
+    std::vector<uint32> shadowedPaths;
+    std::vector<OcclusionTester> occlusionTesters;
+    std::vector<Spectrum> contributions;
+
+    for (uint32 i = begin; i < end; ++i)
+    {
+        uint32 path = hitQueue[i];
+        const Intersection& hit = paths.hits[path];
+        const Vector3& direction = paths.directions[path];
+        const Vector3 toViewer = -direction.GetNormalized();
+        const uint32 depth = paths.depths[path];
+        Spectrum& L = paths.radiances[path];
+        Spectrum& throughput = paths.throughputs[path];
+
+        // Add emitted radiance, weighted against the light sample of the previous vertex
+        if (hit.emitter)
+        {
+            Spectrum Le = hit.emitter->EmittedRadiance(hit.uvn.N(), toViewer);
+            if ((depth == 0) || paths.specularBounces[path])
+            {
+                L += throughput*Le;
+            }
+            else
+            {
+                const Vector3& origin = paths.origins[path];
+                real lightPdf = hit.emitter->Pdf(origin, paths.previousTriangles[path], direction)*LightPickPdf(origin, paths.previousNormals[path], hit.emitter);
+                L += PowerHeuristic(1, paths.bsdfPdfs[path], 1, lightPdf)*throughput*Le;
+            }
+        }
+
+        if (!hit.triangle || !hit.material) continue;
+
+        // The last vertex of a path is not continued, so no BSDF sample can pick up the emission of a light,
+        // and its light sample takes the whole direct illumination instead of an MIS-weighted share
+        const bool lastVertex = (depth+1 >= settings.maxPathDepth);
+
+        // Sample a light, and queue a shadow ray carrying the light contribution
+        size_t pick;
+        real pickPdf;
+        if (!lights.empty() && hit.material->MatchesFlags(lightSamplingFlags) &&
+            lightBvh->SampleIndex(hit.point, hit.uvn.N(), rng.CanonicalRandom(), pick, pickPdf) && (pickPdf > 0.0f))
+        {
+            Sample2D lightSample = {{rng.CanonicalRandom(), rng.CanonicalRandom()}};
+            LightSamplingRecord lrec(rng, hit, lightSample);
+            lights[pick]->SampleIncidentDirection(hit, lrec);
+            if ((lrec.pdf > 0.0f) && !lrec.emittedRadiance.IsBlack())
+            {
+                Spectrum bsdfValue = hit.material->BsdfCombinedFlagsValue(lrec.toLight, toViewer, hit, lightSamplingFlags);
+                if (!bsdfValue.IsBlack())
+                {
+                    real lightPdf = lrec.pdf*pickPdf;
+                    real bsdfPdf = hit.material->BsdfCombinedFlagsPdf(toViewer, lrec.toLight, hit, BsdfCombinedFlags::All);
+                    real weight = lastVertex ? 1.0f : PowerHeuristic(1, lightPdf, 1, bsdfPdf);
+                    shadowedPaths.push_back(path);
+                    occlusionTesters.push_back(lrec.occlusionTester);
+                    contributions.push_back(weight*throughput*lrec.emittedRadiance*bsdfValue*AbsDotProduct(hit.uvn.N(), lrec.toLight)/lightPdf);
+                }
+            }
+        }
+
+        // Continue the path with a BSDF sample
+        if (lastVertex) continue;
+        BsdfSamplingRecord brec(hit, rng, BsdfCombinedFlags::All);
+        hit.material->SampleBsdf(toViewer, brec);
+        if ((brec.pdf <= 0.0f) || brec.value.IsBlack()) continue;
+
+        throughput *= brec.value*AbsDotProduct(hit.uvn.N(), brec.sampledDirection)/brec.pdf;
+        paths.origins[path] = hit.point;
+        paths.directions[path] = brec.sampledDirection;
+        paths.previousNormals[path] = hit.uvn.N();
+        paths.previousTriangles[path] = hit.triangle;
+        paths.bsdfPdfs[path] = brec.pdf;
+        paths.specularBounces[path] = hit.material->MatchesFlags(brec.sampledComponentIndex, BsdfCombinedFlags::Delta) ? 1 : 0;
+        paths.depths[path] = depth+1;
+        continuedPaths.push_back(path);
+    }
+
+    rayQueues[currentRayQueue].Append(continuedPaths);
+
+    uint32 first = shadowRayQueue.Reserve(static_cast<uint32>(shadowedPaths.size()));
+    std::copy(shadowedPaths.begin(), shadowedPaths.end(), shadowRayQueue.pathIndices.begin() + first);
+    std::copy(occlusionTesters.begin(), occlusionTesters.end(), shadowRayQueue.occlusionTesters.begin() + first);
+    std::copy(contributions.begin(), contributions.end(), shadowRayQueue.contributions.begin() + first);
+
+    stats.Counter("Wavefront", "Path vertices shaded").Add(end-begin);
+}
+
+void WavefrontRenderer::TestShadowRaysKernel(uint32 begin, uint32 end)
+{
+    // Shading queues at most one shadow ray per path, so paths are updated without synchronization
+    for (uint32 i = begin; i < end; ++i)
+    {
+        if (!shadowRayQueue.occlusionTesters[i].FindOcclusion(*scene))
+        {
+            paths.radiances[shadowRayQueue.pathIndices[i]] += shadowRayQueue.contributions[i];
+        }
+    }
+    stats.Counter("Rays", "Shadow rays traced").Add(end-begin);
+}
+
+void WavefrontRenderer::AccumulateSamplesKernel(uint32 begin, uint32 end)
+{
+    std::vector<FilmSample> samples;
+    samples.reserve(end-begin);
+    for (uint32 path = begin; path < end; ++path)
+    {
+        FilmSample s = { paths.radiances[path].ToXYZ(), paths.imageSamples[path], 1.0f };
+        samples.push_back(s);
+    }
+    camera->Film()->AddSamples(samples);
+}
+
+real WavefrontRenderer::LightPickPdf(const Vector3& point, const Vector3& normal, const ILight* light) const
+{
+    boost::unordered_map<const ILight*, size_t>::const_iterator it = lightIndices.find(light);
+    if (it == lightIndices.end()) return 0.0f;
+    return lightBvh->Pdf(point, normal, it->second);
+}
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef RENDERBLISS_WAVEFRONT_RENDERER_H
+#define RENDERBLISS_WAVEFRONT_RENDERER_H
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Interfaces/IRenderer.h"
+#include "renderbliss/Lights/LightBvh.h"
+#include "renderbliss/Math/Geometry/BoundingBox.h"
+#include "renderbliss/Rendering/WavefrontQueues.h"
+
+namespace renderbliss
+{
+class ILight;
+class JobScheduler;
+class MersenneTwister;
+class PropertyMap;
+class StatsTracker;
+
+// A path tracing renderer that processes paths breadth-first, in waves of many paths at once.
+// Each bounce runs as separate data-parallel stages over queues of path states: rays are extended
+// to their closest hits, the hits are shaded, and the shadow rays queued by shading are tested.
+// Every vertex samples one light and continues the path with one BSDF sample, and both
+// strategies are combined with multiple importance sampling.
+class WavefrontRenderer : public IRenderer
+{
+public:
+
+    WavefrontRenderer(const PropertyMap& props, const CameraConstPtr& camera, const SceneConstPtr& scene,
+                      JobScheduler& jobScheduler, StatsTracker& stats);
+    void Render();
+
+private:
+
+    friend class WavefrontStageJob;
+
+    enum Stage
+    {
+        GenerateCameraRays,
+        ExtendPaths,
+        ShadeHits,
+        TestShadowRays,
+        AccumulateSamples
+    };
+
+    struct Settings
+    {
+        uint32 maxPathDepth;
+        uint32 maxPathCount; // Number of paths in flight in a wave
+        uint32 itemsPerJob;  // Number of queue items processed by each job of a stage
+        bool sortRays;       // Whether secondary rays are sorted for coherence before being traced
+        Settings(const PropertyMap& props);
+    } settings;
+    mutable JobScheduler& jobScheduler;
+    mutable StatsTracker& stats;
+    boost::scoped_ptr<LightBvh> lightBvh;
+    boost::unordered_map<const ILight*, size_t> lightIndices;
+    BoundingBox sceneBound;
+
+    // Wavefront state
+    int xStart, yStart, width;
+    uint32 firstWavePixel;
+    PathStates paths;
+    WorkQueue rayQueues[2]; // Rays to extend at the current and the next bounce
+    uint32 currentRayQueue;
+    WorkQueue hitQueue;
+    ShadowRayQueue shadowRayQueue;
+
+    // Runs a stage over a number of items, split into jobs
+    void RunStage(Stage stage, uint32 itemCount);
+
+    // Sorts the queued rays by origin and direction, so that consecutive rays visit the same BVH nodes
+    void SortRayQueue();
+
+    // Stage kernels, each processing a range of items
+    void GenerateCameraRaysKernel(uint32 begin, uint32 end, MersenneTwister& rng);
+    void ExtendPathsKernel(uint32 begin, uint32 end);
+    void ShadeHitsKernel(uint32 begin, uint32 end, MersenneTwister& rng);
+    void TestShadowRaysKernel(uint32 begin, uint32 end);
+    void AccumulateSamplesKernel(uint32 begin, uint32 end);
+
+    // Returns the probability of picking an emitter for the light sample of a shading point
+    real LightPickPdf(const Vector3& point, const Vector3& normal, const ILight* light) const;
+};
+}
+
+#endif
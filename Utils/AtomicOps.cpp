@@ -19,16 +19,77 @@
 // THE SOFTWARE.
 
 #include "renderbliss/Utils/AtomicOps.h"
-#include <boost/interprocess/detail/atomic.hpp>
+#include <boost/version.hpp>
 #include "renderbliss/Macros.h"
 #include "renderbliss/Types.h"
 
+// boost::atomic_ref is only available from Boost 1.73 on.
+// Older versions fall back to compare-and-swap loops on the boost interprocess internals.
+#if BOOST_VERSION >= 107300
+#define RENDERBLISS_HAS_ATOMIC_REF
+#endif
+
+#ifdef RENDERBLISS_HAS_ATOMIC_REF
+
+#include <boost/atomic/atomic_ref.hpp>
+
+namespace
+{
+    using namespace renderbliss;
+
+    // Atomic operations on values in memory which are not declared atomic, such as the pixels of a film
+    template <typename T>
+    boost::atomic_ref<T> AtomicRef(volatile T* value)
+    {
+        return boost::atomic_ref<T>(const_cast<T&>(*value));
+    }
+}
+
+namespace renderbliss
+{
+uint32 AtomicAdd(volatile uint32* value, uint32 delta)
+{
+    RB_ASSERT(value);
+    return AtomicRef(value).fetch_add(delta);
+}
+
+// Processors without a floating point fetch-add fall back to a compare-and-swap loop
+float AtomicAdd(volatile float* value, float delta)
+{
+    RB_ASSERT(value);
+    return AtomicRef(value).fetch_add(delta);
+}
+
+uint32 AtomicIncrement(volatile uint32* value)
+{
+    RB_ASSERT(value);
+    return AtomicRef(value).fetch_add(1);
+}
+
+void AtomicCounter::Add(uint32 delta)
+{
+    AtomicRef(&count).fetch_add(delta, boost::memory_order_relaxed);
+}
+
+void AtomicCounter::operator++()
+{
+    AtomicRef(&count).fetch_add(1, boost::memory_order_relaxed);
+}
+
+void AtomicCounter::operator++(int)
+{
+    AtomicRef(&count).fetch_add(1, boost::memory_order_relaxed);
+}
+}
+
+#else
+
+#include <boost/interprocess/detail/atomic.hpp>
+
 namespace renderbliss
 {
 // FIXME The usage of this namespace is questionable, as it
-// is not part of the Boost public API. It would be advisable
-// to consider an atomic library. Candidates include the atomic
-// library shipping with Intel's TBB, or HP's atomic_ops library.
+// is not part of the Boost public API.
 using namespace boost::interprocess::ipcdetail;
 
 uint32 AtomicAdd(volatile uint32* value, uint32 delta)
@@ -40,7 +101,7 @@ uint32 AtomicAdd(volatile uint32* value, uint32 delta)
         oldValue = *value;
         newValue = oldValue + delta;
     } while(atomic_cas32(value, newValue, oldValue) != oldValue);
-    return newValue;
+    return oldValue;
 }
 
 float AtomicAdd(volatile float* value, float delta)
@@ -53,7 +114,7 @@ float AtomicAdd(volatile float* value, float delta)
         oldValue.f = *value;
         newValue.f = oldValue.f + delta;
     } while (atomic_cas32(v, newValue.i, oldValue.i) != oldValue.i);
-    return newValue.f;
+    return oldValue.f;
 }
 
 uint32 AtomicIncrement(volatile uint32* value)
@@ -62,10 +123,6 @@ uint32 AtomicIncrement(volatile uint32* value)
     return atomic_inc32(value);
 }
 
-AtomicCounter::AtomicCounter() : count(0)
-{
-}
-
 void AtomicCounter::Add(uint32 delta)
 {
     AtomicAdd(&count, delta);
@@ -80,6 +137,15 @@ void AtomicCounter::operator++(int)
 {
     AtomicIncrement(&count);
 }
+}
+
+#endif
+
+namespace renderbliss
+{
+AtomicCounter::AtomicCounter() : count(0)
+{
+}
 
 AtomicCounter::operator uint32() const volatile
 {
@@ -21,10 +21,20 @@
 #ifndef RENDERBLISS_ATOMIC_OPS_H
 #define RENDERBLISS_ATOMIC_OPS_H
 
+#include <cstddef>
+#include <boost/config.hpp>
 #include "renderbliss/Types.h"
 
+// Size of the cache lines of the processors the renderer runs on, in bytes.
+// A literal is needed by the alignment specifiers of some compilers.
+#define RENDERBLISS_CACHE_LINE_SIZE 64
+
 namespace renderbliss
 {
+const size_t cacheLineSize = RENDERBLISS_CACHE_LINE_SIZE;
+
+// The below operations are sequentially consistent, and use the fetch-add instructions of the processor where available.
+
 // Atomically adds a delta to a 32-bit integer in memory and returns its previous value.
 uint32 AtomicAdd(volatile uint32* value, uint32 delta);
 
@@ -34,7 +44,8 @@ float AtomicAdd(volatile float* value, float delta);
 // Atomically increments a 32-bit integer in memory and returns its previous value.
 uint32 AtomicIncrement(volatile uint32* value);
 
-// Helper class for atomic integral count operations
+// Helper class for atomic integral count operations.
+// Counts are only read once the threads updating them are done, so they are updated without ordering constraints.
 class AtomicCounter
 {
 public:
@@ -49,6 +60,15 @@ private:
 
     volatile uint32 count;
 };
+
+// Atomic counter aligned and padded to a cache line, so that threads updating different counters do not contend for the same line.
+// Before C++17, heap allocations may not honour the alignment, and only the padding is guaranteed.
+class BOOST_ALIGNMENT(RENDERBLISS_CACHE_LINE_SIZE) PaddedAtomicCounter : public AtomicCounter
+{
+private:
+
+    byte padding[cacheLineSize - sizeof(AtomicCounter)];
+};
 }
 
 #endif
@@ -20,7 +20,9 @@
 
 #include "renderbliss/Utils/JobScheduler.h"
 #include <deque>
+#include <boost/exception_ptr.hpp>
 #include <boost/thread.hpp>
+#include "renderbliss/Macros.h"
 #include "renderbliss/Types.h"
 #include "renderbliss/Interfaces/IJob.h"
 #include "renderbliss/Utils/Utils.h"
@@ -37,13 +39,24 @@ public:
     void Enqueue(const JobConstPtr& job);
     // Adds jobs to the queue. Should be called as part of a preprocessing step before all jobs are run.
     void Enqueue(const JobList& jobs);
-    // Fetches and returns a job from the queue. Returns a null job if the queue is empty.
+    // Fetches and returns a job from the queue. While the queue is empty, waits for the running jobs,
+    // which may enqueue further jobs. Returns a null job once the queue is empty and no job is running.
     JobConstPtr Next();
+    // Signals that a job returned by Next() has finished running.
+    void JobDone();
+    // Records the exception thrown by a running job, and drops the queued jobs, as well as the jobs enqueued
+    // until the exception is rethrown. Only the first exception is kept.
+    void JobFailed(const boost::exception_ptr& exception);
+    // Rethrows the exception of a failed job, if any, and clears it so that the queue can be reused.
+    void RethrowJobFailure();
 
 private:
 
     mutable boost::mutex mutex;
+    boost::condition_variable jobsChanged;
     std::deque<JobConstPtr> jobs;
+    unsigned numRunningJobs;
+    boost::exception_ptr failure;
 };
 
 // Thread running jobs fetched from a job queue
@@ -62,23 +75,30 @@ private:
 
 namespace renderbliss
 {
-JobQueue::JobQueue()
+JobQueue::JobQueue() : numRunningJobs(0)
 {
 }
 
 void JobQueue::Enqueue(const JobConstPtr& job)
 {
-    boost::mutex::scoped_lock lock(mutex);
-    if (job) jobs.push_back(job);
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        if (job && !failure) jobs.push_back(job);
+    }
+    jobsChanged.notify_one();
 }
 
 void JobQueue::Enqueue(const JobList& jobs)
 {
-    boost::mutex::scoped_lock lock(mutex);
-    foreach (const JobConstPtr& j, jobs)
     {
-        if (j) this->jobs.push_back(j);
+        boost::mutex::scoped_lock lock(mutex);
+        if (failure) return;
+        foreach (const JobConstPtr& j, jobs)
+        {
+            if (j) this->jobs.push_back(j);
+        }
     }
+    jobsChanged.notify_all();
 }
 
 JobConstPtr JobQueue::Next()
@@ -86,15 +106,49 @@ JobConstPtr JobQueue::Next()
     JobConstPtr result;
     {
         boost::mutex::scoped_lock lock(mutex);
+        while (jobs.empty() && numRunningJobs)
+        {
+            jobsChanged.wait(lock);
+        }
         if (!jobs.empty())
         {
             result = jobs.front();
             jobs.pop_front();
+            ++numRunningJobs;
         }
     }
     return result;
 }
 
+void JobQueue::JobDone()
+{
+    bool allDone = false;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        RB_ASSERT(numRunningJobs);
+        allDone = !--numRunningJobs && jobs.empty();
+    }
+    if (allDone) jobsChanged.notify_all();
+}
+
+void JobQueue::JobFailed(const boost::exception_ptr& exception)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    if (!failure) failure = exception;
+    jobs.clear();
+}
+
+void JobQueue::RethrowJobFailure()
+{
+    boost::exception_ptr exception;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        exception = failure;
+        failure = boost::exception_ptr();
+    }
+    if (exception) boost::rethrow_exception(exception);
+}
+
 SchedulerThread::SchedulerThread(const boost::shared_ptr<JobQueue>& jobQueue) : jobQueue(jobQueue)
 {
 }
@@ -103,7 +157,16 @@ void SchedulerThread::operator()()
 {
     while (JobConstPtr j = jobQueue->Next())
     {
-        j->Run();
+        // The job must be counted as done even if it throws, or the other threads would wait for it forever
+        try
+        {
+            j->Run();
+        }
+        catch (...)
+        {
+            jobQueue->JobFailed(boost::current_exception());
+        }
+        jobQueue->JobDone();
     }
 }
 
@@ -147,6 +210,7 @@ void JobScheduler::WaitForAllJobs()
             threads.add_thread(new boost::thread(SchedulerThread(jobQueue)));
         }
         threads.join_all();
+        jobQueue->RethrowJobFailure();
     }
 }
 }
@@ -31,7 +31,8 @@ class IJob;
 class JobQueue;
 typedef boost::shared_ptr<const IJob> JobConstPtr;
 typedef std::vector<JobConstPtr> JobList;
-// A scheduler responsible for spawning and running concurrent jobs
+// A scheduler responsible for spawning and running concurrent jobs.
+// Running jobs may spawn further jobs, for instance to recursively split their work.
 class JobScheduler : boost::noncopyable
 {
 public:
@@ -46,7 +47,8 @@ public:
     // The jobs are run immediately if there is only one hardware thread in the system.
     void Spawn(const JobList& jobs);
 
-    // Waits for all jobs to finish
+    // Waits for all jobs to finish, including the jobs spawned by running jobs.
+    // If a job throws, the jobs not yet started are dropped and the exception is rethrown here once the running jobs are done.
     void WaitForAllJobs();
 
 private:
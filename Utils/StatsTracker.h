@@ -44,7 +44,8 @@ public:
 
 private:
 
-    typedef boost::unordered_map<std::string/*name*/, AtomicCounter> CounterMap;
+    // Counters are padded, as threads updating counters in nearby map nodes would otherwise contend for cache lines
+    typedef boost::unordered_map<std::string/*name*/, PaddedAtomicCounter> CounterMap;
     typedef boost::unordered_map<std::string/*name*/, renderbliss::Timer> TimerMap;
     typedef boost::unordered_map<std::string/*category*/, CounterMap> CounterCategoryMap;
     typedef boost::unordered_map<std::string/*category*/, TimerMap> TimerCategoryMap;
@@ -23,18 +23,20 @@
 
 namespace renderbliss
 {
-Timer::Timer(const std::string& label) : label(label)
+Timer::Timer(const std::string& label) : label(label), elapsed(0.0)
 {
 }
 
 void Timer::Start()
 {
-    timer.restart();
+    startTime = boost::posix_time::microsec_clock::universal_time();
 }
 
 void Timer::Stop()
 {
-    elapsed = timer.elapsed();
+    // Unlike processor time, wall-clock time does not add up the time spent by each thread
+    boost::posix_time::time_duration duration = boost::posix_time::microsec_clock::universal_time() - startTime;
+    elapsed = duration.total_microseconds() * 1.0e-6;
 }
 
 double Timer::Elapsed() const
@@ -23,11 +23,11 @@
 
 #include <iosfwd>
 #include <string>
-#include <boost/timer.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
 namespace renderbliss
 {
-// Platform independent timer class
+// Platform independent timer class, measuring wall-clock time
 // Usage example:
 //   Timer t;
 //   t.Start();
@@ -49,7 +49,7 @@ public:
 private:
 
     std::string label;
-    boost::timer timer;
+    boost::posix_time::ptime startTime;
     double elapsed;
 };
 
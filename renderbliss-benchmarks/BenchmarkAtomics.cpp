@@ -0,0 +1,164 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/interprocess/detail/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include "Benchmarks.h"
+#include "renderbliss/Types.h"
+#include "renderbliss/Utils/AtomicOps.h"
+#include "renderbliss/Utils/Timer.h"
+#include "renderbliss/Utils/Utils.h"
+
+namespace
+{
+using namespace renderbliss;
+
+const uint32 numAdds = 4000000;
+
+// The counter as it was implemented before the fetch-add instructions were used,
+// retrying a compare-and-swap until no other thread changed the count in between
+class CasLoopCounter
+{
+public:
+
+    CasLoopCounter() : count(0) {}
+
+    void operator++()
+    {
+        uint32 oldValue;
+        do
+        {
+            oldValue = count;
+        } while (boost::interprocess::ipcdetail::atomic_cas32(&count, oldValue+1, oldValue) != oldValue);
+    }
+
+    operator uint32() const volatile {return count;}
+
+private:
+
+    volatile uint32 count;
+};
+
+// The floating point addition as it was implemented before, through a compare-and-swap loop on the bits of the value
+void CasLoopAdd(volatile float* value, float delta)
+{
+    volatile uint32* v = reinterpret_cast<volatile uint32*>(value);
+    union {float f; uint32 i;} oldValue, newValue;
+    do
+    {
+        oldValue.f = *value;
+        newValue.f = oldValue.f + delta;
+    } while (boost::interprocess::ipcdetail::atomic_cas32(v, newValue.i, oldValue.i) != oldValue.i);
+}
+
+template <typename Counter>
+void Count(Counter* counter)
+{
+    for (uint32 i = 0; i < numAdds; ++i)
+    {
+        ++*counter;
+    }
+}
+
+void AddFloats(volatile float* value)
+{
+    for (uint32 i = 0; i < numAdds; ++i)
+    {
+        AtomicAdd(value, 1.0f);
+    }
+}
+
+void CasLoopAddFloats(volatile float* value)
+{
+    for (uint32 i = 0; i < numAdds; ++i)
+    {
+        CasLoopAdd(value, 1.0f);
+    }
+}
+
+// Times the given functions, each run on a thread of its own
+void TimeThreads(const std::string& name, const std::vector<boost::function<void ()> >& functions)
+{
+    Timer timer("    " + name);
+    timer.Start();
+    boost::thread_group threads;
+    for (size_t i = 0; i < functions.size(); ++i)
+    {
+        threads.create_thread(functions[i]);
+    }
+    threads.join_all();
+    timer.Stop();
+    std::cout << timer << std::endl;
+}
+
+// Times all threads incrementing one shared counter
+template <typename Counter>
+void TimeSharedCounter(const std::string& name, unsigned numThreads)
+{
+    Counter counter;
+    std::vector<boost::function<void ()> > functions(numThreads, boost::bind(&Count<Counter>, &counter));
+    TimeThreads(name, functions);
+    std::cout << "  " << name << " count " << static_cast<uint32>(counter) << std::endl;
+}
+
+// Times each thread incrementing a counter of its own, the counters being next to each other in memory
+template <typename Counter>
+void TimeAdjacentCounters(const std::string& name, unsigned numThreads)
+{
+    std::vector<Counter> counters(numThreads);
+    std::vector<boost::function<void ()> > functions;
+    for (unsigned i = 0; i < numThreads; ++i)
+    {
+        functions.push_back(boost::bind(&Count<Counter>, &counters[i]));
+    }
+    TimeThreads(name, functions);
+}
+
+// Times all threads adding to one shared floating point value
+void TimeSharedFloat(const std::string& name, void (*addFloats)(volatile float*), unsigned numThreads)
+{
+    volatile float value = 0.0f;
+    std::vector<boost::function<void ()> > functions(numThreads, boost::bind(addFloats, &value));
+    TimeThreads(name, functions);
+    std::cout << "  " << name << " sum " << value << std::endl;
+}
+}
+
+namespace renderbliss
+{
+void BenchmarkAtomics()
+{
+    // At least two threads, so that there is contention even on a single core
+    unsigned numThreads = std::max(HardwareThreadCount(), 2u);
+    std::cout << "Atomics, " << numThreads << " threads, " << numAdds << " additions per thread" << std::endl;
+    TimeSharedCounter<CasLoopCounter>("Shared counter, compare-and-swap loop", numThreads);
+    TimeSharedCounter<AtomicCounter>("Shared counter, fetch-add", numThreads);
+    TimeAdjacentCounters<AtomicCounter>("Counter per thread, unpadded", numThreads);
+    TimeAdjacentCounters<PaddedAtomicCounter>("Counter per thread, padded", numThreads);
+    TimeSharedFloat("Shared float, compare-and-swap loop", &CasLoopAddFloats, numThreads);
+    TimeSharedFloat("Shared float, fetch-add", &AddFloats, numThreads);
+}
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Benchmarks.h"
+#include "renderbliss/Types.h"
+#include "renderbliss/Colour/Spectrum.h"
+#include "renderbliss/Integrators/PhotonMapping/PhotonMap.h"
+#include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Math/Geometry/Vector3.h"
+#include "renderbliss/Utils/JobScheduler.h"
+#include "renderbliss/Utils/PropertyMap.h"
+#include "renderbliss/Utils/Timer.h"
+
+namespace
+{
+using namespace renderbliss;
+
+const uint32 numPhotons = 1000000;
+const uint32 numQueries = 200000;
+
+// Returns a random point on the faces of the unit cube, where photons usually lie on surfaces
+Vector3 RandomSurfacePoint(MersenneTwister& rng)
+{
+    Vector3 p(rng.CanonicalRandom(), rng.CanonicalRandom(), rng.CanonicalRandom());
+    p[rng.RandomUint(2)] = static_cast<real>(rng.RandomUint(1));
+    return p;
+}
+
+// Times the balancing and the lookups of a photon map with a given lookup structure and gather radius
+void TimePhotonMapLookup(const std::string& lookup, real gatherRadius)
+{
+    PropertyMap props;
+    props.Set<uint32>("photons_to_store", numPhotons);
+    props.Set<uint32>("photons_to_gather", 100);
+    props.Set<real>("gather_radius", gatherRadius);
+    props.Set<std::string>("photon_lookup", lookup);
+    PhotonMap photonMap(props);
+
+    MersenneTwister rng;
+    std::vector<Vector3> positions, directions;
+    std::vector<Spectrum> powers;
+    for (uint32 i = 0; i < numPhotons; ++i)
+    {
+        positions.push_back(RandomSurfacePoint(rng));
+        directions.push_back(Vector3(rng.CanonicalRandom(), rng.CanonicalRandom(), 1.0f).GetNormalized());
+        powers.push_back(Spectrum(1.0f));
+    }
+    photonMap.StorePhotons(positions, directions, powers);
+
+    JobScheduler scheduler;
+    Timer balanceTimer("  Balancing");
+    balanceTimer.Start();
+    photonMap.Balance(scheduler);
+    balanceTimer.Stop();
+
+    std::vector<Vector3> queryPoints;
+    for (uint32 i = 0; i < numQueries; ++i)
+    {
+        queryPoints.push_back(RandomSurfacePoint(rng));
+    }
+
+    Timer lookupTimer("  Irradiance estimates");
+    real checksum = 0.0f;
+    lookupTimer.Start();
+    foreach (const Vector3& p, queryPoints)
+    {
+        checksum += photonMap.IrradianceEstimate(p, Vector3(0.0f, 0.0f, 1.0f), 100, gatherRadius).Luminance();
+    }
+    lookupTimer.Stop();
+
+    std::cout << "Photon map lookup (" << lookup << ", radius " << gatherRadius << "), " << numPhotons << " photons, " << numQueries << " queries (checksum " << checksum << ")" << std::endl;
+    std::cout << balanceTimer << std::endl;
+    std::cout << lookupTimer << std::endl;
+}
+}
+
+namespace renderbliss
+{
+void BenchmarkPhotonMapLookup()
+{
+    // The smaller radius holds about as many photons as are gathered
+    TimePhotonMapLookup("kd_tree", 0.05f);
+    TimePhotonMapLookup("hash_grid", 0.05f);
+    TimePhotonMapLookup("kd_tree", 0.015f);
+    TimePhotonMapLookup("hash_grid", 0.015f);
+}
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <iostream>
+#include <limits>
+#include <vector>
+#include "Benchmarks.h"
+#include "renderbliss/Types.h"
+#include "renderbliss/Lights/AliasSampler.h"
+#include "renderbliss/Lights/StepFunctionSampler.h"
+#include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Utils/Timer.h"
+
+namespace
+{
+using namespace renderbliss;
+
+const size_t numSamples = 10000000;
+
+// Draws samples from a sampler, and returns a checksum of the sampled indices so the loop is not optimized away
+template <typename SamplerType>
+size_t DrawSamples(const SamplerType& sampler, const std::vector<real>& canonicalRandoms, Timer& timer)
+{
+    size_t checksum = 0;
+    timer.Start();
+    for (size_t i = 0; i < canonicalRandoms.size(); ++i)
+    {
+        checksum += sampler.SampleIndex(canonicalRandoms[i]);
+    }
+    timer.Stop();
+    return checksum;
+}
+}
+
+namespace renderbliss
+{
+void BenchmarkStepFunctionSampling()
+{
+    MersenneTwister rng;
+    std::vector<real> canonicalRandoms(numSamples);
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+        canonicalRandoms[i] = rng.CanonicalRandom();
+    }
+
+    std::cout << "Step function sampling, " << numSamples << " samples" << std::endl;
+    for (size_t numSteps = 16; numSteps <= 1048576; numSteps *= 16)
+    {
+        std::vector<real> function(numSteps);
+        for (size_t i = 0; i < numSteps; ++i)
+        {
+            function[i] = rng.CanonicalRandom();
+        }
+
+        StepFunctionSampler cdfSampler(function, std::numeric_limits<size_t>::max());
+        AliasSampler aliasSampler(function);
+
+        Timer cdfTimer("  CDF search"), aliasTimer("  Alias table");
+        size_t cdfChecksum = DrawSamples(cdfSampler, canonicalRandoms, cdfTimer);
+        size_t aliasChecksum = DrawSamples(aliasSampler, canonicalRandoms, aliasTimer);
+
+        std::cout << numSteps << " steps (checksums " << cdfChecksum << ", " << aliasChecksum << ")" << std::endl;
+        std::cout << cdfTimer << std::endl;
+        std::cout << aliasTimer << std::endl;
+    }
+}
+}
@@ -0,0 +1,151 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Benchmarks.h"
+#include "renderbliss/Types.h"
+#include "renderbliss/Colour/Spectrum.h"
+#include "renderbliss/Integrators/PhotonMapping/PhotonMap.h"
+#include "renderbliss/Interfaces/IRenderingJob.h"
+#include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Math/Geometry/Vector3.h"
+#include "renderbliss/Rendering/TileOrder.h"
+#include "renderbliss/Utils/JobScheduler.h"
+#include "renderbliss/Utils/PropertyMap.h"
+#include "renderbliss/Utils/Timer.h"
+
+namespace
+{
+using namespace renderbliss;
+
+const uint32 numPhotons = 2000000;
+const int imageSide = 512;
+const real gatherRadius = 0.005f;
+
+// Looks up the photon map at every pixel of a tile, where pixels map to points of the unit square,
+// as a rendering job would while shading the surface seen through the tile
+class TileLookupJob : public IRenderingJob
+{
+public:
+
+    TileLookupJob(const RenderingWorkArea& workArea, const PhotonMap& photonMap, real& checksum)
+        : IRenderingJob(workArea), photonMap(photonMap), checksum(checksum) {}
+
+    virtual void Run() const
+    {
+        real sum = 0.0f;
+        for (int y = workArea.yStart; y <= workArea.yEnd; ++y)
+        {
+            for (int x = workArea.xStart; x <= workArea.xEnd; ++x)
+            {
+                Vector3 p((x+0.5f)/imageSide, (y+0.5f)/imageSide, 0.0f);
+                sum += photonMap.IrradianceEstimate(p, Vector3(0.0f, 0.0f, 1.0f), 50, gatherRadius).Luminance();
+            }
+        }
+        checksum = sum;
+    }
+
+private:
+
+    const PhotonMap& photonMap;
+    real& checksum;
+};
+
+// Returns the mean distance between consecutive tiles, in tiles, as a measure of the locality of an order
+real MeanTileStep(const std::vector<RenderingWorkArea>& tiles, uint32 tileSize)
+{
+    real sum = 0.0f;
+    for (size_t i = 1; i < tiles.size(); ++i)
+    {
+        real dx = static_cast<real>(tiles[i].xStart - tiles[i-1].xStart);
+        real dy = static_cast<real>(tiles[i].yStart - tiles[i-1].yStart);
+        sum += std::sqrt(dx*dx + dy*dy);
+    }
+    return (tiles.size() > 1) ? sum / ((tiles.size()-1)*tileSize) : 0.0f;
+}
+
+// Times the photon map lookups of all the tiles of the image, scheduled in a given order
+void TimeTileOrder(const PhotonMap& photonMap, JobScheduler& scheduler, const std::string& orderName, uint32 tileSize)
+{
+    std::vector<RenderingWorkArea> tiles;
+    MakeTiles(0, 0, imageSide-1, imageSide-1, tileSize, GetTileOrder(orderName), tiles);
+    std::vector<real> checksums(tiles.size(), 0.0f);
+    JobList jobs;
+    for (size_t i = 0; i < tiles.size(); ++i)
+    {
+        jobs.push_back(JobConstPtr(new TileLookupJob(tiles[i], photonMap, checksums[i])));
+    }
+
+    Timer lookupTimer("    Irradiance estimates");
+    lookupTimer.Start();
+    scheduler.Spawn(jobs);
+    scheduler.WaitForAllJobs();
+    lookupTimer.Stop();
+
+    real checksum = 0.0f;
+    foreach (real c, checksums)
+    {
+        checksum += c;
+    }
+    std::cout << "  " << orderName << " (mean step " << MeanTileStep(tiles, tileSize) << " tiles, checksum " << checksum << ")" << std::endl;
+    std::cout << lookupTimer << std::endl;
+}
+}
+
+namespace renderbliss
+{
+void BenchmarkTileOrder()
+{
+    // The photon map is much larger than the caches, so that the lookups of a tile only
+    // find photons in the cache if they were loaded by nearby tiles
+    PropertyMap props;
+    props.Set<uint32>("photons_to_store", numPhotons);
+    props.Set<uint32>("photons_to_gather", 50);
+    props.Set<real>("gather_radius", gatherRadius);
+    PhotonMap photonMap(props);
+
+    MersenneTwister rng;
+    std::vector<Vector3> positions, directions;
+    std::vector<Spectrum> powers;
+    for (uint32 i = 0; i < numPhotons; ++i)
+    {
+        positions.push_back(Vector3(rng.CanonicalRandom(), rng.CanonicalRandom(), 0.0f));
+        directions.push_back(Vector3(rng.CanonicalRandom(), rng.CanonicalRandom(), 1.0f).GetNormalized());
+        powers.push_back(Spectrum(1.0f));
+    }
+    photonMap.StorePhotons(positions, directions, powers);
+    JobScheduler scheduler;
+    photonMap.Balance(scheduler);
+
+    const char* orderNames[] = {"scanline", "morton", "hilbert", "spiral"};
+    for (uint32 tileSize = 8; tileSize <= 32; tileSize *= 2)
+    {
+        std::cout << "Tile order, " << imageSide << "x" << imageSide << " pixels, " << tileSize << "x" << tileSize
+                  << " tiles, " << numPhotons << " photons" << std::endl;
+        foreach (const char* orderName, orderNames)
+        {
+            TimeTileOrder(photonMap, scheduler, orderName, tileSize);
+        }
+    }
+}
+}
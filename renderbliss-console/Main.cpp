@@ -18,7 +18,9 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <string>
 #include <vector>
+#include <boost/bind.hpp>
 #include <log++/Log++.h>
 #include <log++/FileDestination.h>
 #include "renderbliss/Scene.h"
@@ -27,8 +29,10 @@
 #include "renderbliss/Colour/Spectrum.h"
 #include "renderbliss/Colour/Data/CornellBox.h"
 #include "renderbliss/ImageIO/ImageIO.h"
+#include "renderbliss/ImageIO/TileImageWriter.h"
 #include "renderbliss/Integrators/PathIntegrator.h"
 #include "renderbliss/Integrators/PhotonIntegrator.h"
+#include "renderbliss/Integrators/ProgressivePhotonIntegrator.h"
 #include "renderbliss/Integrators/WhittedIntegrator.h"
 #include "renderbliss/Lights/Luminaire.h"
 #include "renderbliss/Materials/LambertianMaterial.h"
@@ -36,14 +40,34 @@
 #include "renderbliss/Math/Geometry/Vector3.h"
 #include "renderbliss/Math/Sampling/Filters/TriangleFilter.h"
 #include "renderbliss/Primitives/MeshPrimitive.h"
+#include "renderbliss/Rendering/BatchRenderer.h"
 #include "renderbliss/Rendering/Renderer.h"
+#include "renderbliss/Rendering/RenderServer.h"
+#include "renderbliss/Rendering/TileCoordinator.h"
+#include "renderbliss/Rendering/TileWorker.h"
+#include "renderbliss/Rendering/WavefrontRenderer.h"
 #include "renderbliss/Textures/ConstantTexture.h"
 #include "renderbliss/Utils/JobScheduler.h"
 #include "renderbliss/Utils/JobScheduler.h"
 #include "renderbliss/Utils/PropertyMap.h"
 #include "renderbliss/Utils/StatsTracker.h"
 
-int main()
+namespace
+{
+// Queues the final pixels of a film tile for writing
+void StreamTile(const renderbliss::IFilm* film, renderbliss::TileImageWriter* writer, const renderbliss::RenderingWorkArea& region)
+{
+    renderbliss::ImageTile tile;
+    tile.x = static_cast<renderbliss::uint32>(region.xStart);
+    tile.y = static_cast<renderbliss::uint32>(region.yStart);
+    tile.width = static_cast<renderbliss::uint32>(region.xEnd-region.xStart+1);
+    tile.height = static_cast<renderbliss::uint32>(region.yEnd-region.yStart+1);
+    film->StoreRegion(region, tile.pixels);
+    writer->Write(tile);
+}
+}
+
+int main(int argc, char* argv[])
 {
     logpp::LogDestinationPtr fileDest(new logpp::LogFileDestination("renderbliss.log", true));
     logpp::GlobalLogger().AddDestination(fileDest);
@@ -265,6 +289,97 @@ int main()
 
     JobScheduler jobScheduler;
 
+    // Multi-process rendering: "renderbliss-console coordinator" hands out the tiles of the image to
+    // the processes started with "renderbliss-console worker [host]", on this machine or others
+    std::string mode = (argc > 1) ? argv[1] : "";
+    if ((mode == "coordinator") || (mode == "worker"))
+    {
+        if (argc > 2)
+        {
+            props.Set<std::string>("coordinator_host", argv[2]);
+        }
+        boost::shared_ptr<IFilm> film(new ImageFilm(512, 512, filter, dummyToneMapper));
+        boost::shared_ptr<const ICamera> camera(new ThinLensCamera(film, 16, Vector3(278.0f, 273.0f, -800.0f), Vector3(278.0f, 273.0f, 1.0f), Vector3::unitY, 37.0f, 800.0f, 0.025f));
+        StatsTracker stats;
+        boost::shared_ptr<SurfaceIntegrator> photon(new PhotonIntegrator(props, stats));
+        if (mode == "coordinator")
+        {
+            TileCoordinator coordinator(props, camera, photon->PassCount(), stats);
+            coordinator.Render();
+            RGBPixelList pixels;
+            camera->Film()->StorePixels(pixels);
+            SavePNG("cornell-photon-map.png", pixels, film->XResolution(), film->YResolution());
+        }
+        else
+        {
+            TileWorker worker(props, camera, scn, photon, jobScheduler, stats);
+            worker.Render();
+        }
+        stats.Log();
+        return 0;
+    }
+
+    // Render server: "renderbliss-console server" keeps the scene and the preprocessed integrators in memory,
+    // and renders the requests sent by "renderbliss-console client [host]" from this machine
+    if (mode == "server")
+    {
+        StatsTracker stats;
+        RenderServer server(props, scn, filter, jobScheduler, stats);
+        server.Serve();
+        stats.Log();
+        return 0;
+    }
+    if (mode == "client")
+    {
+        RenderRequest request;
+        request.eye = Vector3(278.0f, 273.0f, -800.0f);
+        request.lookAt = Vector3(278.0f, 273.0f, 1.0f);
+        request.up = Vector3::unitY;
+        request.horizontalFieldOfView = 37.0f;
+        request.focusDistance = 800.0f;
+        request.aperture = 0.025f;
+        request.xResolution = 512;
+        request.yResolution = 512;
+        request.pixelSamplerWidth = 4;
+        request.integrator = "photon";
+        RGBPixelList pixels;
+        std::string host = (argc > 2) ? argv[2] : "127.0.0.1";
+        uint32 port = 0;
+        props.Get<uint32>("server_port", 7374, port);
+        if (!RequestRender(host, port, request, pixels))
+        {
+            return 1;
+        }
+        SaveEXR("cornell-server.exr", pixels, request.xResolution, request.yResolution);
+        return 0;
+    }
+
+    // Batch rendering: "renderbliss-console batch" renders the box from three viewpoints,
+    // sharing the photon maps and the rendering threads between the images
+    if (mode == "batch")
+    {
+        const real eyeOffsets[] = {-150.0f, 0.0f, 150.0f};
+        std::vector<CameraConstPtr> cameras;
+        for (size_t i = 0; i < 3; ++i)
+        {
+            boost::shared_ptr<IFilm> film(new ImageFilm(512, 512, filter, dummyToneMapper));
+            cameras.push_back(CameraConstPtr(new ThinLensCamera(film, 16, Vector3(278.0f + eyeOffsets[i], 273.0f, -800.0f), Vector3(278.0f, 273.0f, 1.0f), Vector3::unitY, 37.0f, 800.0f, 0.025f)));
+        }
+        StatsTracker stats;
+        boost::shared_ptr<SurfaceIntegrator> photon(new PhotonIntegrator(props, stats));
+        BatchRenderer renderer(props, cameras, scn, photon, jobScheduler, stats);
+        renderer.Render();
+        for (size_t i = 0; i < cameras.size(); ++i)
+        {
+            RGBPixelList pixels;
+            cameras[i]->Film()->StorePixels(pixels);
+            std::string fileName = "cornell-photon-map-" + std::string(1, static_cast<char>('0' + i)) + ".png";
+            SavePNG(fileName, pixels, cameras[i]->Film()->XResolution(), cameras[i]->Film()->YResolution());
+        }
+        stats.Log();
+        return 0;
+    }
+
     //{
     //    boost::shared_ptr<IFilm> film(new ImageFilm(512, 512, filter, dummyToneMapper));
     //    boost::shared_ptr<const ICamera> camera(new ThinLensCamera(film, 4, Vector3(278.0f, 273.0f, -800.0f), Vector3(278.0f, 273.0f, 1.0f), Vector3::unitY, 37.0f, 800.0f, 0.025f));
@@ -291,13 +406,43 @@ int main()
     //    stats.Log();
     //}
 
+    //{
+    //    boost::shared_ptr<IFilm> film(new ImageFilm(512, 512, filter, dummyToneMapper));
+    //    boost::shared_ptr<const ICamera> camera(new ThinLensCamera(film, 4, Vector3(278.0f, 273.0f, -800.0f), Vector3(278.0f, 273.0f, 1.0f), Vector3::unitY, 37.0f, 800.0f, 0.025f));
+    //    StatsTracker stats;
+    //    boost::shared_ptr<SurfaceIntegrator> progressive(new ProgressivePhotonIntegrator(props, stats));
+    //    Renderer renderer(props, camera, scn, progressive, jobScheduler, stats);
+    //    renderer.Render();
+    //    RGBPixelList pixels;
+    //    camera->Film()->StorePixels(pixels);
+    //    SavePNG("cornell-progressive-photon-map.png", pixels, film->XResolution(), film->YResolution());
+    //    stats.Log();
+    //}
+
+    //{
+    //    boost::shared_ptr<IFilm> film(new ImageFilm(512, 512, filter, dummyToneMapper));
+    //    boost::shared_ptr<const ICamera> camera(new ThinLensCamera(film, 4, Vector3(278.0f, 273.0f, -800.0f), Vector3(278.0f, 273.0f, 1.0f), Vector3::unitY, 37.0f, 800.0f, 0.025f));
+    //    StatsTracker stats;
+    //    WavefrontRenderer renderer(props, camera, scn, jobScheduler, stats);
+    //    renderer.Render();
+    //    RGBPixelList pixels;
+    //    camera->Film()->StorePixels(pixels);
+    //    SavePNG("cornell-wavefront-path.png", pixels, film->XResolution(), film->YResolution());
+    //    stats.Log();
+    //}
+
     {
         boost::shared_ptr<IFilm> film(new ImageFilm(512, 512, filter, dummyToneMapper));
         boost::shared_ptr<const ICamera> camera(new ThinLensCamera(film, 16, Vector3(278.0f, 273.0f, -800.0f), Vector3(278.0f, 273.0f, 1.0f), Vector3::unitY, 37.0f, 800.0f, 0.025f));
         StatsTracker stats;
         boost::shared_ptr<SurfaceIntegrator> photon(new PhotonIntegrator(props, stats));
         Renderer renderer(props, camera, scn, photon, jobScheduler, stats);
+
+        // The linear radiance of finished tiles is written while the rest of the image renders
+        TileImageWriter writer("cornell-photon-map.exr", film->XResolution(), film->YResolution(), renderer.TileSize());
+        renderer.SetTileCallback(boost::bind(&StreamTile, film.get(), &writer, _1));
         renderer.Render();
+        writer.Close();
         RGBPixelList pixels;
         camera->Film()->StorePixels(pixels);
         SavePNG("cornell-photon-map.png", pixels, film->XResolution(), film->YResolution());
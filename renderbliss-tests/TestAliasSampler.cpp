@@ -0,0 +1,122 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <cmath>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Math/MathUtils.h"
+#include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Lights/AliasSampler.h"
+#include "renderbliss/Lights/StepFunctionSampler.h"
+
+namespace
+{
+using namespace renderbliss;
+
+struct AliasFixture
+{
+    std::vector<real> function;
+    boost::scoped_ptr<AliasSampler> as;
+    AliasFixture()
+    {
+        for (int i = 0; i < 10; ++i)
+        {
+            function.push_back(static_cast<real>(i+1));
+        }
+        function[4] = 0.0f;
+        as.reset(new AliasSampler(function));
+    }
+};
+
+TEST_FIXTURE(AliasFixture, CheckAliasFunctionIntegral)
+{
+    CHECK_CLOSE(50.0f, as->FunctionIntegral(), Epsilon());
+    CHECK_EQUAL(static_cast<size_t>(10), as->StepCount());
+}
+
+TEST_FIXTURE(AliasFixture, CheckAliasFunctionValue)
+{
+    for (size_t i = 0; i < 10; ++i)
+    {
+        CHECK_CLOSE(function[i], as->FunctionValue(i), Epsilon());
+    }
+}
+
+TEST_FIXTURE(AliasFixture, CheckAliasSampleFrequencies)
+{
+    // Stratified canonical randoms pick each step in proportion to its value
+    const int numSamples = 50000;
+    std::vector<int> counts(10, 0);
+    for (int i = 0; i < numSamples; ++i)
+    {
+        size_t index = as->SampleIndex((i+0.5f)/numSamples);
+        CHECK(index < 10);
+        ++counts[index];
+    }
+    CHECK_EQUAL(0, counts[4]);
+    for (size_t i = 0; i < 10; ++i)
+    {
+        CHECK_CLOSE(function[i]/50.0f, static_cast<real>(counts[i])/numSamples, 1e-3f);
+    }
+}
+
+TEST_FIXTURE(AliasFixture, CheckStepFunctionSamplerAboveThreshold)
+{
+    StepFunctionSampler sfs(function, 1);
+    CHECK_CLOSE(50.0f, sfs.FunctionIntegral(), Epsilon());
+    CHECK_EQUAL(static_cast<size_t>(10), sfs.StepCount());
+    for (size_t i = 0; i < 10; ++i)
+    {
+        CHECK_CLOSE(function[i], sfs.FunctionValue(i), Epsilon());
+        CHECK_EQUAL(as->SampleIndex(i/10.0f + 0.05f), sfs.SampleIndex(i/10.0f + 0.05f));
+    }
+}
+TEST(CheckAliasSampleFrequenciesOfRandomWeights)
+{
+    // Weights spanning several orders of magnitude make the pairing loop drift,
+    // and leave steps over for the rounding fix-up
+    MersenneTwister rng(11);
+    const size_t numSteps = 1000;
+    std::vector<real> weights(numSteps);
+    double sum = 0.0;
+    for (size_t i = 0; i < numSteps; ++i)
+    {
+        weights[i] = std::pow(10.0f, 4.0f*rng.CanonicalRandom()-2.0f);
+        sum += weights[i];
+    }
+    AliasSampler sampler(weights);
+
+    const int numSamples = 2000000;
+    std::vector<int> counts(numSteps, 0);
+    for (int i = 0; i < numSamples; ++i)
+    {
+        ++counts[sampler.SampleIndex(rng.CanonicalRandom())];
+    }
+    for (size_t i = 0; i < numSteps; ++i)
+    {
+        // Within five standard deviations of the expected frequency
+        double p = weights[i]/sum;
+        double tolerance = 5.0*std::sqrt(p*(1.0-p)/numSamples) + 1.0e-6;
+        CHECK_CLOSE(p, static_cast<double>(counts[i])/numSamples, tolerance);
+    }
+}
+}
@@ -19,6 +19,8 @@
 // THE SOFTWARE.
 
 #include <UnitTest++.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
 #include "renderbliss/Math/MathUtils.h"
 #include "renderbliss/Utils/AtomicOps.h"
 
@@ -30,7 +32,7 @@ TEST(CheckAtomicAddUint32)
     uint32 i = 1;
     AtomicAdd(&i, 1);
     CHECK_EQUAL(static_cast<uint32>(2), i);
-    AtomicAdd(&i, 4);
+    CHECK_EQUAL(static_cast<uint32>(2), AtomicAdd(&i, 4));
     CHECK_EQUAL(static_cast<uint32>(6), i);
 }
 
@@ -39,7 +41,7 @@ TEST(CheckAtomicAddFloat)
     float  f = 1.5f;
     AtomicAdd(&f, 0.5f);
     CHECK_CLOSE(2.0f, f, Epsilon());
-    AtomicAdd(&f, 4.5f);
+    CHECK_CLOSE(2.0f, AtomicAdd(&f, 4.5f), Epsilon());
     CHECK_CLOSE(6.5f, f, Epsilon());
     AtomicAdd(&f, -5.0f);
     CHECK_CLOSE(1.5f, f, Epsilon());
@@ -62,4 +64,39 @@ TEST(CheckAtomicCounter)
     uint32 i = c;
     CHECK_EQUAL(i, c);
 }
+
+void AddToCounter(AtomicCounter* c, float* f)
+{
+    for (int i = 0; i < 10000; ++i)
+    {
+        c->Add(2);
+        AtomicAdd(f, 1.0f);
+    }
+}
+
+TEST(CheckAtomicAddConcurrent)
+{
+    AtomicCounter c;
+    float f = 0.0f;
+    boost::thread_group threads;
+    for (int i = 0; i < 4; ++i)
+    {
+        threads.create_thread(boost::bind(&AddToCounter, &c, &f));
+    }
+    threads.join_all();
+    CHECK_EQUAL(static_cast<uint32>(80000), c);
+    CHECK_EQUAL(40000.0f, f);
+}
+
+TEST(CheckPaddedAtomicCounter)
+{
+    CHECK_EQUAL(cacheLineSize, sizeof(PaddedAtomicCounter));
+    PaddedAtomicCounter c[2];
+    CHECK_EQUAL(static_cast<size_t>(0), reinterpret_cast<size_t>(&c[0]) % cacheLineSize);
+    CHECK_EQUAL(static_cast<size_t>(0), reinterpret_cast<size_t>(&c[1]) % cacheLineSize);
+    ++c[1];
+    c[1].Add(2);
+    CHECK_EQUAL(static_cast<uint32>(0), c[0]);
+    CHECK_EQUAL(static_cast<uint32>(3), c[1]);
+}
 }
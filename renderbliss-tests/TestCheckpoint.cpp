@@ -0,0 +1,100 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <cstdio>
+#include <fstream>
+#include "renderbliss/Types.h"
+#include "renderbliss/Rendering/Checkpoint.h"
+
+namespace
+{
+using namespace renderbliss;
+
+RenderCheckpoint MakeCheckpoint()
+{
+    RenderCheckpoint checkpoint;
+    checkpoint.xResolution = 640;
+    checkpoint.yResolution = 480;
+    checkpoint.samplesPerPixel = 16;
+    checkpoint.samplePasses = 4;
+    checkpoint.completedPasses = 7;
+    checkpoint.pixelSeed = 0xdeadbeef;
+    checkpoint.rngState = "1 2 3";
+    for (uint32 i = 0; i < 1000; ++i)
+    {
+        checkpoint.filmState.push_back(static_cast<byte>(i));
+    }
+    return checkpoint;
+}
+
+void CheckEqualCheckpoints(const RenderCheckpoint& expected, const RenderCheckpoint& actual)
+{
+    CHECK_EQUAL(expected.xResolution, actual.xResolution);
+    CHECK_EQUAL(expected.yResolution, actual.yResolution);
+    CHECK_EQUAL(expected.samplesPerPixel, actual.samplesPerPixel);
+    CHECK_EQUAL(expected.samplePasses, actual.samplePasses);
+    CHECK_EQUAL(expected.completedPasses, actual.completedPasses);
+    CHECK_EQUAL(expected.pixelSeed, actual.pixelSeed);
+    CHECK(expected.rngState == actual.rngState);
+    CHECK(expected.filmState == actual.filmState);
+}
+
+TEST(CheckCheckpointSaveAndLoad)
+{
+    const char* fileName = "TestCheckpoint.rbcp";
+    RenderCheckpoint checkpoint = MakeCheckpoint();
+    CHECK(SaveCheckpoint(fileName, checkpoint));
+    RenderCheckpoint loadedCheckpoint;
+    CHECK(LoadCheckpoint(fileName, loadedCheckpoint));
+    CheckEqualCheckpoints(checkpoint, loadedCheckpoint);
+
+    // A truncated file is rejected, leaving the checkpoint unchanged
+    {
+        std::ofstream os(fileName, std::ios::binary | std::ios::trunc);
+        os.write("RBCP", 4);
+    }
+    CHECK(!LoadCheckpoint(fileName, loadedCheckpoint));
+    CheckEqualCheckpoints(checkpoint, loadedCheckpoint);
+    std::remove(fileName);
+}
+
+TEST(CheckCheckpointWriter)
+{
+    const char* fileName = "TestCheckpointWriter.rbcp";
+    RenderCheckpoint expectedCheckpoint = MakeCheckpoint();
+    expectedCheckpoint.completedPasses = 9;
+    {
+        CheckpointWriter writer(fileName);
+        for (uint32 pass = 0; pass < 10; ++pass)
+        {
+            RenderCheckpoint checkpoint = MakeCheckpoint();
+            checkpoint.completedPasses = pass;
+            writer.Write(checkpoint);
+        }
+    }
+
+    // The latest checkpoint is saved by the time the writer is destroyed
+    RenderCheckpoint loadedCheckpoint;
+    CHECK(LoadCheckpoint(fileName, loadedCheckpoint));
+    CheckEqualCheckpoints(expectedCheckpoint, loadedCheckpoint);
+    std::remove(fileName);
+}
+}
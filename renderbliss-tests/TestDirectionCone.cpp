@@ -0,0 +1,75 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include "renderbliss/Types.h"
+#include "renderbliss/Math/MathUtils.h"
+#include "renderbliss/Math/Geometry/DirectionCone.h"
+#include "renderbliss/Math/Geometry/Vector3.h"
+
+namespace
+{
+using namespace renderbliss;
+
+TEST(CheckDirectionConeIsEmpty)
+{
+    DirectionCone cone;
+    CHECK(cone.IsEmpty());
+    CHECK(!cone.Contains(Vector3(0.0f, 0.0f, 1.0f)));
+    cone.Enclose(Vector3(0.0f, 0.0f, 1.0f));
+    CHECK(!cone.IsEmpty());
+    CHECK_CLOSE(0.0f, cone.Spread(), Epsilon());
+}
+
+TEST(CheckDirectionConeEncloseDirections)
+{
+    DirectionCone cone;
+    cone.Enclose(Vector3(1.0f, 0.0f, 0.0f));
+    cone.Enclose(Vector3(0.0f, 1.0f, 0.0f));
+    CHECK_CLOSE(0.25f*Pi(), cone.Spread(), 1e-4f);
+    CHECK(cone.Contains(Vector3(1.0f, 0.0f, 0.0f)));
+    CHECK(cone.Contains(Vector3(0.0f, 1.0f, 0.0f)));
+    CHECK(cone.Contains(Vector3(1.0f, 1.0f, 0.0f).GetNormalized()));
+    CHECK(!cone.Contains(Vector3(0.0f, 0.0f, 1.0f)));
+}
+
+TEST(CheckDirectionConeEncloseOppositeDirections)
+{
+    DirectionCone cone;
+    cone.Enclose(Vector3(0.0f, 0.0f, 1.0f));
+    cone.Enclose(Vector3(0.0f, 0.0f, -1.0f));
+    CHECK(cone.Contains(Vector3(0.0f, 0.0f, 1.0f)));
+    CHECK(cone.Contains(Vector3(0.0f, 0.0f, -1.0f)));
+}
+
+TEST(CheckDirectionConeEncloseCones)
+{
+    DirectionCone a(Vector3(1.0f, 0.0f, 0.0f), 0.1f);
+    DirectionCone b(Vector3(0.0f, 1.0f, 0.0f), 0.2f);
+    a.Enclose(b);
+    CHECK_CLOSE(0.5f*(HalfPi()+0.3f), a.Spread(), 1e-4f);
+    CHECK(a.Contains(Vector3(1.0f, 0.0f, 0.0f)));
+    CHECK(a.Contains(Vector3(0.0f, 1.0f, 0.0f)));
+
+    DirectionCone c(Vector3(0.0f, 0.0f, 1.0f), Pi());
+    c.Enclose(a);
+    CHECK_CLOSE(Pi(), c.Spread(), Epsilon());
+}
+}
@@ -0,0 +1,142 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <cmath>
+#include <boost/shared_ptr.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Camera/Film/ImageFilm.h"
+#include "renderbliss/Interfaces/IFilter.h"
+#include "renderbliss/Interfaces/IToneMapper.h"
+
+namespace
+{
+using namespace renderbliss;
+
+FilmSample MakeSample(real x, real y, real luminance)
+{
+    FilmSample s = { XYZ(luminance, luminance, luminance), {{x, y}}, 1.0f };
+    return s;
+}
+
+TEST(CheckImageFilmRelativeError)
+{
+    boost::shared_ptr<IFilm> film(new ImageFilm(4, 4, boost::shared_ptr<IFilter>(), boost::shared_ptr<IToneMapper>()));
+
+    // The error is unknown until a pixel has two samples
+    CHECK(film->RelativeError(1, 1) > 1.0e6f);
+    film->AddSample(MakeSample(1.5f, 1.5f, 2.0f));
+    CHECK(film->RelativeError(1, 1) > 1.0e6f);
+
+    // Equal samples have no variance
+    film->AddSample(MakeSample(1.25f, 1.75f, 2.0f));
+    CHECK_CLOSE(0.0f, film->RelativeError(1, 1), 1.0e-6f);
+
+    // Samples 1 and 3 have a mean of 2, a variance of 2 and a standard error of 1
+    film->AddSample(MakeSample(2.5f, 1.5f, 1.0f));
+    film->AddSample(MakeSample(2.5f, 1.5f, 3.0f));
+    CHECK_CLOSE(0.5f, film->RelativeError(2, 1), 1.0e-5f);
+
+    // Samples are counted in the pixel holding them only, whatever the filter extent
+    CHECK(film->RelativeError(0, 0) > 1.0e6f);
+}
+
+TEST(CheckImageFilmStateRestoration)
+{
+    boost::shared_ptr<IFilm> film(new ImageFilm(5, 3, boost::shared_ptr<IFilter>(), boost::shared_ptr<IToneMapper>()));
+    film->AddSample(MakeSample(1.5f, 1.5f, 1.0f));
+    film->AddSample(MakeSample(1.5f, 1.5f, 3.0f));
+    film->AddSample(MakeSample(4.5f, 2.5f, 2.0f));
+    std::vector<byte> state;
+    film->StoreState(state);
+
+    boost::shared_ptr<IFilm> resumedFilm(new ImageFilm(5, 3, boost::shared_ptr<IFilter>(), boost::shared_ptr<IToneMapper>()));
+    CHECK(resumedFilm->RestoreState(state));
+    CHECK_CLOSE(film->RelativeError(1, 1), resumedFilm->RelativeError(1, 1), 1.0e-6f);
+
+    // Samples added after resuming accumulate with the restored ones
+    film->AddSample(MakeSample(4.5f, 2.5f, 4.0f));
+    resumedFilm->AddSample(MakeSample(4.5f, 2.5f, 4.0f));
+    CHECK_CLOSE(film->RelativeError(4, 2), resumedFilm->RelativeError(4, 2), 1.0e-6f);
+    std::vector<byte> resumedState;
+    film->StoreState(state);
+    resumedFilm->StoreState(resumedState);
+    CHECK(state == resumedState);
+
+    // The state of a film of another resolution is rejected
+    boost::shared_ptr<IFilm> otherFilm(new ImageFilm(3, 5, boost::shared_ptr<IFilter>(), boost::shared_ptr<IToneMapper>()));
+    CHECK(!otherFilm->RestoreState(state));
+}
+
+TEST(CheckImageFilmRegionMerging)
+{
+    // Samples taken from two films and merged into a third one add up as if they were added to it
+    boost::shared_ptr<IFilm> film(new ImageFilm(6, 4, boost::shared_ptr<IFilter>(), boost::shared_ptr<IToneMapper>()));
+    boost::shared_ptr<IFilm> workerFilm(new ImageFilm(6, 4, boost::shared_ptr<IFilter>(), boost::shared_ptr<IToneMapper>()));
+    boost::shared_ptr<IFilm> mergedFilm(new ImageFilm(6, 4, boost::shared_ptr<IFilter>(), boost::shared_ptr<IToneMapper>()));
+    film->AddSample(MakeSample(1.5f, 1.5f, 1.0f));
+    film->AddSample(MakeSample(1.5f, 1.5f, 3.0f));
+    film->AddSample(MakeSample(4.5f, 2.5f, 2.0f));
+
+    RenderingWorkArea left = {0, 2, 0, 3};
+    RenderingWorkArea right = {3, 5, 0, 3};
+    std::vector<byte> samples;
+    workerFilm->AddSample(MakeSample(1.5f, 1.5f, 1.0f));
+    workerFilm->AddSample(MakeSample(1.5f, 1.5f, 3.0f));
+    workerFilm->TakeRegion(left, samples);
+    CHECK(mergedFilm->MergeRegion(left, samples));
+
+    // Taking a region clears it, so the next region taken only holds the samples added since
+    workerFilm->AddSample(MakeSample(4.5f, 2.5f, 2.0f));
+    workerFilm->TakeRegion(left, samples);
+    CHECK(mergedFilm->MergeRegion(left, samples));
+    workerFilm->TakeRegion(right, samples);
+    CHECK(mergedFilm->MergeRegion(right, samples));
+
+    std::vector<byte> state, mergedState;
+    film->StoreState(state);
+    mergedFilm->StoreState(mergedState);
+    CHECK(state == mergedState);
+
+    // A buffer is rejected by a region of another size
+    RenderingWorkArea column = {0, 0, 0, 3};
+    CHECK(!mergedFilm->MergeRegion(column, samples));
+}
+
+TEST(CheckImageFilmRegionStorage)
+{
+    boost::shared_ptr<IFilm> film(new ImageFilm(4, 4, boost::shared_ptr<IFilter>(), boost::shared_ptr<IToneMapper>()));
+    film->AddSample(MakeSample(2.5f, 1.5f, 1.0f));
+    film->AddSample(MakeSample(2.5f, 1.5f, 3.0f));
+
+    // Pixels are stored in scanline order, without tone mapping, and pixels without samples are black
+    RenderingWorkArea region = {1, 3, 1, 2};
+    RGBPixelList pixels;
+    film->StoreRegion(region, pixels);
+    CHECK_EQUAL(6u, pixels.size());
+    RGB mean = XYZ(2.0f, 2.0f, 2.0f).ToRGB();
+    CHECK_CLOSE(mean.r, pixels[1].colour.r, 1.0e-4f);
+    CHECK_CLOSE(mean.g, pixels[1].colour.g, 1.0e-4f);
+    CHECK_CLOSE(mean.b, pixels[1].colour.b, 1.0e-4f);
+    CHECK_CLOSE(1.0f, pixels[1].opacity, 1.0e-6f);
+    CHECK_CLOSE(0.0f, pixels[0].colour.MaxChannel(), 1.0e-6f);
+    CHECK_CLOSE(0.0f, pixels[4].colour.MaxChannel(), 1.0e-6f);
+}
+}
@@ -20,6 +20,7 @@
 
 #include <UnitTest++.h>
 #include "renderbliss/ImageIO/ImageIO.h"
+#include "renderbliss/ImageIO/TileImageWriter.h"
 
 namespace
 {
@@ -124,4 +125,49 @@ TEST(CheckRunLengthEncodedTGA)
         CHECK_CLOSE(pixelsRead[i].colour.b, pixelsWritten[i].colour.b, 0.0001f);
     }
 }
+
+TEST(CheckTiledHDR)
+{
+    RGBPixelList pixelsRead;
+    uint32 width=0, height=0;
+    CHECK(LoadHDR("nyc-hdr.hdr", pixelsRead, width, height));
+
+    // Tiles are written from the bottom of the image up, so that scanlines are held until the first one is complete
+    const uint32 tileSize = 64;
+    {
+        TileImageWriter writer("nyc-hdr-tiled-w.hdr", width, height, tileSize);
+        for (uint32 y = (height-1)/tileSize*tileSize; y < height; y -= tileSize)
+        {
+            for (uint32 x = 0; x < width; x += tileSize)
+            {
+                ImageTile tile;
+                tile.x = x;
+                tile.y = y;
+                tile.width = std::min(tileSize, width-x);
+                tile.height = std::min(tileSize, height-y);
+                for (uint32 j = 0; j < tile.height; ++j)
+                {
+                    for (uint32 i = 0; i < tile.width; ++i)
+                    {
+                        tile.pixels.push_back(pixelsRead[(y+j)*width + x+i]);
+                    }
+                }
+                writer.Write(tile);
+            }
+        }
+        CHECK(writer.Close());
+    }
+
+    RGBPixelList pixelsWritten;
+    CHECK(LoadHDR("nyc-hdr-tiled-w.hdr", pixelsWritten, width, height));
+
+    CHECK_EQUAL(pixelsRead.size(), pixelsWritten.size());
+
+    for (size_t i = 0; i < pixelsRead.size(); ++i)
+    {
+        CHECK_CLOSE(pixelsRead[i].colour.r, pixelsWritten[i].colour.r, 0.0001f);
+        CHECK_CLOSE(pixelsRead[i].colour.g, pixelsWritten[i].colour.g, 0.0001f);
+        CHECK_CLOSE(pixelsRead[i].colour.b, pixelsWritten[i].colour.b, 0.0001f);
+    }
+}
 }
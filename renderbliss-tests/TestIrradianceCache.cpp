@@ -0,0 +1,96 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include "renderbliss/Types.h"
+#include "renderbliss/Integrators/IrradianceCache.h"
+#include "renderbliss/Math/MersenneTwister.h"
+
+namespace
+{
+using namespace renderbliss;
+
+IrradianceRecord MakeRecord(const Vector3& position, const Vector3& normal, real irradiance, real harmonicMeanDistance)
+{
+    IrradianceRecord record;
+    record.position = position;
+    record.normal = normal;
+    record.irradiance = Spectrum(irradiance);
+    record.rotationalGradient.assign(Spectrum::black);
+    record.translationalGradient.assign(Spectrum::black);
+    record.harmonicMeanDistance = harmonicMeanDistance;
+    return record;
+}
+
+// Returns the luminance of a spectrum relative to that of a unit spectrum
+real RelativeLuminance(const Spectrum& s)
+{
+    return s.Luminance()/Spectrum(1.0f).Luminance();
+}
+
+TEST(CheckIrradianceCacheInterpolation)
+{
+    IrradianceCache cache(BoundingBox(Vector3(-1.0f), Vector3(1.0f)), 0.5f);
+    Spectrum irradiance;
+    CHECK(!cache.Interpolate(Vector3::zero, Vector3::unitZ, irradiance));
+
+    cache.Add(MakeRecord(Vector3(-0.1f, 0.0f, 0.0f), Vector3::unitZ, 1.0f, 0.4f));
+    cache.Add(MakeRecord(Vector3(0.1f, 0.0f, 0.0f), Vector3::unitZ, 3.0f, 0.4f));
+    CHECK_EQUAL(static_cast<size_t>(2), cache.RecordCount());
+
+    // Equidistant records are weighted equally
+    CHECK(cache.Interpolate(Vector3::zero, Vector3::unitZ, irradiance));
+    CHECK_CLOSE(2.0f, RelativeLuminance(irradiance), 1.0e-4f);
+
+    // Records are not used beyond the error bound, nor for diverging normals
+    CHECK(!cache.Interpolate(Vector3(0.5f, 0.0f, 0.0f), Vector3::unitZ, irradiance));
+    CHECK(!cache.Interpolate(Vector3::zero, Vector3::unitX, irradiance));
+}
+
+TEST(CheckIrradianceCacheTranslationalGradient)
+{
+    IrradianceCache cache(BoundingBox(Vector3(-1.0f), Vector3(1.0f)), 0.5f);
+    IrradianceRecord record = MakeRecord(Vector3::zero, Vector3::unitZ, 1.0f, 0.4f);
+    record.translationalGradient[0] = Spectrum(2.0f);
+    cache.Add(record);
+
+    Spectrum irradiance;
+    CHECK(cache.Interpolate(Vector3(0.05f, 0.0f, 0.0f), Vector3::unitZ, irradiance));
+    CHECK_CLOSE(1.1f, RelativeLuminance(irradiance), 1.0e-4f);
+    CHECK(cache.Interpolate(Vector3(0.0f, 0.05f, 0.0f), Vector3::unitZ, irradiance));
+    CHECK_CLOSE(1.0f, RelativeLuminance(irradiance), 1.0e-4f);
+}
+
+TEST(CheckIrradianceCacheFindsAllRecords)
+{
+    // Records of all sizes must be found wherever they are valid, whatever octree node they are stored in
+    IrradianceCache cache(BoundingBox(Vector3(-1.0f), Vector3(1.0f)), 1.0f);
+    MersenneTwister rng;
+    for (uint32 i = 0; i < 200; ++i)
+    {
+        Vector3 position(rng.RandomReal(-1.0f, 1.0f), rng.RandomReal(-1.0f, 1.0f), rng.RandomReal(-1.0f, 1.0f));
+        cache.Add(MakeRecord(position, Vector3::unitZ, 1.0f, rng.RandomReal(0.001f, 0.5f)));
+        Vector3 offset(rng.RandomReal(-0.5f, 0.5f), rng.RandomReal(-0.5f, 0.5f), 0.0f);
+        Spectrum irradiance;
+        CHECK(cache.Interpolate(position + 0.001f*offset, Vector3::unitZ, irradiance));
+        CHECK_CLOSE(1.0f, RelativeLuminance(irradiance), 1.0e-4f);
+    }
+}
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <stdexcept>
+#include "renderbliss/Types.h"
+#include "renderbliss/Interfaces/IJob.h"
+#include "renderbliss/Utils/AtomicOps.h"
+#include "renderbliss/Utils/JobScheduler.h"
+
+namespace
+{
+using namespace renderbliss;
+
+class CountingJob : public IJob
+{
+public:
+
+    CountingJob(AtomicCounter& counter) : counter(counter) {}
+    virtual void Run() const { ++counter; }
+
+private:
+
+    AtomicCounter& counter;
+};
+
+class ThrowingJob : public IJob
+{
+public:
+
+    virtual void Run() const { throw std::runtime_error("job failed"); }
+};
+
+TEST(CheckJobSchedulerRunsAllJobs)
+{
+    JobScheduler scheduler;
+    AtomicCounter counter;
+    JobList jobs;
+    for (int i = 0; i < 100; ++i)
+    {
+        jobs.push_back(JobConstPtr(new CountingJob(counter)));
+    }
+    scheduler.Spawn(jobs);
+    scheduler.WaitForAllJobs();
+    CHECK_EQUAL(static_cast<uint32>(100), counter);
+}
+
+TEST(CheckJobSchedulerRethrowsJobExceptions)
+{
+    JobScheduler scheduler;
+    AtomicCounter counter;
+    JobList jobs;
+    for (int i = 0; i < 100; ++i)
+    {
+        jobs.push_back(JobConstPtr((i == 50) ? static_cast<IJob*>(new ThrowingJob) : new CountingJob(counter)));
+    }
+
+    // Spawn runs the jobs immediately on a single hardware thread, so it may throw as well
+    bool thrown = false;
+    try
+    {
+        scheduler.Spawn(jobs);
+        scheduler.WaitForAllJobs();
+    }
+    catch (const std::runtime_error&)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(counter < 100);
+
+    // The scheduler is usable again once the exception has been rethrown
+    AtomicCounter counterAfterFailure;
+    scheduler.Spawn(JobConstPtr(new CountingJob(counterAfterFailure)));
+    scheduler.WaitForAllJobs();
+    CHECK_EQUAL(static_cast<uint32>(1), counterAfterFailure);
+}
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <boost/scoped_ptr.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Interfaces/ILight.h"
+#include "renderbliss/Lights/LightBvh.h"
+#include "renderbliss/Math/MathUtils.h"
+#include "renderbliss/Math/Geometry/BoundingBox.h"
+#include "renderbliss/Math/Geometry/DirectionCone.h"
+
+namespace
+{
+using namespace renderbliss;
+
+// Small square light facing down the z axis
+class MockLight : public ILight
+{
+public:
+
+    MockLight(const Vector3& center, real power) : center(center), power(power) {}
+    virtual real Pdf(const Vector3&, const TrianglePrimitive*, const Vector3&) const { return 0.0f; }
+    virtual Spectrum Power() const { return Spectrum(power); }
+    virtual void SampleIncidentDirection(const Intersection&, LightSamplingRecord&) const {}
+    virtual void SampleOutgoingRay(const real[5], Vector3&, Vector3&, Vector3&, real& pdf) const { pdf = 0.0f; }
+    virtual Spectrum EmittedRadiance(const Vector3&, const Vector3&) const { return Spectrum(power); }
+    virtual DirectionCone NormalBound() const { return DirectionCone(Vector3(0.0f, 0.0f, -1.0f), 0.0f); }
+    virtual BoundingBox WorldBound() const { return BoundingBox(center - Vector3(0.1f, 0.1f, 0.0f), center + Vector3(0.1f, 0.1f, 0.0f)); }
+
+private:
+
+    Vector3 center;
+    real power;
+};
+
+struct LightBvhFixture
+{
+    LightPtrList lights;
+    boost::scoped_ptr<LightBvh> bvh;
+    LightBvhFixture()
+    {
+        for (int i = 0; i < 7; ++i)
+        {
+            lights.push_back(LightConstPtr(new MockLight(Vector3(2.0f*i, 0.0f, 5.0f), static_cast<real>(i+1))));
+        }
+        bvh.reset(new LightBvh(lights));
+    }
+};
+
+TEST_FIXTURE(LightBvhFixture, CheckPdfsSumToOne)
+{
+    Vector3 point(3.0f, 0.0f, 0.0f), normal(0.0f, 0.0f, 1.0f);
+    real sum = 0.0f;
+    for (size_t i = 0; i < lights.size(); ++i)
+    {
+        sum += bvh->Pdf(point, normal, i);
+    }
+    CHECK_CLOSE(1.0f, sum, 1e-4f);
+}
+
+TEST_FIXTURE(LightBvhFixture, CheckSampleIndexMatchesPdf)
+{
+    Vector3 point(3.0f, 0.0f, 0.0f), normal(0.0f, 0.0f, 1.0f);
+    for (int i = 0; i < 100; ++i)
+    {
+        size_t index;
+        real pdf;
+        CHECK(bvh->SampleIndex(point, normal, i/100.0f, index, pdf));
+        CHECK(index < lights.size());
+        CHECK_CLOSE(bvh->Pdf(point, normal, index), pdf, 1e-4f);
+    }
+}
+
+TEST_FIXTURE(LightBvhFixture, CheckNearerLightIsMoreProbable)
+{
+    // The first and last lights are respectively the least and most powerful
+    Vector3 normal(0.0f, 0.0f, 1.0f);
+    CHECK(bvh->Pdf(Vector3(0.0f, 0.0f, 4.0f), normal, 0) > bvh->Pdf(Vector3(0.0f, 0.0f, 4.0f), normal, 6));
+    CHECK(bvh->Pdf(Vector3(12.0f, 0.0f, 4.0f), normal, 6) > bvh->Pdf(Vector3(12.0f, 0.0f, 4.0f), normal, 0));
+}
+
+TEST_FIXTURE(LightBvhFixture, CheckLightsFacingAwayAreNotSampled)
+{
+    // All the lights face down, away from a point above them
+    Vector3 point(6.0f, 0.0f, 10.0f), normal(0.0f, 0.0f, -1.0f);
+    size_t index;
+    real pdf;
+    CHECK(!bvh->SampleIndex(point, normal, 0.5f, index, pdf));
+    CHECK_CLOSE(0.0f, bvh->Pdf(point, normal, 3), Epsilon());
+}
+}
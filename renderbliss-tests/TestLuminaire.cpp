@@ -0,0 +1,141 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <algorithm>
+#include <cmath>
+#include "renderbliss/Types.h"
+#include "renderbliss/Colour/Spectrum.h"
+#include "renderbliss/Interfaces/ILight.h"
+#include "renderbliss/Lights/Luminaire.h"
+#include "renderbliss/Materials/LambertianMaterial.h"
+#include "renderbliss/Math/MathUtils.h"
+#include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Math/Geometry/Intersection.h"
+#include "renderbliss/Primitives/MeshPrimitive.h"
+#include "renderbliss/Primitives/TrianglePrimitive.h"
+#include "renderbliss/Textures/ConstantTexture.h"
+
+namespace
+{
+using namespace renderbliss;
+
+// A luminaire made of a 2x2 square in the z=0 plane and of a wall triangle standing on one of its sides,
+// lighting a small receiver triangle facing down above the square
+struct LuminaireFixture
+{
+    TextureConstPtr tex;
+    MaterialConstPtr mat;
+    MeshPrimitive square1, square2, wall, receiver;
+    TrianglePrimitiveList triangles;
+    TrianglePrimitiveList receiverTriangles;
+    boost::shared_ptr<Luminaire> luminaire;
+
+    LuminaireFixture() : tex(new ConstantTexture),
+                         mat(new LambertianMaterial(tex)),
+                         square1(MeshPrimitive::CreateFromTriangle(Vector3(-1.0f, -1.0f, 0.0f), Vector3(1.0f, -1.0f, 0.0f), Vector3(1.0f, 1.0f, 0.0f), mat)),
+                         square2(MeshPrimitive::CreateFromTriangle(Vector3(-1.0f, -1.0f, 0.0f), Vector3(1.0f, 1.0f, 0.0f), Vector3(-1.0f, 1.0f, 0.0f), mat)),
+                         wall(MeshPrimitive::CreateFromTriangle(Vector3(1.0f, -1.0f, 0.0f), Vector3(1.0f, 1.0f, 0.0f), Vector3(1.0f, 0.0f, 2.0f), mat)),
+                         receiver(MeshPrimitive::CreateFromTriangle(Vector3(0.0f, -0.5f, 1.0f), Vector3(-0.5f, 0.5f, 1.0f), Vector3(0.5f, 0.5f, 1.0f), mat))
+    {
+        square1.Refine(triangles);
+        TrianglePrimitiveList t;
+        square2.Refine(t);
+        triangles.push_back(t.front());
+        wall.Refine(t);
+        triangles.push_back(t.front());
+        receiver.Refine(receiverTriangles);
+        luminaire.reset(new Luminaire(triangles, Spectrum(1.0f)));
+    }
+
+    // Returns a shading point on a triangle
+    Intersection HitOn(const TrianglePrimitive* triangle, MersenneTwister& rng) const
+    {
+        Intersection hit;
+        Sample2D s = {{rng.CanonicalRandom(), rng.CanonicalRandom()}};
+        Vector3 normal;
+        triangle->SamplePoint(s, hit.point, normal);
+        hit.uvn = Basis3::CreateFromN(normal.GetNormalized());
+        hit.triangle = triangle;
+        hit.material = triangle->Material();
+        return hit;
+    }
+
+    // Checks that the PDF of each sampled direction is the one Pdf returns for it
+    void CheckSampledPdfs(const Intersection& hit, MersenneTwister& rng) const
+    {
+        for (int i = 0; i < 1000; ++i)
+        {
+            Sample2D s = {{rng.CanonicalRandom(), rng.CanonicalRandom()}};
+            LightSamplingRecord lrec(rng, hit, s);
+            luminaire->SampleIncidentDirection(hit, lrec);
+            if (lrec.pdf <= 0.0f) continue;
+            real pdf = luminaire->Pdf(hit.point, hit.triangle, lrec.toLight);
+            CHECK_CLOSE(1.0f, pdf/lrec.pdf, 1.0e-3f);
+        }
+    }
+};
+
+TEST_FIXTURE(LuminaireFixture, CheckPdfMatchesSampledPdf)
+{
+    MersenneTwister rng(7);
+    for (int i = 0; i < 10; ++i)
+    {
+        CheckSampledPdfs(HitOn(receiverTriangles.front().get(), rng), rng);
+    }
+
+    // Shading points on the wall are lit by the square, but never by the wall itself
+    for (int i = 0; i < 10; ++i)
+    {
+        CheckSampledPdfs(HitOn(triangles[2].get(), rng), rng);
+    }
+}
+
+TEST_FIXTURE(LuminaireFixture, CheckPdfSkipsTheSurfaceTriangle)
+{
+    // Straight down from above the first half of the square
+    Vector3 point(0.5f, -0.5f, 0.5f);
+    Vector3 toLight(0.0f, 0.0f, -1.0f);
+    CHECK(luminaire->Pdf(point, 0, toLight) > 0.0f);
+    CHECK(luminaire->Pdf(point, receiverTriangles.front().get(), toLight) > 0.0f);
+    CHECK_EQUAL(0.0f, luminaire->Pdf(point, triangles[0].get(), toLight));
+}
+
+TEST_FIXTURE(LuminaireFixture, CheckPdfIntegratesToOne)
+{
+    // The square alone, seen from above, covers the whole luminaire area except the wall.
+    // Integrate the PDF over the lower hemisphere by uniform sampling.
+    TrianglePrimitiveList squareTriangles(triangles.begin(), triangles.begin()+2);
+    Luminaire square(squareTriangles, Spectrum(1.0f));
+    Vector3 point(0.2f, -0.1f, 0.5f);
+    MersenneTwister rng(3);
+    const int numSamples = 200000;
+    double sum = 0.0;
+    for (int i = 0; i < numSamples; ++i)
+    {
+        real cosTheta = rng.CanonicalRandom();
+        real sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta*cosTheta));
+        real phi = TwoPi()*rng.CanonicalRandom();
+        Vector3 toLight(sinTheta*std::cos(phi), sinTheta*std::sin(phi), -cosTheta);
+        sum += square.Pdf(point, 0, toLight);
+    }
+    CHECK_CLOSE(1.0, TwoPi()*sum/numSamples, 0.02);
+}
+}
@@ -0,0 +1,132 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <algorithm>
+#include <cmath>
+#include "renderbliss/Macros.h"
+#include "renderbliss/Types.h"
+#include "renderbliss/Interfaces/IMaterial.h"
+#include "renderbliss/Math/MathUtils.h"
+#include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Math/Geometry/Intersection.h"
+#include "renderbliss/Math/Sampling/SamplingFunctions.h"
+
+namespace
+{
+using namespace renderbliss;
+
+// Material with a cosine-weighted diffuse component, a glossy component sampled around the normal, and a mirror
+class MockMaterial : public IMaterial
+{
+public:
+
+    MockMaterial()
+    {
+        components[0] = BsdfComponent::DiffuseReflection;
+        components[1] = BsdfComponent::GlossyReflection;
+        components[2] = BsdfComponent::DeltaReflection;
+        numComponents = 3;
+    }
+
+    real ComponentPdf(const Vector3& wi, const Vector3& wo, size_t componentIndex) const
+    {
+        return Pdf(wi, wo, componentIndex);
+    }
+
+protected:
+
+    virtual Spectrum BsdfComponentValue(const Vector3&, const Vector3&, const Intersection&, size_t) const
+    {
+        return Spectrum(1.0f);
+    }
+
+    virtual real Pdf(const Vector3& li, const Vector3& lo, size_t componentIndex) const
+    {
+        if ((li.z*lo.z <= 0.0f) || (componentIndex == 2)) return 0.0f;
+        real cosTheta = std::fabs(lo.z);
+        return (componentIndex == 0) ? cosTheta*InvPi() : 5.0f*cosTheta*cosTheta*cosTheta*cosTheta*InvTwoPi();
+    }
+
+    virtual Vector3 SampleDirection(const Vector3& li, real directionSamples[2], size_t componentIndex) const
+    {
+        if (componentIndex == 2) return Vector3(-li.x, -li.y, li.z);
+        real exponent = (componentIndex == 0) ? 2.0f : 5.0f;
+        real cosTheta = std::pow(1.0f - directionSamples[0], 1.0f/exponent);
+        real sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta*cosTheta));
+        real phi = 2.0f*Pi()*directionSamples[1];
+        return Vector3(sinTheta*std::cos(phi), sinTheta*std::sin(phi), cosTheta);
+    }
+};
+
+TEST(CheckBsdfCombinedFlagsPdf)
+{
+    MockMaterial material;
+    Intersection hit;
+    Vector3 wi = Vector3(0.3f, 0.1f, 1.0f).GetNormalized();
+    Vector3 wo = Vector3(-0.2f, 0.4f, 0.8f).GetNormalized();
+    real diffusePdf = material.ComponentPdf(wi, wo, 0);
+    real glossyPdf = material.ComponentPdf(wi, wo, 1);
+    CHECK(diffusePdf > 0.0f);
+    CHECK(glossyPdf > 0.0f);
+
+    // Matching components are picked uniformly, and delta components count in the pick without adding to the PDF
+    CHECK_CLOSE(diffusePdf, material.BsdfCombinedFlagsPdf(wi, wo, hit, BsdfCombinedFlags::Diffuse), Epsilon());
+    CHECK_CLOSE(glossyPdf, material.BsdfCombinedFlagsPdf(wi, wo, hit, BsdfCombinedFlags::Glossy), Epsilon());
+    CHECK_CLOSE((diffusePdf+glossyPdf)/2.0f, material.BsdfCombinedFlagsPdf(wi, wo, hit, BsdfCombinedFlags::Diffuse | BsdfCombinedFlags::Glossy), Epsilon());
+    CHECK_CLOSE((diffusePdf+glossyPdf)/3.0f, material.BsdfCombinedFlagsPdf(wi, wo, hit, BsdfCombinedFlags::All), Epsilon());
+    CHECK_EQUAL(0.0f, material.BsdfCombinedFlagsPdf(wi, wo, hit, BsdfCombinedFlags::Delta));
+    CHECK_EQUAL(0.0f, material.BsdfCombinedFlagsPdf(wi, -wo, hit, BsdfCombinedFlags::All));
+}
+
+TEST(CheckBsdfCombinedFlagsPdfMatchesSampling)
+{
+    MockMaterial material;
+    Intersection hit;
+    Vector3 wi = Vector3(0.3f, 0.1f, 1.0f).GetNormalized();
+    const int flags = BsdfCombinedFlags::All & ~BsdfCombinedFlags::Delta;
+    MersenneTwister rng;
+    for (int i = 0; i < 100; ++i)
+    {
+        BsdfSamplingRecord brec(hit, rng, flags);
+        material.SampleBsdf(wi, brec);
+        CHECK(brec.pdf > 0.0f);
+        CHECK_CLOSE(brec.pdf, material.BsdfCombinedFlagsPdf(wi, brec.sampledDirection, hit, flags), 1.0e-4f);
+    }
+}
+
+TEST(CheckPowerHeuristicWeightsSumToOne)
+{
+    // Light and BSDF samples of a direction are weighted against each other's PDF
+    const real pdfs[] = {0.01f, 0.3f, 1.0f, 4.0f, 250.0f};
+    foreach (real lightPdf, pdfs)
+    {
+        foreach (real bsdfPdf, pdfs)
+        {
+            for (uint32 numSamples = 1; numSamples <= 16; numSamples *= 4)
+            {
+                real lightWeight = PowerHeuristic(numSamples, lightPdf, numSamples, bsdfPdf);
+                real bsdfWeight = PowerHeuristic(numSamples, bsdfPdf, numSamples, lightPdf);
+                CHECK_CLOSE(1.0f, lightWeight + bsdfWeight, Epsilon());
+            }
+        }
+    }
+}
+}
@@ -61,4 +61,19 @@ TEST_FIXTURE(MersenneTwisterFixture, CheckRandomUint)
     CHECK(r >= static_cast<renderbliss::uint>(15));
     CHECK(r <= static_cast<renderbliss::uint>(235));
 }
+
+TEST_FIXTURE(MersenneTwisterFixture, CheckStateRestoration)
+{
+    mt.CanonicalRandom();
+    std::string state = mt.State();
+    renderbliss::uint32 bits = mt.RandomBits();
+    renderbliss::real r = mt.CanonicalRandom();
+
+    renderbliss::MersenneTwister resumed(1234);
+    CHECK(resumed.RestoreState(state));
+    CHECK_EQUAL(bits, resumed.RandomBits());
+    CHECK_EQUAL(r, resumed.CanonicalRandom());
+
+    CHECK(!resumed.RestoreState("not a state"));
+}
 }
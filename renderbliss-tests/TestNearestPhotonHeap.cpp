@@ -0,0 +1,85 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <algorithm>
+#include <vector>
+#include "renderbliss/Types.h"
+#include "renderbliss/Integrators/PhotonMapping/NearestPhotonHeap.h"
+#include "renderbliss/Math/MersenneTwister.h"
+
+namespace
+{
+using namespace renderbliss;
+
+TEST(CheckNearestPhotonHeapAlignment)
+{
+    NearestPhotonHeap heap(100);
+    heap.Insert(1.0f, 0);
+    CHECK_EQUAL(static_cast<size_t>(0), reinterpret_cast<size_t>(&heap[0]) % 64);
+}
+
+TEST(CheckNearestPhotonHeapKeepsNearest)
+{
+    const uint32 capacity = 37;
+    NearestPhotonHeap heap(capacity);
+    CHECK(heap.Empty());
+
+    MersenneTwister rng;
+    std::vector<real> sqrDists;
+    for (uint32 i = 0; i < 1000; ++i)
+    {
+        real sqrDist = rng.CanonicalRandom();
+        sqrDists.push_back(sqrDist);
+        if (!heap.Full() || (sqrDist < heap.MaxSqrDist()))
+        {
+            heap.Insert(sqrDist, i);
+        }
+        CHECK_EQUAL(std::min(i+1, capacity), heap.Size());
+    }
+    CHECK(heap.Full());
+
+    std::vector<real> nearest;
+    for (uint32 i = 0; i < heap.Size(); ++i)
+    {
+        CHECK_EQUAL(sqrDists[heap[i].index], heap[i].sqrDist);
+        nearest.push_back(heap[i].sqrDist);
+    }
+    std::sort(nearest.begin(), nearest.end());
+    std::sort(sqrDists.begin(), sqrDists.end());
+    sqrDists.resize(capacity);
+    CHECK(sqrDists == nearest);
+    CHECK_EQUAL(sqrDists.back(), heap.MaxSqrDist());
+
+    heap.Reset(5);
+    CHECK(heap.Empty());
+    CHECK_EQUAL(static_cast<uint32>(5), heap.Capacity());
+}
+TEST(CheckThreadNearestPhotonHeap)
+{
+    // The same heap is handed out again to the thread, emptied and with the requested capacity
+    NearestPhotonHeap& heap = ThreadNearestPhotonHeap(10);
+    heap.Insert(1.0f, 0);
+    NearestPhotonHeap& again = ThreadNearestPhotonHeap(20);
+    CHECK_EQUAL(&heap, &again);
+    CHECK(again.Empty());
+    CHECK_EQUAL(static_cast<uint32>(20), again.Capacity());
+}
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <cmath>
+#include "renderbliss/Types.h"
+#include "renderbliss/Integrators/PhotonMapping/Photon.h"
+#include "renderbliss/Math/MathUtils.h"
+#include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Math/Geometry/Vector3.h"
+
+namespace
+{
+using namespace renderbliss;
+
+TEST(CheckPackedDirection)
+{
+    // The quantization error is at most half a step of each spherical coordinate
+    const real maxAngle = 0.5f*(Pi()/255.0f + TwoPi()/256.0f);
+    MersenneTwister rng;
+    for (int i = 0; i < 10000; ++i)
+    {
+        Vector3 v(2.0f*rng.CanonicalRandom()-1.0f, 2.0f*rng.CanonicalRandom()-1.0f, 2.0f*rng.CanonicalRandom()-1.0f);
+        if (v.SquaredNorm() < 0.01f) continue;
+        v.Normalize();
+        Vector3 unpacked = PackedDirection(v).Unpack();
+        CHECK_CLOSE(1.0f, unpacked.Norm(), 1e-4f);
+        CHECK(DotProduct(v, unpacked) >= cos(maxAngle));
+    }
+
+    CHECK_CLOSE(1.0f, PackedDirection(Vector3(0.0f, 0.0f, 1.0f)).Unpack().z, Epsilon());
+    CHECK_CLOSE(-1.0f, PackedDirection(Vector3(0.0f, 0.0f, -1.0f)).Unpack().z, Epsilon());
+}
+
+TEST(CheckPhotonSize)
+{
+    // Photon directions and normals take two bytes each, and positions are stored separately
+    CHECK(sizeof(Photon) <= 8);
+    CHECK(sizeof(IrradiancePhoton) <= 8);
+}
+}
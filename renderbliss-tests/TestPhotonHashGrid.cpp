@@ -0,0 +1,106 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <algorithm>
+#include <vector>
+#include "renderbliss/Types.h"
+#include "renderbliss/Integrators/PhotonMapping/PhotonHashGrid.h"
+#include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Math/Geometry/Vector3.h"
+#include "renderbliss/Utils/JobScheduler.h"
+
+namespace
+{
+using namespace renderbliss;
+
+// Collects the indices of the visited photons that lie within a radius
+struct PhotonCollector
+{
+    real sqrRadius;
+    std::vector<uint32> indices;
+    PhotonCollector(real sqrRadius) : sqrRadius(sqrRadius) {}
+    void operator()(uint32 index, real sqrDist) { if (sqrDist < sqrRadius) indices.push_back(index); }
+};
+
+// Counts the visited photons
+struct VisitCounter
+{
+    uint32 count;
+    VisitCounter() : count(0) {}
+    void operator()(uint32, real) { ++count; }
+};
+
+TEST(CheckPhotonHashGrid)
+{
+    const uint32 numPhotons = 50000;
+    const real radius = 0.03f;
+    MersenneTwister rng;
+    std::vector<Vector3> positions;
+    for (uint32 i = 0; i < numPhotons; ++i)
+    {
+        positions.push_back(Vector3(rng.CanonicalRandom(), rng.CanonicalRandom(), rng.CanonicalRandom()-0.5f));
+    }
+
+    PhotonHashGrid grid;
+    JobScheduler scheduler;
+    grid.SpawnBuildingJobs(&positions[0], numPhotons, 2.0f*radius, scheduler);
+    scheduler.WaitForAllJobs();
+    std::vector<uint32> order;
+    grid.FinishBuilding(order);
+
+    // The order is a permutation of the photons
+    CHECK_EQUAL(static_cast<size_t>(numPhotons), order.size());
+    std::vector<uint32> sortedOrder(order);
+    std::sort(sortedOrder.begin(), sortedOrder.end());
+    for (uint32 i = 0; i < numPhotons; ++i)
+    {
+        CHECK_EQUAL(i, sortedOrder[i]);
+    }
+
+    std::vector<Vector3> gridPositions;
+    foreach (uint32 i, order)
+    {
+        gridPositions.push_back(positions[i]);
+    }
+
+    // Every photon within the radius is visited once, whatever the query radius
+    for (int i = 0; i < 100; ++i)
+    {
+        Vector3 q(rng.CanonicalRandom(), rng.CanonicalRandom(), rng.CanonicalRandom()-0.5f);
+        real queryRadius = (i % 10) ? radius : (i % 20) ? 10.0f*radius : 100.0f*radius;
+        PhotonCollector collector(Sqr(queryRadius));
+        grid.Visit(&gridPositions[0], q, queryRadius, collector);
+        std::sort(collector.indices.begin(), collector.indices.end());
+
+        std::vector<uint32> expected;
+        for (uint32 j = 0; j < numPhotons; ++j)
+        {
+            if (SquaredDistance(gridPositions[j], q) < Sqr(queryRadius)) expected.push_back(j);
+        }
+        CHECK(expected == collector.indices);
+    }
+
+    // Cells beyond the photons are not visited, however many the sphere overlaps
+    VisitCounter counter;
+    grid.Visit(&gridPositions[0], Vector3(50.0f, 0.0f, 0.0f), 20.0f, counter);
+    CHECK_EQUAL(static_cast<uint32>(0), counter.count);
+}
+}
@@ -0,0 +1,382 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Colour/Spectrum.h"
+#include "renderbliss/Integrators/PhotonMapping/PhotonMap.h"
+#include "renderbliss/Interfaces/IJob.h"
+#include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Math/Geometry/Vector3.h"
+#include "renderbliss/Utils/AtomicOps.h"
+#include "renderbliss/Utils/JobScheduler.h"
+#include "renderbliss/Utils/PropertyMap.h"
+
+namespace
+{
+using namespace renderbliss;
+
+// Exposes the kd-tree of a photon map
+class KdTreePhotonMap : public PhotonMap
+{
+public:
+
+    KdTreePhotonMap(const PropertyMap& props) : PhotonMap(props) {}
+
+    // Returns whether all the photons of a subtree lie on the expected side of the ancestor splitting planes
+    bool IsSubtreeValid(size_t nodeIndex, const Vector3& minCorner, const Vector3& maxCorner) const
+    {
+        const Vector3& p = positions[nodeIndex];
+        for (unsigned i = 0; i < 3; ++i)
+        {
+            if ((p[i] < minCorner[i]) || (p[i] > maxCorner[i])) return false;
+        }
+
+        const PhotonNode& node = nodes[nodeIndex];
+        if (node.IsLeaf()) return true;
+        bool valid = true;
+        if (node.HasNearChild())
+        {
+            Vector3 nearMax(maxCorner);
+            nearMax[node.SplitAxis()] = node.SplitPosition();
+            valid &= IsSubtreeValid(nodeIndex+1, minCorner, nearMax);
+        }
+        if (node.HasFarChild())
+        {
+            Vector3 farMin(minCorner);
+            farMin[node.SplitAxis()] = node.SplitPosition();
+            valid &= IsSubtreeValid(node.FarChildIndex(), farMin, maxCorner);
+        }
+        return valid;
+    }
+
+    size_t NodeCount() const { return nodes.size(); }
+
+    // Returns the sorted squared distances of the nearest photons found in the kd-tree
+    std::vector<real> NearestSqrDistances(const Vector3& queryLocation, uint32 numLookup, real sqrMaxRadius) const
+    {
+        NearestPhotonHeap heap(numLookup);
+        LocatePhotons(queryLocation, sqrMaxRadius, heap);
+        std::vector<real> sqrDists;
+        for (uint32 i = 0; i < heap.Size(); ++i)
+        {
+            CHECK_EQUAL(heap[i].sqrDist, SquaredDistance(positions[heap[i].index], queryLocation));
+            sqrDists.push_back(heap[i].sqrDist);
+        }
+        std::sort(sqrDists.begin(), sqrDists.end());
+        return sqrDists;
+    }
+
+    // Same as above, by testing every photon
+    std::vector<real> BruteForceNearestSqrDistances(const Vector3& queryLocation, uint32 numLookup, real sqrMaxRadius) const
+    {
+        std::vector<real> sqrDists;
+        foreach (const Vector3& p, positions)
+        {
+            real sqrDist = SquaredDistance(p, queryLocation);
+            if (sqrDist < sqrMaxRadius) sqrDists.push_back(sqrDist);
+        }
+        std::sort(sqrDists.begin(), sqrDists.end());
+        if (sqrDists.size() > numLookup) sqrDists.resize(numLookup);
+        return sqrDists;
+    }
+};
+
+// Exposes the nearest photon lookup of an irradiance photon map
+class NearestIrradiancePhotonMap : public IrradiancePhotonMap
+{
+public:
+
+    NearestIrradiancePhotonMap(const PropertyMap& props) : IrradiancePhotonMap(props) {}
+
+    // Returns the squared distance of the nearest photon found, or a negative value if none is found
+    real NearestSqrDistance(const Vector3& queryLocation, const Vector3& normal, real sqrMaxRadius) const
+    {
+        NearestPhoton nearest;
+        if (!LocateNearestPhoton(queryLocation, normal, sqrMaxRadius, nearest)) return -1.0f;
+        CHECK_EQUAL(nearest.sqrDist, SquaredDistance(positions[nearest.index], queryLocation));
+        return nearest.sqrDist;
+    }
+
+    // Same as above, by testing every photon
+    real BruteForceNearestSqrDistance(const Vector3& queryLocation, const Vector3& normal, real sqrMaxRadius) const
+    {
+        real nearest = -1.0f;
+        for (size_t i = 0; i < PhotonCount(); ++i)
+        {
+            real sqrDist = SquaredDistance(positions[i], queryLocation);
+            if (   (sqrDist < sqrMaxRadius) && ((nearest < 0.0f) || (sqrDist < nearest))
+                && (DotProduct(photons[i].Direction(), normal) > 0.0f)
+                && (DotProduct(photons[i].Normal(), normal) > normalThreshold))
+            {
+                nearest = sqrDist;
+            }
+        }
+        return nearest;
+    }
+};
+
+// Stores blocks of photons into a shared photon map until it is full
+class PhotonStoringJob : public IJob
+{
+public:
+
+    PhotonStoringJob(PhotonMap& photonMap, AtomicCounter& numStored) : photonMap(photonMap), numStored(numStored) {}
+
+    virtual void Run() const
+    {
+        std::vector<Vector3> positions(100, Vector3(0.5f, 0.5f, 0.5f));
+        std::vector<Vector3> directions(100, Vector3(0.0f, 0.0f, 1.0f));
+        std::vector<Spectrum> powers(100, Spectrum(1.0f));
+        while (!photonMap.Full())
+        {
+            numStored.Add(static_cast<uint32>(photonMap.StorePhotons(positions, directions, powers)));
+        }
+    }
+
+private:
+
+    mutable PhotonMap& photonMap;
+    mutable AtomicCounter& numStored;
+};
+
+TEST(CheckConcurrentPhotonStorage)
+{
+    const uint32 numPhotons = 12345;
+    PropertyMap props;
+    props.Set<uint32>("photons_to_store", numPhotons);
+    PhotonMap photonMap(props);
+    CHECK(photonMap.Empty());
+
+    JobScheduler scheduler;
+    AtomicCounter numStored;
+    for (int i = 0; i < 8; ++i)
+    {
+        scheduler.Spawn(JobConstPtr(new PhotonStoringJob(photonMap, numStored)));
+    }
+    scheduler.WaitForAllJobs();
+    CHECK(photonMap.Full());
+    CHECK_EQUAL(numPhotons, static_cast<uint32>(numStored));
+    CHECK_EQUAL(static_cast<size_t>(numPhotons), photonMap.PhotonCount());
+
+    photonMap.Balance(scheduler);
+    CHECK_EQUAL(static_cast<size_t>(numPhotons), photonMap.PhotonCount());
+}
+
+TEST(CheckPhotonMapBalance)
+{
+    const size_t numPhotons = 100000;
+    PropertyMap props;
+    props.Set<uint32>("photons_to_store", numPhotons);
+    KdTreePhotonMap photonMap(props);
+
+    MersenneTwister rng;
+    std::vector<Vector3> positions, directions;
+    std::vector<Spectrum> powers;
+    for (size_t i = 0; i < numPhotons; ++i)
+    {
+        positions.push_back(Vector3(rng.CanonicalRandom(), rng.CanonicalRandom(), 0.1f*rng.CanonicalRandom()));
+        directions.push_back(Vector3(0.0f, 0.0f, 1.0f));
+        powers.push_back(Spectrum(1.0f));
+    }
+    photonMap.StorePhotons(positions, directions, powers);
+
+    JobScheduler scheduler;
+    photonMap.Balance(scheduler);
+    CHECK_EQUAL(numPhotons, photonMap.PhotonCount());
+    CHECK_EQUAL(numPhotons, photonMap.NodeCount());
+    CHECK(photonMap.IsSubtreeValid(0, Vector3(-1.0f, -1.0f, -1.0f), Vector3(2.0f, 2.0f, 2.0f)));
+}
+
+// Compares the nearest photons found by the lookup structure of a photon map with a brute force search
+void CheckNearestPhotons(const std::string& lookup)
+{
+    const size_t numPhotons = 20000;
+    PropertyMap props;
+    props.Set<uint32>("photons_to_store", numPhotons);
+    props.Set<real>("gather_radius", 0.02f);
+    props.Set<std::string>("photon_lookup", lookup);
+    KdTreePhotonMap photonMap(props);
+
+    MersenneTwister rng;
+    std::vector<Vector3> positions, directions;
+    std::vector<Spectrum> powers;
+    for (size_t i = 0; i < numPhotons; ++i)
+    {
+        positions.push_back(Vector3(rng.CanonicalRandom(), rng.CanonicalRandom(), 0.1f*rng.CanonicalRandom()));
+        directions.push_back(Vector3(0.0f, 0.0f, 1.0f));
+        powers.push_back(Spectrum(1.0f));
+    }
+    photonMap.StorePhotons(positions, directions, powers);
+
+    JobScheduler scheduler;
+    photonMap.Balance(scheduler);
+    for (int i = 0; i < 50; ++i)
+    {
+        Vector3 q(1.2f*rng.CanonicalRandom()-0.1f, 1.2f*rng.CanonicalRandom()-0.1f, 0.1f*rng.CanonicalRandom());
+        uint32 numLookup = 1 + 3*i;
+        real sqrMaxRadius = (i % 2) ? 0.0004f : Infinity();
+        std::vector<real> expected = photonMap.BruteForceNearestSqrDistances(q, numLookup, sqrMaxRadius);
+        std::vector<real> found = photonMap.NearestSqrDistances(q, numLookup, sqrMaxRadius);
+        CHECK(expected == found);
+    }
+}
+
+TEST(CheckPhotonMapNearestPhotons)
+{
+    CheckNearestPhotons("kd_tree");
+}
+
+TEST(CheckPhotonHashGridNearestPhotons)
+{
+    CheckNearestPhotons("hash_grid");
+}
+
+// Compares the nearest irradiance photon facing a normal with a brute force search
+void CheckNearestIrradiancePhoton(const std::string& lookup)
+{
+    const size_t numPhotons = 20000;
+    PropertyMap props;
+    props.Set<uint32>("photons_to_store", numPhotons);
+    props.Set<real>("gather_radius", 0.02f);
+    props.Set<std::string>("photon_lookup", lookup);
+    NearestIrradiancePhotonMap photonMap(props);
+
+    // Half of the photons face away from the query normal
+    MersenneTwister rng;
+    std::vector<Vector3> positions, directions, normals;
+    std::vector<Spectrum> powers;
+    for (size_t i = 0; i < numPhotons; ++i)
+    {
+        real z = (i % 2) ? 1.0f : -1.0f;
+        positions.push_back(Vector3(rng.CanonicalRandom(), rng.CanonicalRandom(), 0.1f*rng.CanonicalRandom()));
+        directions.push_back(Vector3(0.0f, 0.0f, z));
+        normals.push_back(Vector3(0.0f, 0.0f, z));
+        powers.push_back(Spectrum(1.0f));
+    }
+    photonMap.StorePhotons(positions, directions, normals, powers);
+
+    JobScheduler scheduler;
+    photonMap.Balance(scheduler);
+    const Vector3 normal(0.0f, 0.0f, 1.0f);
+    for (int i = 0; i < 50; ++i)
+    {
+        Vector3 q(1.2f*rng.CanonicalRandom()-0.1f, 1.2f*rng.CanonicalRandom()-0.1f, 0.1f*rng.CanonicalRandom());
+        real sqrMaxRadius = (i % 2) ? 0.0004f : 0.01f;
+        CHECK_EQUAL(photonMap.BruteForceNearestSqrDistance(q, normal, sqrMaxRadius), photonMap.NearestSqrDistance(q, normal, sqrMaxRadius));
+    }
+}
+
+TEST(CheckNearestIrradiancePhoton)
+{
+    CheckNearestIrradiancePhoton("kd_tree");
+}
+
+TEST(CheckHashGridNearestIrradiancePhoton)
+{
+    CheckNearestIrradiancePhoton("hash_grid");
+}
+
+TEST(CheckPrecomputeIrradianceEstimate)
+{
+    const size_t numPhotons = 10001;
+    PropertyMap props;
+    props.Set<uint32>("photons_to_store", numPhotons);
+    props.Set<uint32>("precomputed_irradiance_spacing", 4);
+    IrradiancePhotonMap indirectMap(props);
+    PhotonMap causticMap(props), directMap(props);
+
+    MersenneTwister rng;
+    std::vector<Vector3> positions, directions, normals;
+    std::vector<Spectrum> powers;
+    for (size_t i = 0; i < numPhotons; ++i)
+    {
+        positions.push_back(Vector3(rng.CanonicalRandom(), rng.CanonicalRandom(), 0.0f));
+        directions.push_back(Vector3(0.0f, 0.0f, 1.0f));
+        normals.push_back(Vector3(0.0f, 0.0f, 1.0f));
+        powers.push_back(Spectrum(1.0f));
+    }
+    indirectMap.StorePhotons(positions, directions, normals, powers);
+
+    JobScheduler scheduler;
+    AtomicCounter numPrecomputedPhotons;
+    indirectMap.Balance(scheduler);
+    indirectMap.PrecomputeIrradianceEstimate(causticMap, directMap, scheduler, numPrecomputedPhotons);
+    CHECK_EQUAL(static_cast<size_t>(2501), indirectMap.PhotonCount());
+    CHECK_EQUAL(static_cast<uint32>(2501), static_cast<uint32>(numPrecomputedPhotons));
+}
+
+TEST(CheckPhotonMapSaveLoad)
+{
+    const size_t numPhotons = 5000;
+    PropertyMap props;
+    props.Set<uint32>("photons_to_store", numPhotons);
+    props.Set<real>("gather_radius", 0.1f);
+    PhotonMap photonMap(props);
+
+    MersenneTwister rng;
+    std::vector<Vector3> positions, directions;
+    std::vector<Spectrum> powers;
+    for (size_t i = 0; i < numPhotons; ++i)
+    {
+        positions.push_back(Vector3(rng.CanonicalRandom(), rng.CanonicalRandom(), 0.0f));
+        directions.push_back(Vector3(0.0f, 0.0f, 1.0f));
+        powers.push_back(Spectrum(rng.CanonicalRandom()));
+    }
+    photonMap.StorePhotons(positions, directions, powers);
+    photonMap.ScalePower(0.5f);
+
+    JobScheduler scheduler;
+    photonMap.Balance(scheduler);
+    std::stringstream stream;
+    photonMap.Save(stream);
+
+    PhotonMap loadedMap(props);
+    CHECK(loadedMap.Load(stream, scheduler));
+    CHECK_EQUAL(numPhotons, loadedMap.PhotonCount());
+    CHECK_EQUAL(0.5f, loadedMap.PowerScale());
+    Vector3 normal(0.0f, 0.0f, 1.0f);
+    for (int i = 0; i < 20; ++i)
+    {
+        Vector3 q(rng.CanonicalRandom(), rng.CanonicalRandom(), 0.0f);
+        CHECK(photonMap.IrradianceEstimate(q, normal, 50, 0.1f) == loadedMap.IrradianceEstimate(q, normal, 50, 0.1f));
+    }
+
+    // A hash grid photon map rebuilds its grid from the loaded photons
+    PropertyMap gridProps(props);
+    gridProps.Set<std::string>("photon_lookup", "hash_grid");
+    PhotonMap gridMap(gridProps);
+    stream.seekg(0);
+    CHECK(gridMap.Load(stream, scheduler));
+    CHECK_EQUAL(numPhotons, gridMap.PhotonCount());
+
+    // Truncated streams are rejected
+    std::string data = stream.str();
+    std::stringstream truncated(data.substr(0, data.size()/2));
+    PhotonMap truncatedMap(props);
+    CHECK(!truncatedMap.Load(truncated, scheduler));
+    CHECK(truncatedMap.Empty());
+}
+}
@@ -0,0 +1,102 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <string>
+#include <vector>
+#include "renderbliss/Macros.h"
+#include "renderbliss/Types.h"
+#include "renderbliss/Colour/Spectrum.h"
+#include "renderbliss/Integrators/ProgressivePhotonIntegrator.h"
+#include "renderbliss/Integrators/PhotonMapping/PhotonMap.h"
+#include "renderbliss/Math/MathUtils.h"
+#include "renderbliss/Math/Geometry/Vector3.h"
+#include "renderbliss/Utils/JobScheduler.h"
+#include "renderbliss/Utils/PropertyMap.h"
+
+namespace
+{
+using namespace renderbliss;
+
+TEST(CheckProgressiveGatherRadius)
+{
+    const real alpha = 0.7f;
+    CHECK_CLOSE(2.0f, ProgressiveGatherRadius(2.0f, 0, alpha), Epsilon());
+
+    // Every pass keeps a fraction alpha of the photons of the previous ones
+    for (uint32 pass = 1; pass < 32; ++pass)
+    {
+        real previousRadius = ProgressiveGatherRadius(2.0f, pass-1, alpha);
+        real radius = ProgressiveGatherRadius(2.0f, pass, alpha);
+        CHECK(radius < previousRadius);
+        CHECK_CLOSE((pass+alpha)/(pass+1), Sqr(radius)/Sqr(previousRadius), 1.0e-5f);
+    }
+}
+
+TEST(CheckFixedRadiusIrradianceEstimate)
+{
+    // Photons at increasing distances from the query location, arriving from above, and one arriving from below
+    const uint32 numPhotons = 40;
+    std::vector<Vector3> positions, directions, normals;
+    std::vector<Spectrum> powers;
+    for (uint32 i = 0; i < numPhotons; ++i)
+    {
+        real angle = 2.4f*i;
+        real distance = 0.05f*(i+1);
+        positions.push_back(Vector3(distance*std::cos(angle), distance*std::sin(angle), 0.0f));
+        directions.push_back(Vector3(0.0f, 0.0f, 1.0f));
+        normals.push_back(Vector3(0.0f, 0.0f, 1.0f));
+        powers.push_back(Spectrum(1.0f));
+    }
+    positions.push_back(Vector3(0.0f, 0.0f, 0.0f));
+    directions.push_back(Vector3(0.0f, 0.0f, -1.0f));
+    normals.push_back(Vector3(0.0f, 0.0f, 1.0f));
+    powers.push_back(Spectrum(1.0f));
+
+    const char* lookups[] = {"kd_tree", "hash_grid"};
+    foreach (const char* lookup, lookups)
+    {
+        const real initialRadius = 1.0f;
+        PropertyMap props;
+        props.Set<uint32>("photons_to_store", numPhotons+1);
+        props.Set<uint32>("photons_to_gather", 4); // Not used by fixed radius estimates
+        props.Set<real>("gather_radius", initialRadius);
+        props.Set<std::string>("photon_lookup", lookup);
+        IrradiancePhotonMap photonMap(props);
+        photonMap.StorePhotons(positions, directions, normals, powers);
+        JobScheduler scheduler;
+        photonMap.Balance(scheduler);
+
+        // The estimate counts the photons within the radius of the pass, over the area of the disc of that radius
+        for (uint32 pass = 0; pass < 8; ++pass)
+        {
+            real radius = ProgressiveGatherRadius(initialRadius, pass, 0.5f);
+            uint32 numWithinRadius = 0;
+            for (uint32 i = 0; i < numPhotons; ++i)
+            {
+                if (0.05f*(i+1) < radius) ++numWithinRadius;
+            }
+            Spectrum expected(numWithinRadius*InvPi()/Sqr(radius));
+            Spectrum irradiance = photonMap.FixedRadiusIrradianceEstimate(Vector3(0.0f, 0.0f, 0.0f), Vector3(0.0f, 0.0f, 1.0f), radius);
+            CHECK_CLOSE(expected.Luminance(), irradiance.Luminance(), 1.0e-3f*expected.Luminance());
+        }
+    }
+}
+}
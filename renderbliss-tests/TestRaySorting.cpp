@@ -0,0 +1,77 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <vector>
+#include "renderbliss/Types.h"
+#include "renderbliss/Accelerators/RaySorting.h"
+#include "renderbliss/Math/MersenneTwister.h"
+#include "renderbliss/Math/Geometry/BoundingBox.h"
+#include "renderbliss/Math/Geometry/Vector3.h"
+
+namespace
+{
+using namespace renderbliss;
+
+TEST(CheckRaySortKeyOrdersOctantsFirst)
+{
+    BoundingBox bound(Vector3(0.0f), Vector3(1.0f));
+    uint32 nearKey = RaySortKey(Vector3(0.0f), Vector3(1.0f, 1.0f, 1.0f), bound);
+    uint32 farKey = RaySortKey(Vector3(1.0f), Vector3(1.0f, 1.0f, 1.0f), bound);
+    uint32 otherOctantKey = RaySortKey(Vector3(0.0f), Vector3(-1.0f, 1.0f, 1.0f), bound);
+    CHECK(nearKey < farKey);
+    CHECK(farKey < otherOctantKey);
+
+    // Origins outside of the bound are clamped to its border cells
+    CHECK_EQUAL(nearKey, RaySortKey(Vector3(-5.0f), Vector3(1.0f, 1.0f, 1.0f), bound));
+    CHECK_EQUAL(farKey, RaySortKey(Vector3(5.0f), Vector3(1.0f, 1.0f, 1.0f), bound));
+}
+
+TEST(CheckSortRaysGroupsCoherentRays)
+{
+    // Rays leave from the corners of a box in random order
+    BoundingBox bound(Vector3(0.0f), Vector3(1.0f));
+    MersenneTwister rng;
+    std::vector<RaySortEntry> entries;
+    for (uint32 i = 0; i < 800; ++i)
+    {
+        uint32 corner = rng.RandomUint(7);
+        Vector3 origin((corner & 1) ? 1.0f : 0.0f, (corner & 2) ? 1.0f : 0.0f, (corner & 4) ? 1.0f : 0.0f);
+        Vector3 direction(1.0f, (rng.CanonicalRandom() < 0.5f) ? 1.0f : -1.0f, 1.0f);
+        RaySortEntry entry = {RaySortKey(origin, direction, bound), i};
+        entries.push_back(entry);
+    }
+    uint32 coherentRaysBefore = CoherentRayCount(entries);
+
+    SortRays(entries);
+    for (size_t i = 1; i < entries.size(); ++i)
+    {
+        CHECK(entries[i-1].key <= entries[i].key);
+        if (entries[i-1].key == entries[i].key)
+        {
+            CHECK(entries[i-1].index < entries[i].index);
+        }
+    }
+
+    // Sixteen distinct keys leave all but sixteen rays next to a ray sharing their key
+    CHECK_EQUAL(static_cast<uint32>(800-16), CoherentRayCount(entries));
+    CHECK(coherentRaysBefore < CoherentRayCount(entries));
+}
+}
@@ -0,0 +1,151 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/thread/thread.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Rendering/RenderProtocol.h"
+
+namespace
+{
+using namespace renderbliss;
+
+RenderRequest MakeRequest()
+{
+    RenderRequest request;
+    request.eye = Vector3(1.0f, 2.0f, 3.0f);
+    request.horizontalFieldOfView = 37.0f;
+    request.xResolution = 4;
+    request.yResolution = 3;
+    request.pixelSamplerWidth = 2;
+    request.integrator = "path";
+    request.rendererSettings.uints["progressive_passes"] = 4;
+    request.rendererSettings.strings["tile_order"] = "spiral";
+    request.integratorSettings.reals["irradiance_cache_error"] = 0.5f;
+    return request;
+}
+
+ImageTile MakeTile(uint32 x, uint32 y, uint32 width, uint32 height, real value)
+{
+    ImageTile tile;
+    tile.x = x;
+    tile.y = y;
+    tile.width = width;
+    tile.height = height;
+    tile.pixels.assign(width*height, RGBPixel(RGB(value, value, value)));
+    return tile;
+}
+
+// Answers a request with two tiles covering a 4x3 image
+void ServeRequest(boost::asio::io_service* ioService, boost::asio::ip::tcp::acceptor* acceptor)
+{
+    boost::asio::ip::tcp::socket socket(*ioService);
+    acceptor->accept(socket);
+    RenderMessage::Enum type = RenderMessage::Invalid;
+    std::vector<byte> payload;
+    RenderRequest request;
+    if (!ReadRenderMessage(socket, type, payload) || (type != RenderMessage::Request) || !DecodeRenderRequest(payload, request))
+    {
+        return;
+    }
+    EncodeImageTile(MakeTile(2, 0, 2, 3, 2.0f), payload);
+    WriteRenderMessage(socket, RenderMessage::Tile, payload);
+    EncodeImageTile(MakeTile(0, 0, 2, 3, 1.0f), payload);
+    WriteRenderMessage(socket, RenderMessage::Tile, payload);
+    payload.assign(1, 1);
+    WriteRenderMessage(socket, RenderMessage::Done, payload);
+}
+
+void CountTile(uint32* numTiles, const ImageTile&)
+{
+    ++*numTiles;
+}
+
+TEST(CheckRenderRequestEncoding)
+{
+    RenderRequest request = MakeRequest();
+    std::vector<byte> payload;
+    EncodeRenderRequest(request, payload);
+    RenderRequest decodedRequest;
+    CHECK(DecodeRenderRequest(payload, decodedRequest));
+    CHECK_CLOSE(request.eye.z, decodedRequest.eye.z, 0.0f);
+    CHECK_CLOSE(request.horizontalFieldOfView, decodedRequest.horizontalFieldOfView, 0.0f);
+    CHECK_EQUAL(request.yResolution, decodedRequest.yResolution);
+    CHECK_EQUAL(request.pixelSamplerWidth, decodedRequest.pixelSamplerWidth);
+    CHECK_EQUAL(request.integrator, decodedRequest.integrator);
+    CHECK_EQUAL(4u, decodedRequest.rendererSettings.uints["progressive_passes"]);
+    CHECK_EQUAL("spiral", decodedRequest.rendererSettings.strings["tile_order"]);
+    CHECK_CLOSE(0.5f, decodedRequest.integratorSettings.reals["irradiance_cache_error"], 0.0f);
+
+    // Settings that differ encode differently, so that they can be compared by their encoding
+    std::vector<byte> settings, otherSettings;
+    EncodeRenderSettings(request.integratorSettings, settings);
+    request.integratorSettings.reals["irradiance_cache_error"] = 0.25f;
+    EncodeRenderSettings(request.integratorSettings, otherSettings);
+    CHECK(settings != otherSettings);
+
+    payload.pop_back();
+    CHECK(!DecodeRenderRequest(payload, decodedRequest));
+}
+
+TEST(CheckImageTileEncoding)
+{
+    ImageTile tile = MakeTile(16, 32, 3, 2, 0.5f);
+    tile.pixels[4].opacity = 0.25f;
+    std::vector<byte> payload;
+    EncodeImageTile(tile, payload);
+    ImageTile decodedTile;
+    CHECK(DecodeImageTile(payload, decodedTile));
+    CHECK_EQUAL(tile.x, decodedTile.x);
+    CHECK_EQUAL(tile.y, decodedTile.y);
+    CHECK_EQUAL(tile.width, decodedTile.width);
+    CHECK_EQUAL(tile.height, decodedTile.height);
+    CHECK_EQUAL(6u, decodedTile.pixels.size());
+    CHECK_CLOSE(0.5f, decodedTile.pixels[4].colour.g, 0.0f);
+    CHECK_CLOSE(0.25f, decodedTile.pixels[4].opacity, 0.0f);
+
+    payload.resize(payload.size() - 4);
+    CHECK(!DecodeImageTile(payload, decodedTile));
+}
+
+TEST(CheckRenderRequestAssemblesTiles)
+{
+    boost::asio::io_service ioService;
+    // The system picks a free port
+    boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), 0);
+    boost::asio::ip::tcp::acceptor acceptor(ioService, endpoint);
+    uint32 serverPort = acceptor.local_endpoint().port();
+    boost::thread server(boost::bind(&ServeRequest, &ioService, &acceptor));
+
+    RGBPixelList pixels;
+    uint32 numTiles = 0;
+    CHECK(RequestRender("127.0.0.1", serverPort, MakeRequest(), pixels, boost::bind(&CountTile, &numTiles, _1)));
+    server.join();
+    CHECK_EQUAL(2u, numTiles);
+    CHECK_EQUAL(12u, pixels.size());
+    CHECK_CLOSE(1.0f, pixels[0].colour.r, 0.0f);
+    CHECK_CLOSE(1.0f, pixels[9].colour.r, 0.0f);
+    CHECK_CLOSE(2.0f, pixels[10].colour.r, 0.0f);
+    CHECK_CLOSE(2.0f, pixels[3].colour.r, 0.0f);
+}
+}
@@ -0,0 +1,151 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/thread.hpp>
+#include "renderbliss/Scene.h"
+#include "renderbliss/Types.h"
+#include "renderbliss/Colour/Spectrum.h"
+#include "renderbliss/Lights/Luminaire.h"
+#include "renderbliss/Materials/LambertianMaterial.h"
+#include "renderbliss/Math/Geometry/Vector2.h"
+#include "renderbliss/Math/Sampling/Filters/BoxFilter.h"
+#include "renderbliss/Primitives/MeshPrimitive.h"
+#include "renderbliss/Primitives/TrianglePrimitive.h"
+#include "renderbliss/Rendering/RenderProtocol.h"
+#include "renderbliss/Rendering/RenderServer.h"
+#include "renderbliss/Textures/ConstantTexture.h"
+#include "renderbliss/Utils/JobScheduler.h"
+#include "renderbliss/Utils/PropertyMap.h"
+#include "renderbliss/Utils/StatsTracker.h"
+
+namespace
+{
+using namespace renderbliss;
+
+const uint32 serverPort = 7391;
+
+MeshConstPtr CreateQuad(const Vector3& a, const Vector3& b, const Vector3& c, const Vector3& d, const MaterialConstPtr& material)
+{
+    std::vector<size_t> vertexIndices;
+    vertexIndices.push_back(0);
+    vertexIndices.push_back(1);
+    vertexIndices.push_back(2);
+    vertexIndices.push_back(0);
+    vertexIndices.push_back(2);
+    vertexIndices.push_back(3);
+    std::vector<Vector3> vertices;
+    vertices.push_back(a);
+    vertices.push_back(b);
+    vertices.push_back(c);
+    vertices.push_back(d);
+    return MeshConstPtr(new MeshPrimitive(2, vertexIndices, vertices, std::vector<Vector3>(), std::vector<Vector2>(), material));
+}
+
+// A square light facing down onto a diffuse floor, in front of a diffuse wall
+SceneConstPtr CreateScene()
+{
+    MaterialConstPtr material(new LambertianMaterial(TextureConstPtr(new ConstantTexture(Spectrum(0.5f)))));
+    boost::shared_ptr<Scene> scene(new Scene(PropertyMap()));
+    scene->Meshes().push_back(CreateQuad(Vector3(-2.0f, 0.0f, -2.0f), Vector3(-2.0f, 0.0f, 2.0f),
+                                         Vector3(2.0f, 0.0f, 2.0f), Vector3(2.0f, 0.0f, -2.0f), material));
+    scene->Meshes().push_back(CreateQuad(Vector3(-2.0f, 0.0f, 2.0f), Vector3(-2.0f, 3.0f, 2.0f),
+                                         Vector3(2.0f, 3.0f, 2.0f), Vector3(2.0f, 0.0f, 2.0f), material));
+    MeshConstPtr lightMesh(CreateQuad(Vector3(-1.5f, 1.5f, -1.5f), Vector3(1.5f, 1.5f, -1.5f),
+                                      Vector3(1.5f, 1.5f, 1.5f), Vector3(-1.5f, 1.5f, 1.5f), material));
+    TrianglePrimitiveList triangles;
+    lightMesh->Refine(triangles);
+    Luminaire* luminaire = new Luminaire(triangles, Spectrum(1.0f));
+    const_cast<MeshPrimitive*>(lightMesh.get())->SetEmissionProfile(luminaire);
+    scene->Lights().push_back(LightConstPtr(luminaire));
+    scene->Meshes().push_back(lightMesh);
+    scene->PreProcess();
+    return scene;
+}
+
+// Looks straight down at the floor from under the light, without shadow rays or final gathering,
+// so that the image only shows the radiance estimates of the global photon map
+RenderRequest MakePhotonRequest(uint32 specularDepth)
+{
+    RenderRequest request;
+    request.eye = Vector3(0.0f, 1.0f, 0.0f);
+    request.lookAt = Vector3(0.0f, 0.0f, 0.0f);
+    request.up = Vector3(0.0f, 0.0f, 1.0f);
+    request.horizontalFieldOfView = 90.0f;
+    request.focusDistance = 1.0f;
+    request.xResolution = 16;
+    request.yResolution = 16;
+    request.pixelSamplerWidth = 2;
+    request.integrator = "photon";
+    request.integratorSettings.uints["final_gathering_samples"] = 0;
+    request.integratorSettings.uints["shadow_rays"] = 0;
+    request.integratorSettings.uints["specular_depth"] = specularDepth;
+    return request;
+}
+
+real MeanLuminance(const RGBPixelList& pixels)
+{
+    real sum = 0.0f;
+    foreach (const RGBPixel& pixel, pixels)
+    {
+        sum += pixel.colour.Luminance();
+    }
+    return pixels.empty() ? 0.0f : sum/pixels.size();
+}
+
+// Sends a request, waiting for the server to listen if needed
+bool RequestRenderWhenListening(const RenderRequest& request, RGBPixelList& pixels)
+{
+    for (int i = 0; i < 100; ++i)
+    {
+        if (RequestRender("127.0.0.1", serverPort, request, pixels)) return true;
+        boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+    }
+    return false;
+}
+
+TEST(CheckPhotonRequestsDoNotDependOnEarlierRequests)
+{
+    PropertyMap gpmProps;
+    gpmProps.Set<uint32>("photons_to_store", 20000);
+    PropertyMap props;
+    props.Set<uint32>("server_port", serverPort);
+    props.Set<PropertyMap>("global_photon_map", gpmProps);
+    JobScheduler scheduler;
+    StatsTracker stats;
+    RenderServer server(props, CreateScene(), boost::shared_ptr<IFilter>(new BoxFilter), scheduler, stats);
+    boost::thread serverThread(boost::bind(&RenderServer::Serve, &server));
+
+    // The second request has other settings, so its integrator shoots photons again
+    RGBPixelList firstPixels, secondPixels;
+    CHECK(RequestRenderWhenListening(MakePhotonRequest(4), firstPixels));
+    CHECK(RequestRenderWhenListening(MakePhotonRequest(2), secondPixels));
+    server.Stop();
+    serverThread.join();
+
+    CHECK_EQUAL(2u, static_cast<uint32>(stats.Counter("Render Server", "Integrator preprocessings")));
+    CHECK(MeanLuminance(firstPixels) > 0.0f);
+    CHECK_CLOSE(1.0f, MeanLuminance(secondPixels)/MeanLuminance(firstPixels), 0.05f);
+}
+}
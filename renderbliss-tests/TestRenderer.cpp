@@ -0,0 +1,506 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include "renderbliss/Macros.h"
+#include "renderbliss/Scene.h"
+#include "renderbliss/Types.h"
+#include "renderbliss/Interfaces/ICamera.h"
+#include "renderbliss/Interfaces/IFilm.h"
+#include "renderbliss/Camera/Film/ImageFilm.h"
+#include "renderbliss/Integrators/SurfaceIntegrator.h"
+#include "renderbliss/Math/Sampling/Filters/BoxFilter.h"
+#include "renderbliss/Rendering/BatchRenderer.h"
+#include "renderbliss/Rendering/Renderer.h"
+#include "renderbliss/Rendering/RenderingJob.h"
+#include "renderbliss/Utils/JobScheduler.h"
+#include "renderbliss/Utils/PropertyMap.h"
+#include "renderbliss/Utils/StatsTracker.h"
+
+namespace
+{
+using namespace renderbliss;
+
+// Counts the samples added at each image position
+class MockFilm : public IFilm
+{
+public:
+
+    typedef std::map<std::pair<real, real>, uint32> SampleCountMap;
+
+    MockFilm(uint32 xResolution, uint32 yResolution) : IFilm(xResolution, yResolution, boost::shared_ptr<IFilter>(new BoxFilter)) {}
+
+    virtual void AddSample(const FilmSample& s)
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        ++sampleCounts[std::make_pair(s.imageSample[0], s.imageSample[1])];
+    }
+
+    virtual void AddSamples(const std::vector<FilmSample>& samples)
+    {
+        foreach (const FilmSample& s, samples)
+        {
+            AddSample(s);
+        }
+    }
+
+    virtual void StorePixels(RGBPixelList&) const {}
+    virtual void StoreRegion(const RenderingWorkArea&, RGBPixelList&) const {}
+    virtual real RelativeError(uint32, uint32) const { return 0.0f; }
+    virtual void StoreState(std::vector<byte>&) const {}
+    virtual bool RestoreState(const std::vector<byte>&) { return false; }
+    virtual void TakeRegion(const RenderingWorkArea&, std::vector<byte>&) {}
+    virtual bool MergeRegion(const RenderingWorkArea&, const std::vector<byte>&) { return false; }
+
+    const SampleCountMap& SampleCounts() const { return sampleCounts; }
+
+    size_t NumSamples() const
+    {
+        size_t numSamples = 0;
+        foreach (const SampleCountMap::value_type& sample, sampleCounts)
+        {
+            numSamples += sample.second;
+        }
+        return numSamples;
+    }
+
+private:
+
+    boost::mutex mutex;
+    SampleCountMap sampleCounts;
+};
+
+// Counts the samples like MockFilm, and estimates the pixel errors from the samples like ImageFilm
+class ErrorEstimatingMockFilm : public MockFilm
+{
+public:
+
+    ErrorEstimatingMockFilm(uint32 xResolution, uint32 yResolution)
+        : MockFilm(xResolution, yResolution),
+          film(new ImageFilm(xResolution, yResolution, boost::shared_ptr<IFilter>(new BoxFilter), boost::shared_ptr<IToneMapper>()))
+    {
+    }
+
+    virtual void AddSample(const FilmSample& s)
+    {
+        MockFilm::AddSample(s);
+        film->AddSample(s);
+    }
+
+    virtual real RelativeError(uint32 x, uint32 y) const { return film->RelativeError(x, y); }
+
+private:
+
+    boost::shared_ptr<IFilm> film;
+};
+
+class MockCamera : public ICamera
+{
+public:
+
+    MockCamera(const boost::shared_ptr<IFilm>& film, uint32 pixelSamplerWidth) : ICamera(film, pixelSamplerWidth) {}
+    virtual void GenerateRay(const PixelSample&, Ray&) const {}
+};
+
+class MockIntegrator : public SurfaceIntegrator
+{
+public:
+
+    // Preprocessing and each radiance sample can be made to take some time
+    MockIntegrator(StatsTracker& stats, uint32 preProcessMilliseconds=0, uint32 radianceMicroseconds=0, uint32 prePassPixelSpacing=0)
+        : SurfaceIntegrator(stats), preProcessMilliseconds(preProcessMilliseconds), radianceMicroseconds(radianceMicroseconds),
+          prePassPixelSpacing(prePassPixelSpacing), numPrePassRays(0)
+    {
+    }
+
+    virtual uint32 PrePassPixelSpacing() const { return prePassPixelSpacing; }
+
+    virtual void PrePassRay(const Scene&, const Ray&, MersenneTwister&) const
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        ++numPrePassRays;
+    }
+
+    size_t NumPrePassRays() const { return numPrePassRays; }
+
+    virtual void PreProcess(const Scene&, JobScheduler&)
+    {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(preProcessMilliseconds));
+    }
+
+    virtual Spectrum Radiance(const Scene&, const Ray&, MersenneTwister&, real&) const
+    {
+        if (radianceMicroseconds)
+        {
+            boost::this_thread::sleep(boost::posix_time::microseconds(radianceMicroseconds));
+        }
+        return Spectrum::black;
+    }
+
+    virtual void Radiances(const Scene& scene, const std::vector<Ray>& rays, MersenneTwister& rng, std::vector<Spectrum>& radiances) const
+    {
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            batchSizes.push_back(rays.size());
+        }
+        SurfaceIntegrator::Radiances(scene, rays, rng, radiances);
+    }
+
+    const std::vector<size_t>& BatchSizes() const { return batchSizes; }
+
+private:
+
+    uint32 preProcessMilliseconds;
+    uint32 radianceMicroseconds;
+    uint32 prePassPixelSpacing;
+    mutable boost::mutex mutex;
+    mutable size_t numPrePassRays;
+    mutable std::vector<size_t> batchSizes;
+};
+
+bool CountPass(std::vector<std::pair<uint32, uint32> >& passes, uint32 completedPasses, uint32 numPasses)
+{
+    passes.push_back(std::make_pair(completedPasses, numPasses));
+    return true;
+}
+
+bool CountSamplesAfterPass(const MockFilm& film, std::vector<size_t>& sampleCounts, uint32, uint32)
+{
+    sampleCounts.push_back(film.NumSamples());
+    return true;
+}
+
+bool StopAfterPasses(uint32 lastPass, std::vector<std::pair<uint32, uint32> >& passes, uint32 completedPasses, uint32 numPasses)
+{
+    CountPass(passes, completedPasses, numPasses);
+    return completedPasses < lastPass;
+}
+
+bool CancelAfterPass(Renderer& renderer, std::vector<std::pair<uint32, uint32> >& passes, uint32 completedPasses, uint32 numPasses)
+{
+    renderer.Cancel();
+    return CountPass(passes, completedPasses, numPasses);
+}
+
+size_t NumPixels(const ICamera& camera)
+{
+    int xStart=0, yStart=0, xEnd=0, yEnd=0;
+    camera.GetPixelSampleExtents(xStart, yStart, xEnd, yEnd);
+    return static_cast<size_t>((xEnd-xStart+1)*(yEnd-yStart+1));
+}
+
+// Number of pixels of the sample extents visited by a pre-pass with the given pixel spacing
+size_t NumPrePassPixels(const ICamera& camera, uint32 pixelSpacing)
+{
+    int xStart=0, yStart=0, xEnd=0, yEnd=0;
+    camera.GetPixelSampleExtents(xStart, yStart, xEnd, yEnd);
+    int spacing = static_cast<int>(pixelSpacing);
+    return static_cast<size_t>(((xEnd-xStart)/spacing+1)*((yEnd-yStart)/spacing+1));
+}
+
+TEST(CheckProgressivePassesTakeEverySampleOnce)
+{
+    const uint32 pixelSamplerWidth = 3;
+    const uint32 numPasses = 4;
+    boost::shared_ptr<MockFilm> film(new MockFilm(8, 6));
+    CameraConstPtr camera(new MockCamera(film, pixelSamplerWidth));
+    SceneConstPtr scene(new Scene(PropertyMap()));
+    StatsTracker stats;
+    SurfaceIntegratorPtr integrator(new MockIntegrator(stats));
+    JobScheduler scheduler;
+
+    PropertyMap props;
+    props.Set<uint32>("tile_size", 4);
+    props.Set<uint32>("progressive_passes", numPasses);
+    Renderer renderer(props, camera, scene, integrator, scheduler, stats);
+    std::vector<std::pair<uint32, uint32> > passes;
+    renderer.SetPassCallback(boost::bind(&CountPass, boost::ref(passes), _1, _2));
+    renderer.Render();
+
+    // The callback runs once after each pass
+    CHECK_EQUAL(numPasses, passes.size());
+    for (uint32 i = 0; i < passes.size(); ++i)
+    {
+        CHECK_EQUAL(i+1, passes[i].first);
+        CHECK_EQUAL(numPasses, passes[i].second);
+    }
+
+    // Every stratified sample of every pixel in the sample extents is taken exactly once over all passes
+    int xStart=0, yStart=0, xEnd=0, yEnd=0;
+    camera->GetPixelSampleExtents(xStart, yStart, xEnd, yEnd);
+    std::map<std::pair<int, int>, uint32> pixelSampleCounts;
+    foreach (const MockFilm::SampleCountMap::value_type& sample, film->SampleCounts())
+    {
+        CHECK_EQUAL(1u, sample.second);
+        int x = static_cast<int>(std::floor(sample.first.first));
+        int y = static_cast<int>(std::floor(sample.first.second));
+        CHECK(x >= xStart && x <= xEnd && y >= yStart && y <= yEnd);
+        ++pixelSampleCounts[std::make_pair(x, y)];
+    }
+    CHECK_EQUAL(NumPixels(*camera), pixelSampleCounts.size());
+    typedef std::map<std::pair<int, int>, uint32>::value_type PixelCount;
+    foreach (const PixelCount& pixel, pixelSampleCounts)
+    {
+        CHECK_EQUAL(pixelSamplerWidth*pixelSamplerWidth, pixel.second);
+    }
+}
+
+TEST(CheckTimeBudgetEndsRendering)
+{
+    boost::shared_ptr<MockFilm> film(new MockFilm(8, 6));
+    CameraConstPtr camera(new MockCamera(film, 4));
+    SceneConstPtr scene(new Scene(PropertyMap()));
+    StatsTracker stats;
+    SurfaceIntegratorPtr integrator(new MockIntegrator(stats, 0, 200));
+    JobScheduler scheduler;
+
+    // Passes of one sample per pixel are added until the deadline, and none of them takes more than a few milliseconds
+    PropertyMap props;
+    props.Set<real>("time_budget", 0.3f);
+    Renderer renderer(props, camera, scene, integrator, scheduler, stats);
+    using namespace boost::posix_time;
+    ptime start = microsec_clock::universal_time();
+    renderer.Render();
+    real elapsed = (microsec_clock::universal_time() - start).total_microseconds()*1.0e-6f;
+    CHECK(elapsed < 1.0f);
+    CHECK(film->NumSamples() >= NumPixels(*camera));
+}
+
+TEST(CheckPreprocessingCanUseUpTheTimeBudget)
+{
+    boost::shared_ptr<MockFilm> film(new MockFilm(8, 6));
+    CameraConstPtr camera(new MockCamera(film, 2));
+    SceneConstPtr scene(new Scene(PropertyMap()));
+    StatsTracker stats;
+    SurfaceIntegratorPtr integrator(new MockIntegrator(stats, 200));
+    JobScheduler scheduler;
+
+    PropertyMap props;
+    props.Set<real>("time_budget", 0.1f);
+    Renderer renderer(props, camera, scene, integrator, scheduler, stats);
+    std::vector<std::pair<uint32, uint32> > passes;
+    renderer.SetPassCallback(boost::bind(&CountPass, boost::ref(passes), _1, _2));
+    renderer.Render();
+    CHECK(passes.empty());
+    CHECK_EQUAL(0u, film->NumSamples());
+}
+
+TEST(CheckCancelBeforeRenderRendersNothing)
+{
+    boost::shared_ptr<MockFilm> film(new MockFilm(8, 6));
+    CameraConstPtr camera(new MockCamera(film, 2));
+    SceneConstPtr scene(new Scene(PropertyMap()));
+    StatsTracker stats;
+    SurfaceIntegratorPtr integrator(new MockIntegrator(stats));
+    JobScheduler scheduler;
+
+    Renderer renderer(PropertyMap(), camera, scene, integrator, scheduler, stats);
+    std::vector<std::pair<uint32, uint32> > passes;
+    renderer.SetPassCallback(boost::bind(&CountPass, boost::ref(passes), _1, _2));
+    renderer.Cancel();
+    renderer.Render();
+    CHECK(renderer.Cancelled());
+    CHECK(passes.empty());
+    CHECK_EQUAL(0u, film->NumSamples());
+}
+
+TEST(CheckCancelStopsBeforeTheNextPass)
+{
+    boost::shared_ptr<MockFilm> film(new MockFilm(8, 6));
+    CameraConstPtr camera(new MockCamera(film, 2));
+    SceneConstPtr scene(new Scene(PropertyMap()));
+    StatsTracker stats;
+    SurfaceIntegratorPtr integrator(new MockIntegrator(stats));
+    JobScheduler scheduler;
+
+    PropertyMap props;
+    props.Set<uint32>("progressive_passes", 4);
+    Renderer renderer(props, camera, scene, integrator, scheduler, stats);
+    std::vector<std::pair<uint32, uint32> > passes;
+    renderer.SetPassCallback(boost::bind(&CancelAfterPass, boost::ref(renderer), boost::ref(passes), _1, _2));
+    renderer.Render();
+
+    // Only the first pass, of one sample per pixel, is rendered
+    CHECK_EQUAL(1u, passes.size());
+    CHECK_EQUAL(NumPixels(*camera), film->NumSamples());
+}
+
+TEST(CheckAdaptivePassesSkipConvergedPixels)
+{
+    boost::shared_ptr<ErrorEstimatingMockFilm> film(new ErrorEstimatingMockFilm(8, 6));
+    CameraConstPtr camera(new MockCamera(film, 1));
+    SceneConstPtr scene(new Scene(PropertyMap()));
+    StatsTracker stats;
+    SurfaceIntegratorPtr integrator(new MockIntegrator(stats));
+    JobScheduler scheduler;
+
+    PropertyMap props;
+    props.Set<uint32>("tile_size", 4);
+    props.Set<real>("adaptive_error", 0.01f);
+    props.Set<uint32>("adaptive_passes", 4);
+    Renderer renderer(props, camera, scene, integrator, scheduler, stats);
+    std::vector<size_t> sampleCounts;
+    renderer.SetPassCallback(boost::bind(&CountSamplesAfterPass, boost::cref(*film), boost::ref(sampleCounts), _1, _2));
+    renderer.Render();
+
+    // One sample per pixel tells nothing of the error, so the first adaptive pass samples every film pixel again,
+    // though the pixels of the sample extents beyond the film may be skipped once the film edges they map to converge.
+    // The radiance is the same for all rays, so every pixel has then converged and no adaptive pass follows.
+    const size_t numPixels = NumPixels(*camera);
+    CHECK_EQUAL(2u, sampleCounts.size());
+    CHECK_EQUAL(numPixels, sampleCounts[0]);
+    CHECK(sampleCounts[1] >= numPixels + 8*6);
+    CHECK(sampleCounts[1] <= 2*numPixels);
+    CHECK_EQUAL(1u, static_cast<uint32>(stats.Counter("Adaptive Sampling", "Adaptive passes")));
+
+    // A later adaptive pass skips every pixel
+    int xStart=0, yStart=0, xEnd=0, yEnd=0;
+    camera->GetPixelSampleExtents(xStart, yStart, xEnd, yEnd);
+    RenderingWorkArea workArea = {xStart, xEnd, yStart, yEnd};
+    RenderingPass pass = {0, 0, 1, 0.01f};
+    RenderingJob(0, workArea, 0, camera.get(), scene.get(), integrator.get(), pass).Run();
+    CHECK_EQUAL(sampleCounts[1], film->NumSamples());
+}
+
+// Renders into an image film with four progressive passes, saving checkpoints, and returns the film state
+std::vector<byte> RenderWithCheckpoints(bool resume, uint32 lastPass, std::vector<std::pair<uint32, uint32> >& passes)
+{
+    boost::shared_ptr<IFilm> film(new ImageFilm(8, 6, boost::shared_ptr<IFilter>(new BoxFilter), boost::shared_ptr<IToneMapper>()));
+    CameraConstPtr camera(new MockCamera(film, 2));
+    SceneConstPtr scene(new Scene(PropertyMap()));
+    StatsTracker stats;
+    SurfaceIntegratorPtr integrator(new MockIntegrator(stats));
+    JobScheduler scheduler;
+
+    PropertyMap props;
+    props.Set<uint32>("tile_size", 4);
+    props.Set<uint32>("progressive_passes", 4);
+    props.Set<std::string>("checkpoint_file", "TestRendererResume.rbcp");
+    props.Set<bool>("resume", resume);
+    Renderer renderer(props, camera, scene, integrator, scheduler, stats);
+    renderer.SetPassCallback(boost::bind(&StopAfterPasses, lastPass, boost::ref(passes), _1, _2));
+    renderer.Render();
+    std::vector<byte> filmState;
+    film->StoreState(filmState);
+    return filmState;
+}
+
+TEST(CheckResumedRenderingMatchesUninterruptedRendering)
+{
+    std::vector<std::pair<uint32, uint32> > uninterruptedPasses;
+    std::vector<byte> uninterruptedFilm = RenderWithCheckpoints(false, 4, uninterruptedPasses);
+    CHECK_EQUAL(4u, uninterruptedPasses.size());
+
+    // Stopping after two passes saves a checkpoint, from which a fresh renderer renders the last two passes.
+    // The box filter and constant radiance make the film independent of the seeds of both renderings.
+    std::vector<std::pair<uint32, uint32> > stoppedPasses;
+    std::vector<byte> stoppedFilm = RenderWithCheckpoints(false, 2, stoppedPasses);
+    CHECK_EQUAL(2u, stoppedPasses.size());
+    CHECK(stoppedFilm != uninterruptedFilm);
+    std::vector<std::pair<uint32, uint32> > resumedPasses;
+    std::vector<byte> resumedFilm = RenderWithCheckpoints(true, 4, resumedPasses);
+    CHECK_EQUAL(2u, resumedPasses.size());
+    CHECK_EQUAL(3u, resumedPasses.front().first);
+    CHECK(uninterruptedPasses.back() == resumedPasses.back());
+    CHECK(uninterruptedFilm == resumedFilm);
+
+    // The checkpoint of the finished rendering holds every integrator pass, so it is rejected
+    std::vector<std::pair<uint32, uint32> > restartedPasses;
+    std::vector<byte> restartedFilm = RenderWithCheckpoints(true, 4, restartedPasses);
+    CHECK(uninterruptedPasses == restartedPasses);
+    CHECK(uninterruptedFilm == restartedFilm);
+    std::remove("TestRendererResume.rbcp");
+}
+
+TEST(CheckWorkAreasAreShadedInBatches)
+{
+    const uint32 tileSize = 4;
+    const uint32 pixelSamplerWidth = 2;
+    boost::shared_ptr<MockFilm> film(new MockFilm(8, 6));
+    CameraConstPtr camera(new MockCamera(film, pixelSamplerWidth));
+    SceneConstPtr scene(new Scene(PropertyMap()));
+    StatsTracker stats;
+    boost::shared_ptr<MockIntegrator> integrator(new MockIntegrator(stats));
+    JobScheduler scheduler;
+
+    PropertyMap props;
+    props.Set<uint32>("tile_size", tileSize);
+    Renderer renderer(props, camera, scene, integrator, scheduler, stats);
+    renderer.Render();
+
+    // Each work area hands the camera rays of all its pixels to the integrator at once
+    const size_t numSamplesPerPixel = pixelSamplerWidth*pixelSamplerWidth;
+    size_t numRays = 0;
+    foreach (size_t batchSize, integrator->BatchSizes())
+    {
+        CHECK(batchSize <= tileSize*tileSize*numSamplesPerPixel);
+        numRays += batchSize;
+    }
+    CHECK(integrator->BatchSizes().size() < NumPixels(*camera));
+    CHECK_EQUAL(NumPixels(*camera)*numSamplesPerPixel, numRays);
+    CHECK_EQUAL(numRays, film->NumSamples());
+}
+
+TEST(CheckBatchRendererRendersEveryCamera)
+{
+    const uint32 prePassPixelSpacing = 2;
+    boost::shared_ptr<MockFilm> film1(new MockFilm(8, 6));
+    boost::shared_ptr<MockFilm> film2(new MockFilm(5, 3));
+    std::vector<CameraConstPtr> cameras;
+    cameras.push_back(CameraConstPtr(new MockCamera(film1, 2)));
+    cameras.push_back(CameraConstPtr(new MockCamera(film2, 3)));
+    SceneConstPtr scene(new Scene(PropertyMap()));
+    StatsTracker stats;
+    boost::shared_ptr<MockIntegrator> integrator(new MockIntegrator(stats, 0, 0, prePassPixelSpacing));
+    JobScheduler scheduler;
+
+    PropertyMap props;
+    props.Set<uint32>("tile_size", 4);
+    BatchRenderer renderer(props, cameras, scene, integrator, scheduler, stats);
+    renderer.Render();
+
+    // The pre-pass goes through the pixels of both cameras
+    CHECK_EQUAL(NumPrePassPixels(*cameras[0], prePassPixelSpacing) + NumPrePassPixels(*cameras[1], prePassPixelSpacing),
+                integrator->NumPrePassRays());
+
+    // Each film gets all the samples of every pixel of its own camera, each one once
+    CHECK_EQUAL(NumPixels(*cameras[0])*2*2, film1->NumSamples());
+    CHECK_EQUAL(NumPixels(*cameras[1])*3*3, film2->NumSamples());
+    foreach (const MockFilm::SampleCountMap::value_type& sample, film1->SampleCounts())
+    {
+        CHECK_EQUAL(1u, sample.second);
+    }
+    foreach (const MockFilm::SampleCountMap::value_type& sample, film2->SampleCounts())
+    {
+        CHECK_EQUAL(1u, sample.second);
+    }
+}
+}
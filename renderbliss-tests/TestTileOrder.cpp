@@ -0,0 +1,125 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "renderbliss/Types.h"
+#include "renderbliss/Rendering/TileOrder.h"
+#include "renderbliss/Utils/PropertyMap.h"
+
+namespace
+{
+using namespace renderbliss;
+
+// Checks that the tiles cover every pixel exactly once
+void CheckTilesCoverPixels(int xStart, int yStart, int xEnd, int yEnd, const std::vector<RenderingWorkArea>& tiles)
+{
+    int width = xEnd-xStart+1, height = yEnd-yStart+1;
+    std::vector<int> coverage(width*height, 0);
+    for (size_t i = 0; i < tiles.size(); ++i)
+    {
+        CHECK(tiles[i].xStart >= xStart && tiles[i].xEnd <= xEnd);
+        CHECK(tiles[i].yStart >= yStart && tiles[i].yEnd <= yEnd);
+        for (int y = tiles[i].yStart; y <= tiles[i].yEnd; ++y)
+        {
+            for (int x = tiles[i].xStart; x <= tiles[i].xEnd; ++x)
+            {
+                ++coverage[(y-yStart)*width + (x-xStart)];
+            }
+        }
+    }
+    for (size_t i = 0; i < coverage.size(); ++i)
+    {
+        CHECK_EQUAL(1, coverage[i]);
+    }
+}
+
+TEST(CheckTileOrderNames)
+{
+    CHECK_EQUAL(TileOrder::Scanline, GetTileOrder("scanline"));
+    CHECK_EQUAL(TileOrder::Morton, GetTileOrder("morton"));
+    CHECK_EQUAL(TileOrder::Hilbert, GetTileOrder("hilbert"));
+    CHECK_EQUAL(TileOrder::Spiral, GetTileOrder("spiral"));
+    CHECK_EQUAL(TileOrder::Invalid, GetTileOrder("random"));
+}
+
+TEST(CheckTileSettings)
+{
+    uint32 tileSize = 0;
+    TileOrder::Enum tileOrder = TileOrder::Invalid;
+    GetTileSettings(PropertyMap(), tileSize, tileOrder);
+    CHECK_EQUAL(16u, tileSize);
+    CHECK_EQUAL(TileOrder::Scanline, tileOrder);
+
+    PropertyMap props;
+    props.Set<uint32>("tile_size", 0);
+    props.Set<std::string>("tile_order", "hilbert");
+    GetTileSettings(props, tileSize, tileOrder);
+    CHECK_EQUAL(1u, tileSize);
+    CHECK_EQUAL(TileOrder::Hilbert, tileOrder);
+
+    props.Set<std::string>("tile_order", "random");
+    GetTileSettings(props, tileSize, tileOrder);
+    CHECK_EQUAL(TileOrder::Scanline, tileOrder);
+}
+
+TEST(CheckTilesCoverImage)
+{
+    const TileOrder::Enum orders[] = {TileOrder::Scanline, TileOrder::Morton, TileOrder::Hilbert, TileOrder::Spiral};
+    for (size_t i = 0; i < 4; ++i)
+    {
+        std::vector<RenderingWorkArea> tiles;
+        MakeTiles(-3, 2, 97, 60, 16, orders[i], tiles);
+        CHECK_EQUAL(7u*4u, tiles.size());
+        CheckTilesCoverPixels(-3, 2, 97, 60, tiles);
+    }
+}
+
+TEST(CheckHilbertTilesAreNeighbours)
+{
+    // On a power of two grid of tiles, each tile along the Hilbert curve shares an edge with the previous one
+    std::vector<RenderingWorkArea> tiles;
+    MakeTiles(0, 0, 127, 127, 8, TileOrder::Hilbert, tiles);
+    CHECK_EQUAL(256u, tiles.size());
+    for (size_t i = 1; i < tiles.size(); ++i)
+    {
+        int dx = std::abs(tiles[i].xStart - tiles[i-1].xStart);
+        int dy = std::abs(tiles[i].yStart - tiles[i-1].yStart);
+        CHECK_EQUAL(8, dx+dy);
+    }
+}
+
+TEST(CheckSpiralTilesStartAtCentre)
+{
+    std::vector<RenderingWorkArea> tiles;
+    MakeTiles(0, 0, 79, 79, 16, TileOrder::Spiral, tiles);
+    CHECK_EQUAL(32, tiles[0].xStart);
+    CHECK_EQUAL(32, tiles[0].yStart);
+
+    // The eight tiles of the first ring come next
+    for (size_t i = 1; i < 9; ++i)
+    {
+        CHECK(std::abs(tiles[i].xStart - 32) <= 16);
+        CHECK(std::abs(tiles[i].yStart - 32) <= 16);
+    }
+}
+}
@@ -0,0 +1,243 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <algorithm>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/thread/thread.hpp>
+#include "renderbliss/Types.h"
+#include "renderbliss/Camera/ThinLensCamera.h"
+#include "renderbliss/Camera/Film/ImageFilm.h"
+#include "renderbliss/Interfaces/IFilter.h"
+#include "renderbliss/Interfaces/IToneMapper.h"
+#include "renderbliss/Math/Geometry/Vector3.h"
+#include "renderbliss/Rendering/TileCoordinator.h"
+#include "renderbliss/Rendering/TileProtocol.h"
+#include "renderbliss/Utils/PropertyMap.h"
+#include "renderbliss/Utils/StatsTracker.h"
+
+namespace
+{
+using namespace renderbliss;
+
+TEST(CheckTileTaskEncoding)
+{
+    TileTask task = {12, 3, 0xdeadbeef, {-2, 13, 16, 31}};
+    std::vector<byte> payload;
+    EncodeTileTask(task, payload);
+    TileTask decodedTask;
+    CHECK(DecodeTileTask(payload, decodedTask));
+    CHECK_EQUAL(task.index, decodedTask.index);
+    CHECK_EQUAL(task.integratorPass, decodedTask.integratorPass);
+    CHECK_EQUAL(task.seed, decodedTask.seed);
+    CHECK_EQUAL(task.workArea.xStart, decodedTask.workArea.xStart);
+    CHECK_EQUAL(task.workArea.xEnd, decodedTask.workArea.xEnd);
+    CHECK_EQUAL(task.workArea.yStart, decodedTask.workArea.yStart);
+    CHECK_EQUAL(task.workArea.yEnd, decodedTask.workArea.yEnd);
+
+    payload.pop_back();
+    CHECK(!DecodeTileTask(payload, decodedTask));
+}
+
+TEST(CheckTileSeedEncoding)
+{
+    std::vector<byte> payload;
+    EncodeTileSeed(0xdeadbeef, payload);
+    uint32 seed = 0;
+    CHECK(DecodeTileSeed(payload, seed));
+    CHECK_EQUAL(0xdeadbeef, seed);
+
+    payload.push_back(0);
+    CHECK(!DecodeTileSeed(payload, seed));
+}
+
+TEST(CheckTileResultEncoding)
+{
+    TileResult result = {7, {0, 3, 4, 9}, std::vector<byte>(100, 42)};
+    std::vector<byte> payload;
+    EncodeTileResult(result, payload);
+    TileResult decodedResult;
+    CHECK(DecodeTileResult(payload, decodedResult));
+    CHECK_EQUAL(result.index, decodedResult.index);
+    CHECK_EQUAL(result.region.yEnd, decodedResult.region.yEnd);
+    CHECK(result.samples == decodedResult.samples);
+
+    payload.resize(10);
+    CHECK(!DecodeTileResult(payload, decodedResult));
+}
+
+TEST(CheckTileSeeds)
+{
+    RenderingWorkArea tile = {16, 31, 32, 47};
+    RenderingWorkArea nextTile = {32, 47, 32, 47};
+    CHECK_EQUAL(TileSeed(1, 0, tile), TileSeed(1, 0, tile));
+    CHECK(TileSeed(1, 0, tile) != TileSeed(1, 0, nextTile));
+    CHECK(TileSeed(1, 0, tile) != TileSeed(1, 1, tile));
+    CHECK(TileSeed(1, 0, tile) != TileSeed(2, 0, tile));
+}
+
+// Connects to the coordinator and receives the integrator seed, as a worker does before preparing its integrator
+bool ConnectToCoordinator(boost::asio::ip::tcp::socket& socket, uint32 port)
+{
+    boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), static_cast<unsigned short>(port));
+    boost::system::error_code error;
+    socket.connect(endpoint, error);
+    std::vector<byte> payload;
+    TileMessage::Enum type = TileMessage::Invalid;
+    uint32 seed = 0;
+    return !error && WriteTileMessage(socket, TileMessage::Request, payload) && ReadTileMessage(socket, type, payload) &&
+           (type == TileMessage::Seed) && DecodeTileSeed(payload, seed);
+}
+
+// Adds a sample at the centre of the pixels of a tile lying in a film
+void AddTileSamples(IFilm& film, const RenderingWorkArea& tile)
+{
+    for (int y = std::max(0, tile.yStart); y <= std::min(static_cast<int>(film.YResolution())-1, tile.yEnd); ++y)
+    {
+        for (int x = std::max(0, tile.xStart); x <= std::min(static_cast<int>(film.XResolution())-1, tile.xEnd); ++x)
+        {
+            FilmSample s = { XYZ(static_cast<real>(x), static_cast<real>(y), 1.0f), {{x+0.5f, y+0.5f}}, 1.0f };
+            film.AddSample(s);
+        }
+    }
+}
+
+// Takes a task without returning it
+void TakeTask(boost::asio::ip::tcp::socket& socket, uint32 port)
+{
+    CHECK(ConnectToCoordinator(socket, port));
+    std::vector<byte> payload;
+    TileMessage::Enum type = TileMessage::Invalid;
+    CHECK(WriteTileMessage(socket, TileMessage::Request, payload));
+    CHECK(ReadTileMessage(socket, type, payload));
+    CHECK_EQUAL(TileMessage::Task, type);
+}
+
+// Takes a task and disconnects, as a worker that crashed
+void RunFailingWorker(uint32 port)
+{
+    boost::asio::io_service ioService;
+    boost::asio::ip::tcp::socket socket(ioService);
+    TakeTask(socket, port);
+}
+
+// Renders the tasks handed out by the coordinator by adding a sample per pixel, and returns the number of tasks
+uint32 RunWorker(uint32 port, uint32 xResolution, uint32 yResolution)
+{
+    boost::asio::io_service ioService;
+    boost::asio::ip::tcp::socket socket(ioService);
+    CHECK(ConnectToCoordinator(socket, port));
+    boost::shared_ptr<IFilm> film(new ImageFilm(xResolution, yResolution, boost::shared_ptr<IFilter>(), boost::shared_ptr<IToneMapper>()));
+    uint32 numTasks = 0;
+    std::vector<byte> payload;
+    TileMessage::Enum type = TileMessage::Request;
+    while (WriteTileMessage(socket, type, payload) && ReadTileMessage(socket, type, payload) && (type == TileMessage::Task))
+    {
+        TileTask task;
+        CHECK(DecodeTileTask(payload, task));
+        AddTileSamples(*film, task.workArea);
+        TileResult result;
+        result.index = task.index;
+        result.region.xStart = std::max(0, task.workArea.xStart);
+        result.region.xEnd = std::min(static_cast<int>(xResolution)-1, task.workArea.xEnd);
+        result.region.yStart = std::max(0, task.workArea.yStart);
+        result.region.yEnd = std::min(static_cast<int>(yResolution)-1, task.workArea.yEnd);
+        film->TakeRegion(result.region, result.samples);
+        EncodeTileResult(result, payload);
+        type = TileMessage::Result;
+        ++numTasks;
+    }
+    CHECK_EQUAL(TileMessage::Done, type);
+    return numTasks;
+}
+
+TEST(CheckTileCoordinator)
+{
+    const uint32 xResolution = 40, yResolution = 24;
+    boost::shared_ptr<IFilm> film(new ImageFilm(xResolution, yResolution, boost::shared_ptr<IFilter>(), boost::shared_ptr<IToneMapper>()));
+    CameraConstPtr camera(new ThinLensCamera(film, 1, Vector3(0.0f, 0.0f, -1.0f), Vector3(0.0f, 0.0f, 0.0f), Vector3::unitY, 60.0f, 1.0f, 0.0f));
+    PropertyMap props;
+    props.Set<uint32>("coordinator_port", 0);
+    props.Set<uint32>("tile_size", 8);
+    StatsTracker stats;
+    TileCoordinator coordinator(props, camera, 2, stats);
+    boost::thread coordinatorThread(boost::bind(&TileCoordinator::Render, &coordinator));
+    uint32 port = coordinator.ListeningPort();
+    CHECK(port != 0);
+
+    // The task abandoned by the failing worker is handed out again
+    RunFailingWorker(port);
+    uint32 numTasks = RunWorker(port, xResolution, yResolution);
+    coordinatorThread.join();
+    CHECK_EQUAL(numTasks, static_cast<uint32>(stats.Counter("Tile Coordinator", "Merged tiles")));
+    CHECK_EQUAL(1u, static_cast<uint32>(stats.Counter("Tile Coordinator", "Reassigned tiles")));
+
+    // Every pixel got one sample per integrator pass
+    boost::shared_ptr<IFilm> expectedFilm(new ImageFilm(xResolution, yResolution, boost::shared_ptr<IFilter>(), boost::shared_ptr<IToneMapper>()));
+    RenderingWorkArea image = {0, xResolution-1, 0, yResolution-1};
+    AddTileSamples(*expectedFilm, image);
+    AddTileSamples(*expectedFilm, image);
+    for (uint32 y = 0; y < yResolution; ++y)
+    {
+        for (uint32 x = 0; x < xResolution; ++x)
+        {
+            CHECK_CLOSE(0.0f, film->RelativeError(x, y), 1.0e-5f);
+        }
+    }
+    RGBPixelList pixels, expectedPixels;
+    film->StorePixels(pixels);
+    expectedFilm->StorePixels(expectedPixels);
+    CHECK_EQUAL(expectedPixels.size(), pixels.size());
+    for (size_t i = 0; i < pixels.size(); ++i)
+    {
+        CHECK_CLOSE(expectedPixels[i].colour.r, pixels[i].colour.r, 1.0e-4f);
+    }
+}
+
+TEST(CheckTileCoordinatorDisconnectsLateWorkers)
+{
+    const uint32 xResolution = 16, yResolution = 16;
+    boost::shared_ptr<IFilm> film(new ImageFilm(xResolution, yResolution, boost::shared_ptr<IFilter>(), boost::shared_ptr<IToneMapper>()));
+    CameraConstPtr camera(new ThinLensCamera(film, 1, Vector3(0.0f, 0.0f, -1.0f), Vector3(0.0f, 0.0f, 0.0f), Vector3::unitY, 60.0f, 1.0f, 0.0f));
+    PropertyMap props;
+    props.Set<uint32>("coordinator_port", 0);
+    props.Set<uint32>("tile_size", 8);
+    props.Set<real>("worker_timeout", 0.2f);
+    StatsTracker stats;
+    TileCoordinator coordinator(props, camera, 1, stats);
+    boost::thread coordinatorThread(boost::bind(&TileCoordinator::Render, &coordinator));
+    uint32 port = coordinator.ListeningPort();
+    CHECK(port != 0);
+
+    // The worker holding a task stays connected, so its task is only handed out again once it is late
+    boost::asio::io_service ioService;
+    boost::asio::ip::tcp::socket lateSocket(ioService);
+    TakeTask(lateSocket, port);
+    uint32 numTasks = RunWorker(port, xResolution, yResolution);
+    coordinatorThread.join();
+    CHECK_EQUAL(numTasks, static_cast<uint32>(stats.Counter("Tile Coordinator", "Merged tiles")));
+    CHECK_EQUAL(1u, static_cast<uint32>(stats.Counter("Tile Coordinator", "Late workers")));
+    CHECK_EQUAL(1u, static_cast<uint32>(stats.Counter("Tile Coordinator", "Reassigned tiles")));
+}
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <vector>
+#include "renderbliss/Macros.h"
+#include "renderbliss/Types.h"
+#include "renderbliss/Rendering/TileOrder.h"
+#include "renderbliss/Rendering/TileTracker.h"
+
+namespace
+{
+using namespace renderbliss;
+
+TEST(CheckTilesCompleteAfterTheirWorkAreas)
+{
+    // Work areas of the sample extents of a 32x16 film, with a filter of half a pixel
+    std::vector<RenderingWorkArea> workAreas;
+    MakeTiles(-1, -1, 32, 16, 8, TileOrder::Scanline, workAreas);
+    TileTracker tracker(32, 16, 8, 0.5f, 0.5f, workAreas);
+
+    // Every work area but the last is rendered. The last one only reaches the tile of the bottom right corner.
+    std::vector<RenderingWorkArea> tiles;
+    for (size_t i = 0; i+1 < workAreas.size(); ++i)
+    {
+        tracker.Complete(workAreas[i], tiles);
+    }
+    CHECK_EQUAL(7u, tiles.size());
+    foreach (const RenderingWorkArea& tile, tiles)
+    {
+        CHECK(tile.xEnd < 24 || tile.yEnd < 8);
+    }
+
+    std::vector<RenderingWorkArea> lastTiles;
+    tracker.Complete(workAreas.back(), lastTiles);
+    CHECK_EQUAL(1u, lastTiles.size());
+    CHECK_EQUAL(24, lastTiles.back().xStart);
+    CHECK_EQUAL(31, lastTiles.back().xEnd);
+    CHECK_EQUAL(8, lastTiles.back().yStart);
+    CHECK_EQUAL(15, lastTiles.back().yEnd);
+
+    // Every tile is reported once
+    std::vector<RenderingWorkArea> remainingTiles;
+    tracker.TakeRemaining(remainingTiles);
+    CHECK(remainingTiles.empty());
+}
+
+TEST(CheckRemainingTilesAreClippedToTheFilm)
+{
+    TileTracker tracker(20, 10, 16, 1.0f, 1.0f, std::vector<RenderingWorkArea>());
+    std::vector<RenderingWorkArea> tiles;
+    tracker.TakeRemaining(tiles);
+    CHECK_EQUAL(2u, tiles.size());
+    CHECK_EQUAL(16, tiles[1].xStart);
+    CHECK_EQUAL(19, tiles[1].xEnd);
+    CHECK_EQUAL(9, tiles[1].yEnd);
+
+    tiles.clear();
+    tracker.TakeRemaining(tiles);
+    CHECK(tiles.empty());
+}
+}
@@ -0,0 +1,97 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <algorithm>
+#include <vector>
+#include "renderbliss/Types.h"
+#include "renderbliss/Interfaces/IJob.h"
+#include "renderbliss/Rendering/WavefrontQueues.h"
+#include "renderbliss/Utils/JobScheduler.h"
+
+namespace
+{
+using namespace renderbliss;
+
+// Appends a range of path indices to a work queue
+class AppendingJob : public IJob
+{
+public:
+
+    AppendingJob(WorkQueue& queue, uint32 begin, uint32 end) : queue(queue), begin(begin), end(end) {}
+
+    virtual void Run() const
+    {
+        std::vector<uint32> pathIndices;
+        for (uint32 i = begin; i < end; ++i)
+        {
+            pathIndices.push_back(i);
+        }
+        queue.Append(pathIndices);
+    }
+
+private:
+
+    WorkQueue& queue;
+    uint32 begin, end;
+};
+
+TEST(CheckWorkQueueConcurrentAppends)
+{
+    const uint32 numPaths = 100000;
+    WorkQueue queue;
+    queue.Reset(numPaths);
+
+    JobScheduler scheduler;
+    JobList jobs;
+    for (uint32 begin = 0; begin < numPaths; begin += 1000)
+    {
+        jobs.push_back(JobConstPtr(new AppendingJob(queue, begin, std::min(numPaths, begin+1000))));
+    }
+    scheduler.Spawn(jobs);
+    scheduler.WaitForAllJobs();
+    CHECK_EQUAL(numPaths, queue.Size());
+
+    // Every index is queued exactly once, in whatever order the jobs ran
+    std::vector<uint32> pathIndices;
+    for (uint32 i = 0; i < queue.Size(); ++i)
+    {
+        pathIndices.push_back(queue[i]);
+    }
+    std::sort(pathIndices.begin(), pathIndices.end());
+    for (uint32 i = 0; i < numPaths; ++i)
+    {
+        CHECK_EQUAL(i, pathIndices[i]);
+    }
+
+    queue.Clear();
+    CHECK_EQUAL(static_cast<uint32>(0), queue.Size());
+}
+
+TEST(CheckShadowRayQueueReserve)
+{
+    ShadowRayQueue queue;
+    queue.Reset(10);
+    CHECK_EQUAL(static_cast<uint32>(0), queue.Reserve(3));
+    CHECK_EQUAL(static_cast<uint32>(3), queue.Reserve(0));
+    CHECK_EQUAL(static_cast<uint32>(3), queue.Reserve(7));
+    CHECK_EQUAL(static_cast<uint32>(10), queue.Size());
+}
+}
@@ -0,0 +1,168 @@
+// Copyright (c) 2008-2011 Yannick Tapsoba.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <UnitTest++.h>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include "renderbliss/Macros.h"
+#include "renderbliss/Scene.h"
+#include "renderbliss/Types.h"
+#include "renderbliss/Camera/ThinLensCamera.h"
+#include "renderbliss/Colour/Spectrum.h"
+#include "renderbliss/Integrators/PathIntegrator.h"
+#include "renderbliss/Interfaces/IFilm.h"
+#include "renderbliss/Lights/Luminaire.h"
+#include "renderbliss/Materials/LambertianMaterial.h"
+#include "renderbliss/Math/Sampling/Filters/BoxFilter.h"
+#include "renderbliss/Primitives/MeshPrimitive.h"
+#include "renderbliss/Primitives/TrianglePrimitive.h"
+#include "renderbliss/Rendering/Renderer.h"
+#include "renderbliss/Rendering/WavefrontRenderer.h"
+#include "renderbliss/Textures/ConstantTexture.h"
+#include "renderbliss/Utils/JobScheduler.h"
+#include "renderbliss/Utils/PropertyMap.h"
+#include "renderbliss/Utils/StatsTracker.h"
+
+namespace
+{
+using namespace renderbliss;
+
+// Averages the luminance of the samples added to the film
+class MeanFilm : public IFilm
+{
+public:
+
+    MeanFilm(uint32 xResolution, uint32 yResolution)
+        : IFilm(xResolution, yResolution, boost::shared_ptr<IFilter>(new BoxFilter)), sum(0.0), numSamples(0)
+    {
+    }
+
+    virtual void AddSample(const FilmSample& s)
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        sum += s.radianceSample.y;
+        ++numSamples;
+    }
+
+    virtual void AddSamples(const std::vector<FilmSample>& samples)
+    {
+        foreach (const FilmSample& s, samples)
+        {
+            AddSample(s);
+        }
+    }
+
+    virtual void StorePixels(RGBPixelList&) const {}
+    virtual void StoreRegion(const RenderingWorkArea&, RGBPixelList&) const {}
+    virtual real RelativeError(uint32, uint32) const { return 0.0f; }
+    virtual void StoreState(std::vector<byte>&) const {}
+    virtual bool RestoreState(const std::vector<byte>&) { return false; }
+    virtual void TakeRegion(const RenderingWorkArea&, std::vector<byte>&) {}
+    virtual bool MergeRegion(const RenderingWorkArea&, const std::vector<byte>&) { return false; }
+
+    double Mean() const { return numSamples ? sum/numSamples : 0.0; }
+
+private:
+
+    boost::mutex mutex;
+    double sum;
+    size_t numSamples;
+};
+
+MeshConstPtr CreateQuad(const Vector3& a, const Vector3& b, const Vector3& c, const Vector3& d, const MaterialConstPtr& material)
+{
+    std::vector<size_t> vertexIndices;
+    vertexIndices.push_back(0);
+    vertexIndices.push_back(1);
+    vertexIndices.push_back(2);
+    vertexIndices.push_back(0);
+    vertexIndices.push_back(2);
+    vertexIndices.push_back(3);
+    std::vector<Vector3> vertices;
+    vertices.push_back(a);
+    vertices.push_back(b);
+    vertices.push_back(c);
+    vertices.push_back(d);
+    return MeshConstPtr(new MeshPrimitive(2, vertexIndices, vertices, std::vector<Vector3>(), std::vector<Vector2>(), material));
+}
+
+// A large square light close above a diffuse floor, in front of a diffuse wall.
+// The light is large enough for BSDF sampling to take a good share of the direct illumination.
+SceneConstPtr CreateScene()
+{
+    MaterialConstPtr material(new LambertianMaterial(TextureConstPtr(new ConstantTexture(Spectrum(0.5f)))));
+    boost::shared_ptr<Scene> scene(new Scene(PropertyMap()));
+    scene->Meshes().push_back(CreateQuad(Vector3(-2.0f, 0.0f, -2.0f), Vector3(-2.0f, 0.0f, 2.0f),
+                                         Vector3(2.0f, 0.0f, 2.0f), Vector3(2.0f, 0.0f, -2.0f), material));
+    scene->Meshes().push_back(CreateQuad(Vector3(-2.0f, 0.0f, 2.0f), Vector3(-2.0f, 3.0f, 2.0f),
+                                         Vector3(2.0f, 3.0f, 2.0f), Vector3(2.0f, 0.0f, 2.0f), material));
+    MeshConstPtr lightMesh(CreateQuad(Vector3(-1.5f, 1.5f, -1.5f), Vector3(1.5f, 1.5f, -1.5f),
+                                      Vector3(1.5f, 1.5f, 1.5f), Vector3(-1.5f, 1.5f, 1.5f), material));
+    TrianglePrimitiveList triangles;
+    lightMesh->Refine(triangles);
+    Luminaire* luminaire = new Luminaire(triangles, Spectrum(1.0f));
+    const_cast<MeshPrimitive*>(lightMesh.get())->SetEmissionProfile(luminaire);
+    scene->Lights().push_back(LightConstPtr(luminaire));
+    scene->Meshes().push_back(lightMesh);
+    scene->PreProcess();
+    return scene;
+}
+
+CameraConstPtr CreateCamera(const boost::shared_ptr<IFilm>& film)
+{
+    return CameraConstPtr(new ThinLensCamera(film, 8, Vector3(0.0f, 0.75f, -3.0f), Vector3(0.0f, 0.75f, 0.0f), Vector3(0.0f, 1.0f, 0.0f), 90.0f, 3.0f, 0.0f));
+}
+
+// Renders the scene with the wavefront renderer and the path integrator, and checks that they agree on the mean radiance
+void CheckMeanRadianceMatchesPathIntegrator(uint32 pathDepth)
+{
+    SceneConstPtr scene = CreateScene();
+    JobScheduler scheduler;
+    PropertyMap props;
+    props.Set<uint32>("path_depth", pathDepth);
+    props.Set<uint32>("shadow_rays", 1);
+
+    boost::shared_ptr<MeanFilm> wavefrontFilm(new MeanFilm(32, 32));
+    StatsTracker wavefrontStats;
+    WavefrontRenderer wavefrontRenderer(props, CreateCamera(wavefrontFilm), scene, scheduler, wavefrontStats);
+    wavefrontRenderer.Render();
+
+    boost::shared_ptr<MeanFilm> pathFilm(new MeanFilm(32, 32));
+    StatsTracker pathStats;
+    SurfaceIntegratorPtr integrator(new PathIntegrator(props, pathStats));
+    Renderer pathRenderer(props, CreateCamera(pathFilm), scene, integrator, scheduler, pathStats);
+    pathRenderer.Render();
+
+    CHECK(pathFilm->Mean() > 0.0);
+    CHECK_CLOSE(1.0, wavefrontFilm->Mean()/pathFilm->Mean(), 0.02);
+}
+
+TEST(CheckDirectIlluminationMatchesPathIntegrator)
+{
+    // Paths end at their first vertex, whose light sample then carries all the direct illumination
+    CheckMeanRadianceMatchesPathIntegrator(1);
+}
+
+TEST(CheckIndirectIlluminationMatchesPathIntegrator)
+{
+    CheckMeanRadianceMatchesPathIntegrator(3);
+}
+}